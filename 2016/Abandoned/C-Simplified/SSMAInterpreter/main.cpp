@@ -1,8 +1,20 @@
 #include "ssm_basic.h"
 #include "ssm_vm.h"
+#include "ssm_benchmark.h"
+#include <cstring>
 
-int main()
+int main(int argc, char **argv)
 {
+	if (argc == 2 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		if (!CheckSandbox())
+			return 1;
+
+		BenchmarkDispatch();
+		BenchmarkScheduler();
+		return 0;
+	}
+
 	uint8_t test[] = {
 		43, 114, 0, 0, 0, 0, 24, 3, 28, 22, 3, 3, 42, 25, 0, 21, 3, 28, 29, 43, 6, 0, 0, 0,
 		24, 3, 27, 21, 3, 29, 43, 6, 0, 0, 0, 24, 3, 2, 29, 44, 26, 21, 29, 44, 0, 22, 3,
@@ -11,8 +23,9 @@ int main()
 		32, 25, 1, 4, 0, 32, 21, 3, 40, 225, 255, 26, 25, 1, 4, 0, 35, 29, 44, 0,
 		22, 10, 29, 43, 45, 0, 0, 0, 24, 3, 26, 44
 	};
-	auto module = SSMModule(test, 0);
-	auto vm = SSMVirtualMachine::Create(module);
+	auto module = SSMModule(test, sizeof(test), 0);
+	// --jit runs the module as native code
+	auto vm = SSMVirtualMachine::Create(module, argc == 2 && strcmp(argv[1], "--jit") == 0);
 	vm->Run();
 
 	return 0;
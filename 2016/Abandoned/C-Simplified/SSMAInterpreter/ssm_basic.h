@@ -148,4 +148,55 @@ struct FrameCallerInfo
 	cpuval_t ESIndex;
 	cpuval_t ES[ESSize];
 };
-#pragma pack(pop)
\ No newline at end of file
+#pragma pack(pop)
+
+const class OpcodeSizeTable
+{
+	size_t _table[256]{}; // zero initialized
+public:
+	OpcodeSizeTable()
+	{
+		_table[SSMAOpCode::term] = sizeof(OP_V);
+		_table[SSMAOpCode::nop] = sizeof(OP_V);
+
+		_table[SSMAOpCode::add] = sizeof(OP_V);
+		_table[SSMAOpCode::sub] = sizeof(OP_V);
+		_table[SSMAOpCode::mul] = sizeof(OP_V);
+		_table[SSMAOpCode::div_] = sizeof(OP_V);
+		_table[SSMAOpCode::mod] = sizeof(OP_V);
+		_table[SSMAOpCode::b_and] = sizeof(OP_V);
+		_table[SSMAOpCode::b_or] = sizeof(OP_V);
+		_table[SSMAOpCode::b_xor] = sizeof(OP_V);
+		_table[SSMAOpCode::b_rev] = sizeof(OP_V);
+
+		_table[SSMAOpCode::push_c0] = sizeof(OP_V);
+		_table[SSMAOpCode::push_c1] = sizeof(OP_V);
+		_table[SSMAOpCode::push_1] = sizeof(OP_U1);
+		_table[SSMAOpCode::push_4] = sizeof(OP_U4);
+		_table[SSMAOpCode::push_r] = sizeof(OP_U1);
+		_table[SSMAOpCode::push_ra] = sizeof(OP_U1U2);
+		_table[SSMAOpCode::pop] = sizeof(OP_V);
+		_table[SSMAOpCode::swap] = sizeof(OP_V);
+		_table[SSMAOpCode::dup] = sizeof(OP_V);
+		_table[SSMAOpCode::rec] = sizeof(OP_V);
+		_table[SSMAOpCode::store_1] = sizeof(OP_V);
+		_table[SSMAOpCode::store_2] = sizeof(OP_V);
+		_table[SSMAOpCode::store_4] = sizeof(OP_V);
+		_table[SSMAOpCode::load_1] = sizeof(OP_V);
+		_table[SSMAOpCode::load_2] = sizeof(OP_V);
+		_table[SSMAOpCode::load_4] = sizeof(OP_V);
+		_table[SSMAOpCode::alloc] = sizeof(OP_U2);
+
+		_table[SSMAOpCode::jmp] = sizeof(OP_S2);
+		_table[SSMAOpCode::jmpz] = sizeof(OP_S2);
+		_table[SSMAOpCode::jmpn] = sizeof(OP_S2);
+		_table[SSMAOpCode::call] = sizeof(OP_U4);
+		_table[SSMAOpCode::ret] = sizeof(OP_V);
+
+	}
+
+	const size_t operator[](SSMAOpCode op) const
+	{
+		return _table[op];
+	}
+} _OpSize;
\ No newline at end of file
@@ -0,0 +1,275 @@
+#pragma once
+#include "ssm_basic.h"
+#include "ssm_cpu.h"
+#include "ssm_memory.h"
+#include "ssm_module.h"
+#include "ssm_scheduler.h"
+#include "ssm_vm.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// test_fab.txt and test_gcd.txt of C-S-Compiler, assembled by hand
+// variables are allocated and accessed the way the compiler does, i.e. alloc 4 and push_ra $RSB
+// NOTE the interpreter has no cmp, so comparisons are lowered to sub and jmpz/jmpn
+static const uint8_t BenchmarkFab[] = {
+	36, 4, 0, 23, 10, 0, 0, 0, 28, 24, 1, 32, 26, 36, 4, 0, 36, 4, 0, 36, 4, 0, 21, 28, 25, 1, 8, 0, 32,
+	26, 21, 28, 25, 1, 12, 0, 32, 26, 36, 4, 0, 24, 1, 35, 22, 3, 3, 42, 101, 0, 36, 4, 0, 22, 2, 28,
+	25, 1, 20, 0, 32, 26, 25, 1, 20, 0, 35, 24, 1, 35, 3, 42, 3, 0, 40, 59, 0, 25, 1, 8, 0, 35, 25, 1,
+	12, 0, 35, 2, 28, 25, 1, 16, 0, 32, 26, 25, 1, 12, 0, 35, 28, 25, 1, 8, 0, 32, 26, 25, 1, 16, 0, 35,
+	28, 25, 1, 12, 0, 32, 26, 25, 1, 20, 0, 35, 21, 2, 28, 25, 1, 20, 0, 32, 26, 40, 182, 255, 25, 1,
+	12, 0, 35, 28, 25, 1, 4, 0, 32, 26, 40, 8, 0, 21, 28, 25, 1, 4, 0, 32, 26, 25, 1, 4, 0, 35, 29, 0
+};
+
+static const uint8_t BenchmarkGcd[] = {
+	36, 4, 0, 36, 4, 0, 23, 8, 0, 0, 0, 28, 24, 1, 32, 26, 23, 42, 0, 0, 0, 28, 25, 1, 4, 0, 32, 26, 24,
+	1, 35, 25, 1, 4, 0, 35, 3, 41, 48, 0, 25, 1, 4, 0, 35, 24, 1, 35, 3, 42, 19, 0, 25, 1, 4, 0, 35, 24,
+	1, 35, 3, 28, 25, 1, 4, 0, 32, 26, 40, 213, 255, 24, 1, 35, 25, 1, 4, 0, 35, 3, 28, 24, 1, 32, 26,
+	40, 196, 255, 24, 1, 35, 29, 0
+};
+
+// offsets of operands of push_4 that initialize variables, i.e. n of test_fab and y of test_gcd
+// inputs are raised so that a run takes long enough to measure
+constexpr size_t BenchmarkFabInput = 4;
+constexpr size_t BenchmarkGcdInput = 17;
+// offsets of results on the stack, i.e. r of test_fab and x of test_gcd
+constexpr size_t BenchmarkFabResult = 4;
+constexpr size_t BenchmarkGcdResult = 0;
+constexpr cpuval_t BenchmarkFabN = 1000000;
+constexpr cpuval_t BenchmarkGcdY = 8000042;
+
+constexpr size_t BenchmarkRunCount = 10;
+constexpr size_t BenchmarkStackSize = 1 * 1024 * 1024; // 1 MB
+
+// short scripts run on the scheduler, i.e. test_fab and test_gcd with small inputs
+constexpr size_t BenchmarkScriptCount = 20000;
+constexpr cpuval_t BenchmarkScriptFabN = 1000;
+constexpr cpuval_t BenchmarkScriptGcdY = 8042;
+
+// hostile modules, which must neither reach memory of the host nor be left running
+//   a load and a store out of memory allocated, which fault
+//   and a function that overwrites the depth of ES, or $RIP, saved in its frame before ret, i.e.
+//   call f; term; f: push_4 1000 (or 3); push_r RSB; push_4 28 (or 36); sub; store_4; ret
+static const uint8_t SandboxWildLoad[] = { 23, 0, 255, 255, 255, 35, 0 };
+static const uint8_t SandboxWildStore[] = { 20, 20, 32, 0 };
+static const uint8_t SandboxForgedDepth[] = { 43, 6, 0, 0, 0, 0, 23, 232, 3, 0, 0, 24, 1, 23, 28, 0, 0, 0, 3, 32, 44 };
+static const uint8_t SandboxForgedRIP[] = { 43, 6, 0, 0, 0, 0, 23, 3, 0, 0, 0, 24, 1, 23, 36, 0, 0, 0, 3, 32, 44 };
+
+// Run a hostile module with Cycle, threaded code and native code, and print the state each ends in
+//   $expected are states of Cycle, threaded code and native code, and returns whether all end so
+//   e.g. native code returns to where it's called regardless of the frame, and threaded code restores ES as verified
+inline bool _CheckSandbox(const char *name, const uint8_t *program, size_t size, const CPUState(&expected)[3])
+{
+	static const char *const names[] = { "terminated", "running", "thrown" };
+	auto nameOf = [](CPUState state) { return names[static_cast<int>(state)]; };
+
+	std::vector<uint8_t> bytes(program, program + size);
+
+	MemoryBus memory;
+	auto module = memory.Load(SSMModule(bytes.data(), bytes.size(), 0));
+	auto stack = memory.Allocate(BenchmarkStackSize);
+
+	CPUState states[3];
+	{
+		SSMCPU cpu(memory, module, stack);
+		for (size_t i = 0; i < 1000 && cpu.GetState() == CPUState::Running; ++i)
+			cpu.Cycle();
+		states[0] = cpu.GetState();
+	}
+	{
+		auto code = ThreadedCode::Decode(module);
+		SSMCPU cpu(memory, module, stack);
+		cpu.Run(code);
+		states[1] = cpu.GetState();
+	}
+
+	auto jit = JitCode::Compile(module);
+	if (jit)
+	{
+		SSMCPU cpu(memory, module, stack);
+		cpu.Run(*jit);
+		states[2] = cpu.GetState();
+	}
+	else
+	{
+		states[2] = expected[2];
+	}
+
+	bool passed = states[0] == expected[0] && states[1] == expected[1] && states[2] == expected[2];
+	printf("sandbox: %s, cycle %s, threaded %s, native %s%s\n", name,
+		nameOf(states[0]), nameOf(states[1]), jit ? nameOf(states[2]) : "not supported", passed ? "" : ", unexpected");
+	return passed;
+}
+
+// run hostile modules, and returns whether all end as expected
+inline bool CheckSandbox()
+{
+	const auto T = CPUState::Terminated, X = CPUState::Thrown;
+	bool passed = true;
+	passed &= _CheckSandbox("wild load", SandboxWildLoad, sizeof(SandboxWildLoad), { X, X, X });
+	passed &= _CheckSandbox("wild store", SandboxWildStore, sizeof(SandboxWildStore), { X, X, X });
+	passed &= _CheckSandbox("forged depth of ES", SandboxForgedDepth, sizeof(SandboxForgedDepth), { X, T, T });
+	passed &= _CheckSandbox("forged $RIP", SandboxForgedRIP, sizeof(SandboxForgedRIP), { X, X, T });
+	return passed;
+}
+
+// Run a program with Cycle, threaded code, fused threaded code and native code, and print instructions per second of each
+inline void _BenchmarkProgram(const char *name, const uint8_t *program, size_t size, size_t inputOffset, cpuval_t input, size_t resultOffset)
+{
+	using clock = std::chrono::steady_clock;
+
+	std::vector<uint8_t> bytes(program, program + size);
+	std::memcpy(&bytes[inputOffset], &input, sizeof(input));
+
+	MemoryBus memory;
+	auto module = memory.Load(SSMModule(bytes.data(), bytes.size(), 0));
+	auto stack = memory.Allocate(BenchmarkStackSize);
+
+	// all run the same instructions, so they're counted once
+	size_t instCount = 0;
+	cpuval_t cycleResult = 0;
+	auto cycleStart = clock::now();
+	for (size_t i = 0; i < BenchmarkRunCount; ++i)
+	{
+		SSMCPU cpu(memory, module, stack);
+		instCount = 0;
+		while (cpu.GetState() == CPUState::Running)
+		{
+			cpu.Cycle();
+			instCount += 1;
+		}
+	}
+	cycleResult = memory.Access<cpuval_t>(stack + resultOffset);
+	auto cycleSeconds = std::chrono::duration<double>(clock::now() - cycleStart).count();
+
+	// threaded code is run as decoded, and with superinstructions fused
+	auto runThreaded = [&](ThreadedCode &code) {
+		auto start = clock::now();
+		for (size_t i = 0; i < BenchmarkRunCount; ++i)
+		{
+			SSMCPU cpu(memory, module, stack);
+			cpu.Run(code);
+		}
+		auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+		auto result = memory.Access<cpuval_t>(stack + resultOffset);
+		if (result != cycleResult)
+			printf("%s: result %u of threaded code differs from %u\n", name, result, cycleResult);
+
+		return seconds;
+	};
+
+	auto code = ThreadedCode::Decode(module, false);
+	auto fusedCode = ThreadedCode::Decode(module);
+	auto threadedSeconds = runThreaded(code);
+	auto fusedSeconds = runThreaded(fusedCode);
+
+	auto cycleRate = instCount * BenchmarkRunCount / cycleSeconds / 1e6;
+	auto threadedRate = instCount * BenchmarkRunCount / threadedSeconds / 1e6;
+	auto fusedRate = instCount * BenchmarkRunCount / fusedSeconds / 1e6;
+	printf("%s: %zu instructions, result %u, cycle %.1f M inst/s, threaded %.1f M inst/s, %.2fx\n",
+		name, instCount, cycleResult, cycleRate, threadedRate, threadedRate / cycleRate);
+	printf("%s: %zu instructions fused into %zu handlers, %.1f M inst/s, %.2fx\n",
+		name, fusedCode.GetInstructionCount(), fusedCode.GetHandlerCount(), fusedRate, fusedRate / cycleRate);
+
+	auto jit = JitCode::Compile(module);
+	if (!jit)
+	{
+		printf("%s: native code is not supported, which is interpreted\n", name);
+		return;
+	}
+
+	auto jitStart = clock::now();
+	for (size_t i = 0; i < BenchmarkRunCount; ++i)
+	{
+		SSMCPU cpu(memory, module, stack);
+		cpu.Run(*jit);
+	}
+	auto jitSeconds = std::chrono::duration<double>(clock::now() - jitStart).count();
+
+	auto jitResult = memory.Access<cpuval_t>(stack + resultOffset);
+	if (jitResult != cycleResult)
+		printf("%s: result %u of native code differs from %u\n", name, jitResult, cycleResult);
+
+	auto jitRate = instCount * BenchmarkRunCount / jitSeconds / 1e6;
+	printf("%s: %zu bytes of native code, %.1f M inst/s, %.2fx\n",
+		name, jit->GetCodeSize(), jitRate, jitRate / cycleRate);
+}
+
+// run test_fab and test_gcd, and compare the dispatch of Cycle with threaded code, with and without superinstructions,
+// and with native code
+inline void BenchmarkDispatch()
+{
+#ifdef SSMA_THREADED_DISPATCH
+	printf("threaded code is dispatched by computed goto\n");
+#else
+	printf("threaded code is dispatched by switch\n");
+#endif
+
+	_BenchmarkProgram("test_fab", BenchmarkFab, sizeof(BenchmarkFab), BenchmarkFabInput, BenchmarkFabN, BenchmarkFabResult);
+	_BenchmarkProgram("test_gcd", BenchmarkGcd, sizeof(BenchmarkGcd), BenchmarkGcdInput, BenchmarkGcdY, BenchmarkGcdResult);
+}
+
+// run short scripts one by one, each on a vm created on its own, and on a scheduler, and print scripts per second of each
+inline void BenchmarkScheduler()
+{
+	using clock = std::chrono::steady_clock;
+
+	std::vector<uint8_t> fab(BenchmarkFab, BenchmarkFab + sizeof(BenchmarkFab));
+	std::vector<uint8_t> gcd(BenchmarkGcd, BenchmarkGcd + sizeof(BenchmarkGcd));
+	std::memcpy(&fab[BenchmarkFabInput], &BenchmarkScriptFabN, sizeof(cpuval_t));
+	std::memcpy(&gcd[BenchmarkGcdInput], &BenchmarkScriptGcdY, sizeof(cpuval_t));
+
+	const SSMModule modules[] = { SSMModule(fab.data(), fab.size(), 0), SSMModule(gcd.data(), gcd.size(), 0) };
+	const size_t resultOffsets[] = { BenchmarkFabResult, BenchmarkGcdResult };
+	auto result = [&](SSMVirtualMachine &vm, size_t k) {
+		return vm.GetMemory().Access<cpuval_t>(vm.GetStack() + resultOffsets[k]);
+	};
+
+	// scripts alternate between test_fab and test_gcd
+	cpuval_t results[2] = {};
+	size_t instCount = 0;
+	auto serialStart = clock::now();
+	for (size_t i = 0; i < BenchmarkScriptCount; ++i)
+	{
+		auto vm = SSMVirtualMachine::Create(modules[i % 2]);
+		vm->Run();
+		results[i % 2] = result(*vm, i % 2);
+		instCount += vm->GetInstructionCount();
+	}
+	auto serialSeconds = std::chrono::duration<double>(clock::now() - serialStart).count();
+
+	std::atomic<size_t> mismatchCount{ 0 }, runCount{ 0 };
+	std::atomic<long long> runTime{ 0 };
+	size_t workerCount = std::thread::hardware_concurrency();
+	auto scheduledStart = clock::now();
+	{
+		SSMScheduler scheduler(workerCount);
+		for (size_t i = 0; i < BenchmarkScriptCount; ++i)
+		{
+			auto k = i % 2;
+			scheduler.Submit(modules[k], [&, k](SSMVirtualMachine &vm) {
+				if (vm.GetState() != CPUState::Terminated || result(vm, k) != results[k])
+					mismatchCount += 1;
+
+				runCount += vm.GetRunCount();
+				runTime += std::chrono::duration_cast<std::chrono::nanoseconds>(vm.GetRunTime()).count();
+			});
+		}
+
+		scheduler.Wait();
+	}
+	auto scheduledSeconds = std::chrono::duration<double>(clock::now() - scheduledStart).count();
+
+	if (mismatchCount > 0)
+		printf("scheduler: %zu scripts differ in results\n", mismatchCount.load());
+
+	auto serialRate = BenchmarkScriptCount / serialSeconds / 1e3;
+	auto scheduledRate = BenchmarkScriptCount / scheduledSeconds / 1e3;
+	printf("scheduler: %zu scripts, %zu instructions, one by one %.1f K scripts/s, on %zu workers %.1f K scripts/s, %.2fx\n",
+		BenchmarkScriptCount, instCount, serialRate, workerCount, scheduledRate, scheduledRate / serialRate);
+	printf("scheduler: %.2f slices of %zu instructions, and %.1f us of cpu time per script\n",
+		static_cast<double>(runCount) / BenchmarkScriptCount, SSMScheduler::DefaultSliceSize, runTime / 1e3 / BenchmarkScriptCount);
+}
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 #include "ssm_basic.h"
 #include "ssm_util.h"
+#include "ssm_memory.h"
+#include "ssm_module.h"
+#include "ssm_threaded.h"
+#include "ssm_jit.h"
+#include <cstdint>
 
 class SSMCPU
 {
@@ -8,6 +13,10 @@ class SSMCPU
 	cpuval_t _es[ESSize];
 	size_t _esIndex = 0;
 	CPUState _state = CPUState::Terminated;
+	// memory where addresses in registers and ES are mapped
+	MemoryBus *_memory = nullptr;
+	// instructions executed by Cycle and threaded code, but not native code
+	size_t _instCount = 0;
 
 	// Unwrap a register as a cpuval_t
 	cpuval_t &_Unwrap(Register reg);
@@ -23,12 +32,15 @@ class SSMCPU
 	cpuval_t _ESPop();
 	// Peek the top of ES(Evaluation Stack)
 	cpuval_t _ESPeek();
+	// Execute an instruction, or threaded code, without guarding memory
+	void _Cycle();
+	void _Run(ThreadedCode &code, size_t budget);
 
 public:
 	// construct and initialize
-	SSMCPU(uint8_t *ip, size_t instOffset, uint8_t *sp)
+	SSMCPU(MemoryBus &memory, const SSMModule &module, cpuval_t stack)
 	{
-		Initialize(ip, instOffset, sp);
+		Initialize(memory, module, stack);
 	}
 
 	// construct an uninitialized cpu instance
@@ -37,62 +49,26 @@ public:
 	SSMCPU(SSMCPU &&) = delete;
 
 	CPUState GetState() { return _state; }
-	void Initialize(uint8_t *ip, size_t instOffset, uint8_t *sp);
+	// instructions executed since initialized, except those of native code
+	//   instructions of a block are counted when it ends, so a block faulting is not counted
+	size_t GetInstructionCount() const { return _instCount; }
+	// Initialize registers to run a module loaded into $memory, whose stack is at $stack
+	void Initialize(MemoryBus &memory, const SSMModule &module, cpuval_t stack);
 	// Execute an instruction and move forward
+	//   an access to memory unallocated leaves the cpu thrown, as does one in Run
 	void Cycle();
+	// Execute threaded code from $RIP until termination
+	//   $RIP and ES are brought up to date when the code terminates
+	void Run(ThreadedCode &code);
+	// Execute threaded code from $RIP until termination, or until $budget instructions are executed
+	//   which yields at the end of a block, so that a block may run over $budget
+	//   the cpu is left running if it yields, with $RIP and ES up to date, and resumes by another Run
+	void Run(ThreadedCode &code, size_t budget);
+	// Execute native code from its entry until termination
+	//   $RIP and ES are brought up to date when the code terminates
+	void Run(const JitCode &code);
 };
 
-const class OpcodeSizeTable
-{
-	size_t _table[256]{}; // zero initialized
-public:
-	OpcodeSizeTable()
-	{
-		_table[SSMAOpCode::term] = sizeof(OP_V);
-		_table[SSMAOpCode::nop] = sizeof(OP_V);
-
-		_table[SSMAOpCode::add] = sizeof(OP_V);
-		_table[SSMAOpCode::sub] = sizeof(OP_V);
-		_table[SSMAOpCode::mul] = sizeof(OP_V);
-		_table[SSMAOpCode::div_] = sizeof(OP_V);
-		_table[SSMAOpCode::mod] = sizeof(OP_V);
-		_table[SSMAOpCode::b_and] = sizeof(OP_V);
-		_table[SSMAOpCode::b_or] = sizeof(OP_V);
-		_table[SSMAOpCode::b_xor] = sizeof(OP_V);
-		_table[SSMAOpCode::b_rev] = sizeof(OP_V);
-
-		_table[SSMAOpCode::push_c0] = sizeof(OP_V);
-		_table[SSMAOpCode::push_c1] = sizeof(OP_V);
-		_table[SSMAOpCode::push_1] = sizeof(OP_U1);
-		_table[SSMAOpCode::push_4] = sizeof(OP_U4);
-		_table[SSMAOpCode::push_r] = sizeof(OP_U1);
-		_table[SSMAOpCode::push_ra] = sizeof(OP_U1U2);
-		_table[SSMAOpCode::pop] = sizeof(OP_V);
-		_table[SSMAOpCode::swap] = sizeof(OP_V);
-		_table[SSMAOpCode::dup] = sizeof(OP_V);
-		_table[SSMAOpCode::rec] = sizeof(OP_V);
-		_table[SSMAOpCode::store_1] = sizeof(OP_V);
-		_table[SSMAOpCode::store_2] = sizeof(OP_V);
-		_table[SSMAOpCode::store_4] = sizeof(OP_V);
-		_table[SSMAOpCode::load_1] = sizeof(OP_V);
-		_table[SSMAOpCode::load_2] = sizeof(OP_V);
-		_table[SSMAOpCode::load_4] = sizeof(OP_V);
-		_table[SSMAOpCode::alloc] = sizeof(OP_U2);
-
-		_table[SSMAOpCode::jmp] = sizeof(OP_S2);
-		_table[SSMAOpCode::jmpz] = sizeof(OP_S2);
-		_table[SSMAOpCode::jmpn] = sizeof(OP_S2);
-		_table[SSMAOpCode::call] = sizeof(OP_U4);
-		_table[SSMAOpCode::ret] = sizeof(OP_V);
-
-	}
-
-	const size_t operator[](SSMAOpCode op) const
-	{
-		return _table[op];
-	}
-} _OpSize;
-
 //==========================================================================
 // impl. for SSMACPU
 
@@ -108,7 +84,7 @@ inline cpuval_t &SSMCPU::_Unwrap(Register reg)
 inline OP_V *SSMCPU::_Fetch()
 {
 	// retrive $RIP
-	auto &&rip = reinterpret_cast<OP_V*>(_Unwrap(Register::RIP));
+	auto &&rip = _memory->FetchOp(_Unwrap(Register::RIP));
 	// advance $RIP
 	_Unwrap(Register::RIP) += _OpSize[rip->Code];
 	// return reinterpreted $RIP 
@@ -141,26 +117,37 @@ inline cpuval_t SSMCPU::_ESPeek()
 	return _es[_esIndex - 1];
 }
 
-inline void SSMCPU::Initialize(uint8_t *ip, size_t instOffset, uint8_t *sp)
+inline void SSMCPU::Initialize(MemoryBus &memory, const SSMModule &module, cpuval_t stack)
 {
+	_memory = &memory;
+
 	// initialize registers
-	_Unwrap(Register::RIP) = reinterpret_cast<cpuval_t>(ip) + instOffset;
-	_Unwrap(Register::RSB) = reinterpret_cast<cpuval_t>(sp);
-	_Unwrap(Register::RST) = reinterpret_cast<cpuval_t>(sp);
+	_Unwrap(Register::RIP) = module.Address + static_cast<cpuval_t>(module.InstOffset);
+	_Unwrap(Register::RSB) = stack;
+	_Unwrap(Register::RST) = stack;
 	_Unwrap(Register::RTD) = 0;
-	_Unwrap(Register::RMB) = reinterpret_cast<cpuval_t>(ip);
+	_Unwrap(Register::RMB) = module.Address;
 
 	// initialize Evaluation Stack
-	// ...
+	_esIndex = 0;
 
+	_instCount = 0;
 	_state = CPUState::Running;
 }
 
-// opcode is interpreted via switch clause
 inline void SSMCPU::Cycle()
 {
 	_Assert(_state == CPUState::Running);
 
+	if (!_memory->Guard([this]() { _Cycle(); }))
+		_state = CPUState::Thrown;
+	else if (_state != CPUState::Thrown)
+		_instCount += 1;
+}
+
+// opcode is interpreted via switch clause
+inline void SSMCPU::_Cycle()
+{
 	// fetch instruction and move forward
 	const auto &&op = _Fetch();
 
@@ -257,38 +244,38 @@ inline void SSMCPU::Cycle()
 		break;
 	case SSMAOpCode::store_1:
 	{
-		uint8_t *&&p = reinterpret_cast<uint8_t*>(_ESPop());
-		*p = _ESPop();
+		auto &&p = _ESPop();
+		_memory->Access<uint8_t>(p) = static_cast<uint8_t>(_ESPop());
 		break;
 	}
 	case SSMAOpCode::store_2:
 	{
-		uint16_t *&&p = reinterpret_cast<uint16_t*>(_ESPop());
-		*p = _ESPop();
+		auto &&p = _ESPop();
+		_memory->Access<uint16_t>(p) = static_cast<uint16_t>(_ESPop());
 		break;
 	}
 	case SSMAOpCode::store_4:
 	{
-		uint32_t *&&p = reinterpret_cast<uint32_t*>(_ESPop());
-		*p = _ESPop();
+		auto &&p = _ESPop();
+		_memory->Access<uint32_t>(p) = static_cast<uint32_t>(_ESPop());
 		break;
 	}
 	case SSMAOpCode::load_1:
 	{
-		uint8_t *&&p = reinterpret_cast<uint8_t*>(_ESPop());
-		_ESPush(*p);
+		auto &&p = _ESPop();
+		_ESPush(_memory->Access<uint8_t>(p));
 		break;
 	}
 	case SSMAOpCode::load_2:
 	{
-		uint16_t *&&p = reinterpret_cast<uint16_t*>(_ESPop());
-		_ESPush(*p);
+		auto &&p = _ESPop();
+		_ESPush(_memory->Access<uint16_t>(p));
 	}
 		break;	
 	case SSMAOpCode::load_4:
 	{
-		uint32_t *&&p = reinterpret_cast<uint32_t*>(_ESPop());
-		_ESPush(*p);
+		auto &&p = _ESPop();
+		_ESPush(_memory->Access<uint32_t>(p));
 		break;
 	}
 	case SSMAOpCode::alloc:
@@ -315,15 +302,16 @@ inline void SSMCPU::Cycle()
 		// $RMB
 		// ES Index
 		// ES
-		FrameCallerInfo *info = reinterpret_cast<FrameCallerInfo*>(_Unwrap(Register::RST));
+		FrameCallerInfo *info = &_memory->Access<FrameCallerInfo>(_Unwrap(Register::RST));
 		info->RSB = _Unwrap(Register::RSB);
 		info->RIP = _Unwrap(Register::RIP);
 		info->RMB = _Unwrap(Register::RMB);
 		info->ESIndex = _esIndex;
-		for (int i = 0; i < ESSize;++i)
+		// only the live part of ES is saved
+		for (size_t i = 0; i < _esIndex; ++i)
 			info->ES[i] = _es[i];
 
-		auto &&stk_pval = reinterpret_cast<cpuval_t>(info + 1);
+		auto &&stk_pval = _Unwrap(Register::RST) + static_cast<cpuval_t>(sizeof(FrameCallerInfo));
 		_Unwrap(Register::RSB) = stk_pval;
 		_Unwrap(Register::RST) = stk_pval;
 		_Unwrap(Register::RIP) = _Unwrap(Register::RMB) + op->As<OP_U4>()->Operand1;
@@ -339,13 +327,23 @@ inline void SSMCPU::Cycle()
 		// $RMB
 		// ES Index
 		// ES
-		FrameCallerInfo *info = reinterpret_cast<FrameCallerInfo*>(_Unwrap(Register::RSB)) - 1;
+		auto &&address = _Unwrap(Register::RSB) - static_cast<cpuval_t>(sizeof(FrameCallerInfo));
+		FrameCallerInfo *info = &_memory->Access<FrameCallerInfo>(address);
 		_Unwrap(Register::RIP) = info->RIP;
 		_Unwrap(Register::RSB) = info->RSB;
 		_Unwrap(Register::RMB) = info->RMB;
-		_Unwrap(Register::RST) = reinterpret_cast<cpuval_t>(info);
+		_Unwrap(Register::RST) = address;
+
+		// the frame is in memory of the vm, which may have overwritten it
+		//   a depth beyond ES faults the cpu, as an access to memory unallocated does
+		if (info->ESIndex > ESSize)
+		{
+			_state = CPUState::Thrown;
+			break;
+		}
+
 		_esIndex = info->ESIndex;
-		for (int i = 0; i < ESSize; ++i)
+		for (size_t i = 0; i < _esIndex; ++i)
 			_es[i] = info->ES[i];
 
 		break;
@@ -354,4 +352,388 @@ inline void SSMCPU::Cycle()
 	default:
 		throw 0;
 	}
+}
+
+// threaded code is interpreted via computed goto, or a switch clause if not supported
+// $ip points to the operands of the instruction being executed
+#ifdef SSMA_THREADED_DISPATCH
+#define SSMA_HANDLER(op) _handle_##op:
+#define SSMA_DISPATCH() goto *(ip++)->Handler
+#else
+#define SSMA_HANDLER(op) case ThreadedOp::op:
+#define SSMA_DISPATCH() continue
+#endif
+// charge instructions of a block that ends, and yield if the budget runs out
+//   $ip is set to the next instruction before, which is a leader
+#define SSMA_CHARGE(count) if ((left -= static_cast<int64_t>(count)) <= 0) goto _yield
+
+inline void SSMCPU::Run(ThreadedCode &code)
+{
+	Run(code, INT64_MAX);
+}
+
+inline void SSMCPU::Run(ThreadedCode &code, size_t budget)
+{
+	_Assert(_state == CPUState::Running);
+
+	if (!_memory->Guard([&]() { _Run(code, budget); }))
+		_state = CPUState::Thrown;
+}
+
+inline void SSMCPU::_Run(ThreadedCode &code, size_t budget)
+{
+#ifdef SSMA_THREADED_DISPATCH
+	// NOTE in the order of ThreadedOp
+	static const void *const handlers[] = {
+		&&_handle_term, &&_handle_nop,
+		&&_handle_add, &&_handle_sub, &&_handle_mul, &&_handle_div_, &&_handle_mod,
+		&&_handle_b_and, &&_handle_b_or, &&_handle_b_xor, &&_handle_b_rev,
+		&&_handle_push_c0, &&_handle_push_c1, &&_handle_push_i, &&_handle_push_r, &&_handle_push_ra,
+		&&_handle_pop, &&_handle_swap, &&_handle_dup, &&_handle_rec,
+		&&_handle_store_1, &&_handle_store_2, &&_handle_store_4,
+		&&_handle_load_1, &&_handle_load_2, &&_handle_load_4, &&_handle_alloc,
+		&&_handle_jmp, &&_handle_jmpz, &&_handle_jmpn, &&_handle_call, &&_handle_ret, &&_handle_tick,
+		&&_handle_load_ra, &&_handle_store_ra, &&_handle_add_i, &&_handle_sub_i,
+		&&_handle_sub_jmpz, &&_handle_sub_jmpn, &&_handle_sub_i_jmpz, &&_handle_sub_i_jmpn, &&_handle_push_r_dup,
+		&&_handle_invalid,
+	};
+	static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<size_t>(ThreadedOp::Count), "a handler is missing");
+
+	code.Thread(handlers);
+#endif
+
+	// the cpu is initialized at the entry, or has yielded at a leader, with ES as deep as verified
+	const ThreadedSlot *ip = code.Locate(_Unwrap(Register::RIP) - _Unwrap(Register::RMB));
+	_Assert(code.DepthAt(_Unwrap(Register::RIP) - _Unwrap(Register::RMB)) == _esIndex);
+	// addresses are offsets from the base of memory
+	uint8_t *const base = _memory->GetBase();
+	// instructions left to execute, which may run below 0 by a block
+	const auto limit = static_cast<int64_t>(budget < INT64_MAX ? budget : INT64_MAX);
+	auto left = limit;
+
+	// ES is kept in locals, where the top is cached in $tos, and $sp points to the value under it
+	//   with depth d, values under the top are es[2..d], so that es[0..1] are never read as live values
+	//   ES is verified when decoded, so neither overflow nor underflow is checked here
+	cpuval_t es[ESSize + 1] = {};
+	cpuval_t *sp = es + _esIndex;
+	cpuval_t tos = _esIndex > 0 ? _es[_esIndex - 1] : 0;
+	for (size_t i = 0; i + 1 < _esIndex; ++i)
+		es[i + 2] = _es[i];
+
+#ifdef SSMA_THREADED_DISPATCH
+	SSMA_DISPATCH();
+#else
+	for (;;) switch (static_cast<ThreadedOp>((ip++)->Op))
+	{
+#endif
+
+	// termination
+	SSMA_HANDLER(term)
+		_Unwrap(Register::RIP) = ip[0].Value;
+		left -= static_cast<int64_t>(ip[1].Value);
+
+		_state = CPUState::Terminated;
+		goto _leave;
+	// nop
+	SSMA_HANDLER(nop)
+		SSMA_DISPATCH();
+
+	// arithmetic operations
+	SSMA_HANDLER(add)
+		tos = *sp-- + tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(sub)
+		tos = *sp-- - tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(mul)
+		tos = *sp-- * tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(div_)
+		tos = *sp-- / tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(mod)
+		tos = *sp-- % tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(b_and)
+		tos = *sp-- & tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(b_or)
+		tos = *sp-- | tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(b_xor)
+		tos = *sp-- ^ tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(b_rev)
+		tos = ~tos;
+		SSMA_DISPATCH();
+
+	// ES operations
+	SSMA_HANDLER(push_c0)
+		*++sp = tos;
+		tos = 0;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(push_c1)
+		*++sp = tos;
+		tos = 1;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(push_i)
+		*++sp = tos;
+		tos = ip[0].Value;
+		ip += 1;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(push_r)
+		*++sp = tos;
+		tos = _Unwrap(static_cast<Register>(ip[0].Value));
+		ip += 1;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(push_ra)
+		*++sp = tos;
+		tos = _Unwrap(static_cast<Register>(ip[0].Value)) + ip[1].Value;
+		ip += 2;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(pop)
+		tos = *sp--;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(swap)
+	{
+		cpuval_t tmp = *sp;
+		*sp = tos;
+		tos = tmp;
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(dup)
+		*++sp = tos;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(rec)
+		_Unwrap(Register::RTD) = tos;
+		tos = *sp--;
+		SSMA_DISPATCH();
+	// the address is on the top, and the value is under it
+	SSMA_HANDLER(store_1)
+		*reinterpret_cast<uint8_t*>(base + tos) = static_cast<uint8_t>(sp[0]);
+		tos = sp[-1];
+		sp -= 2;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(store_2)
+		*reinterpret_cast<uint16_t*>(base + tos) = static_cast<uint16_t>(sp[0]);
+		tos = sp[-1];
+		sp -= 2;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(store_4)
+		*reinterpret_cast<uint32_t*>(base + tos) = sp[0];
+		tos = sp[-1];
+		sp -= 2;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(load_1)
+		tos = *reinterpret_cast<uint8_t*>(base + tos);
+		SSMA_DISPATCH();
+	SSMA_HANDLER(load_2)
+		tos = *reinterpret_cast<uint16_t*>(base + tos);
+		SSMA_DISPATCH();
+	SSMA_HANDLER(load_4)
+		tos = *reinterpret_cast<uint32_t*>(base + tos);
+		SSMA_DISPATCH();
+	SSMA_HANDLER(alloc)
+		_Unwrap(Register::RST) += ip[0].Value;
+		ip += 1;
+		SSMA_DISPATCH();
+
+	// flow control
+	SSMA_HANDLER(jmp)
+	{
+		auto count = ip[1].Value;
+		ip = ip[0].Target;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(jmpz)
+	{
+		auto cond = tos, count = ip[1].Value;
+		tos = *sp--;
+		ip = cond == 0 ? ip[0].Target : ip + 2;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(jmpn)
+	{
+		auto cond = tos, count = ip[1].Value;
+		tos = *sp--;
+		ip = IsNegative(cond) ? ip[0].Target : ip + 2;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(call)
+	{
+		// see Cycle for the layout of caller info
+		//   only the live part of ES is saved, in the order of _es
+		FrameCallerInfo *info = reinterpret_cast<FrameCallerInfo*>(base + _Unwrap(Register::RST));
+		info->RSB = _Unwrap(Register::RSB);
+		info->RIP = ip[1].Value;
+		info->RMB = _Unwrap(Register::RMB);
+
+		auto depth = static_cast<cpuval_t>(sp - es);
+		info->ESIndex = depth;
+		for (cpuval_t i = 0; i + 1 < depth; ++i)
+			info->ES[i] = es[i + 2];
+		if (depth > 0)
+			info->ES[depth - 1] = tos;
+
+		auto &&stk_pval = _Unwrap(Register::RST) + static_cast<cpuval_t>(sizeof(FrameCallerInfo));
+		_Unwrap(Register::RSB) = stk_pval;
+		_Unwrap(Register::RST) = stk_pval;
+		sp = es;
+
+		auto count = ip[2].Value;
+		ip = ip[0].Target;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(ret)
+	{
+		auto count = ip[0].Value;
+		auto address = _Unwrap(Register::RSB) - static_cast<cpuval_t>(sizeof(FrameCallerInfo));
+		FrameCallerInfo *info = reinterpret_cast<FrameCallerInfo*>(base + address);
+		_Unwrap(Register::RSB) = info->RSB;
+		_Unwrap(Register::RMB) = info->RMB;
+		_Unwrap(Register::RST) = address;
+
+		// $RIP of the caller is an address, which is located in the threaded code
+		//   ES is restored to the depth verified for the instruction returned to, not to the depth saved in the frame,
+		//   which is in memory of the vm and may be overwritten by it
+		//   a frame that returns to no instruction decoded faults the cpu, see Cycle
+		auto offset = info->RIP - _Unwrap(Register::RMB);
+		if (!code.Contains(offset))
+		{
+			_state = CPUState::Thrown;
+			return;
+		}
+		ip = code.Locate(offset);
+
+		auto depth = code.DepthAt(offset);
+		for (size_t i = 0; i + 1 < depth; ++i)
+			es[i + 2] = info->ES[i];
+		if (depth > 0)
+			tos = info->ES[depth - 1];
+		sp = es + depth;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(tick)
+	{
+		auto count = ip[0].Value;
+		ip += 1;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+
+	// superinstructions
+	SSMA_HANDLER(load_ra)
+		*++sp = tos;
+		tos = *reinterpret_cast<uint32_t*>(base + static_cast<cpuval_t>(_Unwrap(static_cast<Register>(ip[0].Value)) + ip[1].Value));
+		ip += 2;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(store_ra)
+		*reinterpret_cast<uint32_t*>(base + static_cast<cpuval_t>(_Unwrap(static_cast<Register>(ip[0].Value)) + ip[1].Value)) = tos;
+		tos = *sp--;
+		ip += 2;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(add_i)
+		tos += ip[0].Value;
+		ip += 1;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(sub_i)
+		tos -= ip[0].Value;
+		ip += 1;
+		SSMA_DISPATCH();
+	SSMA_HANDLER(sub_jmpz)
+	{
+		auto diff = sp[0] - tos, count = ip[1].Value;
+		tos = sp[-1];
+		sp -= 2;
+		ip = diff == 0 ? ip[0].Target : ip + 2;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(sub_jmpn)
+	{
+		auto diff = sp[0] - tos, count = ip[1].Value;
+		tos = sp[-1];
+		sp -= 2;
+		ip = IsNegative(diff) ? ip[0].Target : ip + 2;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(sub_i_jmpz)
+	{
+		auto diff = tos - ip[1].Value, count = ip[2].Value;
+		tos = *sp--;
+		ip = diff == 0 ? ip[0].Target : ip + 3;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(sub_i_jmpn)
+	{
+		auto diff = tos - ip[1].Value, count = ip[2].Value;
+		tos = *sp--;
+		ip = IsNegative(diff) ? ip[0].Target : ip + 3;
+		SSMA_CHARGE(count);
+		SSMA_DISPATCH();
+	}
+	SSMA_HANDLER(push_r_dup)
+		sp[1] = tos;
+		tos = _Unwrap(static_cast<Register>(ip[0].Value));
+		sp[2] = tos;
+		sp += 2;
+		ip += 1;
+		SSMA_DISPATCH();
+
+	SSMA_HANDLER(invalid)
+		throw 0;
+
+#ifndef SSMA_THREADED_DISPATCH
+	default:
+		throw 0;
+	}
+#endif
+
+	// the budget runs out
+_yield:
+	_Unwrap(Register::RIP) = _Unwrap(Register::RMB) + code.OffsetOf(ip);
+
+	// bring ES and the count up to date when the code terminates or yields
+_leave:
+	_esIndex = sp - es;
+	for (size_t i = 0; i + 1 < _esIndex; ++i)
+		_es[i] = es[i + 2];
+	if (_esIndex > 0)
+		_es[_esIndex - 1] = tos;
+
+	_instCount += static_cast<size_t>(limit - left);
+}
+
+#undef SSMA_HANDLER
+#undef SSMA_DISPATCH
+#undef SSMA_CHARGE
+
+inline void SSMCPU::Run(const JitCode &code)
+{
+	_Assert(_state == CPUState::Running);
+
+	JitExit exit{};
+	if (!_memory->Guard([&]() { code.Run(_reg, _memory->GetBase(), exit); }))
+	{
+		_state = CPUState::Thrown;
+		return;
+	}
+
+	// an unknown opcode, or a ret from the entry, leaves native code without termination
+	if (!exit.Terminated)
+		throw 0;
+
+	_Unwrap(Register::RIP) = exit.RIP;
+	_esIndex = exit.ESIndex;
+	for (size_t i = 0; i < _esIndex; ++i)
+		_es[i] = exit.ES[i];
+
+	_state = CPUState::Terminated;
 }
\ No newline at end of file
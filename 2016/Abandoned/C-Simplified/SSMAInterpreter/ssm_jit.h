@@ -0,0 +1,789 @@
+#pragma once
+#include "ssm_basic.h"
+#include "ssm_module.h"
+#include "ssm_threaded.h"
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+// native code is generated for x86-64 only, elsewhere modules are always interpreted
+#if defined(__x86_64__) || defined(_M_X64)
+#define SSMA_JIT_SUPPORTED
+#endif
+
+#ifdef SSMA_JIT_SUPPORTED
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+// state left by native code when it exits, which the cpu is brought up to date with
+#pragma pack(push, 1)
+struct JitExit
+{
+	cpuval_t RIP;
+	cpuval_t ESIndex;
+	cpuval_t ES[ESSize];
+	// set by term only, i.e. an unknown opcode or a ret from the entry exits without it
+	cpuval_t Terminated;
+};
+#pragma pack(pop)
+
+// x86-64 instructions encoded into a buffer
+//   registers are numbered as they're encoded, i.e. 0 for rax, ..., 15 for r15
+//   operations are on 32 bits, which zero the upper half, unless $wide
+class X64Assembler
+{
+	std::vector<uint8_t> _code;
+
+public:
+	enum : int
+	{
+		rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+		r8, r9, r10, r11, r12, r13, r14, r15,
+	};
+
+	// a memory operand [$Base + $Index + $Disp], where $Index is -1 if none
+	struct Memory
+	{
+		int Base;
+		int Index;
+		int32_t Disp;
+	};
+
+	static Memory At(int base, int32_t disp = 0) { return Memory{ base, -1, disp }; }
+	static Memory At(int base, int index, int32_t disp) { return Memory{ base, index, disp }; }
+
+private:
+	// emit a REX prefix, if any bit is set or $force
+	void _Rex(bool wide, int reg, int rm, int index = -1, bool force = false);
+	void _Rex(bool wide, int reg, const Memory &m, bool force = false) { _Rex(wide, reg, m.Base, m.Index, force); }
+	// emit ModRM of register $rm
+	void _Direct(int reg, int rm);
+	// emit ModRM, and SIB if any, of memory $m
+	void _Indirect(int reg, const Memory &m);
+
+public:
+
+	// opcodes of op r/m32, r32
+	static constexpr uint8_t Add = 0x01;
+	static constexpr uint8_t Or = 0x09;
+	static constexpr uint8_t And = 0x21;
+	static constexpr uint8_t Sub = 0x29;
+	static constexpr uint8_t Xor = 0x31;
+	static constexpr uint8_t Test = 0x85;
+	static constexpr uint8_t Mov = 0x89;
+	// condition codes of jcc
+	static constexpr uint8_t IfZero = 0x4;
+	static constexpr uint8_t IfSign = 0x8;
+
+	size_t GetPosition() const { return _code.size(); }
+	const std::vector<uint8_t> &GetCode() const { return _code; }
+
+	void Byte(uint8_t value) { _code.push_back(value); }
+	void Dword(uint32_t value);
+	// Point a rel32 at $at to $target
+	void Bind(size_t at, size_t target);
+
+	// op $dst, $src
+	void Op(uint8_t opcode, int dst, int src, bool wide = false);
+	void Imul(int dst, int src);
+	// not $rm, or div $rm, by the extension of opcode F7
+	void Not(int rm);
+	void Div(int rm);
+	void MovImm(int dst, uint32_t imm);
+	void AddImm(int dst, uint32_t imm);
+	// mov $dst, $m of $size bytes, which is zero extended
+	void Load(int dst, const Memory &m, size_t size = 4, bool wide = false);
+	// mov $m, $src of $size bytes
+	void Store(const Memory &m, int src, size_t size = 4);
+	void StoreImm(const Memory &m, uint32_t imm);
+	void AddMemImm(const Memory &m, uint32_t imm);
+	void Lea(int dst, const Memory &m);
+	void Push(int reg);
+	void Pop(int reg);
+	void Ret() { Byte(0xC3); }
+	// jmp, jcc and call rel32, which return where rel32 is to be bound
+	size_t Jmp();
+	size_t Jcc(uint8_t cond);
+	size_t Call();
+};
+
+// native x86-64 code translated from a module, by a template per instruction
+//   each function, i.e. the entry or a target of call, is translated into a native function,
+//   where call and ret become native call and ret, so a function returns to where it's called
+//   the depth of ES is verified to be static, so ES is kept in r8d ~ r13d by depth instead of memory
+//   and is only saved in the frame on call, the way the interpreter does
+//   $RIP is not maintained, like threaded code
+// addresses are offsets from the base of memory of the vm, which are accessed as [rbx + r32], see MemoryBus
+class JitCode
+{
+	uint8_t *_buffer = nullptr;
+	size_t _size = 0;
+#ifdef _WIN32
+	// unwind info of native code, so that SEH unwinds it when memory faults
+	void *_functionTable = nullptr;
+#endif
+
+	// registers reserved by native code
+	//   r15 points to registers of the cpu, r14 to the stack of the stub, where the exit is
+	//   rbx is the base of memory, where an address of 32 bits is added to as an index
+	static constexpr int _RegisterBase = X64Assembler::r15;
+	static constexpr int _StubFrame = X64Assembler::r14;
+	static constexpr int _MemoryBase = X64Assembler::rbx;
+	static constexpr int _FirstES = X64Assembler::r8;
+
+	JitCode() = default;
+
+	// the register that the value at $depth of ES is kept in
+	static int _ES(int depth);
+	// a register of the cpu
+	static X64Assembler::Memory _RegisterOf(Register reg);
+	// memory of the vm at the address in $reg, plus $disp
+	static X64Assembler::Memory _Address(int reg, int32_t disp = 0);
+	// Find offsets of instructions of the function at $start
+	//   i.e. those reachable from $start without entering a call
+	static std::set<size_t> _Explore(const std::map<size_t, ThreadedCode::_Inst> &insts, size_t start);
+	// Translate an instruction, whose depth of ES is $depth
+	//   rel32 of jumps and calls are returned for binding
+	static void _Translate(X64Assembler &as, const ThreadedCode::_Inst &inst, int depth,
+		std::vector<std::pair<size_t, size_t>> &jumps, std::vector<std::pair<size_t, size_t>> &calls, std::vector<size_t> &exits);
+
+public:
+	JitCode(JitCode &) = delete;
+	~JitCode();
+
+	// bytes of native code
+	size_t GetCodeSize() const { return _size; }
+
+	// Run native code from the entry until termination
+	//   registers of the cpu are used and updated in place, ES and $RIP are left in $exit
+	//   $memory is the base of memory of the vm, and a fault on accessing it is left to the caller
+	void Run(cpuval_t *reg, uint8_t *memory, JitExit &exit) const;
+
+	// Translate a module, which throws if the module fails verification
+	//   the module is one loaded into memory, see ThreadedCode::Decode
+	//   returns nullptr if native code is not supported, where the module is to be interpreted
+	static std::unique_ptr<JitCode> Compile(const SSMModule &module);
+};
+
+//==========================================================================
+// impl. for X64Assembler
+
+inline void X64Assembler::_Rex(bool wide, int reg, int rm, int index, bool force)
+{
+	uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index >= 0 && (index & 8)) ? 2 : 0) | ((rm & 8) ? 1 : 0);
+	if (rex != 0x40 || force)
+		Byte(rex);
+}
+
+inline void X64Assembler::_Direct(int reg, int rm)
+{
+	Byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+inline void X64Assembler::_Indirect(int reg, const Memory &m)
+{
+	// always with disp32, so that rbp and r13 need no special case
+	if (m.Index >= 0)
+	{
+		// rsp cannot be an index
+		_Assert(m.Index != rsp);
+
+		Byte(0x80 | (reg & 7) << 3 | rsp);
+		Byte((m.Index & 7) << 3 | (m.Base & 7));
+	}
+	else
+	{
+		Byte(0x80 | (reg & 7) << 3 | (m.Base & 7));
+		// rsp and r12 as a base are encoded with SIB
+		if ((m.Base & 7) == rsp)
+			Byte(0x24);
+	}
+	Dword(static_cast<uint32_t>(m.Disp));
+}
+
+inline void X64Assembler::Dword(uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		Byte(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+inline void X64Assembler::Bind(size_t at, size_t target)
+{
+	auto rel = static_cast<uint32_t>(static_cast<int32_t>(target - (at + 4)));
+	for (int i = 0; i < 4; ++i)
+		_code[at + i] = static_cast<uint8_t>(rel >> (i * 8));
+}
+
+inline void X64Assembler::Op(uint8_t opcode, int dst, int src, bool wide)
+{
+	_Rex(wide, src, dst);
+	Byte(opcode);
+	_Direct(src, dst);
+}
+
+inline void X64Assembler::Imul(int dst, int src)
+{
+	_Rex(false, dst, src);
+	Byte(0x0F);
+	Byte(0xAF);
+	_Direct(dst, src);
+}
+
+inline void X64Assembler::Not(int rm)
+{
+	_Rex(false, 0, rm);
+	Byte(0xF7);
+	_Direct(2, rm);
+}
+
+inline void X64Assembler::Div(int rm)
+{
+	_Rex(false, 0, rm);
+	Byte(0xF7);
+	_Direct(6, rm);
+}
+
+inline void X64Assembler::MovImm(int dst, uint32_t imm)
+{
+	_Rex(false, 0, dst);
+	Byte(0xB8 | (dst & 7));
+	Dword(imm);
+}
+
+inline void X64Assembler::AddImm(int dst, uint32_t imm)
+{
+	_Rex(false, 0, dst);
+	Byte(0x81);
+	_Direct(0, dst);
+	Dword(imm);
+}
+
+inline void X64Assembler::Load(int dst, const Memory &m, size_t size, bool wide)
+{
+	_Rex(wide, dst, m);
+	switch (size)
+	{
+	case 1:
+		Byte(0x0F);
+		Byte(0xB6);
+		break;
+	case 2:
+		Byte(0x0F);
+		Byte(0xB7);
+		break;
+	default:
+		Byte(0x8B);
+		break;
+	}
+	_Indirect(dst, m);
+}
+
+inline void X64Assembler::Store(const Memory &m, int src, size_t size)
+{
+	switch (size)
+	{
+	case 1:
+		// with REX, the low byte of sil and dil rather than dh and bh
+		_Rex(false, src, m, true);
+		Byte(0x88);
+		break;
+	case 2:
+		Byte(0x66);
+		_Rex(false, src, m);
+		Byte(0x89);
+		break;
+	default:
+		_Rex(false, src, m);
+		Byte(0x89);
+		break;
+	}
+	_Indirect(src, m);
+}
+
+inline void X64Assembler::StoreImm(const Memory &m, uint32_t imm)
+{
+	_Rex(false, 0, m);
+	Byte(0xC7);
+	_Indirect(0, m);
+	Dword(imm);
+}
+
+inline void X64Assembler::AddMemImm(const Memory &m, uint32_t imm)
+{
+	_Rex(false, 0, m);
+	Byte(0x81);
+	_Indirect(0, m);
+	Dword(imm);
+}
+
+inline void X64Assembler::Lea(int dst, const Memory &m)
+{
+	_Rex(false, dst, m);
+	Byte(0x8D);
+	_Indirect(dst, m);
+}
+
+inline void X64Assembler::Push(int reg)
+{
+	_Rex(false, 0, reg);
+	Byte(0x50 | (reg & 7));
+}
+
+inline void X64Assembler::Pop(int reg)
+{
+	_Rex(false, 0, reg);
+	Byte(0x58 | (reg & 7));
+}
+
+inline size_t X64Assembler::Jmp()
+{
+	Byte(0xE9);
+	Dword(0);
+	return GetPosition() - 4;
+}
+
+inline size_t X64Assembler::Jcc(uint8_t cond)
+{
+	Byte(0x0F);
+	Byte(0x80 | cond);
+	Dword(0);
+	return GetPosition() - 4;
+}
+
+inline size_t X64Assembler::Call()
+{
+	Byte(0xE8);
+	Dword(0);
+	return GetPosition() - 4;
+}
+
+//==========================================================================
+// impl. for JitCode
+
+inline JitCode::~JitCode()
+{
+#ifdef SSMA_JIT_SUPPORTED
+	if (_buffer == nullptr)
+		return;
+
+#ifdef _WIN32
+	if (_functionTable != nullptr)
+		RtlDeleteFunctionTable(static_cast<PRUNTIME_FUNCTION>(_functionTable));
+	VirtualFree(_buffer, 0, MEM_RELEASE);
+#else
+	munmap(_buffer, _size);
+#endif
+#endif
+}
+
+inline int JitCode::_ES(int depth)
+{
+	_Assert(depth >= 0 && depth < static_cast<int>(ESSize));
+
+	return _FirstES + depth;
+}
+
+inline X64Assembler::Memory JitCode::_RegisterOf(Register reg)
+{
+	return X64Assembler::At(_RegisterBase, static_cast<int32_t>(static_cast<uint8_t>(reg) * sizeof(cpuval_t)));
+}
+
+inline X64Assembler::Memory JitCode::_Address(int reg, int32_t disp)
+{
+	return X64Assembler::At(_MemoryBase, reg, disp);
+}
+
+inline std::set<size_t> JitCode::_Explore(const std::map<size_t, ThreadedCode::_Inst> &insts, size_t start)
+{
+	std::set<size_t> body;
+	std::vector<size_t> pending{ start };
+	while (!pending.empty())
+	{
+		auto offset = pending.back();
+		pending.pop_back();
+		if (!body.insert(offset).second)
+			continue;
+
+		const auto &inst = insts.at(offset);
+		switch (inst.Op)
+		{
+		case ThreadedOp::term:
+		case ThreadedOp::ret:
+		case ThreadedOp::invalid:
+			break;
+		case ThreadedOp::jmp:
+			pending.push_back(inst.Target);
+			break;
+		case ThreadedOp::jmpz:
+		case ThreadedOp::jmpn:
+			pending.push_back(inst.Target);
+			pending.push_back(inst.Next);
+			break;
+		// the callee is a function of its own
+		default:
+			pending.push_back(inst.Next);
+			break;
+		}
+	}
+
+	return body;
+}
+
+inline void JitCode::_Translate(X64Assembler &as, const ThreadedCode::_Inst &inst, int depth,
+	std::vector<std::pair<size_t, size_t>> &jumps, std::vector<std::pair<size_t, size_t>> &calls, std::vector<size_t> &exits)
+{
+	using X = X64Assembler;
+
+	// values at the top of ES, and where a value pushed goes
+	auto top = [&]() { return _ES(depth - 1); };
+	auto second = [&]() { return _ES(depth - 2); };
+	auto next = [&]() { return _ES(depth); };
+	// a field of caller info, whose address is in eax
+	auto frame = [&](size_t field) { return _Address(X::rax, static_cast<int32_t>(field)); };
+	auto frameES = [&](int i) { return frame(offsetof(FrameCallerInfo, ES) + i * sizeof(cpuval_t)); };
+
+	switch (inst.Op)
+	{
+	case ThreadedOp::term:
+	{
+		// see JitExit, which is pushed by the stub
+		as.Load(X::rax, X::At(_StubFrame), 4, true);
+		auto field = [&](size_t offset) { return X::At(X::rax, static_cast<int32_t>(offset)); };
+		as.StoreImm(field(offsetof(JitExit, RIP)), inst.Values[0]);
+		as.StoreImm(field(offsetof(JitExit, ESIndex)), depth);
+		for (int i = 0; i < depth; ++i)
+			as.Store(field(offsetof(JitExit, ES) + i * sizeof(cpuval_t)), _ES(i));
+		as.StoreImm(field(offsetof(JitExit, Terminated)), 1);
+		exits.push_back(as.Jmp());
+		break;
+	}
+	case ThreadedOp::nop:
+		break;
+
+	case ThreadedOp::add:
+		as.Op(X::Add, second(), top());
+		break;
+	case ThreadedOp::sub:
+		as.Op(X::Sub, second(), top());
+		break;
+	case ThreadedOp::mul:
+		as.Imul(second(), top());
+		break;
+	case ThreadedOp::div_:
+	case ThreadedOp::mod:
+		as.Op(X::Mov, X::rax, second());
+		as.Op(X::Xor, X::rdx, X::rdx);
+		as.Div(top());
+		as.Op(X::Mov, second(), inst.Op == ThreadedOp::div_ ? X::rax : X::rdx);
+		break;
+	case ThreadedOp::b_and:
+		as.Op(X::And, second(), top());
+		break;
+	case ThreadedOp::b_or:
+		as.Op(X::Or, second(), top());
+		break;
+	case ThreadedOp::b_xor:
+		as.Op(X::Xor, second(), top());
+		break;
+	case ThreadedOp::b_rev:
+		as.Not(top());
+		break;
+
+	case ThreadedOp::push_c0:
+		as.Op(X::Xor, next(), next());
+		break;
+	case ThreadedOp::push_c1:
+		as.MovImm(next(), 1);
+		break;
+	case ThreadedOp::push_i:
+		as.MovImm(next(), inst.Values[0]);
+		break;
+	case ThreadedOp::push_r:
+		as.Load(next(), _RegisterOf(static_cast<Register>(inst.Values[0])));
+		break;
+	case ThreadedOp::push_ra:
+		as.Load(next(), _RegisterOf(static_cast<Register>(inst.Values[0])));
+		as.AddImm(next(), inst.Values[1]);
+		break;
+	case ThreadedOp::pop:
+		break;
+	case ThreadedOp::swap:
+		as.Op(X::Mov, X::rax, top());
+		as.Op(X::Mov, top(), second());
+		as.Op(X::Mov, second(), X::rax);
+		break;
+	case ThreadedOp::dup:
+		as.Op(X::Mov, next(), top());
+		break;
+	case ThreadedOp::rec:
+		as.Store(_RegisterOf(Register::RTD), top());
+		break;
+	// addresses are 32 bits, whose upper half of the register is zero
+	case ThreadedOp::store_1:
+		as.Store(_Address(top()), second(), 1);
+		break;
+	case ThreadedOp::store_2:
+		as.Store(_Address(top()), second(), 2);
+		break;
+	case ThreadedOp::store_4:
+		as.Store(_Address(top()), second());
+		break;
+	case ThreadedOp::load_1:
+		as.Load(top(), _Address(top()), 1);
+		break;
+	case ThreadedOp::load_2:
+		as.Load(top(), _Address(top()), 2);
+		break;
+	case ThreadedOp::load_4:
+		as.Load(top(), _Address(top()));
+		break;
+	case ThreadedOp::alloc:
+		as.AddMemImm(_RegisterOf(Register::RST), inst.Values[0]);
+		break;
+
+	case ThreadedOp::jmp:
+		jumps.emplace_back(as.Jmp(), inst.Target);
+		break;
+	case ThreadedOp::jmpz:
+	case ThreadedOp::jmpn:
+		as.Op(X::Test, top(), top());
+		jumps.emplace_back(as.Jcc(inst.Op == ThreadedOp::jmpz ? X::IfZero : X::IfSign), inst.Target);
+		break;
+	case ThreadedOp::call:
+	{
+		// see SSMCPU::Cycle for the layout of caller info
+		as.Load(X::rax, _RegisterOf(Register::RST));
+		as.Load(X::rcx, _RegisterOf(Register::RSB));
+		as.Store(frame(offsetof(FrameCallerInfo, RSB)), X::rcx);
+		as.StoreImm(frame(offsetof(FrameCallerInfo, RIP)), inst.Values[0]);
+		as.Load(X::rcx, _RegisterOf(Register::RMB));
+		as.Store(frame(offsetof(FrameCallerInfo, RMB)), X::rcx);
+		as.StoreImm(frame(offsetof(FrameCallerInfo, ESIndex)), depth);
+		for (int i = 0; i < depth; ++i)
+			as.Store(frameES(i), _ES(i));
+
+		as.Lea(X::rcx, X::At(X::rax, sizeof(FrameCallerInfo)));
+		as.Store(_RegisterOf(Register::RSB), X::rcx);
+		as.Store(_RegisterOf(Register::RST), X::rcx);
+		calls.emplace_back(as.Call(), inst.Target);
+
+		// the callee has restored $RST to caller info, where ES is restored from
+		as.Load(X::rax, _RegisterOf(Register::RST));
+		for (int i = 0; i < depth; ++i)
+			as.Load(_ES(i), frameES(i));
+		break;
+	}
+	case ThreadedOp::ret:
+		as.Load(X::rax, _RegisterOf(Register::RSB));
+		as.Lea(X::rax, X::At(X::rax, -static_cast<int32_t>(sizeof(FrameCallerInfo))));
+		as.Load(X::rcx, frame(offsetof(FrameCallerInfo, RSB)));
+		as.Store(_RegisterOf(Register::RSB), X::rcx);
+		as.Load(X::rcx, frame(offsetof(FrameCallerInfo, RMB)));
+		as.Store(_RegisterOf(Register::RMB), X::rcx);
+		as.Store(_RegisterOf(Register::RST), X::rax);
+		as.Ret();
+		break;
+
+	// leave without termination, where the cpu throws
+	default:
+		exits.push_back(as.Jmp());
+		break;
+	}
+}
+
+inline void JitCode::Run(cpuval_t *reg, uint8_t *memory, JitExit &exit) const
+{
+	using Entry = void(*)(cpuval_t *, uint8_t *, JitExit *);
+
+	// the stub is at the start of the buffer
+	reinterpret_cast<Entry>(_buffer)(reg, memory, &exit);
+}
+
+inline std::unique_ptr<JitCode> JitCode::Compile(const SSMModule &module)
+{
+	using X = X64Assembler;
+
+	std::set<size_t> reachable;
+	std::vector<int> depthOf;
+	if (!ThreadedCode::Analyze(module, reachable, depthOf))
+		throw 0;
+
+#ifndef SSMA_JIT_SUPPORTED
+	return nullptr;
+#else
+	std::map<size_t, ThreadedCode::_Inst> insts;
+	std::vector<size_t> functions{ module.InstOffset };
+	for (auto offset : reachable)
+	{
+		auto inst = ThreadedCode::_DecodeInst(module, offset);
+		if (inst.Op == ThreadedOp::call)
+			functions.push_back(inst.Target);
+
+		insts.emplace(offset, inst);
+	}
+
+	X64Assembler as;
+
+	// the stub saves registers reserved, and calls the entry with the exit pushed
+	//   a function may exit at any depth of calls, so the stack of the stub is kept in _StubFrame
+	//   where each push ends is kept for unwind info
+	std::vector<std::pair<size_t, int>> pushes;
+	auto push = [&](int reg) {
+		as.Push(reg);
+		pushes.emplace_back(as.GetPosition(), reg);
+	};
+	push(X::r12);
+	push(X::r13);
+	push(X::r14);
+	push(X::r15);
+	push(_MemoryBase);
+#ifdef _WIN32
+	as.Op(X::Mov, _RegisterBase, X::rcx, true);
+	as.Op(X::Mov, _MemoryBase, X::rdx, true);
+	push(X::r8);
+#else
+	as.Op(X::Mov, _RegisterBase, X::rdi, true);
+	as.Op(X::Mov, _MemoryBase, X::rsi, true);
+	push(X::rdx);
+#endif
+	as.Op(X::Mov, _StubFrame, X::rsp, true);
+
+	std::vector<std::pair<size_t, size_t>> calls; // rel32 -> offset of the function
+	std::vector<size_t> exits; // rel32 of jumps to the exit
+	calls.emplace_back(as.Call(), module.InstOffset);
+
+	// a return from the entry falls into the exit
+	auto exitPosition = as.GetPosition();
+	as.Op(X::Mov, X::rsp, _StubFrame, true);
+	as.Pop(X::rax);
+	as.Pop(_MemoryBase);
+	as.Pop(X::r15);
+	as.Pop(X::r14);
+	as.Pop(X::r13);
+	as.Pop(X::r12);
+	as.Ret();
+
+	// instructions reachable from more than one function are translated for each of them
+	auto functionsPosition = as.GetPosition();
+	std::map<size_t, size_t> positionOf; // offset of the function -> its native position
+	for (auto start : functions)
+	{
+		if (positionOf.count(start) != 0)
+			continue;
+
+		positionOf[start] = as.GetPosition();
+
+		auto body = _Explore(insts, start);
+		std::map<size_t, size_t> labels; // offset of an instruction -> its native position
+		std::vector<std::pair<size_t, size_t>> jumps; // rel32 -> offset of the target
+		for (auto it = body.begin(); it != body.end(); ++it)
+		{
+			const auto &inst = insts.at(*it);
+			labels[inst.Offset] = as.GetPosition();
+			_Translate(as, inst, depthOf[inst.Offset], jumps, calls, exits);
+
+			// control falling through to an instruction not translated next
+			auto fallsThrough = inst.Op != ThreadedOp::term && inst.Op != ThreadedOp::ret
+				&& inst.Op != ThreadedOp::jmp && inst.Op != ThreadedOp::invalid;
+			auto after = std::next(it);
+			if (fallsThrough && (after == body.end() || *after != inst.Next))
+				jumps.emplace_back(as.Jmp(), inst.Next);
+		}
+
+		for (const auto &jump : jumps)
+			as.Bind(jump.first, labels.at(jump.second));
+	}
+
+	for (const auto &call : calls)
+		as.Bind(call.first, positionOf.at(call.second));
+	for (auto exit : exits)
+		as.Bind(exit, exitPosition);
+
+#ifdef _WIN32
+	// unwind info of the stub, and of functions, which push nothing but return addresses
+	//   see UNWIND_INFO and UNWIND_CODE of x64 exception handling
+	auto codeEnd = as.GetPosition();
+	while (as.GetPosition() % 4 != 0)
+		as.Byte(0xCC);
+
+	auto stubInfo = as.GetPosition();
+	as.Byte(1); // version 1, without handlers
+	as.Byte(static_cast<uint8_t>(pushes.back().first));
+	as.Byte(static_cast<uint8_t>(pushes.size()));
+	as.Byte(0); // no frame register
+	for (auto it = pushes.rbegin(); it != pushes.rend(); ++it)
+	{
+		// the exit is pushed from a volatile register, which is an allocation of 8 bytes to unwind
+		auto volatileRegister = it->second != X::r12 && it->second != X::r13 && it->second != X::r14
+			&& it->second != X::r15 && it->second != _MemoryBase;
+		as.Byte(static_cast<uint8_t>(it->first));
+		as.Byte(volatileRegister ? 2 /* UWOP_ALLOC_SMALL */ : static_cast<uint8_t>(it->second << 4 | 0 /* UWOP_PUSH_NONVOL */));
+	}
+	if (pushes.size() % 2 != 0)
+	{
+		as.Byte(0);
+		as.Byte(0);
+	}
+
+	auto functionsInfo = as.GetPosition();
+	as.Dword(1);
+
+	auto tablePosition = as.GetPosition();
+	as.Dword(0);
+	as.Dword(static_cast<uint32_t>(functionsPosition));
+	as.Dword(static_cast<uint32_t>(stubInfo));
+	as.Dword(static_cast<uint32_t>(functionsPosition));
+	as.Dword(static_cast<uint32_t>(codeEnd));
+	as.Dword(static_cast<uint32_t>(functionsInfo));
+#else
+	(void)functionsPosition;
+#endif
+
+	// code is written before the buffer is made executable, never both at a time
+	const auto &code = as.GetCode();
+#ifdef _WIN32
+	auto buffer = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (buffer == nullptr)
+		return nullptr;
+#else
+	auto buffer = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED)
+		return nullptr;
+#endif
+
+	std::unique_ptr<JitCode> result(new JitCode());
+	result->_buffer = static_cast<uint8_t*>(buffer);
+	result->_size = code.size();
+	std::memcpy(buffer, code.data(), code.size());
+
+#ifdef _WIN32
+	DWORD protect;
+	if (!VirtualProtect(buffer, code.size(), PAGE_EXECUTE_READ, &protect))
+		return nullptr;
+	FlushInstructionCache(GetCurrentProcess(), buffer, code.size());
+
+	auto table = reinterpret_cast<PRUNTIME_FUNCTION>(result->_buffer + tablePosition);
+	if (!RtlAddFunctionTable(table, 2, reinterpret_cast<DWORD64>(buffer)))
+		return nullptr;
+	result->_functionTable = table;
+#else
+	if (mprotect(buffer, code.size(), PROT_READ | PROT_EXEC) != 0)
+		return nullptr;
+#endif
+
+	return result;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+// faults of memory are handled apart from other headers, see SSMInstallFaultHandler in ssm_memory.h
+#if !defined(_WIN32) && defined(__LP64__)
+#include <signal.h>
+#include <cstring>
+
+void SSMInstallFaultHandler(void(*handle)(void *address));
+
+namespace
+{
+	void(*_faultHandle)(void *address) = nullptr;
+	// handlers installed before, for SIGSEGV and SIGBUS
+	struct sigaction _previousActions[2];
+
+	void _OnFault(int sig, siginfo_t *info, void *)
+	{
+		// jumps out if the fault is of a vm
+		_faultHandle(info->si_addr);
+
+		// otherwise, it is left to whoever handled it before, by faulting again
+		sigaction(sig, &_previousActions[sig == SIGSEGV ? 0 : 1], nullptr);
+	}
+}
+
+void SSMInstallFaultHandler(void(*handle)(void *address))
+{
+	_faultHandle = handle;
+
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_sigaction = &_OnFault;
+	sigemptyset(&action.sa_mask);
+	// the handler jumps out, so the signal must not be left blocked
+	action.sa_flags = SA_SIGINFO | SA_NODEFER;
+
+	sigaction(SIGSEGV, &action, &_previousActions[0]);
+	sigaction(SIGBUS, &action, &_previousActions[1]);
+}
+#endif
\ No newline at end of file
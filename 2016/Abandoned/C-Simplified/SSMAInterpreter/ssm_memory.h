@@ -1,10 +1,384 @@
 #pragma once
 #include "ssm_basic.h"
+#include "ssm_module.h"
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
+// memory is sandboxed where the host is 64-bit, see MemoryBus
+#if defined(_WIN64) || defined(__LP64__)
+#define SSMA_LINEAR_MEMORY
+#endif
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <setjmp.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(SSMA_LINEAR_MEMORY) && !defined(_MSC_VER)
+// Install a handler of SIGSEGV and SIGBUS, which calls $handle with the address faulted on
+//   a fault is left to the handler installed before if $handle returns
+// NOTE this is in ssm_memory.cpp, since <signal.h> declares dup, which is an opcode as well
+void SSMInstallFaultHandler(void(*handle)(void *address));
+#endif
+
+// memory of a vm, which addresses of the vm are mapped into
+//   where the host is 64-bit, memory is a linear region of 4 GB reserved, and an address is an offset from its base
+//   so no address of 32 bits reaches memory of the host, and memory is accessed without checking bounds
+//   only regions allocated are committed, others, including a guard after each region, fault when accessed
+//   a fault is caught by a signal handler (or SEH), which unwinds to Guard
+// NOTE on 32-bit hosts, an address is a pointer of the host as is, and faults are not caught
 class MemoryBus
 {
+	// base of linear memory, or nullptr on 32-bit hosts
+	uint8_t *_base = nullptr;
+	// address of the next region to allocate, after the guard at address 0
+	size_t _top = GuardSize;
+#ifndef SSMA_LINEAR_MEMORY
+	std::vector<uint8_t*> _regions;
+#endif
+
+#if defined(SSMA_LINEAR_MEMORY) && !defined(_MSC_VER)
+	// the innermost Guard running on this thread
+	struct _Fault
+	{
+		sigjmp_buf *Jump;
+		const MemoryBus *Memory;
+	};
+
+	static _Fault &_CurrentFault();
+	static void _InstallHandler();
+	static void _Handle(void *address);
+#endif
+#if defined(SSMA_LINEAR_MEMORY) && defined(_MSC_VER)
+	int _Filter(EXCEPTION_POINTERS *exception) const;
+	// Run $fn with $context under SEH, which cannot be mixed with objects to unwind
+	bool _GuardedCall(void(*fn)(void *), void *context) const;
+#endif
+
+	// whether $p is in the region reserved
+	bool _Contains(const void *p) const;
+
+public:
+	// unit of commitment and size of guards, which is the allocation granularity of windows
+	static constexpr size_t GuardSize = 64 * 1024;
+#ifdef SSMA_LINEAR_MEMORY
+	// 4 GB for addresses of 32 bits, and a guard for an access starting below 4 GB but ending above
+	static constexpr size_t ReservedSize = (static_cast<size_t>(1) << 32) + GuardSize;
+#endif
+
+	MemoryBus();
+	MemoryBus(MemoryBus &) = delete;
+	~MemoryBus();
+
+	// the host address where address 0 of the vm is mapped
+	uint8_t *GetBase() const { return _base; }
+
 	template <typename T>
-	T &Access(cpuval_t p);
+	T &Access(cpuval_t p)
+	{
+		return *reinterpret_cast<T*>(_base + p);
+	}
+
+	OP_V *FetchOp(cpuval_t p)
+	{
+		return reinterpret_cast<OP_V*>(_base + p);
+	}
+
+	// Commit a region of $size bytes, which is zeroed and followed by a guard, and returns its address
+	//   throws if memory is exhausted
+	cpuval_t Allocate(size_t size);
+	// Copy a module into a region allocated, and returns the module loaded, whose address is set
+	SSMModule Load(const SSMModule &module);
+	// Decommit all regions, so that memory is reused as if reserved anew
+	//   returns false if regions cannot be decommitted
+	bool Reset();
+
+	// Run $fn, and returns false if it faults on accessing memory unallocated
+	//   $fn is unwound without running destructors, so it should create no object to destruct
+	template <typename Fn>
+	bool Guard(Fn &&fn);
+};
+
+// memory of vms, which is reserved once and reused by vms one after another
+//   at most $capacity are taken at once, and Acquire waits for one to be returned beyond that
+//   NOTE memory takes 4 GB of address space, and a few mappings, which are limited for a process
+class MemoryPool : public std::enable_shared_from_this<MemoryPool>
+{
+	std::mutex _lock;
+	std::condition_variable _returned;
+	std::vector<std::unique_ptr<MemoryBus>> _free;
+	size_t _capacity;
+	size_t _takenCount = 0;
+
+	// Take back memory, which is reset so that no vm sees memory of another
+	void _Return(MemoryBus *memory);
+
+public:
+	static constexpr size_t DefaultCapacity = 256;
+
+	explicit MemoryPool(size_t capacity = DefaultCapacity) :_capacity(capacity) { }
+	MemoryPool(MemoryPool &) = delete;
+
+	// Take memory with no region allocated, which is returned when released
+	//   NOTE the pool should be owned by a shared_ptr, which memory taken keeps alive
+	std::shared_ptr<MemoryBus> Acquire();
+};
+
+//==========================================================================
+// impl. for MemoryBus
+
+inline MemoryBus::MemoryBus()
+{
+#ifdef SSMA_LINEAR_MEMORY
+#ifdef _WIN32
+	_base = static_cast<uint8_t*>(VirtualAlloc(nullptr, ReservedSize, MEM_RESERVE, PAGE_NOACCESS));
+	if (_base == nullptr)
+		throw 0;
+#else
+	auto base = mmap(nullptr, ReservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		throw 0;
+	_base = static_cast<uint8_t*>(base);
+#endif
+#endif
+}
+
+inline MemoryBus::~MemoryBus()
+{
+#ifdef SSMA_LINEAR_MEMORY
+#ifdef _WIN32
+	VirtualFree(_base, 0, MEM_RELEASE);
+#else
+	munmap(_base, ReservedSize);
+#endif
+#else
+	for (auto region : _regions)
+		delete[] region;
+#endif
+}
+
+inline bool MemoryBus::_Contains(const void *p) const
+{
+#ifdef SSMA_LINEAR_MEMORY
+	auto address = static_cast<const uint8_t*>(p);
+	return address >= _base && address < _base + ReservedSize;
+#else
+	return false;
+#endif
+}
+
+inline cpuval_t MemoryBus::Allocate(size_t size)
+{
+	// regions are committed in units of guards
+	size = (size + GuardSize - 1) / GuardSize * GuardSize;
+
+#ifdef SSMA_LINEAR_MEMORY
+	if (size > (static_cast<size_t>(1) << 32) - GuardSize - _top)
+		throw 0;
+
+	auto address = _top;
+#ifdef _WIN32
+	if (VirtualAlloc(_base + address, size, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+		throw 0;
+#else
+	if (mprotect(_base + address, size, PROT_READ | PROT_WRITE) != 0)
+		throw 0;
+#endif
+	_top += size + GuardSize;
+
+	return static_cast<cpuval_t>(address);
+#else
+	auto region = new uint8_t[size]{};
+	_regions.push_back(region);
+
+	return reinterpret_cast<cpuval_t>(region);
+#endif
+}
+
+inline SSMModule MemoryBus::Load(const SSMModule &module)
+{
+	auto address = Allocate(module.ModuleSize);
+	std::memcpy(&Access<uint8_t>(address), module.ModuleBase, module.ModuleSize);
+
+	SSMModule loaded(&Access<uint8_t>(address), module.ModuleSize, module.InstOffset);
+	loaded.Address = address;
+	return loaded;
+}
+
+inline bool MemoryBus::Reset()
+{
+#ifdef SSMA_LINEAR_MEMORY
+	// regions are between the guard at address 0 and the top
+	if (_top > GuardSize)
+	{
+#ifdef _WIN32
+		if (!VirtualFree(_base + GuardSize, _top - GuardSize, MEM_DECOMMIT))
+			return false;
+#else
+		// mapped anew, so that pages are dropped and the mapping is merged with the reserved
+		auto base = mmap(_base + GuardSize, _top - GuardSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+		if (base == MAP_FAILED)
+			return false;
+#endif
+	}
+#else
+	for (auto region : _regions)
+		delete[] region;
+	_regions.clear();
+#endif
+
+	_top = GuardSize;
+	return true;
+}
+
+#if defined(SSMA_LINEAR_MEMORY) && !defined(_MSC_VER)
+inline MemoryBus::_Fault &MemoryBus::_CurrentFault()
+{
+	static thread_local _Fault fault{ nullptr, nullptr };
+	return fault;
+}
+
+inline void MemoryBus::_InstallHandler()
+{
+	static bool installed = []() {
+		SSMInstallFaultHandler(&MemoryBus::_Handle);
+		return true;
+	}();
+	(void)installed;
+}
+
+inline void MemoryBus::_Handle(void *address)
+{
+	auto &fault = _CurrentFault();
+	if (fault.Jump != nullptr && fault.Memory->_Contains(address))
+		siglongjmp(*fault.Jump, 1);
+}
+#endif
+
+#if defined(SSMA_LINEAR_MEMORY) && defined(_MSC_VER)
+inline int MemoryBus::_Filter(EXCEPTION_POINTERS *exception) const
+{
+	auto record = exception->ExceptionRecord;
+	if (record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION && _Contains(reinterpret_cast<void*>(record->ExceptionInformation[1])))
+		return EXCEPTION_EXECUTE_HANDLER;
+
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+inline bool MemoryBus::_GuardedCall(void(*fn)(void *), void *context) const
+{
+	__try
+	{
+		fn(context);
+		return true;
+	}
+	__except (_Filter(GetExceptionInformation()))
+	{
+		return false;
+	}
+}
+#endif
+
+template <typename Fn>
+inline bool MemoryBus::Guard(Fn &&fn)
+{
+#if defined(SSMA_LINEAR_MEMORY) && defined(_MSC_VER)
+	using F = typename std::remove_reference<Fn>::type;
+	return _GuardedCall([](void *context) { (*static_cast<F*>(context))(); }, &fn);
+#elif defined(SSMA_LINEAR_MEMORY)
+	_InstallHandler();
+
+	// guards may nest, e.g. a vm run by another
+	auto &fault = _CurrentFault();
+	auto previous = fault;
+
+	sigjmp_buf jump;
+	if (sigsetjmp(jump, 0) != 0)
+	{
+		fault = previous;
+		return false;
+	}
+
+	fault = _Fault{ &jump, this };
+	try
+	{
+		fn();
+	}
+	catch (...)
+	{
+		fault = previous;
+		throw;
+	}
+
+	fault = previous;
+	return true;
+#else
+	fn();
+	return true;
+#endif
+}
+
+//==========================================================================
+// impl. for MemoryPool
+
+inline std::shared_ptr<MemoryBus> MemoryPool::Acquire()
+{
+	std::unique_ptr<MemoryBus> memory;
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		_returned.wait(lock, [this]() { return _takenCount < _capacity; });
+
+		_takenCount += 1;
+		if (!_free.empty())
+		{
+			memory = std::move(_free.back());
+			_free.pop_back();
+		}
+	}
+
+	// memory is reserved out of the lock
+	if (!memory)
+	{
+		try
+		{
+			memory.reset(new MemoryBus());
+		}
+		catch (...)
+		{
+			_Return(nullptr);
+			throw;
+		}
+	}
+
+	auto self = shared_from_this();
+	return std::shared_ptr<MemoryBus>(memory.release(), [self](MemoryBus *p) { self->_Return(p); });
+}
+
+inline void MemoryPool::_Return(MemoryBus *memory)
+{
+	std::unique_ptr<MemoryBus> owned(memory);
+	// memory that cannot be reset is released instead
+	if (owned && !owned->Reset())
+		owned.reset();
+
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_takenCount -= 1;
+		if (owned)
+			_free.push_back(std::move(owned));
+	}
 
-	OP_V *FetchOp(cpuval_t p);
-};
\ No newline at end of file
+	_returned.notify_one();
+}
\ No newline at end of file
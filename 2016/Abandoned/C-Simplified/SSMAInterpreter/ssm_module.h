@@ -4,18 +4,21 @@
 struct SSMModule
 {
 	uint8_t *ModuleBase;
+	size_t ModuleSize;
 	size_t InstOffset;
+	// address of the module in memory of a vm, once loaded, see MemoryBus::Load
+	cpuval_t Address = 0;
 
 public:
-	SSMModule(uint8_t *base, size_t instOffset) :ModuleBase(base), InstOffset(instOffset) { }
+	SSMModule(uint8_t *base, size_t size, size_t instOffset) :ModuleBase(base), ModuleSize(size), InstOffset(instOffset) { }
 
 	SSMAOpCode *GetEntry() const
 	{
 		return reinterpret_cast<SSMAOpCode*>(ModuleBase + InstOffset);
 	}
 
-	static SSMModule CreateTest(SSMAOpCode *ip)
+	static SSMModule CreateTest(SSMAOpCode *ip, size_t size)
 	{
-		return SSMModule(reinterpret_cast<uint8_t*>(ip), 0);
+		return SSMModule(reinterpret_cast<uint8_t*>(ip), size, 0);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,220 @@
+#pragma once
+#include "ssm_memory.h"
+#include "ssm_module.h"
+#include "ssm_vm.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// vms multiplexed over a fixed pool of workers
+//   a vm runs for a slice of instructions at a time, and is queued again if still running,
+//   so that a long vm never holds a worker from short ones
+//   each worker takes vms from the front of its own queue, and steals from the back of others' when it runs out
+//   memory of vms is pooled, so that Submit waits while too many vms are live, see MemoryPool
+class SSMScheduler
+{
+	struct _Task
+	{
+		std::shared_ptr<SSMVirtualMachine> VM;
+		std::function<void(SSMVirtualMachine &)> OnFinish;
+	};
+
+	struct _Queue
+	{
+		std::mutex Lock;
+		std::deque<_Task> Tasks;
+	};
+
+	size_t _sliceSize;
+	std::shared_ptr<MemoryPool> _pool;
+	std::vector<std::unique_ptr<_Queue>> _queues;
+	std::vector<std::thread> _workers;
+	// vms in queues, and workers sleeping for want of them
+	std::atomic<size_t> _queuedCount{ 0 };
+	std::atomic<size_t> _sleepingCount{ 0 };
+	// queue of the next vm submitted, which are spread round-robin
+	std::atomic<size_t> _nextQueue{ 0 };
+
+	std::mutex _lock;
+	std::condition_variable _queued;
+	std::condition_variable _finished;
+	// vms submitted and not finished yet, guarded by $_lock
+	size_t _liveCount = 0;
+	bool _stopping = false;
+
+	// Queue a vm to a worker, and wake a worker sleeping to take it
+	//   unless the vm $yielded on the worker, and is alone in its queue, as the worker takes it back right away
+	void _Push(size_t index, _Task task, bool yielded);
+	// Take a vm of a worker, or steal one from others, and returns false if all queues are empty
+	bool _Take(size_t index, _Task &task);
+	// Finish a vm, which is destructed, so that its memory is returned
+	void _Finish(_Task &task);
+	void _Work(size_t index);
+
+public:
+	static constexpr size_t DefaultSliceSize = 10000;
+
+	// $workerCount of 0 is the count of hardware threads
+	//   at most $memoryCapacity vms are live at once
+	explicit SSMScheduler(size_t workerCount = 0, size_t sliceSize = DefaultSliceSize, size_t memoryCapacity = MemoryPool::DefaultCapacity);
+	SSMScheduler(SSMScheduler &) = delete;
+	// waits for vms submitted to finish
+	~SSMScheduler();
+
+	// Create a vm of $module, and queue it to run, which throws if the module fails verification
+	//   this waits if memory of vms is all taken, until a vm finishes
+	//   $onFinish is called on a worker when the vm finishes, e.g. to read results, before its memory is returned
+	// NOTE a vm that throws, i.e. on an unknown opcode, finishes as is, still running
+	//      $onFinish should neither throw nor submit
+	void Submit(const SSMModule &module, std::function<void(SSMVirtualMachine &)> onFinish = nullptr);
+	// Wait until vms submitted finish
+	void Wait();
+};
+
+//==========================================================================
+// impl. for SSMScheduler
+
+inline SSMScheduler::SSMScheduler(size_t workerCount, size_t sliceSize, size_t memoryCapacity)
+	:_sliceSize(sliceSize), _pool(std::make_shared<MemoryPool>(memoryCapacity))
+{
+	if (workerCount == 0)
+		workerCount = std::thread::hardware_concurrency();
+	if (workerCount == 0)
+		workerCount = 1;
+
+	for (size_t i = 0; i < workerCount; ++i)
+		_queues.emplace_back(new _Queue());
+	for (size_t i = 0; i < workerCount; ++i)
+		_workers.emplace_back([this, i]() { _Work(i); });
+}
+
+inline SSMScheduler::~SSMScheduler()
+{
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_stopping = true;
+	}
+	_queued.notify_all();
+
+	for (auto &worker : _workers)
+		worker.join();
+}
+
+inline void SSMScheduler::Submit(const SSMModule &module, std::function<void(SSMVirtualMachine &)> onFinish)
+{
+	auto vm = SSMVirtualMachine::Create(module, *_pool);
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_liveCount += 1;
+	}
+
+	auto index = _nextQueue++ % _queues.size();
+	_Push(index, _Task{ std::move(vm), std::move(onFinish) }, false);
+}
+
+inline void SSMScheduler::Wait()
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	_finished.wait(lock, [this]() { return _liveCount == 0; });
+}
+
+inline void SSMScheduler::_Push(size_t index, _Task task, bool yielded)
+{
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lock(_queues[index]->Lock);
+		wake = !yielded || !_queues[index]->Tasks.empty();
+		_queues[index]->Tasks.push_back(std::move(task));
+	}
+
+	// a worker going to sleep counts itself before checking for vms queued, see _Work
+	//   so that either it finds the vm, or it's counted here and woken
+	_queuedCount += 1;
+	if (wake && _sleepingCount > 0)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_queued.notify_one();
+	}
+}
+
+inline bool SSMScheduler::_Take(size_t index, _Task &task)
+{
+	for (size_t i = 0; i < _queues.size(); ++i)
+	{
+		auto &queue = *_queues[(index + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		if (queue.Tasks.empty())
+			continue;
+
+		// the own queue is run round-robin, and others are stolen from the back
+		if (i == 0)
+		{
+			task = std::move(queue.Tasks.front());
+			queue.Tasks.pop_front();
+		}
+		else
+		{
+			task = std::move(queue.Tasks.back());
+			queue.Tasks.pop_back();
+		}
+
+		_queuedCount -= 1;
+		return true;
+	}
+
+	return false;
+}
+
+inline void SSMScheduler::_Finish(_Task &task)
+{
+	if (task.OnFinish)
+		task.OnFinish(*task.VM);
+	task = _Task{};
+
+	std::lock_guard<std::mutex> lock(_lock);
+	if (--_liveCount == 0)
+		_finished.notify_all();
+}
+
+inline void SSMScheduler::_Work(size_t index)
+{
+	_Task task;
+	for (;;)
+	{
+		if (!_Take(index, task))
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_sleepingCount += 1;
+			_queued.wait(lock, [this]() { return _stopping || _queuedCount > 0; });
+			_sleepingCount -= 1;
+
+			// vms have finished when stopping
+			if (_stopping)
+				return;
+
+			continue;
+		}
+
+		bool running = false;
+		try
+		{
+			running = task.VM->RunSlice(_sliceSize);
+		}
+		catch (...)
+		{
+		}
+
+		// a vm yielding is queued again behind others of the worker
+		if (running)
+			_Push(index, std::move(task), true);
+		else
+			_Finish(task);
+	}
+}
\ No newline at end of file
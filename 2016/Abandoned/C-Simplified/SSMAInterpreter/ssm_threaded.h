@@ -0,0 +1,776 @@
+#pragma once
+#include "ssm_basic.h"
+#include "ssm_module.h"
+#include <set>
+#include <vector>
+
+// dispatch by computed goto where the compiler supports labels as values,
+// otherwise threaded code is dispatched by a switch
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(SSMA_NO_THREADED_DISPATCH)
+#define SSMA_THREADED_DISPATCH
+#endif
+
+// operations of threaded code
+// most map to an opcode, while push_1, push_4, and push_r(a) of $RIP become push_i
+//   an operation that ends a block takes the count of instructions in the block as its last operand, see ThreadedCode
+enum class ThreadedOp : uint8_t
+{
+	term, // [1+2] $RIP after, and the count
+	nop,
+
+	add,
+	sub,
+	mul,
+	div_,
+	mod,
+	b_and,
+	b_or,
+	b_xor,
+	b_rev,
+
+	push_c0,
+	push_c1,
+	push_i, // [1+1] push an immediate into ES
+	push_r, // [1+1] push the value of a register into ES
+	push_ra, // [1+2] push the value of a register plus an offset into ES
+	pop,
+	swap,
+	dup,
+	rec,
+	store_1,
+	store_2,
+	store_4,
+	load_1,
+	load_2,
+	load_4,
+	alloc,
+
+	jmp, // [1+2] continue at the target, and the count
+	jmpz,
+	jmpn,
+	call, // [1+3] the target, $RIP to return to, and the count
+	ret, // [1+1] the count
+	tick, // [1+1] the count of a block falling through into a leader
+
+	// superinstructions, fused from sequences that compiled programs produce
+	//   push_r(a) below is either push_r or push_ra, whose offset of push_r is 0
+	load_ra, // [1+2] push_r(a), load_4
+	store_ra, // [1+2] push_r(a), store_4, or dup, push_r(a), store_4, pop
+	add_i, // [1+1] push_i, add
+	sub_i, // [1+1] push_i, sub
+	sub_jmpz, // [1+2] sub, jmpz
+	sub_jmpn, // [1+2] sub, jmpn
+	sub_i_jmpz, // [1+3] push_i, sub, jmpz, i.e. the target, the immediate and the count
+	sub_i_jmpn, // [1+3] push_i, sub, jmpn
+	push_r_dup, // [1+1] push_r, dup
+
+	invalid, // an unknown opcode, which throws when executed
+
+	Count
+};
+
+// a slot of threaded code
+// an instruction is a slot of its handler followed by slots of its operands
+union ThreadedSlot
+{
+	// address of the handler, once threaded for computed goto
+	const void *Handler;
+	// ThreadedOp, before threaded
+	size_t Op;
+	// an immediate, a register or an address
+	cpuval_t Value;
+	// the handler slot of the instruction jumped to
+	const ThreadedSlot *Target;
+};
+
+// bytecode of a module pre-decoded into threaded code
+// so that no opcode size is looked up and no offset is added at runtime
+//   only instructions reachable from the entry are decoded, in the order of their offsets
+//   $RIP is not maintained while threaded code runs, it's known to each instruction that refers to it
+//   depth of ES is verified when decoded, so that threaded code runs without checking it
+//   instructions are counted by blocks, where the operation that ends a block charges the count of the block
+//   so that a run can be sliced by instructions, and yields only where a block ends, whose next is a leader
+class ThreadedCode
+{
+	// native code is translated from instructions decoded the same way
+	friend class JitCode;
+
+	std::vector<ThreadedSlot> _slots;
+	// offset of an instruction -> index of its handler slot, or -1 if not decoded
+	std::vector<size_t> _slotOf;
+	// index of a handler slot -> offset of its instruction, for leaders only
+	std::vector<size_t> _offsetOf;
+	// offset of an instruction -> depth of ES when it's reached, as verified, or -1 if not reached
+	std::vector<int> _depthOf;
+	size_t _entry = 0;
+	bool _threaded = false;
+	size_t _instCount = 0;
+	size_t _handlerCount = 0;
+
+	// an instruction decoded, before fused and emitted
+	//   the target is emitted before values, if any
+	struct _Inst
+	{
+		size_t Offset;
+		// offset of the instruction after
+		size_t Next;
+		ThreadedOp Op;
+		// offset of the instruction jumped to, or _NoTarget
+		size_t Target;
+		cpuval_t Values[2];
+		size_t ValueCount;
+	};
+
+	static constexpr size_t _NoTarget = static_cast<size_t>(-1);
+
+	ThreadedCode() = default;
+
+	// Count operand slots of an operation
+	static size_t _OperandCount(ThreadedOp op);
+	// whether an operation ends a block, i.e. it takes a count
+	static bool _EndsBlock(ThreadedOp op);
+	// Decode an instruction at $offset
+	static _Inst _DecodeInst(const SSMModule &module, size_t offset);
+	// Fuse instructions from $k into a superinstruction, and returns how many are fused
+	//   returns 1 with the instruction at $k if nothing is fused
+	//   no instruction but the first may be a leader, i.e. entered other than by falling through
+	static size_t _Fuse(const std::vector<_Inst> &insts, size_t k, const std::vector<bool> &isLeader, _Inst &fused);
+	// Find offsets of instructions reachable from the entry of $module
+	//   which throws if an instruction reachable is out of the module
+	static std::set<size_t> _Explore(const SSMModule &module);
+	// Verify that ES neither overflows nor underflows in any path from the entry of $module
+	//   i.e. each instruction is reached with the same depth of ES, which is enough for its operands
+	static bool _Verify(const SSMModule &module, const std::set<size_t> &reachable, std::vector<int> &depthOf);
+
+public:
+	ThreadedCode(ThreadedCode &) = delete;
+	ThreadedCode(ThreadedCode &&) = default;
+
+	// the handler slot to start with
+	const ThreadedSlot *GetEntry() const { return &_slots[_entry]; }
+	// whether the instruction at $offset of the module is decoded, and has a handler slot of its own
+	bool Contains(cpuval_t offset) const { return offset < _slotOf.size() && _slotOf[offset] != static_cast<size_t>(-1); }
+	// the handler slot of the instruction at $offset of the module
+	const ThreadedSlot *Locate(cpuval_t offset) const;
+	// offset of the instruction of a handler slot, which is of a leader, i.e. where a run yields
+	cpuval_t OffsetOf(const ThreadedSlot *slot) const;
+	// depth of ES when the instruction at $offset of the module is reached
+	//   e.g. where a call returns to, since the depth saved in the frame is in memory of the vm, and not trusted
+	size_t DepthAt(cpuval_t offset) const;
+
+	// Replace operations with addresses of their handlers, indexed by ThreadedOp
+	//   this is done once, before the code is first run
+	void Thread(const void *const *handlers);
+
+	// instructions of the module decoded
+	size_t GetInstructionCount() const { return _instCount; }
+	// handlers dispatched to, which are fewer than instructions if fused
+	size_t GetHandlerCount() const { return _handlerCount; }
+
+	// Find instructions reachable from the entry of $module, and depth of ES when each is reached, or -1 if not
+	//   returns false if the module fails verification
+	static bool Analyze(const SSMModule &module, std::set<size_t> &reachable, std::vector<int> &depthOf);
+
+	// Decode a module, which throws if the module fails verification
+	//   the module is one loaded into memory, whose address $RIP is known by, see MemoryBus::Load
+	//   common sequences of instructions are fused into superinstructions if $fuse
+	static ThreadedCode Decode(const SSMModule &module, bool fuse = true);
+};
+
+//==========================================================================
+// impl. for ThreadedCode
+
+inline size_t ThreadedCode::_OperandCount(ThreadedOp op)
+{
+	switch (op)
+	{
+	case ThreadedOp::push_i:
+	case ThreadedOp::push_r:
+	case ThreadedOp::alloc:
+	case ThreadedOp::ret:
+	case ThreadedOp::tick:
+	case ThreadedOp::add_i:
+	case ThreadedOp::sub_i:
+	case ThreadedOp::push_r_dup:
+		return 1;
+	case ThreadedOp::push_ra:
+	case ThreadedOp::jmp:
+	case ThreadedOp::jmpz:
+	case ThreadedOp::jmpn:
+	case ThreadedOp::term:
+	case ThreadedOp::load_ra:
+	case ThreadedOp::store_ra:
+	case ThreadedOp::sub_jmpz:
+	case ThreadedOp::sub_jmpn:
+		return 2;
+	case ThreadedOp::call:
+	case ThreadedOp::sub_i_jmpz:
+	case ThreadedOp::sub_i_jmpn:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+inline bool ThreadedCode::_EndsBlock(ThreadedOp op)
+{
+	switch (op)
+	{
+	case ThreadedOp::term:
+	case ThreadedOp::jmp:
+	case ThreadedOp::jmpz:
+	case ThreadedOp::jmpn:
+	case ThreadedOp::call:
+	case ThreadedOp::ret:
+	case ThreadedOp::tick:
+	case ThreadedOp::sub_jmpz:
+	case ThreadedOp::sub_jmpn:
+	case ThreadedOp::sub_i_jmpz:
+	case ThreadedOp::sub_i_jmpn:
+		return true;
+	default:
+		return false;
+	}
+}
+
+inline std::set<size_t> ThreadedCode::_Explore(const SSMModule &module)
+{
+	auto base = module.ModuleBase;
+	std::set<size_t> reachable;
+	std::vector<size_t> pending{ module.InstOffset };
+	while (!pending.empty())
+	{
+		auto offset = pending.back();
+		pending.pop_back();
+
+		// follow instructions until control never falls through
+		while (reachable.insert(offset).second)
+		{
+			// running out of the module is not supported
+			_Assert(offset < module.ModuleSize);
+			auto op = reinterpret_cast<const OP_V*>(base + offset);
+			auto size = _OpSize[op->Code];
+			_Assert(offset + size <= module.ModuleSize);
+			if (size == 0 || op->Code == SSMAOpCode::term || op->Code == SSMAOpCode::ret)
+				break;
+
+			auto next = offset + size;
+			switch (op->Code)
+			{
+			case SSMAOpCode::jmp:
+			case SSMAOpCode::jmpz:
+			case SSMAOpCode::jmpn:
+			{
+				auto target = static_cast<ptrdiff_t>(next) + op->As<OP_S2>()->Operand1;
+				// a jump out of the module is not supported
+				_Assert(target >= 0);
+				pending.push_back(static_cast<size_t>(target));
+				break;
+			}
+			case SSMAOpCode::call:
+				pending.push_back(op->As<OP_U4>()->Operand1);
+				break;
+			default:
+				break;
+			}
+
+			if (op->Code == SSMAOpCode::jmp)
+				break;
+
+			offset = next;
+		}
+	}
+
+	return reachable;
+}
+
+inline bool ThreadedCode::_Verify(const SSMModule &module, const std::set<size_t> &reachable, std::vector<int> &depthOf)
+{
+	auto base = module.ModuleBase;
+	// depth of ES when an instruction is reached, or -1 if not reached yet
+	depthOf.assign(*reachable.rbegin() + 1, -1);
+	std::vector<size_t> pending;
+
+	auto reach = [&](size_t offset, int depth) {
+		if (depthOf[offset] == -1)
+		{
+			depthOf[offset] = depth;
+			pending.push_back(offset);
+		}
+
+		return depthOf[offset] == depth;
+	};
+
+	// a function is called with an empty ES
+	if (!reach(module.InstOffset, 0))
+		return false;
+
+	while (!pending.empty())
+	{
+		auto offset = pending.back();
+		pending.pop_back();
+
+		auto op = reinterpret_cast<const OP_V*>(base + offset);
+		auto next = offset + _OpSize[op->Code];
+		auto depth = depthOf[offset];
+
+		// values popped and pushed
+		int popCount = 0, pushCount = 0;
+		switch (op->Code)
+		{
+		case SSMAOpCode::add:
+		case SSMAOpCode::sub:
+		case SSMAOpCode::mul:
+		case SSMAOpCode::div_:
+		case SSMAOpCode::mod:
+		case SSMAOpCode::b_and:
+		case SSMAOpCode::b_or:
+		case SSMAOpCode::b_xor:
+			popCount = 2, pushCount = 1;
+			break;
+		case SSMAOpCode::b_rev:
+		case SSMAOpCode::load_1:
+		case SSMAOpCode::load_2:
+		case SSMAOpCode::load_4:
+			popCount = 1, pushCount = 1;
+			break;
+		case SSMAOpCode::push_c0:
+		case SSMAOpCode::push_c1:
+		case SSMAOpCode::push_1:
+		case SSMAOpCode::push_4:
+		case SSMAOpCode::push_r:
+		case SSMAOpCode::push_ra:
+			pushCount = 1;
+			break;
+		case SSMAOpCode::pop:
+		case SSMAOpCode::rec:
+		case SSMAOpCode::jmpz:
+		case SSMAOpCode::jmpn:
+			popCount = 1;
+			break;
+		case SSMAOpCode::swap:
+			popCount = 2, pushCount = 2;
+			break;
+		case SSMAOpCode::dup:
+			popCount = 1, pushCount = 2;
+			break;
+		case SSMAOpCode::store_1:
+		case SSMAOpCode::store_2:
+		case SSMAOpCode::store_4:
+			popCount = 2;
+			break;
+		default:
+			// others leave ES as is, and an unknown opcode throws when it's run
+			break;
+		}
+
+		if (depth < popCount || depth - popCount + pushCount > static_cast<int>(ESSize))
+			return false;
+
+		depth = depth - popCount + pushCount;
+		switch (op->Code)
+		{
+		// ES is restored on ret, and an unknown opcode throws anyway
+		case SSMAOpCode::term:
+		case SSMAOpCode::ret:
+			break;
+
+		case SSMAOpCode::jmp:
+			if (!reach(next + op->As<OP_S2>()->Operand1, depth))
+				return false;
+			break;
+		case SSMAOpCode::jmpz:
+		case SSMAOpCode::jmpn:
+			if (!reach(next + op->As<OP_S2>()->Operand1, depth) || !reach(next, depth))
+				return false;
+			break;
+		case SSMAOpCode::call:
+			if (!reach(op->As<OP_U4>()->Operand1, 0) || !reach(next, depth))
+				return false;
+			break;
+
+		default:
+			if (_OpSize[op->Code] != 0 && !reach(next, depth))
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+inline bool ThreadedCode::Analyze(const SSMModule &module, std::set<size_t> &reachable, std::vector<int> &depthOf)
+{
+	reachable = _Explore(module);
+	return _Verify(module, reachable, depthOf);
+}
+
+inline const ThreadedSlot *ThreadedCode::Locate(cpuval_t offset) const
+{
+	// returning to an instruction not decoded is not supported
+	_Assert(Contains(offset));
+
+	return &_slots[_slotOf[offset]];
+}
+
+inline cpuval_t ThreadedCode::OffsetOf(const ThreadedSlot *slot) const
+{
+	auto index = static_cast<size_t>(slot - _slots.data());
+	_Assert(index < _offsetOf.size() && _offsetOf[index] != static_cast<size_t>(-1));
+
+	return static_cast<cpuval_t>(_offsetOf[index]);
+}
+
+inline size_t ThreadedCode::DepthAt(cpuval_t offset) const
+{
+	_Assert(offset < _depthOf.size() && _depthOf[offset] != -1);
+
+	return static_cast<size_t>(_depthOf[offset]);
+}
+
+inline void ThreadedCode::Thread(const void *const *handlers)
+{
+	if (_threaded)
+		return;
+
+	for (size_t i = 0; i < _slots.size();)
+	{
+		auto op = static_cast<ThreadedOp>(_slots[i].Op);
+		_slots[i].Handler = handlers[static_cast<size_t>(op)];
+		i += 1 + _OperandCount(op);
+	}
+
+	_threaded = true;
+}
+
+inline ThreadedCode::_Inst ThreadedCode::_DecodeInst(const SSMModule &module, size_t offset)
+{
+	auto op = reinterpret_cast<const OP_V*>(module.ModuleBase + offset);
+	auto next = offset + _OpSize[op->Code];
+	// $RIP after the instruction is fetched, which is an address in memory of the vm
+	auto rip = module.Address + static_cast<cpuval_t>(next);
+
+	_Inst inst{ offset, next, ThreadedOp::invalid, _NoTarget, {}, 0 };
+	auto value = [&](cpuval_t v) { inst.Values[inst.ValueCount++] = v; };
+	auto target = [&](size_t to) { inst.Target = to; };
+
+	switch (op->Code)
+	{
+	case SSMAOpCode::term:
+		inst.Op = ThreadedOp::term;
+		value(rip);
+		break;
+	case SSMAOpCode::nop:
+		inst.Op = ThreadedOp::nop;
+		break;
+
+	case SSMAOpCode::add:
+		inst.Op = ThreadedOp::add;
+		break;
+	case SSMAOpCode::sub:
+		inst.Op = ThreadedOp::sub;
+		break;
+	case SSMAOpCode::mul:
+		inst.Op = ThreadedOp::mul;
+		break;
+	case SSMAOpCode::div_:
+		inst.Op = ThreadedOp::div_;
+		break;
+	case SSMAOpCode::mod:
+		inst.Op = ThreadedOp::mod;
+		break;
+	case SSMAOpCode::b_and:
+		inst.Op = ThreadedOp::b_and;
+		break;
+	case SSMAOpCode::b_or:
+		inst.Op = ThreadedOp::b_or;
+		break;
+	case SSMAOpCode::b_xor:
+		inst.Op = ThreadedOp::b_xor;
+		break;
+	case SSMAOpCode::b_rev:
+		inst.Op = ThreadedOp::b_rev;
+		break;
+
+	case SSMAOpCode::push_c0:
+		inst.Op = ThreadedOp::push_c0;
+		break;
+	case SSMAOpCode::push_c1:
+		inst.Op = ThreadedOp::push_c1;
+		break;
+	case SSMAOpCode::push_1:
+		inst.Op = ThreadedOp::push_i;
+		value(op->As<OP_U1>()->Operand1);
+		break;
+	case SSMAOpCode::push_4:
+		inst.Op = ThreadedOp::push_i;
+		value(op->As<OP_U4>()->Operand1);
+		break;
+	case SSMAOpCode::push_r:
+	{
+		auto reg = op->As<OP_U1>()->Operand1;
+		if (reg == static_cast<uint8_t>(Register::RIP))
+		{
+			inst.Op = ThreadedOp::push_i;
+			value(rip);
+		}
+		else if (reg < RegisterCount)
+		{
+			inst.Op = ThreadedOp::push_r;
+			value(reg);
+		}
+		else
+		{
+			inst.Op = ThreadedOp::invalid;
+		}
+		break;
+	}
+	case SSMAOpCode::push_ra:
+	{
+		auto _op = op->As<OP_U1U2>();
+		if (_op->Operand1 == static_cast<uint8_t>(Register::RIP))
+		{
+			inst.Op = ThreadedOp::push_i;
+			value(rip + _op->Operand2);
+		}
+		else if (_op->Operand1 < RegisterCount)
+		{
+			inst.Op = ThreadedOp::push_ra;
+			value(_op->Operand1);
+			value(_op->Operand2);
+		}
+		else
+		{
+			inst.Op = ThreadedOp::invalid;
+		}
+		break;
+	}
+	case SSMAOpCode::pop:
+		inst.Op = ThreadedOp::pop;
+		break;
+	case SSMAOpCode::swap:
+		inst.Op = ThreadedOp::swap;
+		break;
+	case SSMAOpCode::dup:
+		inst.Op = ThreadedOp::dup;
+		break;
+	case SSMAOpCode::rec:
+		inst.Op = ThreadedOp::rec;
+		break;
+	case SSMAOpCode::store_1:
+		inst.Op = ThreadedOp::store_1;
+		break;
+	case SSMAOpCode::store_2:
+		inst.Op = ThreadedOp::store_2;
+		break;
+	case SSMAOpCode::store_4:
+		inst.Op = ThreadedOp::store_4;
+		break;
+	case SSMAOpCode::load_1:
+		inst.Op = ThreadedOp::load_1;
+		break;
+	case SSMAOpCode::load_2:
+		inst.Op = ThreadedOp::load_2;
+		break;
+	case SSMAOpCode::load_4:
+		inst.Op = ThreadedOp::load_4;
+		break;
+	case SSMAOpCode::alloc:
+		inst.Op = ThreadedOp::alloc;
+		value(op->As<OP_U2>()->Operand1);
+		break;
+
+	case SSMAOpCode::jmp:
+	case SSMAOpCode::jmpz:
+	case SSMAOpCode::jmpn:
+		inst.Op = op->Code == SSMAOpCode::jmp ? ThreadedOp::jmp : op->Code == SSMAOpCode::jmpz ? ThreadedOp::jmpz : ThreadedOp::jmpn;
+		target(next + op->As<OP_S2>()->Operand1);
+		break;
+	case SSMAOpCode::call:
+		inst.Op = ThreadedOp::call;
+		target(op->As<OP_U4>()->Operand1);
+		value(rip);
+		break;
+	case SSMAOpCode::ret:
+		inst.Op = ThreadedOp::ret;
+		break;
+
+	default:
+		inst.Op = ThreadedOp::invalid;
+		break;
+	}
+
+	return inst;
+}
+
+inline size_t ThreadedCode::_Fuse(const std::vector<_Inst> &insts, size_t k, const std::vector<bool> &isLeader, _Inst &fused)
+{
+	fused = insts[k];
+
+	// whether $n instructions from $k run in a row
+	auto inRow = [&](size_t n) {
+		if (k + n > insts.size())
+			return false;
+
+		for (size_t i = k + 1; i < k + n; ++i)
+		{
+			if (insts[i].Offset != insts[i - 1].Next || isLeader[insts[i].Offset])
+				return false;
+		}
+
+		return true;
+	};
+	auto op = [&](size_t i) { return insts[k + i].Op; };
+	auto isAddress = [&](size_t i) { return op(i) == ThreadedOp::push_r || op(i) == ThreadedOp::push_ra; };
+	auto isImmediate = [&](size_t i) { return op(i) == ThreadedOp::push_c0 || op(i) == ThreadedOp::push_c1 || op(i) == ThreadedOp::push_i; };
+	auto immediate = [&](size_t i) { return op(i) == ThreadedOp::push_i ? insts[k + i].Values[0] : op(i) == ThreadedOp::push_c1 ? 1 : 0; };
+
+	auto make = [&](ThreadedOp fusedOp, size_t count, size_t target) {
+		fused.Op = fusedOp;
+		fused.Next = insts[k + count - 1].Next;
+		fused.Target = target;
+		fused.ValueCount = 0;
+		return count;
+	};
+	auto makeAddress = [&](ThreadedOp fusedOp, size_t count, size_t i) {
+		make(fusedOp, count, _NoTarget);
+		fused.Values[0] = insts[k + i].Values[0];
+		fused.Values[1] = op(i) == ThreadedOp::push_ra ? insts[k + i].Values[1] : 0;
+		fused.ValueCount = 2;
+		return count;
+	};
+	auto makeImmediate = [&](ThreadedOp fusedOp, size_t count, size_t i, size_t target) {
+		make(fusedOp, count, target);
+		fused.Values[0] = immediate(i);
+		fused.ValueCount = 1;
+		return count;
+	};
+
+	// longer sequences are tried first
+	if (inRow(4) && op(0) == ThreadedOp::dup && isAddress(1) && op(2) == ThreadedOp::store_4 && op(3) == ThreadedOp::pop)
+		return makeAddress(ThreadedOp::store_ra, 4, 1);
+
+	if (inRow(3) && isImmediate(0) && op(1) == ThreadedOp::sub && op(2) == ThreadedOp::jmpz)
+		return makeImmediate(ThreadedOp::sub_i_jmpz, 3, 0, insts[k + 2].Target);
+	if (inRow(3) && isImmediate(0) && op(1) == ThreadedOp::sub && op(2) == ThreadedOp::jmpn)
+		return makeImmediate(ThreadedOp::sub_i_jmpn, 3, 0, insts[k + 2].Target);
+
+	if (inRow(2) && isAddress(0) && op(1) == ThreadedOp::load_4)
+		return makeAddress(ThreadedOp::load_ra, 2, 0);
+	if (inRow(2) && isAddress(0) && op(1) == ThreadedOp::store_4)
+		return makeAddress(ThreadedOp::store_ra, 2, 0);
+	if (inRow(2) && isImmediate(0) && op(1) == ThreadedOp::add)
+		return makeImmediate(ThreadedOp::add_i, 2, 0, _NoTarget);
+	if (inRow(2) && isImmediate(0) && op(1) == ThreadedOp::sub)
+		return makeImmediate(ThreadedOp::sub_i, 2, 0, _NoTarget);
+	if (inRow(2) && op(0) == ThreadedOp::sub && op(1) == ThreadedOp::jmpz)
+		return make(ThreadedOp::sub_jmpz, 2, insts[k + 1].Target);
+	if (inRow(2) && op(0) == ThreadedOp::sub && op(1) == ThreadedOp::jmpn)
+		return make(ThreadedOp::sub_jmpn, 2, insts[k + 1].Target);
+	if (inRow(2) && op(0) == ThreadedOp::push_r && op(1) == ThreadedOp::dup)
+	{
+		make(ThreadedOp::push_r_dup, 2, _NoTarget);
+		fused.Values[0] = insts[k].Values[0];
+		fused.ValueCount = 1;
+		return 2;
+	}
+
+	return 1;
+}
+
+inline ThreadedCode ThreadedCode::Decode(const SSMModule &module, bool fuse)
+{
+	std::set<size_t> reachable;
+	std::vector<int> depthOf;
+	if (!Analyze(module, reachable, depthOf))
+		throw 0;
+
+	std::vector<_Inst> insts;
+	size_t end = 0;
+	for (auto offset : reachable)
+	{
+		// instructions overlapped, i.e. a jump into the middle of an instruction, are not supported
+		_Assert(offset >= end);
+
+		insts.push_back(_DecodeInst(module, offset));
+		end = insts.back().Next;
+	}
+
+	// leaders are the entry, targets of jumps and calls, and where a branch falls through or a call returns to
+	std::vector<bool> isLeader(end + 1, false);
+	isLeader[module.InstOffset] = true;
+	for (const auto &inst : insts)
+	{
+		if (inst.Target != _NoTarget)
+			isLeader[inst.Target] = true;
+		if (inst.Op == ThreadedOp::jmpz || inst.Op == ThreadedOp::jmpn || inst.Op == ThreadedOp::call)
+			isLeader[inst.Next] = true;
+	}
+
+	ThreadedCode code;
+	code._slotOf.assign(*reachable.rbegin() + 1, static_cast<size_t>(-1));
+	code._instCount = insts.size();
+
+	// jumps are resolved when all handler slots are known
+	std::vector<std::pair<size_t, size_t>> jumps; // index of the target slot -> offset of the target
+	// instructions since the last leader
+	cpuval_t blockCount = 0;
+
+	for (size_t k = 0; k < insts.size();)
+	{
+		_Inst inst = insts[k];
+		auto count = fuse ? _Fuse(insts, k, isLeader, inst) : 1;
+		k += count;
+		blockCount += static_cast<cpuval_t>(count);
+
+		if (isLeader[inst.Offset])
+		{
+			code._offsetOf.resize(code._slots.size() + 1, static_cast<size_t>(-1));
+			code._offsetOf[code._slots.size()] = inst.Offset;
+		}
+		code._slotOf[inst.Offset] = code._slots.size();
+		code._handlerCount += 1;
+
+		ThreadedSlot slot;
+		slot.Op = static_cast<size_t>(inst.Op);
+		code._slots.push_back(slot);
+
+		if (inst.Target != _NoTarget)
+		{
+			jumps.emplace_back(code._slots.size(), inst.Target);
+			code._slots.push_back(ThreadedSlot{});
+		}
+
+		for (size_t i = 0; i < inst.ValueCount; ++i)
+		{
+			slot.Value = inst.Values[i];
+			code._slots.push_back(slot);
+		}
+
+		// a block ends where control is transferred, or where it falls through into a leader
+		//   which is charged by a tick, as no operation is there to take the count
+		auto fallsIntoLeader = inst.Op != ThreadedOp::invalid && !_EndsBlock(inst.Op) && isLeader[inst.Next];
+		if (fallsIntoLeader)
+		{
+			slot.Op = static_cast<size_t>(ThreadedOp::tick);
+			code._slots.push_back(slot);
+			code._handlerCount += 1;
+		}
+		if (_EndsBlock(inst.Op) || fallsIntoLeader)
+		{
+			slot.Value = blockCount;
+			code._slots.push_back(slot);
+			blockCount = 0;
+		}
+	}
+
+	// NOTE slots are not moved from now on
+	for (const auto &jump : jumps)
+	{
+		code._slots[jump.first].Target = code.Locate(static_cast<cpuval_t>(jump.second));
+	}
+
+	code._entry = code._slotOf[module.InstOffset];
+	code._depthOf = std::move(depthOf);
+	return code;
+}
\ No newline at end of file
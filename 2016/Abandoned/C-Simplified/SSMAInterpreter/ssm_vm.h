@@ -1,36 +1,95 @@
 #pragma once
 #include "ssm_cpu.h"
+#include "ssm_memory.h"
 #include "ssm_module.h"
+#include <chrono>
 #include <memory>
 
 class SSMVirtualMachine
 {
 	static constexpr size_t StackSize = 1 * 1024 * 1024; // 1 MB
 	SSMCPU _cpu;
-	uint8_t *_stk = new uint8_t[StackSize];
+	// the module and the stack are allocated in memory of the vm, which is sandboxed
+	//   memory may be taken from a pool, which it's returned to when the vm is destructed
+	std::shared_ptr<MemoryBus> _memory;
+	SSMModule _module;
+	cpuval_t _stk;
+	// the module is pre-decoded once, and run as threaded code
+	ThreadedCode _code;
+	// or run as native code, if enabled and supported
+	std::unique_ptr<JitCode> _jit;
+	// time spent running the vm, and runs, i.e. calls of Run and RunSlice
+	std::chrono::nanoseconds _runTime{ 0 };
+	size_t _runCount = 0;
 
-	SSMVirtualMachine(const SSMModule &module)
+	SSMVirtualMachine(std::shared_ptr<MemoryBus> memory, const SSMModule &module, bool enableJit)
+		:_memory(std::move(memory)), _module(_memory->Load(module)), _stk(_memory->Allocate(StackSize)), _code(ThreadedCode::Decode(_module))
 	{
-		_cpu.Initialize(module.ModuleBase, module.InstOffset, _stk);
+		if (enableJit)
+			_jit = JitCode::Compile(_module);
+
+		_cpu.Initialize(*_memory, _module, _stk);
 	}
 
 public:
-	~SSMVirtualMachine()
-	{
-		delete[] _stk;
-	}
+	// whether the module is run as native code
+	//   i.e. false if the jit is disabled, or falls back to the interpreter
+	bool IsJitted() const { return _jit != nullptr; }
+
+	CPUState GetState() { return _cpu.GetState(); }
 
+	// memory of the vm, and address of the stack in it, e.g. to read results
+	MemoryBus &GetMemory() { return *_memory; }
+	cpuval_t GetStack() const { return _stk; }
+
+	// cpu time accounted to the vm
+	//   instructions executed, except those of native code, see SSMCPU::GetInstructionCount
+	size_t GetInstructionCount() const { return _cpu.GetInstructionCount(); }
+	//   time spent running, measured by the clock around each run
+	std::chrono::nanoseconds GetRunTime() const { return _runTime; }
+	size_t GetRunCount() const { return _runCount; }
+
+	// Run the module until termination, and returns whether it terminates
+	//   i.e. false if it faults on accessing memory unallocated
 	bool Run()
 	{
-		while (_cpu.GetState() == CPUState::Running)
-			_cpu.Cycle();
+		auto start = std::chrono::steady_clock::now();
+		// native code runs from the entry, so a vm run by slices before goes on as threaded code
+		if (_cpu.GetState() == CPUState::Running && _jit && _runCount == 0)
+			_cpu.Run(*_jit);
+		else if (_cpu.GetState() == CPUState::Running)
+			_cpu.Run(_code);
 
+		_runTime += std::chrono::steady_clock::now() - start;
+		_runCount += 1;
 		return _cpu.GetState() == CPUState::Terminated;
 	}
 
-	static std::shared_ptr<SSMVirtualMachine> Create(const SSMModule &module)
+	// Run the module for a slice of about $budget instructions, and returns whether it's still running
+	//   a slice yields at the end of a block, see SSMCPU::Run
+	//   the module is run as threaded code even if jitted, since native code has nowhere to yield
+	bool RunSlice(size_t budget)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (_cpu.GetState() == CPUState::Running)
+			_cpu.Run(_code, budget);
+
+		_runTime += std::chrono::steady_clock::now() - start;
+		_runCount += 1;
+		return _cpu.GetState() == CPUState::Running;
+	}
+
+	// the module is translated into native code if $enableJit, where supported
+	static std::shared_ptr<SSMVirtualMachine> Create(const SSMModule &module, bool enableJit = false)
+	{
+		SSMVirtualMachine *p = new SSMVirtualMachine(std::make_shared<MemoryBus>(), module, enableJit);
+		return std::shared_ptr<SSMVirtualMachine>(p);
+	}
+
+	// memory of the vm is taken from $pool, which waits if all is taken, see MemoryPool
+	static std::shared_ptr<SSMVirtualMachine> Create(const SSMModule &module, MemoryPool &pool)
 	{
-		SSMVirtualMachine *p = new SSMVirtualMachine(module);
+		SSMVirtualMachine *p = new SSMVirtualMachine(pool.Acquire(), module, false);
 		return std::shared_ptr<SSMVirtualMachine>(p);
 	}
 };
\ No newline at end of file
@@ -10,6 +10,26 @@
 #include <stack>
 #include <vector>
 #include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace eds;
 
@@ -654,6 +674,641 @@ namespace jsonlite
 		callback();
 		_impl->CloseObject();
 	}
+
+	//============================================================================
+	// JsonWriter
+	namespace internal
+	{
+		// number formatting
+
+		constexpr CharType DIGIT_PAIRS[] =
+			"00010203040506070809"
+			"10111213141516171819"
+			"20212223242526272829"
+			"30313233343536373839"
+			"40414243444546474849"
+			"50515253545556575859"
+			"60616263646566676869"
+			"70717273747576777879"
+			"80818283848586878889"
+			"90919293949596979899";
+
+		constexpr uint64_t POWERS_OF_10[] =
+		{
+			1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+			100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+			10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+			100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+		};
+
+		inline int CountLeadingZero(uint64_t x)
+		{
+			// assume x != 0
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, x);
+			return 63 - static_cast<int>(index);
+#else
+			return __builtin_clzll(x);
+#endif
+		}
+
+		inline int CountDecimalDigits(uint64_t x)
+		{
+			// approximate log10 by log2, then correct it with a single comparison
+			// NOTE zero is treated as one to yield a single digit
+			x |= 1;
+			int t = ((64 - CountLeadingZero(x)) * 1233) >> 12;
+			return t + (x >= POWERS_OF_10[t]);
+		}
+
+		// write 4 digits of x < 10000, with leading zeros
+		inline void Write4Digits(CharType *p, uint32_t x)
+		{
+			memcpy(p, DIGIT_PAIRS + (x / 100) * 2, 2);
+			memcpy(p + 2, DIGIT_PAIRS + (x % 100) * 2, 2);
+		}
+
+		// write 8 digits of x < 100000000, with leading zeros
+		inline void Write8Digits(CharType *p, uint32_t x)
+		{
+			Write4Digits(p, x / 10000);
+			Write4Digits(p + 4, x % 10000);
+		}
+
+		// write digits of x at [p, p + CountDecimalDigits(x)), returns end of the digits
+		// NOTE all 20 digits are formatted, and the significant ones are copied, so no branch depends on x
+		//      20 chars at p are overwritten
+		inline CharType *WriteUnsigned(CharType *p, uint64_t x)
+		{
+			CharType digits[40] = {};
+			Write4Digits(digits, static_cast<uint32_t>(x / 10000000000000000ull));
+			Write8Digits(digits + 4, static_cast<uint32_t>(x / 100000000 % 100000000));
+			Write8Digits(digits + 12, static_cast<uint32_t>(x % 100000000));
+
+			int n = CountDecimalDigits(x);
+			memcpy(p, digits + 20 - n, 20);
+			return p + n;
+		}
+
+		inline CharType *WriteSigned(CharType *p, int64_t x)
+		{
+			uint64_t u = static_cast<uint64_t>(x);
+			if (x < 0)
+			{
+				*p++ = '-';
+				u = 0 - u;
+			}
+
+			return WriteUnsigned(p, u);
+		}
+
+		// Grisu2 algorithm by Florian Loitsch, which yields shortest(in most cases) digits
+		// that guarantee round trip of the double
+		namespace grisu
+		{
+			constexpr uint64_t DP_SIGNIFICAND_MASK = 0x000fffffffffffffull;
+			constexpr uint64_t DP_EXPONENT_MASK = 0x7ff0000000000000ull;
+			constexpr uint64_t DP_HIDDEN_BIT = 0x0010000000000000ull;
+			constexpr int DP_SIGNIFICAND_SIZE = 52;
+			constexpr int DP_EXPONENT_BIAS = 0x3ff + DP_SIGNIFICAND_SIZE;
+			constexpr int DP_MIN_EXPONENT = -DP_EXPONENT_BIAS;
+			constexpr int DIY_SIGNIFICAND_SIZE = 64;
+
+			// 10^k normalized as DiyFp, for k = -348, -340, ..., 340
+			constexpr uint64_t CACHED_POWERS_F[] =
+			{
+			0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+			0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+			0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+			0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+			0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+			0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+			0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+			0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+			0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+			0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+			0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+			0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+			0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+			0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+			0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+			0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+			0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+			0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+			0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+			0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+			0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+			0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+			0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+			0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+			0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+			0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+			0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+			0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+			0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+			};
+			constexpr int16_t CACHED_POWERS_E[] =
+			{
+			-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+			-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+			-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+			-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+			-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+			109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+			375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+			641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+			907, 933, 960, 986, 1013, 1039, 1066,
+			};
+
+			struct DiyFp
+			{
+				uint64_t F;
+				int E;
+
+				DiyFp Subtract(const DiyFp &rhs) const
+				{
+					return DiyFp{ F - rhs.F, E };
+				}
+
+				DiyFp Multiply(const DiyFp &rhs) const
+				{
+					const uint64_t M32 = 0xffffffffull;
+					uint64_t a = F >> 32, b = F & M32;
+					uint64_t c = rhs.F >> 32, d = rhs.F & M32;
+					uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+
+					// round the lower 64 bits
+					uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ull << 31);
+					return DiyFp{ ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), E + rhs.E + 64 };
+				}
+
+				DiyFp Normalize() const
+				{
+					int s = CountLeadingZero(F);
+					return DiyFp{ F << s, E - s };
+				}
+			};
+
+			inline DiyFp FromDouble(double d)
+			{
+				uint64_t u;
+				memcpy(&u, &d, sizeof(u));
+
+				int biasedE = static_cast<int>((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+				uint64_t significand = u & DP_SIGNIFICAND_MASK;
+				if (biasedE != 0)
+					return DiyFp{ significand + DP_HIDDEN_BIT, biasedE - DP_EXPONENT_BIAS };
+				else
+					return DiyFp{ significand, DP_MIN_EXPONENT + 1 };
+			}
+
+			// boundaries m- and m+ of v, normalized with the same exponent
+			inline void NormalizedBoundaries(const DiyFp &v, DiyFp &minus, DiyFp &plus)
+			{
+				plus = DiyFp{ (v.F << 1) + 1, v.E - 1 }.Normalize();
+				minus = (v.F == DP_HIDDEN_BIT)
+					? DiyFp{ (v.F << 2) - 1, v.E - 2 }
+					: DiyFp{ (v.F << 1) - 1, v.E - 1 };
+
+				minus.F <<= minus.E - plus.E;
+				minus.E = plus.E;
+			}
+
+			// find c = 10^-K such that the exponent of c * w falls in [-60, -32]
+			inline DiyFp GetCachedPower(int e, int &K)
+			{
+				double dk = (-61 - e) * 0.30102999566398114 + 347;
+				int k = static_cast<int>(dk);
+				if (dk - k > 0.0)
+					k++;
+
+				unsigned index = static_cast<unsigned>((k >> 3) + 1);
+				K = -(-348 + static_cast<int>(index << 3));
+
+				return DiyFp{ CACHED_POWERS_F[index], CACHED_POWERS_E[index] };
+			}
+
+			inline void GrisuRound(CharType *buffer, int len, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t wpw)
+			{
+				while (rest < wpw && delta - rest >= tenKappa
+					&& (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw))
+				{
+					buffer[len - 1]--;
+					rest += tenKappa;
+				}
+			}
+
+			inline void DigitGen(const DiyFp &W, const DiyFp &Mp, uint64_t delta, CharType *buffer, int &len, int &K)
+			{
+				const DiyFp one{ 1ull << -Mp.E, Mp.E };
+				const DiyFp wpw = Mp.Subtract(W);
+
+				uint32_t p1 = static_cast<uint32_t>(Mp.F >> -one.E);
+				uint64_t p2 = Mp.F & (one.F - 1);
+				int kappa = CountDecimalDigits(p1);
+				len = 0;
+
+				// integral part
+				while (kappa > 0)
+				{
+					uint32_t pow = static_cast<uint32_t>(POWERS_OF_10[kappa - 1]);
+					uint32_t d = p1 / pow;
+					p1 %= pow;
+
+					if (d || len)
+						buffer[len++] = static_cast<CharType>('0' + d);
+
+					kappa--;
+					uint64_t tmp = (static_cast<uint64_t>(p1) << -one.E) + p2;
+					if (tmp <= delta)
+					{
+						K += kappa;
+						GrisuRound(buffer, len, delta, tmp, POWERS_OF_10[kappa] << -one.E, wpw.F);
+						return;
+					}
+				}
+
+				// fractional part
+				while (true)
+				{
+					p2 *= 10;
+					delta *= 10;
+
+					CharType d = static_cast<CharType>(p2 >> -one.E);
+					if (d || len)
+						buffer[len++] = static_cast<CharType>('0' + d);
+
+					p2 &= one.F - 1;
+					kappa--;
+					if (p2 < delta)
+					{
+						K += kappa;
+						int index = -kappa;
+						GrisuRound(buffer, len, delta, p2, one.F, wpw.F * (index < 20 ? POWERS_OF_10[index] : 0));
+						return;
+					}
+				}
+			}
+
+			// digits of a positive finite value v = buffer * 10^K
+			inline void Grisu2(double value, CharType *buffer, int &len, int &K)
+			{
+				const DiyFp v = FromDouble(value);
+				DiyFp wm, wp;
+				NormalizedBoundaries(v, wm, wp);
+
+				const DiyFp c = GetCachedPower(wp.E, K);
+				const DiyFp W = v.Normalize().Multiply(c);
+				DiyFp Wp = wp.Multiply(c);
+				DiyFp Wm = wm.Multiply(c);
+				Wm.F++;
+				Wp.F--;
+
+				DigitGen(W, Wp, Wp.F - Wm.F, buffer, len, K);
+			}
+		}
+
+		// write digits * 10^K in the form of ECMAScript Number.prototype.toString
+		inline CharType *Prettify(CharType *p, const CharType *digits, int len, int K)
+		{
+			// position of the decimal point
+			const int kk = len + K;
+
+			if (K >= 0 && kk <= 21)
+			{
+				// 1234e7 -> 12340000000
+				memcpy(p, digits, len);
+				memset(p + len, '0', K);
+				return p + kk;
+			}
+			else if (kk > 0 && kk <= 21)
+			{
+				// 1234e-2 -> 12.34
+				memcpy(p, digits, kk);
+				p[kk] = '.';
+				memcpy(p + kk + 1, digits + kk, len - kk);
+				return p + len + 1;
+			}
+			else if (kk > -6 && kk <= 0)
+			{
+				// 1234e-6 -> 0.001234
+				const int offset = 2 - kk;
+				p[0] = '0';
+				p[1] = '.';
+				memset(p + 2, '0', -kk);
+				memcpy(p + offset, digits, len);
+				return p + offset + len;
+			}
+			else
+			{
+				// 1234e30 -> 1.234e+33
+				*p++ = digits[0];
+				if (len > 1)
+				{
+					*p++ = '.';
+					memcpy(p, digits + 1, len - 1);
+					p += len - 1;
+				}
+
+				*p++ = 'e';
+				int exp = kk - 1;
+				if (exp < 0)
+				{
+					*p++ = '-';
+					exp = -exp;
+				}
+				else
+				{
+					*p++ = '+';
+				}
+
+				return WriteUnsigned(p, static_cast<uint64_t>(exp));
+			}
+		}
+
+		// large enough for any double or 64-bit integer, with the chars WriteUnsigned overwrites after it
+		constexpr size_t MAX_NUMBER_LENGTH = 48;
+
+		inline CharType *WriteDouble(CharType *p, double value)
+		{
+			// NOTE -0.0 compares equal to 0, so its sign is checked by bit
+			if (std::signbit(value))
+			{
+				*p++ = '-';
+				value = -value;
+			}
+			if (value == 0)
+			{
+				*p++ = '0';
+				return p;
+			}
+
+			CharType digits[24];
+			int len, K;
+			grisu::Grisu2(value, digits, len, K);
+
+			return Prettify(p, digits, len, K);
+		}
+
+		// characters that must be escaped in a json string
+		struct EscapeTable
+		{
+			CharType Table[256];
+
+			constexpr EscapeTable() : Table()
+			{
+				for (int i = 0; i < 0x20; ++i)
+				{
+					Table[i] = 'u';
+				}
+
+				Table['\b'] = 'b';
+				Table['\f'] = 'f';
+				Table['\n'] = 'n';
+				Table['\r'] = 'r';
+				Table['\t'] = 't';
+				Table['\"'] = '\"';
+				Table['\\'] = '\\';
+			}
+		};
+
+		constexpr EscapeTable JSON_ESCAPE_TABLE;
+	}
+
+	JsonWriter::JsonWriter() { }
+	JsonWriter::JsonWriter(int fd, size_t chunkSize) : _fd(fd), _chunkSize(chunkSize)
+	{
+		if (chunkSize == 0)
+			throw Exception("Chunk size must be positive.");
+
+		_Reserve(chunkSize);
+	}
+	JsonWriter::~JsonWriter()
+	{
+		if (_fd != -1 && _size != 0)
+		{
+			try
+			{
+				Flush();
+			}
+			catch (...) { }
+		}
+	}
+
+	void JsonWriter::Clear()
+	{
+		_size = 0;
+		_nonEmpty.clear();
+		_inObject.clear();
+		_keyWritten = false;
+	}
+
+	void JsonWriter::Flush()
+	{
+		if (_fd == -1)
+			throw Exception("JsonWriter is not bound to a file descriptor.");
+
+		// a chunk per write, so that a buffer grown by a large value is not written at once
+		size_t written = 0;
+		while (written < _size)
+		{
+			auto chunk = std::min(_size - written, _chunkSize);
+#ifdef _WIN32
+			auto n = _write(_fd, _buffer.get() + written, static_cast<unsigned>(chunk));
+#else
+			auto n = write(_fd, _buffer.get() + written, chunk);
+#endif
+			if (n < 0)
+			{
+				if (errno == EINTR) continue;
+				throw Exception("Failed to write to the file descriptor.");
+			}
+
+			written += static_cast<size_t>(n);
+		}
+
+		_size = 0;
+	}
+
+	internal::CharType *JsonWriter::_Reserve(size_t n)
+	{
+		// for a file-backed writer, drain the buffer once a chunk is filled
+		// NOTE the buffer only grows beyond a chunk for a single value larger than that
+		if (_fd != -1 && _size != 0 && _size + n > _chunkSize)
+		{
+			Flush();
+		}
+
+		if (_size + n > _capacity)
+		{
+			size_t capacity = _capacity == 0 ? 256 : _capacity * 2;
+			while (capacity < _size + n)
+			{
+				capacity *= 2;
+			}
+
+			std::unique_ptr<internal::CharType[]> buffer(new internal::CharType[capacity]);
+			if (_size != 0)
+			{
+				memcpy(buffer.get(), _buffer.get(), _size);
+			}
+
+			_buffer = Move(buffer);
+			_capacity = capacity;
+		}
+
+		return _buffer.get() + _size;
+	}
+
+	void JsonWriter::_Write(const internal::CharType *p, size_t n)
+	{
+		memcpy(_Reserve(n), p, n);
+		_size += n;
+	}
+
+	void JsonWriter::_PrepareValue()
+	{
+		if (_nonEmpty.empty())
+			return;
+
+		if (_inObject.back())
+		{
+			if (!_keyWritten)
+				throw Exception("A field key is expected.");
+
+			_keyWritten = false;
+		}
+		else
+		{
+			if (_nonEmpty.back())
+				_Put(internal::JSON_ELEMENT_SAPERATOR);
+
+			_nonEmpty.back() = true;
+		}
+	}
+
+	void JsonWriter::_WriteEscapedString(internal::StringViewType str)
+	{
+		const auto &table = internal::JSON_ESCAPE_TABLE.Table;
+
+		// worst case of the escaped string is 6 times the length
+		internal::CharType *p = _Reserve(str.size() * 6 + 2);
+		*p++ = internal::JSON_BEGIN_STRING;
+
+		for (internal::CharType ch : str)
+		{
+			internal::CharType esc = table[static_cast<uint8_t>(ch)];
+			if (esc == 0)
+			{
+				*p++ = ch;
+			}
+			else if (esc == 'u')
+			{
+				*p++ = '\\';
+				*p++ = 'u';
+				*p++ = '0';
+				*p++ = '0';
+				*p++ = "0123456789abcdef"[static_cast<uint8_t>(ch) >> 4];
+				*p++ = "0123456789abcdef"[static_cast<uint8_t>(ch) & 0xf];
+			}
+			else
+			{
+				*p++ = '\\';
+				*p++ = esc;
+			}
+		}
+
+		*p++ = internal::JSON_END_STRING;
+		_Commit(p);
+	}
+
+	void JsonWriter::FeedKey(internal::StringViewType key)
+	{
+		if (_inObject.empty() || !_inObject.back() || _keyWritten)
+			throw Exception("A field key is not expected.");
+
+		if (_nonEmpty.back())
+			_Put(internal::JSON_ELEMENT_SAPERATOR);
+
+		_nonEmpty.back() = true;
+		_WriteEscapedString(key);
+		_Put(internal::JSON_PAIR_SAPERATOR);
+		_keyWritten = true;
+	}
+
+	void JsonWriter::FeedNull()
+	{
+		_PrepareValue();
+		_Write(internal::JSON_LITERAL_NULL, 4);
+	}
+	void JsonWriter::FeedBoolean(bool value)
+	{
+		_PrepareValue();
+		if (value)
+			_Write(internal::JSON_LITERAL_TRUE, 4);
+		else
+			_Write(internal::JSON_LITERAL_FALSE, 5);
+	}
+	void JsonWriter::FeedInteger(int64_t value)
+	{
+		_PrepareValue();
+		_Commit(internal::WriteSigned(_Reserve(internal::MAX_NUMBER_LENGTH), value));
+	}
+	void JsonWriter::FeedUnsigned(uint64_t value)
+	{
+		_PrepareValue();
+		_Commit(internal::WriteUnsigned(_Reserve(internal::MAX_NUMBER_LENGTH), value));
+	}
+	void JsonWriter::FeedDouble(double value)
+	{
+		_PrepareValue();
+
+		// json has no representation of NaN or infinity
+		if (value != value || value - value != 0)
+			_Write(internal::JSON_LITERAL_NULL, 4);
+		else
+			_Commit(internal::WriteDouble(_Reserve(internal::MAX_NUMBER_LENGTH), value));
+	}
+	void JsonWriter::FeedString(internal::StringViewType value)
+	{
+		_PrepareValue();
+		_WriteEscapedString(value);
+	}
+
+	void JsonWriter::BeginArray()
+	{
+		_PrepareValue();
+		_Put(internal::JSON_BEGIN_ARRAY);
+		_nonEmpty.push_back(false);
+		_inObject.push_back(false);
+	}
+	void JsonWriter::EndArray()
+	{
+		if (_inObject.empty() || _inObject.back())
+			throw Exception("Trying to close a unmatched state.");
+
+		_nonEmpty.pop_back();
+		_inObject.pop_back();
+		_Put(internal::JSON_END_ARRAY);
+	}
+	void JsonWriter::BeginObject()
+	{
+		_PrepareValue();
+		_Put(internal::JSON_BEGIN_OBJECT);
+		_nonEmpty.push_back(false);
+		_inObject.push_back(true);
+	}
+	void JsonWriter::EndObject()
+	{
+		if (_inObject.empty() || !_inObject.back() || _keyWritten)
+			throw Exception("Trying to close a unmatched state.");
+
+		_nonEmpty.pop_back();
+		_inObject.pop_back();
+		_Put(internal::JSON_END_OBJECT);
+	}
+
 	//*
 	//============================================================================
 	// JsonValue
@@ -726,4 +1381,1187 @@ namespace jsonlite
 		return JsonValue(*_ctx);
 	}
 	//*/
+
+	//============================================================================
+	// JsonDocument
+	namespace internal
+	{
+		constexpr size_t JSON_MAX_DEPTH = 512;
+		// objects with at least this many members get a hash index
+		constexpr uint32_t JSON_HASHED_OBJECT_THRESHOLD = 8;
+
+		inline uint32_t CalcHashIndexCapacity(uint32_t count)
+		{
+			// keep load factor under 0.5
+			uint32_t capacity = 16;
+			while (capacity < count * 2)
+			{
+				capacity <<= 1;
+			}
+
+			return capacity;
+		}
+
+		inline int ParseHexDigit(CharType ch)
+		{
+			if (ch >= '0' && ch <= '9') return ch - '0';
+			if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+			if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+
+			return -1;
+		}
+
+		inline void AppendUtf8(StringType &s, uint32_t cp)
+		{
+			if (cp < 0x80)
+			{
+				s.push_back(static_cast<CharType>(cp));
+			}
+			else if (cp < 0x800)
+			{
+				s.push_back(static_cast<CharType>(0xc0 | (cp >> 6)));
+				s.push_back(static_cast<CharType>(0x80 | (cp & 0x3f)));
+			}
+			else if (cp < 0x10000)
+			{
+				s.push_back(static_cast<CharType>(0xe0 | (cp >> 12)));
+				s.push_back(static_cast<CharType>(0x80 | ((cp >> 6) & 0x3f)));
+				s.push_back(static_cast<CharType>(0x80 | (cp & 0x3f)));
+			}
+			else
+			{
+				s.push_back(static_cast<CharType>(0xf0 | (cp >> 18)));
+				s.push_back(static_cast<CharType>(0x80 | ((cp >> 12) & 0x3f)));
+				s.push_back(static_cast<CharType>(0x80 | ((cp >> 6) & 0x3f)));
+				s.push_back(static_cast<CharType>(0x80 | (cp & 0x3f)));
+			}
+		}
+
+		// unescape raw text of a string, which is assumed to be validated
+		StringType UnescapeJsonString(StringViewType raw)
+		{
+			StringType s;
+			s.reserve(raw.size());
+
+			for (size_t i = 0; i < raw.size(); ++i)
+			{
+				if (raw[i] != JSON_ESCAPE_CHARACTER)
+				{
+					s.push_back(raw[i]);
+					continue;
+				}
+
+				switch (raw[++i])
+				{
+				case 'b': s.push_back('\b'); break;
+				case 'f': s.push_back('\f'); break;
+				case 'r': s.push_back('\r'); break;
+				case 'n': s.push_back('\n'); break;
+				case 't': s.push_back('\t'); break;
+				case 'u':
+				{
+					uint32_t cp = 0;
+					for (size_t k = 0; k < 4; ++k)
+					{
+						cp = (cp << 4) | ParseHexDigit(raw[++i]);
+					}
+
+					// combine a surrogate pair if any
+					if (cp >= 0xd800 && cp < 0xdc00
+						&& i + 6 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u')
+					{
+						uint32_t low = 0;
+						for (size_t k = 0; k < 4; ++k)
+						{
+							low = (low << 4) | ParseHexDigit(raw[i + 3 + k]);
+						}
+
+						if (low >= 0xdc00 && low < 0xe000)
+						{
+							cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+							i += 6;
+						}
+					}
+
+					AppendUtf8(s, cp);
+					break;
+				}
+				default:
+					// '\"', '/' and '\\'
+					s.push_back(raw[i]);
+					break;
+				}
+			}
+
+			return s;
+		}
+
+		// builds the arena of a JsonDocument in a single pass
+		class JsonDomBuilder
+		{
+		public:
+			JsonDomBuilder(JsonDocument &doc)
+				: _doc(doc)
+				, _begin(doc._source.data())
+				, _cursor(doc._source.data())
+				, _end(doc._source.data() + doc._source.size()) { }
+
+			// parse a single value that spans the whole source
+			uint32_t BuildDocument()
+			{
+				if (_doc._source.size() >= JSON_NODE_NO_INDEX)
+					throw Exception("Source text is too large.");
+
+				uint32_t root = _ParseValue(0);
+
+				_SkipWhitespace();
+				if (_cursor != _end)
+					throw Exception("Unexpected character after the document.");
+
+				return root;
+			}
+
+			// parse a value on each non-empty line
+			void BuildLines(std::vector<uint32_t> &roots)
+			{
+				if (_doc._source.size() >= JSON_NODE_NO_INDEX)
+					throw Exception("Source text is too large.");
+
+				while (true)
+				{
+					// empty lines are skipped between values, but a value may not span lines
+					_lineMode = false;
+					_SkipWhitespace();
+					if (_cursor == _end)
+						break;
+
+					_lineMode = true;
+					roots.push_back(_ParseValue(0));
+
+					// nothing but whitespaces may follow a value on the same line
+					while (_cursor != _end && (*_cursor == ' ' || *_cursor == '\r' || *_cursor == '\t'))
+					{
+						++_cursor;
+					}
+
+					if (_cursor != _end && *_cursor != '\n')
+						throw Exception("Unexpected character after the document.");
+				}
+			}
+
+		private:
+			void _SkipWhitespace()
+			{
+				while (_cursor != _end
+					&& (*_cursor == ' ' || (*_cursor == '\n' && !_lineMode) || *_cursor == '\r' || *_cursor == '\t'))
+				{
+					++_cursor;
+				}
+			}
+			CharType _PeekNextNonWhitespace()
+			{
+				_SkipWhitespace();
+				if (_cursor == _end)
+					throw Exception("Unexpected EOF encountered");
+				if (*_cursor == '\n')
+					throw Exception("Unexpected end of line in a json line.");
+
+				return *_cursor;
+			}
+			void _AssertNextNonWhitespace(CharType ch)
+			{
+				if (_PeekNextNonWhitespace() != ch)
+					throw Exception("Unexpected character encountered");
+
+				++_cursor;
+			}
+			void _AssertLiteral(const CharType *p)
+			{
+				for (; *p != '\0'; ++p, ++_cursor)
+				{
+					if (_cursor == _end || *_cursor != *p)
+						throw Exception("Invalid literal.");
+				}
+			}
+
+			uint32_t _NewNode(JsonType type, uint32_t length = 0, uint32_t offset = 0)
+			{
+				_doc._nodes.push_back(JsonNode{ type, 0, 0, length, offset, 0 });
+				return static_cast<uint32_t>(_doc._nodes.size() - 1);
+			}
+
+			uint32_t _ParseValue(size_t depth)
+			{
+				switch (_PeekNextNonWhitespace())
+				{
+				case 'n':
+					_AssertLiteral(JSON_LITERAL_NULL);
+					return _NewNode(JsonType::Null);
+				case 't':
+					_AssertLiteral(JSON_LITERAL_TRUE);
+					return _NewNode(JsonType::Boolean, 0, 1);
+				case 'f':
+					_AssertLiteral(JSON_LITERAL_FALSE);
+					return _NewNode(JsonType::Boolean, 0, 0);
+				case JSON_BEGIN_STRING:
+					return _ParseString(false);
+				case JSON_BEGIN_ARRAY:
+					return _ParseArray(depth + 1);
+				case JSON_BEGIN_OBJECT:
+					return _ParseObject(depth + 1);
+				default:
+					return _ParseNumber();
+				}
+			}
+
+			// validate a number, but leave conversion to JsonElement::AsDouble
+			uint32_t _ParseNumber()
+			{
+				const CharType *start = _cursor;
+				auto isDigit = [this]() { return _cursor != _end && *_cursor >= '0' && *_cursor <= '9'; };
+
+				if (_cursor != _end && *_cursor == '-') ++_cursor;
+
+				if (!isDigit())
+					throw Exception("Not a number value.");
+				if (*_cursor++ != '0')
+				{
+					while (isDigit()) ++_cursor;
+				}
+
+				if (_cursor != _end && *_cursor == '.')
+				{
+					++_cursor;
+					if (!isDigit())
+						throw Exception("Not a number value.");
+					while (isDigit()) ++_cursor;
+				}
+
+				if (_cursor != _end && (*_cursor == 'e' || *_cursor == 'E'))
+				{
+					++_cursor;
+					if (_cursor != _end && (*_cursor == '+' || *_cursor == '-')) ++_cursor;
+					if (!isDigit())
+						throw Exception("Not a number value.");
+					while (isDigit()) ++_cursor;
+				}
+
+				return _NewNode(JsonType::Number,
+					static_cast<uint32_t>(_cursor - start),
+					static_cast<uint32_t>(start - _begin));
+			}
+
+			uint32_t _ParseString(bool isKey)
+			{
+				// assume the cursor is at the opening quote
+				const CharType *start = ++_cursor;
+				bool escaped = false;
+
+				while (true)
+				{
+					if (_cursor == _end)
+						throw Exception("Unexpected EOF encountered");
+
+					CharType ch = *_cursor;
+					if (ch == JSON_END_STRING)
+					{
+						break;
+					}
+					else if (ch == JSON_ESCAPE_CHARACTER)
+					{
+						escaped = true;
+						_ValidateEscape();
+					}
+					else if (static_cast<uint8_t>(ch) < 0x20)
+					{
+						throw Exception("Unescaped control character in a string.");
+					}
+					else
+					{
+						++_cursor;
+					}
+				}
+
+				StringViewType raw(start, _cursor - start);
+				++_cursor;
+
+				uint32_t index = _NewNode(JsonType::String,
+					static_cast<uint32_t>(raw.size()),
+					static_cast<uint32_t>(start - _begin));
+
+				JsonNode &node = _doc._nodes[index];
+				node.Flags = escaped ? JSON_NODE_ESCAPED : 0;
+				if (isKey)
+				{
+					node.Extra = escaped
+						? HashJsonKey(UnescapeJsonString(raw))
+						: HashJsonKey(raw);
+				}
+
+				return index;
+			}
+
+			void _ValidateEscape()
+			{
+				// assume the cursor is at the backslash
+				if (_end - _cursor < 2)
+					throw Exception("Unexpected EOF encountered");
+
+				switch (_cursor[1])
+				{
+				case 'b': case 'f': case 'r': case 'n': case 't':
+				case '\"': case '/': case '\\':
+					_cursor += 2;
+					break;
+				case 'u':
+					if (_end - _cursor < 6)
+						throw Exception("Unexpected EOF encountered");
+					for (int i = 2; i < 6; ++i)
+					{
+						if (ParseHexDigit(_cursor[i]) < 0)
+							throw Exception("Invalid unicode escape sequence.");
+					}
+					_cursor += 6;
+					break;
+				default:
+					throw Exception("Unexpected characters to escape.");
+				}
+			}
+
+			uint32_t _ParseArray(size_t depth)
+			{
+				if (depth > JSON_MAX_DEPTH)
+					throw Exception("Json document is nested too deep.");
+
+				_AssertNextNonWhitespace(JSON_BEGIN_ARRAY);
+				uint32_t index = _NewNode(JsonType::Array);
+				size_t scratchBase = _scratch.size();
+
+				// if not an empty array
+				if (_PeekNextNonWhitespace() != JSON_END_ARRAY)
+				{
+					while (true)
+					{
+						_scratch.push_back(_ParseValue(depth));
+
+						if (_PeekNextNonWhitespace() == JSON_END_ARRAY)
+							break;
+
+						_AssertNextNonWhitespace(JSON_ELEMENT_SAPERATOR);
+					}
+				}
+
+				_AssertNextNonWhitespace(JSON_END_ARRAY);
+				_CommitChildren(index, scratchBase, _scratch.size() - scratchBase);
+
+				return index;
+			}
+
+			uint32_t _ParseObject(size_t depth)
+			{
+				if (depth > JSON_MAX_DEPTH)
+					throw Exception("Json document is nested too deep.");
+
+				_AssertNextNonWhitespace(JSON_BEGIN_OBJECT);
+				uint32_t index = _NewNode(JsonType::Object);
+				size_t scratchBase = _scratch.size();
+
+				// if not an empty object
+				if (_PeekNextNonWhitespace() != JSON_END_OBJECT)
+				{
+					while (true)
+					{
+						if (_PeekNextNonWhitespace() != JSON_BEGIN_STRING)
+							throw Exception("Expecting a key.");
+
+						_scratch.push_back(_ParseString(true));
+						_AssertNextNonWhitespace(JSON_PAIR_SAPERATOR);
+						_scratch.push_back(_ParseValue(depth));
+
+						if (_PeekNextNonWhitespace() == JSON_END_OBJECT)
+							break;
+
+						_AssertNextNonWhitespace(JSON_ELEMENT_SAPERATOR);
+					}
+				}
+
+				_AssertNextNonWhitespace(JSON_END_OBJECT);
+				uint32_t count = static_cast<uint32_t>((_scratch.size() - scratchBase) / 2);
+				_CommitChildren(index, scratchBase, count);
+
+				// build hash index for large objects
+				JsonNode &node = _doc._nodes[index];
+				node.Extra = JSON_NODE_NO_INDEX;
+				if (count >= JSON_HASHED_OBJECT_THRESHOLD)
+				{
+					uint32_t capacity = CalcHashIndexCapacity(count);
+					uint32_t mask = capacity - 1;
+
+					node.Extra = static_cast<uint32_t>(_doc._index.size());
+					_doc._index.resize(_doc._index.size() + capacity, 0);
+
+					uint32_t *table = _doc._index.data() + node.Extra;
+					for (uint32_t i = 0; i < count; ++i)
+					{
+						uint32_t hash = _doc._nodes[_doc._slots[node.Offset + 2 * i]].Extra;
+						uint32_t pos = hash & mask;
+						while (table[pos] != 0)
+						{
+							pos = (pos + 1) & mask;
+						}
+
+						// store ordinal + 1, so that 0 marks an empty bucket
+						table[pos] = i + 1;
+					}
+				}
+
+				return index;
+			}
+
+			// move children from the scratch stack to slots, which keeps them contiguous
+			void _CommitChildren(uint32_t index, size_t scratchBase, size_t count)
+			{
+				JsonNode &node = _doc._nodes[index];
+				node.Offset = static_cast<uint32_t>(_doc._slots.size());
+				node.Length = static_cast<uint32_t>(count);
+
+				_doc._slots.insert(_doc._slots.end(), _scratch.begin() + scratchBase, _scratch.end());
+				_scratch.resize(scratchBase);
+			}
+
+			JsonDocument &_doc;
+
+			const CharType *_begin;
+			const CharType *_cursor;
+			const CharType *_end;
+			// newlines end the value being parsed, see BuildLines
+			bool _lineMode = false;
+
+			// children of containers under construction
+			std::vector<uint32_t> _scratch;
+		};
+	}
+
+	JsonDocument::JsonDocument(internal::StringViewType source)
+		: _source(source)
+	{
+		_Build();
+	}
+	JsonDocument::JsonDocument(internal::StringType &&source)
+		: _storage(std::make_unique<internal::StringType>(Move(source)))
+	{
+		_source = *_storage;
+		_Build();
+	}
+
+	JsonElement JsonDocument::GetRoot(size_t index) const
+	{
+		if (index >= _roots.size())
+			throw Exception("Root index out of range.");
+
+		return JsonElement(*this, _roots[index]);
+	}
+
+	JsonDocument JsonDocument::FromLines(internal::StringViewType source)
+	{
+		JsonDocument doc;
+		doc._source = source;
+		doc._nodes.reserve(source.size() / 8 + 1);
+
+		internal::JsonDomBuilder(doc).BuildLines(doc._roots);
+		return doc;
+	}
+
+	void JsonDocument::_Build()
+	{
+		// a rough guess to avoid most of reallocations
+		_nodes.reserve(_source.size() / 8 + 1);
+
+		_roots.push_back(internal::JsonDomBuilder(*this).BuildDocument());
+	}
+
+	//============================================================================
+	// JsonElement
+	const internal::JsonNode &JsonElement::_Node() const
+	{
+		if (_doc == nullptr)
+			throw Exception("Accessing an invalid JsonElement.");
+
+		return _doc->_nodes[_index];
+	}
+
+	JsonType JsonElement::GetType() const
+	{
+		return _Node().Type;
+	}
+
+	bool JsonElement::AsBoolean() const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Boolean)
+			throw Exception("Not a valid boolean value.");
+
+		return node.Offset != 0;
+	}
+	double JsonElement::AsDouble() const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Number)
+			throw Exception("Not a number value.");
+
+		// strtod requires a terminated string
+		auto raw = GetRawText();
+		internal::CharType buf[128];
+		if (raw.size() < sizeof(buf))
+		{
+			raw.copy(buf, raw.size());
+			buf[raw.size()] = '\0';
+			return strtod(buf, nullptr);
+		}
+		else
+		{
+			return strtod(internal::StringType(raw).c_str(), nullptr);
+		}
+	}
+	internal::StringType JsonElement::AsString() const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::String)
+			throw Exception("Not a string value.");
+
+		auto raw = GetRawText();
+		return IsEscaped()
+			? internal::UnescapeJsonString(raw)
+			: internal::StringType(raw);
+	}
+
+	internal::StringViewType JsonElement::GetRawText() const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::String && node.Type != JsonType::Number)
+			throw Exception("Only strings and numbers have raw text.");
+
+		return _doc->_source.substr(node.Offset, node.Length);
+	}
+	bool JsonElement::IsEscaped() const
+	{
+		return (_Node().Flags & internal::JSON_NODE_ESCAPED) != 0;
+	}
+	uint32_t JsonElement::GetKeyHash() const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::String)
+			throw Exception("Only keys have a hash.");
+
+		return node.Extra;
+	}
+
+	size_t JsonElement::Size() const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Array && node.Type != JsonType::Object)
+			throw Exception("Only arrays and objects have a size.");
+
+		return node.Length;
+	}
+
+	JsonElement JsonElement::operator[](size_t index) const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Array)
+			throw Exception("Not an array.");
+		if (index >= node.Length)
+			throw Exception("Array index out of range.");
+
+		return JsonElement(*_doc, _doc->_slots[node.Offset + index]);
+	}
+
+	JsonElement JsonElement::Find(internal::StringViewType key) const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Object)
+			throw Exception("Not an object.");
+
+		uint32_t hash = internal::HashJsonKey(key);
+		const uint32_t *members = _doc->_slots.data() + node.Offset;
+
+		auto match = [&](uint32_t i) {
+			JsonElement k(*_doc, members[2 * i]);
+			const auto &keyNode = _doc->_nodes[members[2 * i]];
+			if (keyNode.Extra != hash) return false;
+
+			return k.IsEscaped() ? k.AsString() == key : k.GetRawText() == key;
+		};
+
+		if (node.Extra == internal::JSON_NODE_NO_INDEX)
+		{
+			// small objects, linear scan on hashes is fast enough
+			for (uint32_t i = 0; i < node.Length; ++i)
+			{
+				if (match(i))
+					return JsonElement(*_doc, members[2 * i + 1]);
+			}
+		}
+		else
+		{
+			uint32_t mask = internal::CalcHashIndexCapacity(node.Length) - 1;
+			const uint32_t *table = _doc->_index.data() + node.Extra;
+			for (uint32_t pos = hash & mask; table[pos] != 0; pos = (pos + 1) & mask)
+			{
+				if (match(table[pos] - 1))
+					return JsonElement(*_doc, members[2 * (table[pos] - 1) + 1]);
+			}
+		}
+
+		return JsonElement();
+	}
+
+	JsonElement JsonElement::KeyAt(size_t index) const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Object)
+			throw Exception("Not an object.");
+		if (index >= node.Length)
+			throw Exception("Object member index out of range.");
+
+		return JsonElement(*_doc, _doc->_slots[node.Offset + 2 * index]);
+	}
+	JsonElement JsonElement::ValueAt(size_t index) const
+	{
+		const auto &node = _Node();
+		if (node.Type != JsonType::Object)
+			throw Exception("Not an object.");
+		if (index >= node.Length)
+			throw Exception("Object member index out of range.");
+
+		return JsonElement(*_doc, _doc->_slots[node.Offset + 2 * index + 1]);
+	}
+
+	//============================================================================
+	// JsonLinesParser
+	class JsonLinesParser::InternalImpl
+	{
+	public:
+		InternalImpl(internal::StringViewType source, size_t workerCount, size_t batchSize)
+			: _source(source)
+			, _batchSize(batchSize)
+		{
+			if (batchSize == 0)
+				throw Exception("Batch size must be positive.");
+
+			if (workerCount == 0)
+			{
+				workerCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+			}
+
+			_batchCount = (source.size() + batchSize - 1) / batchSize;
+
+			// parsed batches waiting for the consumer are bounded by the window
+			_window = workerCount * 2;
+			_slots.resize(_window);
+
+			for (size_t i = 0; i < workerCount; ++i)
+			{
+				_workers.emplace_back([this]() { _Work(); });
+			}
+		}
+		~InternalImpl()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopped = true;
+			}
+
+			_freeCond.notify_all();
+			for (auto &worker : _workers)
+			{
+				worker.join();
+			}
+		}
+
+		std::unique_ptr<JsonDocument> NextBatch()
+		{
+			while (_consumed < _batchCount)
+			{
+				BatchSlot &slot = _slots[_consumed % _window];
+
+				std::unique_lock<std::mutex> lock(_mutex);
+				_readyCond.wait(lock, [&]() { return slot.Ready; });
+
+				auto doc = Move(slot.Document);
+				auto error = slot.Error;
+				slot.Ready = false;
+				slot.Error = nullptr;
+				_consumed += 1;
+
+				lock.unlock();
+				_freeCond.notify_all();
+
+				if (error)
+					std::rethrow_exception(error);
+
+				// a batch within a single long line has no document
+				if (doc->GetRootCount() != 0)
+					return doc;
+			}
+
+			return nullptr;
+		}
+
+	private:
+		struct BatchSlot
+		{
+			bool Ready = false;
+			std::unique_ptr<JsonDocument> Document;
+			std::exception_ptr Error;
+		};
+
+		// the first line that starts at or after pos
+		size_t _FindBoundary(size_t pos) const
+		{
+			if (pos == 0 || pos >= _source.size())
+				return std::min(pos, _source.size());
+
+			size_t newline = _source.find('\n', pos - 1);
+			return newline == _source.npos ? _source.size() : newline + 1;
+		}
+
+		void _Work()
+		{
+			while (true)
+			{
+				size_t index = _nextBatch.fetch_add(1);
+				if (index >= _batchCount)
+					return;
+
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_freeCond.wait(lock, [&]() { return _stopped || index < _consumed + _window; });
+
+					if (_stopped)
+						return;
+				}
+
+				// batches are split independently, no worker has to scan for another
+				size_t begin = _FindBoundary(index * _batchSize);
+				size_t end = _FindBoundary((index + 1) * _batchSize);
+
+				std::unique_ptr<JsonDocument> doc;
+				std::exception_ptr error;
+				try
+				{
+					doc = std::make_unique<JsonDocument>(
+						JsonDocument::FromLines(_source.substr(begin, end - begin)));
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+
+					BatchSlot &slot = _slots[index % _window];
+					slot.Document = Move(doc);
+					slot.Error = error;
+					slot.Ready = true;
+				}
+
+				_readyCond.notify_all();
+			}
+		}
+
+		internal::StringViewType _source;
+		size_t _batchSize;
+		size_t _batchCount;
+		size_t _window;
+
+		std::vector<std::thread> _workers;
+		std::atomic<size_t> _nextBatch{ 0 };
+
+		// guarded by _mutex
+		std::mutex _mutex;
+		std::condition_variable _readyCond;
+		std::condition_variable _freeCond;
+		std::vector<BatchSlot> _slots;
+		size_t _consumed = 0;
+		bool _stopped = false;
+	};
+
+	JsonLinesParser::JsonLinesParser(internal::StringViewType source, size_t workerCount, size_t batchSize)
+		: _impl(std::make_unique<InternalImpl>(source, workerCount, batchSize)) { }
+	JsonLinesParser::~JsonLinesParser() { }
+
+	std::unique_ptr<JsonDocument> JsonLinesParser::NextBatch()
+	{
+		return _impl->NextBatch();
+	}
+
+	void JsonLinesParser::ForEach(const std::function<void(const JsonElement &)> &callback)
+	{
+		while (auto batch = NextBatch())
+		{
+			for (size_t i = 0; i < batch->GetRootCount(); ++i)
+			{
+				callback(batch->GetRoot(i));
+			}
+		}
+	}
+
+	//============================================================================
+	// JsonQuery
+	namespace internal
+	{
+		// walks the raw text by a path, where only keys on the path are looked into
+		class JsonPathScanner
+		{
+		public:
+			JsonPathScanner(StringViewType source)
+				: _cursor(source.data())
+				, _end(source.data() + source.size()) { }
+
+			// position the cursor at the value of key, returns false if the object has no such key
+			bool EnterMember(StringViewType key)
+			{
+				_AssertNextNonWhitespace(JSON_BEGIN_OBJECT);
+				if (_PeekNextNonWhitespace() == JSON_END_OBJECT)
+					return false;
+
+				while (true)
+				{
+					_AssertNextNonWhitespace(JSON_BEGIN_STRING);
+
+					const CharType *start = _cursor;
+					bool escaped = _SkipString(true);
+					StringViewType raw(start, _cursor - start - 1);
+
+					_AssertNextNonWhitespace(JSON_PAIR_SAPERATOR);
+
+					bool match = escaped
+						? UnescapeJsonString(raw) == key
+						: raw == key;
+					if (match)
+						return true;
+
+					SkipValue();
+					if (!_NextElement(JSON_END_OBJECT))
+						return false;
+				}
+			}
+
+			// position the cursor at the element of index, returns false if it's out of range
+			bool EnterElement(size_t index)
+			{
+				_AssertNextNonWhitespace(JSON_BEGIN_ARRAY);
+				if (_PeekNextNonWhitespace() == JSON_END_ARRAY)
+					return false;
+
+				for (size_t i = 0; i < index; ++i)
+				{
+					SkipValue();
+					if (!_NextElement(JSON_END_ARRAY))
+						return false;
+				}
+
+				return true;
+			}
+
+			// first character of the next value
+			CharType PeekValue()
+			{
+				return _PeekNextNonWhitespace();
+			}
+
+			// skip a value without validating it, returns its raw text
+			StringViewType SkipValue()
+			{
+				CharType ch = _PeekNextNonWhitespace();
+				const CharType *start = _cursor;
+
+				switch (ch)
+				{
+				case JSON_BEGIN_STRING:
+					++_cursor;
+					_SkipString(false);
+					break;
+				case JSON_BEGIN_ARRAY:
+				case JSON_BEGIN_OBJECT:
+					_SkipContainer();
+					break;
+				default:
+					// literals and numbers
+					while (_cursor != _end && !_IsDelimiter(*_cursor))
+					{
+						++_cursor;
+					}
+
+					if (_cursor == start)
+						throw Exception("Unexpected character encountered");
+					break;
+				}
+
+				return StringViewType(start, _cursor - start);
+			}
+
+		private:
+			static bool _IsDelimiter(CharType ch)
+			{
+				switch (ch)
+				{
+				case ' ': case '\n': case '\r': case '\t':
+				case JSON_ELEMENT_SAPERATOR:
+				case JSON_END_ARRAY:
+				case JSON_END_OBJECT:
+					return true;
+				default:
+					return false;
+				}
+			}
+
+			void _SkipWhitespace()
+			{
+				while (_cursor != _end
+					&& (*_cursor == ' ' || *_cursor == '\n' || *_cursor == '\r' || *_cursor == '\t'))
+				{
+					++_cursor;
+				}
+			}
+			CharType _PeekNextNonWhitespace()
+			{
+				_SkipWhitespace();
+				if (_cursor == _end)
+					throw Exception("Unexpected EOF encountered");
+
+				return *_cursor;
+			}
+			void _AssertNextNonWhitespace(CharType ch)
+			{
+				if (_PeekNextNonWhitespace() != ch)
+					throw Exception("Unexpected character encountered");
+
+				++_cursor;
+			}
+
+			// consume a separator and returns true, or consume the closing bracket and returns false
+			bool _NextElement(CharType close)
+			{
+				CharType ch = _PeekNextNonWhitespace();
+				++_cursor;
+
+				if (ch == JSON_ELEMENT_SAPERATOR)
+					return true;
+				if (ch == close)
+					return false;
+
+				throw Exception("Unexpected character encountered");
+			}
+
+			// assume the cursor is after the opening quote, and leave it after the closing one
+			// returns if the string contains escape sequences
+			bool _SkipString(bool validateEscape)
+			{
+				bool escaped = false;
+				while (true)
+				{
+					if (_cursor == _end)
+						throw Exception("Unexpected EOF encountered");
+
+					CharType ch = *_cursor++;
+					if (ch == JSON_END_STRING)
+						return escaped;
+
+					if (ch == JSON_ESCAPE_CHARACTER)
+					{
+						escaped = true;
+						if (validateEscape)
+							_ValidateEscape();
+						else if (_cursor != _end)
+							++_cursor;
+					}
+				}
+			}
+
+			void _ValidateEscape()
+			{
+				// assume the cursor is after the backslash
+				if (_cursor == _end)
+					throw Exception("Unexpected EOF encountered");
+
+				switch (*_cursor)
+				{
+				case 'b': case 'f': case 'r': case 'n': case 't':
+				case '\"': case '/': case '\\':
+					_cursor += 1;
+					break;
+				case 'u':
+					if (_end - _cursor < 5)
+						throw Exception("Unexpected EOF encountered");
+					for (int i = 1; i < 5; ++i)
+					{
+						if (ParseHexDigit(_cursor[i]) < 0)
+							throw Exception("Invalid unicode escape sequence.");
+					}
+					_cursor += 5;
+					break;
+				default:
+					throw Exception("Unexpected characters to escape.");
+				}
+			}
+
+			// bracket matching, where only strings have to be looked into
+			void _SkipContainer()
+			{
+				size_t depth = 0;
+				while (_cursor != _end)
+				{
+					switch (*_cursor++)
+					{
+					case JSON_BEGIN_STRING:
+						_SkipString(false);
+						break;
+					case JSON_BEGIN_ARRAY:
+					case JSON_BEGIN_OBJECT:
+						depth += 1;
+						break;
+					case JSON_END_ARRAY:
+					case JSON_END_OBJECT:
+						if (--depth == 0)
+							return;
+						break;
+					default:
+						break;
+					}
+				}
+
+				throw Exception("Unexpected EOF encountered");
+			}
+
+			const CharType *_cursor;
+			const CharType *_end;
+		};
+	}
+
+	JsonQuery JsonQuery::FromPointer(internal::StringViewType pointer)
+	{
+		JsonQuery query;
+		if (pointer.empty())
+			return query;
+
+		if (pointer[0] != '/')
+			throw Exception("Json pointer must start with '/'.");
+
+		internal::StringType token;
+		for (size_t i = 1; i <= pointer.size(); ++i)
+		{
+			if (i == pointer.size() || pointer[i] == '/')
+			{
+				query._AppendSegment(Move(token));
+				token.clear();
+			}
+			else if (pointer[i] == '~')
+			{
+				// ~0 for '~' and ~1 for '/'
+				if (i + 1 == pointer.size() || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+					throw Exception("Invalid escape sequence in json pointer.");
+
+				token.push_back(pointer[++i] == '0' ? '~' : '/');
+			}
+			else
+			{
+				token.push_back(pointer[i]);
+			}
+		}
+
+		return query;
+	}
+
+	JsonQuery JsonQuery::FromPath(internal::StringViewType path)
+	{
+		JsonQuery query;
+		if (path.empty())
+			return query;
+
+		size_t i = 0;
+		while (true)
+		{
+			if (path[i] == '[')
+			{
+				size_t close = path.find(']', i);
+				if (close == path.npos || close == i + 1)
+					throw Exception("Invalid array index in path.");
+
+				internal::StringType index(path.substr(i + 1, close - i - 1));
+				query._AppendSegment(index);
+				if (!query._segments.back().IsIndex)
+					throw Exception("Invalid array index in path.");
+
+				i = close + 1;
+			}
+			else
+			{
+				size_t stop = path.find_first_of(".[", i);
+				if (stop == path.npos)
+					stop = path.size();
+				if (stop == i)
+					throw Exception("Empty key in path.");
+
+				query._AppendSegment(internal::StringType(path.substr(i, stop - i)));
+				i = stop;
+			}
+
+			if (i == path.size())
+				break;
+
+			// a '.' separates segments, but is optional before '['
+			if (path[i] == '.')
+			{
+				if (++i == path.size())
+					throw Exception("Empty key in path.");
+			}
+		}
+
+		return query;
+	}
+
+	void JsonQuery::_AppendSegment(internal::StringType key)
+	{
+		Segment segment{ Move(key), 0, false };
+
+		// a number without leading zeros may also index an array
+		const auto &s = segment.Key;
+		if (!s.empty() && s.size() < 19 && (s[0] != '0' || s.size() == 1)
+			&& s.find_first_not_of("0123456789") == s.npos)
+		{
+			segment.Index = static_cast<size_t>(std::stoull(s));
+			segment.IsIndex = true;
+		}
+
+		_segments.push_back(Move(segment));
+	}
+
+	internal::StringViewType JsonQuery::SelectRaw(internal::StringViewType source) const
+	{
+		internal::JsonPathScanner scanner(source);
+
+		for (const auto &segment : _segments)
+		{
+			// the container type decides how a segment is matched
+			internal::CharType ch = scanner.PeekValue();
+
+			bool found = false;
+			if (ch == internal::JSON_BEGIN_OBJECT)
+			{
+				found = scanner.EnterMember(segment.Key);
+			}
+			else if (ch == internal::JSON_BEGIN_ARRAY && segment.IsIndex)
+			{
+				found = scanner.EnterElement(segment.Index);
+			}
+
+			if (!found)
+				return internal::StringViewType();
+		}
+
+		return scanner.SkipValue();
+	}
 }
\ No newline at end of file
@@ -201,6 +201,11 @@ namespace eds
 #include <functional>
 #include <sstream>
 #include <memory>
+#include <string_view>
+#include <cstdint>
+#include <array>
+#include <tuple>
+#include <utility>
 
 // comment this to add serializer support
 //#define JSONLITE_SERIALIZATION_DISABLED
@@ -211,14 +216,16 @@ namespace jsonlite
 	{
 		using CharType = char;
 		using StringType = std::basic_string<CharType>;
+		using StringViewType = std::basic_string_view<CharType>;
 		using stl_ostringstream = std::basic_ostringstream<CharType>;
 		using stl_istringstream = std::basic_istringstream<CharType>;
 
 		using ContextMark = std::stringstream::streampos;
 		class JsonContext;
+		class JsonDomBuilder;
 	}
 
-	enum class JsonType
+	enum class JsonType : uint8_t
 	{
 		Null,
 		Boolean,
@@ -232,8 +239,10 @@ namespace jsonlite
 
 	// exported interface classes
 	class JsonBuilder;
+	class JsonWriter;
 	class JsonValue;
 	class JsonParser;
+	class JsonElement;
 
 	// generic serializer for type T
 	template <typename T>
@@ -294,6 +303,76 @@ namespace jsonlite
 		std::unique_ptr<InternalImpl> _impl;
 	};
 
+	//============================================================================
+	// JsonWriter
+	//   a serializer that appends to a reusable flat buffer
+	//   if constructed with a file descriptor, the buffer is written out in chunks
+	class JsonWriter : public eds::Uncopyable
+	{
+	public:
+		JsonWriter();
+		JsonWriter(int fd, size_t chunkSize = 64 * 1024);
+		~JsonWriter();
+
+#ifndef JSONLITE_SERIALIZATION_DISABLED
+
+		template <typename T>
+		void Serialize(const T &dat)
+		{
+			JsonSerializer<typename eds::RemoveSpecifier<T>::Type>().Serialize(*this, dat);
+		}
+
+		template <typename T>
+		void SerializeAsField(internal::StringViewType key, const T &dat)
+		{
+			FeedKey(key);
+			Serialize<T>(dat);
+		}
+
+#endif // !JSONLITE_SERIALIZATION_DISABLED
+
+		void FeedKey(internal::StringViewType key);
+
+		void FeedNull();
+		void FeedBoolean(bool value);
+		void FeedInteger(int64_t value);
+		void FeedUnsigned(uint64_t value);
+		void FeedDouble(double value);
+		void FeedString(internal::StringViewType value);
+
+		void BeginArray();
+		void EndArray();
+		void BeginObject();
+		void EndObject();
+
+		// content in the buffer, i.e. not yet flushed
+		internal::StringViewType GetView() const { return internal::StringViewType(_buffer.get(), _size); }
+		// reset the writer to write another document, but keep the buffer
+		void Clear();
+		// write content in the buffer to the file descriptor
+		void Flush();
+
+	private:
+		void _PrepareValue();
+		internal::CharType *_Reserve(size_t n);
+		void _Commit(internal::CharType *end) { _size = end - _buffer.get(); }
+		void _Put(internal::CharType ch) { *_Reserve(1) = ch; ++_size; }
+		void _Write(const internal::CharType *p, size_t n);
+		void _WriteEscapedString(internal::StringViewType str);
+
+		std::unique_ptr<internal::CharType[]> _buffer;
+		size_t _size = 0;
+		size_t _capacity = 0;
+
+		int _fd = -1;
+		size_t _chunkSize = 0;
+
+		// for each open array or object, if an element has been written
+		std::vector<bool> _nonEmpty;
+		std::vector<bool> _inObject;
+		bool _keyWritten = false;
+	};
+
 	//============================================================================
 	// JsonValue
 	class JsonValue
@@ -342,6 +421,215 @@ namespace jsonlite
 		std::unique_ptr<internal::JsonContext> _ctx;
 	};
 
+	//============================================================================
+	// JsonDocument
+	//   an immutable DOM built in a single pass into a contiguous arena
+	//   strings and numbers are kept as views into the source text,
+	//   and are decoded only when asked for
+
+	namespace internal
+	{
+		// a tagged node in the arena of a JsonDocument
+		struct JsonNode
+		{
+			JsonType Type;
+			uint8_t Flags;
+			uint16_t Reserved;
+
+			// String, Number: length of the raw text
+			// Array, Object: number of elements(or members)
+			uint32_t Length;
+
+			// String, Number: offset of the raw text in the source
+			// Array, Object: index of the first slot
+			// Boolean: the value
+			uint32_t Offset;
+
+			// String: hash of the unescaped text(keys only)
+			// Object: offset of the hash index, or JSON_NODE_NO_INDEX
+			uint32_t Extra;
+		};
+
+		static_assert(sizeof(JsonNode) == 16, "JsonNode is expected to be 16 bytes.");
+
+		// JsonNode::Flags
+		constexpr uint8_t JSON_NODE_ESCAPED = 0x1;
+		constexpr uint32_t JSON_NODE_NO_INDEX = 0xffffffff;
+
+		// FNV-1a, hash of object keys
+		constexpr uint32_t HashJsonKey(StringViewType key)
+		{
+			uint32_t hash = 2166136261u;
+			for (CharType ch : key)
+			{
+				hash ^= static_cast<uint8_t>(ch);
+				hash *= 16777619u;
+			}
+
+			return hash;
+		}
+	}
+
+	class JsonDocument;
+
+	// a lightweight handle to a node in a JsonDocument
+	// a default constructed JsonElement is invalid, and is also what a failed lookup yields
+	class JsonElement
+	{
+	public:
+		JsonElement() = default;
+		JsonElement(const JsonDocument &doc, uint32_t index)
+			: _doc(&doc), _index(index) { }
+
+#ifndef JSONLITE_SERIALIZATION_DISABLED
+
+		template <typename T>
+		T Deserialize() const
+		{
+			return JsonSerializer<T>().Deserialize(*this);
+		}
+
+#endif // !JSONLITE_SERIALIZATION_DISABLED
+
+		bool IsValid() const { return _doc != nullptr; }
+		JsonType GetType() const;
+
+		bool AsBoolean() const;
+		double AsDouble() const;
+		internal::StringType AsString() const;
+
+		// text of a String(escape sequences kept, quotes removed) or a Number in the source
+		internal::StringViewType GetRawText() const;
+		// if AsString() has to unescape the raw text
+		bool IsEscaped() const;
+		// String(keys only): internal::HashJsonKey of the unescaped text
+		uint32_t GetKeyHash() const;
+
+		// Array and Object: number of elements(or members)
+		size_t Size() const;
+
+		// Array: O(1) indexing
+		JsonElement operator[](size_t index) const;
+
+		// Object: hashed lookup, returns an invalid element if the key is not found
+		JsonElement Find(internal::StringViewType key) const;
+		JsonElement operator[](internal::StringViewType key) const { return Find(key); }
+
+		// Object: enumerate members in the order of the source
+		JsonElement KeyAt(size_t index) const;
+		JsonElement ValueAt(size_t index) const;
+
+	private:
+		const internal::JsonNode &_Node() const;
+
+		const JsonDocument *_doc = nullptr;
+		uint32_t _index = 0;
+	};
+
+	class JsonDocument
+	{
+	public:
+		// NOTE source is not copied, and must outlive the document
+		explicit JsonDocument(internal::StringViewType source);
+		// the document takes ownership of the source text
+		explicit JsonDocument(internal::StringType &&source);
+		// one document per line(JSON Lines), where empty lines are skipped
+		// NOTE source is not copied, and must outlive the document
+		static JsonDocument FromLines(internal::StringViewType source);
+
+		JsonDocument(const JsonDocument &) = delete;
+		JsonDocument &operator =(const JsonDocument &) = delete;
+		JsonDocument(JsonDocument &&) = default;
+		JsonDocument &operator =(JsonDocument &&) = default;
+
+		JsonElement GetRoot() const { return GetRoot(0); }
+		// roots of a document built from lines
+		// NOTE a document built from empty lines has no root, and throws on access
+		JsonElement GetRoot(size_t index) const;
+		size_t GetRootCount() const { return _roots.size(); }
+
+		internal::StringViewType GetSource() const { return _source; }
+		size_t GetNodeCount() const { return _nodes.size(); }
+
+	private:
+		friend class JsonElement;
+		friend class internal::JsonDomBuilder;
+
+		JsonDocument() = default;
+
+		void _Build();
+
+		// heap allocated, so that views into it survive a move of the document
+		std::unique_ptr<internal::StringType> _storage;
+		internal::StringViewType _source;
+
+		// the arena
+		std::vector<internal::JsonNode> _nodes;
+		// children of arrays, and (key, value) pairs of objects
+		std::vector<uint32_t> _slots;
+		// open addressing tables of large objects
+		std::vector<uint32_t> _index;
+
+		std::vector<uint32_t> _roots;
+	};
+
+	//============================================================================
+	// JsonLinesParser
+	//   parses newline-delimited json in parallel
+	//   the source is split into batches at line boundaries, and each batch is parsed
+	//   by a worker into a JsonDocument of its own, which is delivered in the order of the source
+	class JsonLinesParser : public eds::Uncopyable
+	{
+	public:
+		// NOTE source is not copied, and must outlive the parser and all batches yielded
+		// workerCount of 0 means the number of hardware threads
+		JsonLinesParser(internal::StringViewType source, size_t workerCount = 0, size_t batchSize = 256 * 1024);
+		~JsonLinesParser();
+
+		// blocks until the next batch is parsed, and returns nullptr if all batches are consumed
+		// if the batch is malformed, the exception is rethrown here
+		std::unique_ptr<JsonDocument> NextBatch();
+
+		// invoke callback on every document in the order of the source
+		void ForEach(const std::function<void(const JsonElement &)> &callback);
+
+	private:
+		class InternalImpl;
+		std::unique_ptr<InternalImpl> _impl;
+	};
+
+	//============================================================================
+	// JsonQuery
+	//   selects a value in the raw text by a path, without parsing the rest of the document
+	//   values off the path are skipped by bracket matching, and are NOT validated
+	class JsonQuery
+	{
+	public:
+		// JSON Pointer(RFC 6901), e.g. "/items/0/name", where "" selects the whole document
+		static JsonQuery FromPointer(internal::StringViewType pointer);
+		// dotted path, e.g. "items[0].name" or "items.0.name", where "" selects the whole document
+		static JsonQuery FromPath(internal::StringViewType path);
+
+		// raw text of the value selected, to be parsed by JsonDocument for instance
+		// if the value does not exist, a null view(i.e. data() == nullptr) is returned
+		internal::StringViewType SelectRaw(internal::StringViewType source) const;
+
+		size_t GetDepth() const { return _segments.size(); }
+
+	private:
+		// a segment matches either a key of an object, or an index of an array if it's a number
+		struct Segment
+		{
+			internal::StringType Key;
+			size_t Index;
+			bool IsIndex;
+		};
+
+		void _AppendSegment(internal::StringType key);
+
+		std::vector<Segment> _segments;
+	};
+
 } // namespace jsonlite
 
 #ifndef JSONLITE_SERIALIZATION_DISABLED
@@ -357,10 +645,18 @@ namespace jsonlite
 		{
 			return builder.FeedBoolean(dat);
 		}
+		void Serialize(JsonWriter &writer, const bool &dat)
+		{
+			return writer.FeedBoolean(dat);
+		}
 		bool Deserialize(const JsonValue &value)
 		{
 			return value.AsBoolean();
 		}
+		bool Deserialize(const JsonElement &value)
+		{
+			return value.AsBoolean();
+		}
 	};
 
 	template<>
@@ -370,10 +666,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const int8_t &dat)
+		{
+			return writer.FeedInteger(dat);
+		}
 		int8_t Deserialize(const JsonValue &value)
 		{
 			return static_cast<int8_t>(value.AsDouble());
 		}
+		int8_t Deserialize(const JsonElement &value)
+		{
+			return static_cast<int8_t>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -383,10 +687,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const uint8_t &dat)
+		{
+			return writer.FeedUnsigned(dat);
+		}
 		uint8_t Deserialize(const JsonValue &value)
 		{
 			return static_cast<uint8_t>(value.AsDouble());
 		}
+		uint8_t Deserialize(const JsonElement &value)
+		{
+			return static_cast<uint8_t>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -396,10 +708,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const int16_t &dat)
+		{
+			return writer.FeedInteger(dat);
+		}
 		int16_t Deserialize(const JsonValue &value)
 		{
 			return static_cast<int16_t>(value.AsDouble());
 		}
+		int16_t Deserialize(const JsonElement &value)
+		{
+			return static_cast<int16_t>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -409,10 +729,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const uint16_t &dat)
+		{
+			return writer.FeedUnsigned(dat);
+		}
 		uint16_t Deserialize(const JsonValue &value)
 		{
 			return static_cast<uint16_t>(value.AsDouble());
 		}
+		uint16_t Deserialize(const JsonElement &value)
+		{
+			return static_cast<uint16_t>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -422,10 +750,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const int32_t &dat)
+		{
+			return writer.FeedInteger(dat);
+		}
 		int32_t Deserialize(const JsonValue &value)
 		{
 			return static_cast<int32_t>(value.AsDouble());
 		}
+		int32_t Deserialize(const JsonElement &value)
+		{
+			return static_cast<int32_t>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -435,10 +771,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const uint32_t &dat)
+		{
+			return writer.FeedUnsigned(dat);
+		}
 		uint32_t Deserialize(const JsonValue &value)
 		{
 			return static_cast<uint32_t>(value.AsDouble());
 		}
+		uint32_t Deserialize(const JsonElement &value)
+		{
+			return static_cast<uint32_t>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -448,10 +792,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(static_cast<double>(dat));
 		}
+		void Serialize(JsonWriter &writer, const float &dat)
+		{
+			return writer.FeedDouble(static_cast<double>(dat));
+		}
 		float Deserialize(const JsonValue &value)
 		{
 			return static_cast<float>(value.AsDouble());
 		}
+		float Deserialize(const JsonElement &value)
+		{
+			return static_cast<float>(value.AsDouble());
+		}
 	};
 
 	template<>
@@ -461,10 +813,18 @@ namespace jsonlite
 		{
 			return builder.FeedDouble(dat);
 		}
+		void Serialize(JsonWriter &writer, const double &dat)
+		{
+			return writer.FeedDouble(dat);
+		}
 		double Deserialize(const JsonValue &value)
 		{
 			return value.AsDouble();
 		}
+		double Deserialize(const JsonElement &value)
+		{
+			return value.AsDouble();
+		}
 	};
 
 	template<>
@@ -474,10 +834,18 @@ namespace jsonlite
 		{
 			return builder.FeedString(dat);
 		}
+		void Serialize(JsonWriter &writer, const internal::StringType &dat)
+		{
+			return writer.FeedString(dat);
+		}
 		internal::StringType Deserialize(const JsonValue &value)
 		{
 			return std::move(value.AsString());
 		}
+		internal::StringType Deserialize(const JsonElement &value)
+		{
+			return std::move(value.AsString());
+		}
 	};
 
 	// generic array based on std::vector
@@ -494,6 +862,17 @@ namespace jsonlite
 				}
 			});
 		}
+		void Serialize(JsonWriter &writer, const std::vector<T> &dat)
+		{
+			JsonSerializer<T> elementSerializer;
+
+			writer.BeginArray();
+			for (const T &x : dat)
+			{
+				elementSerializer.Serialize(writer, x);
+			}
+			writer.EndArray();
+		}
 		std::vector<T> Deserialize(const JsonValue &value)
 		{
 			std::vector<T> tmp;
@@ -503,6 +882,296 @@ namespace jsonlite
 
 			return move(tmp);
 		}
+		std::vector<T> Deserialize(const JsonElement &value)
+		{
+			JsonSerializer<T> elementSerializer;
+
+			std::vector<T> tmp;
+			tmp.reserve(value.Size());
+			for (size_t i = 0; i < value.Size(); ++i)
+			{
+				tmp.push_back(elementSerializer.Deserialize(value[i]));
+			}
+
+			return tmp;
+		}
+	};
+} // namespace jsonlite
+
+namespace jsonlite
+{
+	//============================================================================
+	// reflection
+	//   describe fields of a struct once, and serializers are generated at compile time
+	//   object keys are dispatched by a perfect hash built on the field names
+	//
+	//   JSONLITE_REFLECT(Item,
+	//       JSONLITE_FIELD(Item, Name),
+	//       JSONLITE_FIELD_AS(Item, IsAvailable, "available"));
+	//
+	//   NOTE the macro specializes templates in namespace jsonlite, so use it at global scope
+	//   missing fields are left as default constructed, and unknown keys are ignored
+
+	template <typename T, typename M>
+	struct JsonField
+	{
+		using ObjectType = T;
+		using MemberType = M;
+
+		internal::StringViewType Name;
+		M T::*Member;
+	};
+
+	template <typename T, typename M>
+	constexpr JsonField<T, M> MakeJsonField(internal::StringViewType name, M T::*member)
+	{
+		return JsonField<T, M>{ name, member };
+	}
+
+	// specialized by JSONLITE_REFLECT, GetFields() returns a tuple of JsonField
+	template <typename T>
+	struct JsonReflection;
+
+#define JSONLITE_FIELD(TYPE, MEMBER) ::jsonlite::MakeJsonField(#MEMBER, &TYPE::MEMBER)
+#define JSONLITE_FIELD_AS(TYPE, MEMBER, KEY) ::jsonlite::MakeJsonField(KEY, &TYPE::MEMBER)
+
+#define JSONLITE_REFLECT(TYPE, ...) \
+	template <> \
+	struct jsonlite::JsonReflection<TYPE> \
+	{ \
+		static constexpr auto GetFields() { return std::make_tuple(__VA_ARGS__); } \
+	}; \
+	template <> \
+	struct jsonlite::JsonSerializer<TYPE> : jsonlite::JsonReflectedSerializer<TYPE> { }
+
+	namespace internal
+	{
+		// give up searching a seed for a table size after this many attempts
+		constexpr uint32_t JSON_PERFECT_HASH_MAX_SEED = 4096;
+
+		constexpr uint32_t CeilLog2(size_t n)
+		{
+			uint32_t bits = 0;
+			while ((size_t(1) << bits) < n)
+			{
+				bits += 1;
+			}
+
+			return bits;
+		}
+
+		constexpr uint32_t JsonPerfectHashSlot(uint32_t hash, uint32_t seed, uint32_t bits)
+		{
+			uint32_t x = (hash ^ (seed * 0x85ebca6bu)) * 0x9e3779b1u;
+			return x >> (32 - bits);
+		}
+
+		// a collision-free table from key hashes to field indices
+		// table size is searched from the next power of 2 of N to 4 times of that
+		template <size_t N>
+		struct JsonFieldHashTable
+		{
+			static constexpr uint32_t MaxBits = (N > 1 ? CeilLog2(N) : 1) + 2;
+
+			// if no perfect hash is found, Bits is 0 and lookups fall back to linear scan
+			uint32_t Seed = 0;
+			uint32_t Bits = 0;
+			// field index + 1, or 0 for empty slots
+			uint16_t Slots[size_t(1) << MaxBits] = {};
+
+			constexpr bool IsPerfect() const { return Bits != 0; }
+
+			// returns N if no field is mapped
+			constexpr size_t Lookup(uint32_t hash) const
+			{
+				uint16_t slot = Slots[JsonPerfectHashSlot(hash, Seed, Bits)];
+				return slot != 0 ? slot - size_t(1) : N;
+			}
+		};
+
+		template <size_t N>
+		constexpr JsonFieldHashTable<N> MakeJsonFieldHashTable(const std::array<StringViewType, N> &names)
+		{
+			static_assert(N < 0xffff, "Too many fields.");
+
+			JsonFieldHashTable<N> result;
+
+			uint32_t hashes[N + 1] = {};
+			for (size_t i = 0; i < N; ++i)
+			{
+				hashes[i] = HashJsonKey(names[i]);
+			}
+
+			for (uint32_t bits = (N > 1 ? CeilLog2(N) : 1); bits <= result.MaxBits; ++bits)
+			{
+				for (uint32_t seed = 0; seed < JSON_PERFECT_HASH_MAX_SEED; ++seed)
+				{
+					for (auto &slot : result.Slots)
+					{
+						slot = 0;
+					}
+
+					bool collided = false;
+					for (size_t i = 0; i < N && !collided; ++i)
+					{
+						auto &slot = result.Slots[JsonPerfectHashSlot(hashes[i], seed, bits)];
+						collided = slot != 0;
+						slot = static_cast<uint16_t>(i + 1);
+					}
+
+					if (!collided)
+					{
+						result.Seed = seed;
+						result.Bits = bits;
+						return result;
+					}
+				}
+			}
+
+			result.Seed = 0;
+			result.Bits = 0;
+			return result;
+		}
+
+		template <typename Tuple, size_t ...I>
+		constexpr std::array<StringViewType, sizeof...(I)> CollectJsonFieldNames(const Tuple &fields, std::index_sequence<I...>)
+		{
+			return { { std::get<I>(fields).Name... } };
+		}
+	}
+
+	// generated serializer for a type described by JsonReflection<T>
+	template <typename T>
+	struct JsonReflectedSerializer
+	{
+	private:
+		using FieldTuple = decltype(JsonReflection<T>::GetFields());
+
+		static constexpr size_t FieldCount = std::tuple_size<FieldTuple>::value;
+		using FieldIndices = std::make_index_sequence<FieldCount>;
+
+		static constexpr std::array<internal::StringViewType, FieldCount> FieldNames
+			= internal::CollectJsonFieldNames(JsonReflection<T>::GetFields(), FieldIndices{});
+		static constexpr internal::JsonFieldHashTable<FieldCount> FieldTable
+			= internal::MakeJsonFieldHashTable<FieldCount>(FieldNames);
+
+		template <size_t I>
+		using MemberTypeAt = typename std::tuple_element<I, FieldTuple>::type::MemberType;
+
+		template <size_t I>
+		static constexpr auto _FieldAt()
+		{
+			return std::get<I>(JsonReflection<T>::GetFields());
+		}
+
+		// returns FieldCount if key is not a field
+		static size_t _FindField(uint32_t hash, internal::StringViewType key)
+		{
+			if (FieldTable.IsPerfect())
+			{
+				size_t index = FieldTable.Lookup(hash);
+
+				// a single comparison to reject unknown keys
+				return (index < FieldCount && FieldNames[index] == key) ? index : FieldCount;
+			}
+			else
+			{
+				for (size_t i = 0; i < FieldCount; ++i)
+				{
+					if (FieldNames[i] == key)
+						return i;
+				}
+
+				return FieldCount;
+			}
+		}
+
+		template <typename Builder, size_t ...I>
+		static void _SerializeFields(Builder &builder, const T &dat, std::index_sequence<I...>)
+		{
+			(_SerializeField<I>(builder, dat), ...);
+		}
+
+		template <size_t I>
+		static void _SerializeField(JsonBuilder &builder, const T &dat)
+		{
+			builder.FeedKey(internal::StringType(FieldNames[I]));
+			JsonSerializer<MemberTypeAt<I>>().Serialize(builder, dat.*_FieldAt<I>().Member);
+		}
+
+		template <size_t I>
+		static void _SerializeField(JsonWriter &writer, const T &dat)
+		{
+			writer.FeedKey(FieldNames[I]);
+			JsonSerializer<MemberTypeAt<I>>().Serialize(writer, dat.*_FieldAt<I>().Member);
+		}
+
+		template <typename Value, size_t I>
+		static void _DeserializeField(T &dat, const Value &value)
+		{
+			dat.*_FieldAt<I>().Member = JsonSerializer<MemberTypeAt<I>>().Deserialize(value);
+		}
+
+		// dispatch table indexed by the field index
+		template <typename Value, size_t ...I>
+		static constexpr std::array<void(*)(T &, const Value &), FieldCount + 1> _MakeDecoders(std::index_sequence<I...>)
+		{
+			return { { &_DeserializeField<Value, I>..., nullptr } };
+		}
+
+	public:
+		void Serialize(JsonBuilder &builder, const T &dat)
+		{
+			builder.FeedObject([&]() {
+				_SerializeFields(builder, dat, FieldIndices{});
+			});
+		}
+		void Serialize(JsonWriter &writer, const T &dat)
+		{
+			writer.BeginObject();
+			_SerializeFields(writer, dat, FieldIndices{});
+			writer.EndObject();
+		}
+
+		T Deserialize(const JsonValue &value)
+		{
+			static constexpr auto decoders = _MakeDecoders<JsonValue>(FieldIndices{});
+
+			T tmp{};
+			value.AsObject([&tmp](const internal::StringType &key, const JsonValue &value) {
+				size_t index = _FindField(internal::HashJsonKey(key), key);
+				if (index < FieldCount)
+				{
+					decoders[index](tmp, value);
+				}
+			});
+
+			return tmp;
+		}
+		T Deserialize(const JsonElement &value)
+		{
+			static constexpr auto decoders = _MakeDecoders<JsonElement>(FieldIndices{});
+
+			if (value.GetType() != JsonType::Object)
+				throw eds::Exception("Not an object.");
+
+			T tmp{};
+			for (size_t i = 0; i < value.Size(); ++i)
+			{
+				// hash of the key is computed when the document is built
+				JsonElement key = value.KeyAt(i);
+				size_t index = key.IsEscaped()
+					? _FindField(key.GetKeyHash(), key.AsString())
+					: _FindField(key.GetKeyHash(), key.GetRawText());
+
+				if (index < FieldCount)
+				{
+					decoders[index](tmp, value.ValueAt(i));
+				}
+			}
+
+			return tmp;
+		}
 	};
 } // namespace jsonlite
 
@@ -0,0 +1,45 @@
+#include "catch.hpp"
+#include "../Jsonlite.h"
+#include <string>
+
+using namespace jsonlite;
+
+TEST_CASE("JsonDocument::FromLines")
+{
+    std::string source = "{\"a\": 1}\n\n  [true, null]\r\n\"x\"";
+    auto doc = JsonDocument::FromLines(source);
+    REQUIRE(doc.GetRootCount() == 3);
+    REQUIRE(doc.GetRoot()["a"].AsDouble() == 1);
+    REQUIRE(doc.GetRoot(1).Size() == 2);
+    REQUIRE(doc.GetRoot(2).AsString() == "x");
+    REQUIRE_THROWS_AS(doc.GetRoot(3), eds::Exception);
+}
+
+TEST_CASE("JsonDocument::FromLines with no line")
+{
+    std::string source = "\n \r\n\t\n";
+    auto doc = JsonDocument::FromLines(source);
+    REQUIRE(doc.GetRootCount() == 0);
+    REQUIRE_THROWS_AS(doc.GetRoot(), eds::Exception);
+
+    auto empty = JsonDocument::FromLines("");
+    REQUIRE(empty.GetRootCount() == 0);
+    REQUIRE_THROWS_AS(empty.GetRoot(), eds::Exception);
+}
+
+TEST_CASE("JsonDocument::FromLines rejects values spanning lines")
+{
+    std::string objects = "{\"a\": 1}\n{\"b\":\n2}\n";
+    REQUIRE_THROWS_AS(JsonDocument::FromLines(objects), eds::Exception);
+
+    std::string arrays = "[1,\n2]";
+    REQUIRE_THROWS_AS(JsonDocument::FromLines(arrays), eds::Exception);
+
+    // a whole document may still span lines
+    REQUIRE(JsonDocument(arrays).GetRoot().Size() == 2);
+
+    std::string lines = "[1, 2]\n{\"b\":\n2}\n";
+    JsonLinesParser parser(lines, 2, 1);
+    REQUIRE(parser.NextBatch() != nullptr);
+    REQUIRE_THROWS_AS(parser.NextBatch(), eds::Exception);
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "catch.hpp"
+#include "../Jsonlite.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#define fileno _fileno
+#endif
+
+using namespace jsonlite;
+
+TEST_CASE("JsonWriter::FeedInteger")
+{
+    JsonWriter writer;
+    writer.BeginArray();
+    writer.FeedUnsigned(0);
+    writer.FeedUnsigned(9);
+    writer.FeedUnsigned(10);
+    writer.FeedUnsigned(99999999);
+    writer.FeedUnsigned(100000000);
+    writer.FeedUnsigned(9999999999999999999ull);
+    writer.FeedUnsigned(UINT64_MAX);
+    writer.FeedInteger(-1);
+    writer.FeedInteger(INT64_MIN);
+    writer.EndArray();
+
+    REQUIRE(std::string(writer.GetView()) ==
+        "[0,9,10,99999999,100000000,9999999999999999999,18446744073709551615,-1,-9223372036854775808]");
+
+    for (uint64_t x = 1; x != 0 && x < UINT64_MAX / 3; x = x * 3 + 1)
+    {
+        writer.Clear();
+        writer.FeedUnsigned(x);
+        REQUIRE(std::string(writer.GetView()) == std::to_string(x));
+    }
+
+    writer.Clear();
+    writer.FeedDouble(1e-300);
+    REQUIRE(std::string(writer.GetView()) == "1e-300");
+
+    writer.Clear();
+    writer.BeginArray();
+    writer.FeedDouble(0.0);
+    writer.FeedDouble(-0.0);
+    writer.FeedDouble(-1.5);
+    writer.EndArray();
+    REQUIRE(std::string(writer.GetView()) == "[0,-0,-1.5]");
+}
+
+TEST_CASE("JsonWriter writes out in chunks")
+{
+    JsonWriter memory;
+    memory.BeginArray();
+    for (int i = 0; i < 1000; ++i)
+    {
+        memory.FeedInteger(i * 7919);
+    }
+    memory.FeedString(std::string(100, 'x'));
+    memory.EndArray();
+    std::string expected(memory.GetView());
+
+    FILE *file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    {
+        JsonWriter writer(fileno(file), 64);
+        writer.BeginArray();
+        for (int i = 0; i < 1000; ++i)
+        {
+            writer.FeedInteger(i * 7919);
+
+            // what is not written out yet is never more than a chunk
+            REQUIRE(writer.GetView().size() <= 64);
+        }
+
+        // a value larger than a chunk still goes through
+        writer.FeedString(std::string(100, 'x'));
+        writer.EndArray();
+    }
+
+    std::string actual(expected.size() + 1, '\0');
+    std::rewind(file);
+    actual.resize(std::fread(&actual[0], 1, actual.size(), file));
+    std::fclose(file);
+
+    REQUIRE(actual == expected);
+    REQUIRE_THROWS_AS(JsonWriter(1, 0), eds::Exception);
+}
\ No newline at end of file
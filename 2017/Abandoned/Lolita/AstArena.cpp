@@ -1,44 +1,81 @@
 #include "AstArena.h"
+#include <cassert>
 
 using namespace std;
 
 namespace lolita
 {
+	AstArena::AstArena(AstArena&& other)
+		: chunks_(move(other.chunks_))
+		, cursor_(exchange(other.cursor_, nullptr))
+		, limit_(exchange(other.limit_, nullptr))
+		, destructors_(move(other.destructors_))
+		, object_count_(exchange(other.object_count_, 0))
+		, byte_count_(exchange(other.byte_count_, 0))
+	{
+		other.chunks_.clear();
+		other.destructors_.clear();
+	}
 
+	AstArena& AstArena::operator=(AstArena&& other)
+	{
+		if (this != &other)
+		{
+			Release();
 
+			chunks_ = move(other.chunks_);
+			cursor_ = exchange(other.cursor_, nullptr);
+			limit_ = exchange(other.limit_, nullptr);
+			destructors_ = move(other.destructors_);
+			object_count_ = exchange(other.object_count_, 0);
+			byte_count_ = exchange(other.byte_count_, 0);
 
-	// Decl Factory
-	//
-	DeclBase* AstArena::NewGroupDecl(const std::vector<DeclBase*>& group)
-	{
-		auto result = MakeAstObject<GroupDecl>();
-		result->Group = group;
+			other.chunks_.clear();
+			other.destructors_.clear();
+		}
 
-		return result;
+		return *this;
 	}
-	DeclBase* AstArena::NewVariableDecl(QualType type, const std::string& name, ExprBase* init)
-	{
-		auto result = MakeAstObject<VariableDecl>();
-		result->Type = type;
-		result->Name = name;
-		result->Init = init;
 
-		return result;
+	AstArena::~AstArena()
+	{
+		Release();
 	}
-	DeclBase* AstArena::NewFunctionDecl(CType* type, const std::string& name, StmtBase* body)
+
+	void AstArena::Release()
 	{
-		auto result = MakeAstObject<FunctionDecl>();
-		result->Type = type;
-		result->Name = name;
-		result->Body = body;
+		// destroy objects in the reverse order of creation
+		for (auto iter = destructors_.rbegin(); iter != destructors_.rend(); ++iter)
+		{
+			iter->Destroy(iter->Object);
+		}
 
-		return result;
+		destructors_.clear();
+		chunks_.clear();
+		cursor_ = limit_ = nullptr;
+		object_count_ = byte_count_ = 0;
 	}
 
-	// Scope Factory
-	//
-	Scope* AstArena::NewScope(Scope* parent, ScopeCategory cat)
+	void* AstArena::AllocateChunk(size_t size, size_t align)
 	{
-		return MakeAstObject<Scope>(parent, cat);
+		// NOTE operator new[] aligns a chunk for any fundamental type
+		assert(align <= alignof(max_align_t));
+
+		if (size > kChunkSize / 4)
+		{
+			// a large object takes a chunk of its own, and the current chunk is kept
+			chunks_.push_back(unique_ptr<char[]>{ new char[size] });
+			byte_count_ += size;
+
+			return chunks_.back().get();
+		}
+
+		chunks_.push_back(unique_ptr<char[]>{ new char[kChunkSize] });
+		byte_count_ += kChunkSize;
+
+		cursor_ = chunks_.back().get() + size;
+		limit_ = chunks_.back().get() + kChunkSize;
+
+		return chunks_.back().get();
 	}
 }
\ No newline at end of file
@@ -5,8 +5,12 @@
 #include "Decl.h"
 #include "Scope.h"
 #include "Literal.h"
+#include <cstdint>
 #include <memory>
-#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace lolita
 {
@@ -15,6 +19,8 @@ namespace lolita
 
 	// Guard object that manages the lifetime of AstObject
 	// when this object goes out of the scope, all its properties would be discarded
+	// NOTE objects are bump-allocated from large chunks, so that nodes are laid out
+	//      in the order they are created, i.e. mostly the order of parsing
 	class AstArena
 	{
 	public:
@@ -23,27 +29,88 @@ namespace lolita
 		// default ctor
 		AstArena() = default;
 
-		// Decl Factory
-		//
-		DeclBase* NewGroupDecl(const std::vector<DeclBase*>& group);
-		DeclBase* NewVariableDecl(QualType type, const std::string& name, ExprBase* init);
-		DeclBase* NewFunctionDecl(CType* type, const std::string& name, StmtBase* body);
+		AstArena(AstArena&& other);
+		AstArena& operator=(AstArena&& other);
 
-		// Scope Factory
-		//
-		Scope* NewScope(Scope* parent, ScopeCategory cat);
+		AstArena(const AstArena&) = delete;
+		AstArena& operator=(const AstArena&) = delete;
+
+		~AstArena();
 
 		template <typename T, typename ... TArgs>
 		T* MakeAstObject(TArgs&& ...args)
 		{
-			auto ptr = std::make_unique<T>(std::forward<TArgs>(args)...);
-			auto result = ptr.get();
-			
-			allocated_.emplace_back(std::move(ptr));
+			auto result = new (Allocate(sizeof(T), alignof(T))) T(std::forward<TArgs>(args)...);
+			object_count_ += 1;
+
+			// only objects owning resources, e.g. a std::string, are to be destroyed
+			if constexpr (!std::is_trivially_destructible_v<T>)
+			{
+				destructors_.push_back(Destructor{ result, [](void* p) { static_cast<T*>(p)->~T(); } });
+			}
+
 			return result;
 		}
 
+		// copy elements into the arena
+		template <typename T>
+		ArenaArray<T> MakeArray(const std::vector<T>& elements)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "an element of ArenaArray is never destroyed");
+
+			if (elements.empty())
+				return {};
+
+			auto data = static_cast<T*>(Allocate(sizeof(T) * elements.size(), alignof(T)));
+			std::uninitialized_copy(elements.begin(), elements.end(), data);
+
+			return ArenaArray<T>{ data, elements.size() };
+		}
+
+		// number of objects made by MakeAstObject
+		size_t ObjectCount() const { return object_count_; }
+
+		// bytes of chunks allocated
+		size_t ByteCount() const { return byte_count_; }
+
 	private:
-		std::deque<std::unique_ptr<AstObject>> allocated_;
+		void* Allocate(size_t size, size_t align)
+		{
+			// a quick path
+			auto offset = (align - reinterpret_cast<uintptr_t>(cursor_) % align) % align;
+			if (size + offset <= static_cast<size_t>(limit_ - cursor_))
+			{
+				auto result = cursor_ + offset;
+				cursor_ = result + size;
+
+				return result;
+			}
+
+			return AllocateChunk(size, align);
+		}
+
+		void* AllocateChunk(size_t size, size_t align);
+		void Release();
+
+		struct Destructor
+		{
+			void* Object;
+			void(*Destroy)(void*);
+		};
+
+		// size of an ordinary chunk
+		static constexpr size_t kChunkSize = 64 * 1024;
+
+		std::vector<std::unique_ptr<char[]>> chunks_;
+
+		// free space in the current chunk
+		char* cursor_ = nullptr;
+		char* limit_ = nullptr;
+
+		// objects to be destroyed, in the order of creation
+		std::vector<Destructor> destructors_;
+
+		size_t object_count_ = 0;
+		size_t byte_count_ = 0;
 	};
 }
\ No newline at end of file
@@ -1,24 +1,168 @@
 #include "AstBuilder.h"
 #include "TextUtils.h"
+#include "TranslationContext.h"
+#include "Error.h"
 
 namespace lolita
 {
+	AstBuilder::AstBuilder()
+	{
+		scopes_.EnterScope(ScopeCategory::File);
+	}
+
+	// Utility Functions
+	//
+	void AstBuilder::EnterFunction(const FunctionType* type, const std::vector<std::string>& params)
+	{
+		scopes_.EnterScope(ScopeCategory::Function);
+
+		// NOTE an unnamed parameter is not visible in the body
+		for (size_t i = 0; i < params.size() && i < type->ParamTypes().size(); ++i)
+		{
+			if (!params[i].empty())
+				DeclareEntity(params[i], type->ParamTypes()[i], StorageSpecifier::None);
+		}
+	}
+	void AstBuilder::ExitFunction()
+	{
+		assert(scopes_.CurrentCategory() == ScopeCategory::Function);
+		scopes_.ExitScope();
+	}
+
+	void AstBuilder::AnnotateLocation(SourceLocation loc)
+	{
+		location_ = loc;
+	}
+
+	// NOTE nodes are not built on an error, so parsing stops as it does for a syntax error
+	void AstBuilder::ReportError(const std::string& msg)
+	{
+		lolita::ReportError(location_, msg);
+		throw ParsingError{};
+	}
+
+	// Decl Factory
+	//
+	DeclBase* AstBuilder::NewGroupDecl(const std::vector<DeclBase*>& group)
+	{
+		auto result = arena_.MakeAstObject<GroupDecl>();
+		result->Group = arena_.MakeArray(group);
+
+		return result;
+	}
+	DeclBase* AstBuilder::NewVariableDecl(QualType type, const std::string& name, StorageSpecifier storage, ExprBase* init)
+	{
+		auto result = arena_.MakeAstObject<VariableDecl>();
+		result->Spec = storage;
+		result->Type = type;
+		result->Name = name;
+		result->Init = init;
+
+		DeclareEntity(name, type, storage);
+		return result;
+	}
+	DeclBase* AstBuilder::NewFunctionDecl(CType* type, const std::string& name, StmtBase* body)
+	{
+		auto result = arena_.MakeAstObject<FunctionDecl>();
+		result->Type = type;
+		result->Name = name;
+		result->Body = body;
+
+		DeclareEntity(name, type->MakeQualified(), StorageSpecifier::None);
+		return result;
+	}
+
+	// Scope Factory
+	//
+	Scope* AstBuilder::NewScope(Scope* parent, ScopeCategory cat)
+	{
+		return arena_.MakeAstObject<Scope>(parent, cat);
+	}
+
+	void AstBuilder::EnterScope(ScopeCategory cat)
+	{
+		scopes_.EnterScope(cat);
+	}
+	void AstBuilder::ExitScope()
+	{
+		// NOTE the file scope is never exited
+		assert(scopes_.Depth() > 1);
+		scopes_.ExitScope();
+	}
+
+	void AstBuilder::RedeclareTopLevel(const DeclBase* decl)
+	{
+		assert(scopes_.Depth() == 1);
+
+		if (auto group = dynamic_cast<const GroupDecl*>(decl))
+		{
+			for (auto item : group->Group)
+			{
+				RedeclareTopLevel(item);
+			}
+		}
+		else if (auto var = dynamic_cast<const VariableDecl*>(decl))
+		{
+			DeclareEntity(var->Name, var->Type, var->Spec);
+		}
+		else if (auto func = dynamic_cast<const FunctionDecl*>(decl))
+		{
+			DeclareEntity(func->Name, func->Type->MakeQualified(), StorageSpecifier::None);
+		}
+	}
+
+	NamedEntity* AstBuilder::DeclareEntity(const std::string& name, QualType type, StorageSpecifier storage)
+	{
+		auto symbol = InternSymbol(name);
+
+		// FIXME: ensure a redeclaration is compatible
+		if (auto entity = scopes_.LookupLocalEntity(symbol))
+			return entity;
+
+		auto entity = arena_.MakeAstObject<NamedEntity>();
+		entity->Name = symbol;
+		entity->Type = type;
+		entity->StorageClass = storage;
+
+		scopes_.DeclareEntity(entity);
+		return entity;
+	}
+
 	// Expr Factory
 	//
 	ExprBase* AstBuilder::NewLiteralExpr(const CConstant& value)
 	{
-		return arena_->MakeAstObject<LiteralExpr>(value);
+		return arena_.MakeAstObject<LiteralExpr>(value);
+	}
+	ExprBase* AstBuilder::NewSizeOfExpr(CType* type)
+	{
+		// 6.5.3.4 The sizeof and _Alignof operators
+		// NOTE the result is folded into an integer constant of size_t, which is unsigned int
+		// FIXME: types of expressions are not deduced yet, so sizeof an expression is not supported
+		if (type == nullptr)
+			ReportError("sizeof an expression is not supported yet");
+		if (type->Size() == 0)
+			ReportError("sizeof applied to an incomplete type");
+
+		return NewLiteralExpr(CInteger{ type->Size(), IntPrecision::UInt32 });
 	}
-	ExprBase* AstBuilder::NewVariableExpr(const std::string& name)
+	ExprBase* AstBuilder::NewAlignOfExpr(CType* type)
+	{
+		if (type == nullptr || type->Alignment() == 0)
+			ReportError("_Alignof applied to an incomplete type");
+
+		return NewLiteralExpr(CInteger{ type->Alignment(), IntPrecision::UInt32 });
+	}
+	ExprBase* AstBuilder::NewVariableExpr(SymbolId name)
 	{
 		// ensure name refers to a variable
-		auto entity = local_scope_->LookupEntity(name);
-		if (entity == nullptr || entity->StorageClass != StorageSpecifier::Typedef)
+		auto entity = scopes_.LookupEntity(name);
+		if (entity == nullptr || entity->StorageClass == StorageSpecifier::Typedef)
 		{
-			ReportError(FormatString("identifier %s does not refer to a variable", name.c_str()));
+			ReportError(FormatString("identifier %s does not refer to a variable", std::string{ SymbolText(name) }.c_str()));
 		}
 
-		return arena_->MakeAstObject<VariableExpr>(entity);
+		return arena_.MakeAstObject<VariableExpr>(entity);
 	}
 	ExprBase* AstBuilder::NewCastExpr(CType* target_type, ExprBase* val)
 	{
@@ -27,10 +171,16 @@ namespace lolita
 		// void target type discards expression value
 		if (target_type->IsVoid())
 		{
-			return arena_->MakeAstObject<CastExpr>(target_type, val);
+			return arena_.MakeAstObject<CastExpr>(target_type, val);
 		}
 
+		// NOTE types of expressions are not deduced yet, skip checks for them
 		CType* src_type = val->GetType();
+		if (src_type == nullptr)
+		{
+			return arena_.MakeAstObject<CastExpr>(target_type, val);
+		}
+
 		if (!src_type->IsScalar())
 		{
 			throw "cannot cast a non-scalar type";
@@ -58,36 +208,36 @@ namespace lolita
 			throw "casting requires scalar type";
 		}
 
-		return arena_->MakeAstObject<CastExpr>(target_type, val);
+		return arena_.MakeAstObject<CastExpr>(target_type, val);
 	}
 	ExprBase* AstBuilder::NewUnaryExpr(UnaryOp op, ExprBase* expr)
 	{
 		// FIXME: ensure op(expr) can apply to expr
 
-		return arena_->MakeAstObject<UnaryExpr>(op, expr);
+		return arena_.MakeAstObject<UnaryExpr>(op, expr);
 	}
 	ExprBase* AstBuilder::NewBinaryExpr(BinaryOp op, ExprBase* lhs, ExprBase* rhs)
 	{
 		// FIXME: ensure op(lhs, rhs) is valid
 
-		return arena_->MakeAstObject<BinaryExpr>(op, lhs, rhs);
+		return arena_.MakeAstObject<BinaryExpr>(op, lhs, rhs);
 	}
 	ExprBase* AstBuilder::NewConditionalExpr(ExprBase* cond, ExprBase* yes, ExprBase* no)
 	{
 		// 6.5.15 Conditional operator
 
-		if (!cond->GetType()->IsScalar())
+		if (cond->GetType() != nullptr && !cond->GetType()->IsScalar())
 		{
 			throw "condition expression must have scalar type";
 		}
 
 		// FIXME: ensure yes and no have the same type
 
-		return arena_->MakeAstObject<ConditionalExpr>(cond, yes, no);
+		return arena_.MakeAstObject<ConditionalExpr>(cond, yes, no);
 	}
 	ExprBase* AstBuilder::NewCommaExpr(const std::vector<ExprBase*>& list)
 	{
-		return arena_->MakeAstObject<CommaExpr>(list);
+		return arena_.MakeAstObject<CommaExpr>(arena_.MakeArray(list));
 	}
 	ExprBase* AstBuilder::NewAccessExpr(ExprBase* obj, const std::string& name, bool deref)
 	{
@@ -97,57 +247,58 @@ namespace lolita
 
 		// FIXME: ensure actual_obj has member with name specified
 
-		return arena_->MakeAstObject<AccessExpr>(actual_obj, name);
+		return arena_.MakeAstObject<AccessExpr>(actual_obj, name);
 	}
-	ExprBase* AstBuilder::NewInvokeExpr(ExprBase* callee, std::vector<ExprBase*> args)
+	ExprBase* AstBuilder::NewInvokeExpr(ExprBase* callee, const std::vector<ExprBase*>& args)
 	{
 		// FIXME:
 		auto type = dynamic_cast<PointerType*>(callee->GetType());
-		if (type == nullptr || !type->BaseType().Type->IsFunction())
+		if (callee->GetType() != nullptr && (type == nullptr || !type->BaseType().Type->IsFunction()))
 		{
 			throw "only function or pointer to function should be called";
 		}
 
 		// FIXME: ensure correct number of arguments are provided
 
-		return arena_->MakeAstObject<InvokeExpr>(callee, args);
+		return arena_.MakeAstObject<InvokeExpr>(callee, arena_.MakeArray(args));
 	}
 	ExprBase* AstBuilder::NewSubscriptExpr(ExprBase* data, ExprBase* index)
 	{
 		// FIXME: ensure subscript applies to data (array or pointer)
 		// FIXME: ensure index is an integer
 
-		return arena_->MakeAstObject<SubscriptExpr>(data, index);
+		return arena_.MakeAstObject<SubscriptExpr>(data, index);
 	}
 
 	// Stmt Factory
 	//
-	StmtBase* AstBuilder::NewDeclStmt(QualType type, const std::string& name, ExprBase* value)
+	StmtBase* AstBuilder::NewDeclStmt(QualType type, const std::string& name, StorageSpecifier storage, ExprBase* value)
 	{
-		auto result = arena_->MakeAstObject<DeclStmt>();
+		auto result = arena_.MakeAstObject<DeclStmt>();
 		result->Type = type;
 		result->Name = name;
 		result->Value = value;
 
+		DeclareEntity(name, type, storage);
 		return result;
 	}
-	StmtBase* AstBuilder::NewCompoundStmt(std::vector<StmtBase*> children)
+	StmtBase* AstBuilder::NewCompoundStmt(const std::vector<StmtBase*>& children)
 	{
-		auto result = arena_->MakeAstObject<CompoundStmt>();
-		result->Children = std::move(children);
+		auto result = arena_.MakeAstObject<CompoundStmt>();
+		result->Children = arena_.MakeArray(children);
 
 		return result;
 	}
 	StmtBase* AstBuilder::NewExprStmt(ExprBase* expr)
 	{
-		auto result = arena_->MakeAstObject<ExprStmt>();
+		auto result = arena_.MakeAstObject<ExprStmt>();
 		result->Expr = expr;
 
 		return result;
 	}
 	StmtBase* AstBuilder::NewIfStmt(ExprBase* cond, StmtBase* yes, StmtBase* no)
 	{
-		auto result = arena_->MakeAstObject<IfStmt>();
+		auto result = arena_.MakeAstObject<IfStmt>();
 		result->Choice = cond;
 		result->First = yes;
 		result->Second = no;
@@ -156,7 +307,7 @@ namespace lolita
 	}
 	StmtBase* AstBuilder::NewWhileStmt(ExprBase* cond, StmtBase* body)
 	{
-		auto result = arena_->MakeAstObject<WhileStmt>();
+		auto result = arena_.MakeAstObject<WhileStmt>();
 		result->Predicate = cond;
 		result->Body = body;
 
@@ -164,31 +315,35 @@ namespace lolita
 	}
 	StmtBase* AstBuilder::NewBreakStmt()
 	{
-		auto result = arena_->MakeAstObject<JumpStmt>();
+		auto result = arena_.MakeAstObject<JumpStmt>();
 		result->Strategy = JumpStrategy::Break;
 
 		return result;
 	}
 	StmtBase* AstBuilder::NewContinueStmt()
 	{
-		auto result = arena_->MakeAstObject<JumpStmt>();
+		auto result = arena_.MakeAstObject<JumpStmt>();
 		result->Strategy = JumpStrategy::Continue;
 
 		return result;
 	}
 	StmtBase* AstBuilder::NewReturnStmt(ExprBase* expr)
 	{
-		auto result = arena_->MakeAstObject<ReturnStmt>();
+		auto result = arena_.MakeAstObject<ReturnStmt>();
 		result->Expr = expr;
 
 		return result;
 	}
 	StmtBase* AstBuilder::NewGotoStmt(const std::string& label)
 	{
-		auto result = arena_->MakeAstObject<JumpStmt>();
+		auto result = arena_.MakeAstObject<JumpStmt>();
 		result->Strategy = JumpStrategy::Goto;
 		result->TargetLabel = label;
 
 		return result;
 	}
+	void AstBuilder::AnnotateLabels(StmtBase* stmt, const std::vector<SymbolId>& labels)
+	{
+		stmt->Labels = arena_.MakeArray(labels);
+	}
 }
\ No newline at end of file
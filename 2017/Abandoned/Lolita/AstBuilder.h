@@ -9,31 +9,53 @@ namespace lolita
 	class AstBuilder
 	{
 	public:
+		AstBuilder();
+
 		// Utility Functions
 		//
-		void EnterFunction();
+		// the scope of a function body, where parameters named in $params are declared
+		void EnterFunction(const FunctionType* type, const std::vector<std::string>& params);
 		void ExitFunction();
 
 		void AnnotateLocation(SourceLocation loc);
 
 		void ReportError(const std::string& msg);
 
+		// the arena where nodes are allocated
+		AstArena& Arena() { return arena_; }
+
 		// Decl Factory
 		//
+		DeclBase* NewGroupDecl(const std::vector<DeclBase*>& group);
+		DeclBase* NewVariableDecl(QualType type, const std::string& name, StorageSpecifier storage, ExprBase* init);
+		DeclBase* NewFunctionDecl(CType* type, const std::string& name, StmtBase* body);
+
+		// Scope Factory
+		//
+		Scope* NewScope(Scope* parent, ScopeCategory cat);
+
+		// the file scope is entered on construction
+		void EnterScope(ScopeCategory cat);
+		void ExitScope();
+
+		const ScopeStack& Scopes() const { return scopes_; }
+
+		// make names declared by a top-level declaration visible, e.g. one made by another builder
+		void RedeclareTopLevel(const DeclBase* decl);
 
 		// Expr Factory
 		//
 
 		// NOTE those factory funtions does not map to a unique Ast node type
 		ExprBase* NewLiteralExpr(const CConstant& val);
-		ExprBase* NewVariableExpr(const std::string& name);
+		ExprBase* NewVariableExpr(SymbolId name);
 		ExprBase* NewCastExpr(CType* type, ExprBase* val);
 		ExprBase* NewUnaryExpr(UnaryOp op, ExprBase* val);
 		ExprBase* NewBinaryExpr(BinaryOp op, ExprBase* lhs, ExprBase* rhs);
 		ExprBase* NewConditionalExpr(ExprBase* cond, ExprBase* yes, ExprBase* no);
 		ExprBase* NewCommaExpr(const std::vector<ExprBase*>& list);
 		ExprBase* NewAccessExpr(ExprBase* obj, const std::string& name, bool deref);
-		ExprBase* NewInvokeExpr(ExprBase* callee, std::vector<ExprBase*> args);
+		ExprBase* NewInvokeExpr(ExprBase* callee, const std::vector<ExprBase*>& args);
 		ExprBase* NewSubscriptExpr(ExprBase* data, ExprBase* index);
 
 		ExprBase* NewSizeOfExpr(CType* type);
@@ -41,8 +63,8 @@ namespace lolita
 
 		// Stmt Factory
 		//
-		StmtBase* NewDeclStmt(QualType type, const std::string& name, ExprBase* value);
-		StmtBase* NewCompoundStmt(std::vector<StmtBase*> stmt);
+		StmtBase* NewDeclStmt(QualType type, const std::string& name, StorageSpecifier storage, ExprBase* value);
+		StmtBase* NewCompoundStmt(const std::vector<StmtBase*>& children);
 		StmtBase* NewExprStmt(ExprBase* expr);
 		StmtBase* NewIfStmt(ExprBase* cond, StmtBase* yes, StmtBase* no);
 		// StmtBase* NewForStmt(StmtBase* init, ExprBase* cond, ExprBase* next, StmtBase* body);
@@ -52,10 +74,17 @@ namespace lolita
 		StmtBase* NewReturnStmt(ExprBase* expr);
 		StmtBase* NewGotoStmt(const std::string& label);
 
+		void AnnotateLabels(StmtBase* stmt, const std::vector<SymbolId>& labels);
+
 	private:
-		AstArena::Ptr arena_;
+		// declare an entity in the innermost scope, or returns the one declared before
+		NamedEntity* DeclareEntity(const std::string& name, QualType type, StorageSpecifier storage);
+
+		AstArena arena_;
+
+		ScopeStack scopes_;
 
-		Scope* file_scope_;
-		Scope* local_scope_;
+		// where errors are reported, see AnnotateLocation
+		SourceLocation location_ = {};
 	};
 }
\ No newline at end of file
@@ -1,16 +1,45 @@
 #pragma once
 #include "AstModel.h"
-#include "Type.h"
+#include <cstddef>
 #include <vector>
 
 namespace lolita
 {
 	// common base type
+	// NOTE AstObjects are destroyed by AstArena with their exact types,
+	//      so the destructor is not virtual and a trivial node costs nothing to destroy
 	class AstObject
 	{
 	public:
 		AstObject() = default;
 
-		virtual ~AstObject() = default;
+	protected:
+		~AstObject() = default;
+	};
+
+	// A fixed-size array allocated in an AstArena, e.g. a list of child nodes
+	// NOTE elements are never destroyed, so they must be trivially destructible
+	template <typename T>
+	class ArenaArray
+	{
+	public:
+		ArenaArray() = default;
+		ArenaArray(T* data, size_t size)
+			: data_(data), size_(size) { }
+
+		T* begin() const { return data_; }
+		T* end() const { return data_ + size_; }
+
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		T& operator[](size_t index) const { return data_[index]; }
+
+		T& front() const { return data_[0]; }
+		T& back() const { return data_[size_ - 1]; }
+
+	private:
+		T* data_ = nullptr;
+		size_t size_ = 0;
 	};
 }
\ No newline at end of file
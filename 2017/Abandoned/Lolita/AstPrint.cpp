@@ -20,15 +20,15 @@ namespace lolita
 		{
 			void VisitLiteralExpr(LiteralExpr &expr) override
 			{
-				if (auto pi = get_if<CInteger>(&expr.Value))
+				if (auto pi = get_if<CInteger>(&expr.Value()))
 				{
 					printf("Integer Const: %llu\n", pi->Value());
 				}
-				else if (auto pf = get_if<CFloat>(&expr.Value))
+				else if (auto pf = get_if<CFloat>(&expr.Value()))
 				{
 					printf("Float Const: %lf\n", pf->Value());
 				}
-				else if (auto ps = get_if<CString>(&expr.Value))
+				else if (auto ps = get_if<CString>(&expr.Value()))
 				{
 					printf("String Literal: %s\n", ('"' + ps->Value() + '"').c_str());
 				}
@@ -39,17 +39,17 @@ namespace lolita
 			};
 			void VisitVariableExpr(VariableExpr& expr) override
 			{
-				printf("Variable Expr: %s\n", expr.Name.c_str());
+				printf("Variable Expr: %s\n", std::string{ SymbolText(expr.Entity()->Name) }.c_str());
 			};
 			void VisitCastExpr(CastExpr &) override { };
 			void VisitUnaryExpr(UnaryExpr &) override { };
 			void VisitBinaryExpr(BinaryExpr& expr)  override
 			{
-				printf("Binary Expr: %s\n", ToString(expr.Op));
+				printf("Binary Expr: %s\n", ToString(expr.Op()));
 
 				depth += 2;
-				PrintAst(expr.Left);
-				PrintAst(expr.Right);
+				PrintAst(expr.LeftExpr());
+				PrintAst(expr.RightExpr());
 				depth -= 2;
 			};
 			void VisitConditionalExpr(ConditionalExpr &) override { };
@@ -60,8 +60,8 @@ namespace lolita
 				printf("Subscript Expr:\n");
 
 				depth += 2;
-				PrintAst(expr.object_);
-				PrintAst(expr.index_);
+				PrintAst(expr.Object());
+				PrintAst(expr.Index());
 				depth -= 2;
 			}
 			void VisitInvokeExpr(InvokeExpr& expr) override
@@ -69,15 +69,13 @@ namespace lolita
 				printf("Invoke Expr:\n");
 
 				depth += 2;
-				PrintAst(expr.callee_);
-				for (auto child : expr.args_)
+				PrintAst(expr.Callee());
+				for (auto child : expr.Args())
 				{
 					PrintAst(child);
 				}
 				depth -= 2;
 			};
-			void VisitTypeMetaExpr(TypeMetaExpr &) override { };
-			void VisitValueMetaExpr(ValueMetaExpr &) override { };
 		};
 
 		auto visitor = Visitor{};
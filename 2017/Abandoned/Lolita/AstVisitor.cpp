@@ -14,8 +14,6 @@ namespace lolita
 	void AccessExpr::Accept(ExprVisitor& visitor) { visitor.VisitAccessExpr(*this); }
 	void SubscriptExpr::Accept(ExprVisitor& visitor) { visitor.VisitSubscriptExpr(*this); }
 	void InvokeExpr::Accept(ExprVisitor& visitor) { visitor.VisitInvokeExpr(*this); }
-	void TypeMetaExpr::Accept(ExprVisitor& visitor) { visitor.VisitTypeMetaExpr(*this); }
-	void ValueMetaExpr::Accept(ExprVisitor& visitor) { visitor.VisitValueMetaExpr(*this); }
 
 	// Accept Function for StmtBase
 	//
@@ -21,8 +21,6 @@ namespace lolita
 		virtual void VisitAccessExpr(AccessExpr&) { }
 		virtual void VisitSubscriptExpr(SubscriptExpr&) { }
 		virtual void VisitInvokeExpr(InvokeExpr&) { }
-		virtual void VisitTypeMetaExpr(TypeMetaExpr&) { }
-		virtual void VisitValueMetaExpr(ValueMetaExpr&) { }
 	};
 
 	class StmtVisitor
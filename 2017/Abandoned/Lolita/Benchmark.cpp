@@ -0,0 +1,300 @@
+#include "Benchmark.h"
+#include "SourceFile.h"
+#include "SourceLexer.h"
+#include "TranslationContext.h"
+#include "Preprocessor.h"
+#include "ParserImpl.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+namespace lolita
+{
+	using BenchmarkClock = chrono::steady_clock;
+
+	// minimal duration of a benchmark to make the result stable
+	static constexpr auto kBenchmarkDuration = chrono::seconds{ 2 };
+
+	// run $fn repeatedly for at least kBenchmarkDuration, and returns seconds per run
+	template <typename Fn>
+	static double MeasureRepeatedly(Fn fn)
+	{
+		// warm up caches
+		fn();
+
+		auto run_count = size_t{ 0 };
+		auto start = BenchmarkClock::now();
+		auto elapsed = BenchmarkClock::duration{};
+		do
+		{
+			fn();
+
+			run_count += 1;
+			elapsed = BenchmarkClock::now() - start;
+		} while (elapsed < kBenchmarkDuration);
+
+		return chrono::duration<double>(elapsed).count() / run_count;
+	}
+
+	void BenchmarkLexer(const vector<string>& files)
+	{
+		auto src = SourceManager{};
+		auto diag = DiagonisticClient{};
+		InitTranslation(src, diag);
+
+		auto sources = vector<SourceFile::Ptr>{};
+		auto total_size = size_t{ 0 };
+		for (const auto& filename : files)
+		{
+			auto file = SourceFile::Open(filename, filename);
+			if (!file)
+			{
+				printf("cannot open %s\n", filename.c_str());
+				continue;
+			}
+
+			total_size += file->Size();
+			sources.push_back(move(file));
+		}
+
+		auto token_count = size_t{ 0 };
+		auto seconds = MeasureRepeatedly([&]() {
+			token_count = 0;
+			for (const auto& file : sources)
+			{
+				token_count += LexSourceFile(file.get()).size();
+			}
+		});
+
+		auto megabytes = total_size / (1024.0 * 1024.0);
+		printf("lexer: %zu files, %.2f MB, %zu tokens, %.3f ms per run, %.1f MB/s\n",
+			sources.size(), megabytes, token_count, seconds * 1000, megabytes / seconds);
+
+		FinalizeTranslation();
+	}
+
+	// size of the generated source for BenchmarkMacroExpansion
+	static constexpr auto kMacroRecordCount = 64;
+	static constexpr auto kMacroFieldCount = 12;
+	static constexpr auto kMacroMaxArgCount = 16;
+	static constexpr auto kMacroForEachCount = 1024;
+
+	// generate a source in the style of X-macros nested in X-macros,
+	// and of P99, i.e. counting arguments and dispatching by token pasting
+	static string GenerateMacroSource()
+	{
+		auto text = string{};
+		auto line = [&](const string& s) {
+			text += s;
+			text += '\n';
+		};
+
+		line("#define CAT(a, b) a ## b");
+		line("#define XCAT(a, b) CAT(a, b)");
+		line("#define STR(x) #x");
+		line("#define XSTR(x) STR(x)");
+
+		// #define ARG_N(_1, _2, ..., N, ...) N
+		// #define NARG(...) ARG_N(__VA_ARGS__, 16, 15, ..., 1, 0)
+		auto arg_n = string{ "#define ARG_N(" };
+		auto narg = string{ "#define NARG(...) ARG_N(__VA_ARGS__" };
+		for (auto i = 1; i <= kMacroMaxArgCount; ++i)
+		{
+			arg_n += "_" + to_string(i) + ", ";
+			narg += ", " + to_string(kMacroMaxArgCount + 1 - i);
+		}
+		line(arg_n + "N, ...) N");
+		line(narg + ", 0)");
+
+		// #define FE_n(m, x, ...) m(x) FE_n-1(m, __VA_ARGS__)
+		line("#define FE_1(m, x) m(x)");
+		for (auto i = 2; i <= kMacroMaxArgCount; ++i)
+		{
+			line("#define FE_" + to_string(i) + "(m, x, ...) m(x) FE_" + to_string(i - 1) + "(m, __VA_ARGS__)");
+		}
+		line("#define FOR_EACH(m, ...) XCAT(FE_, NARG(__VA_ARGS__))(m, __VA_ARGS__)");
+
+		// records, whose fields are X-macros as well
+		auto records = string{ "#define RECORDS(X)" };
+		for (auto i = 0; i < kMacroRecordCount; ++i)
+		{
+			auto fields = "#define FIELDS_r" + to_string(i) + "(X)";
+			for (auto j = 0; j < kMacroFieldCount; ++j)
+			{
+				fields += j % 2 == 0 ? " X(int, f" : " X(long, f";
+				fields += to_string(j) + ")";
+			}
+
+			line(fields);
+			records += " X(r" + to_string(i) + ")";
+		}
+		line(records);
+
+		line("#define AS_MEMBER(type, name) type name;");
+		line("#define AS_NAME(type, name) XSTR(name),");
+		line("#define AS_STRUCT(r) struct r { CAT(FIELDS_, r)(AS_MEMBER) };");
+		line("#define AS_NAMES(r) static const char* CAT(r, _names)[] = { CAT(FIELDS_, r)(AS_NAME) };");
+		line("RECORDS(AS_STRUCT)");
+		line("RECORDS(AS_NAMES)");
+
+		line("#define DECL(x) int XCAT(x, _var);");
+		for (auto i = 0; i < kMacroForEachCount; ++i)
+		{
+			auto args = string{ "v" + to_string(i) };
+			for (auto j = 1; j <= i % kMacroMaxArgCount; ++j)
+			{
+				args += ", v" + to_string(i) + "_" + to_string(j);
+			}
+
+			line("FOR_EACH(DECL, " + args + ")");
+		}
+
+		return text;
+	}
+
+	void BenchmarkMacroExpansion()
+	{
+		auto src = SourceManager{};
+		auto diag = DiagonisticClient{};
+		InitTranslation(src, diag);
+
+		auto file = SourceFile::FromMemory("<macro-benchmark>", GenerateMacroSource());
+		auto input = LexSourceFile(file.get());
+
+		auto output = TokenBuffer{};
+		auto seconds = MeasureRepeatedly([&]() {
+			auto cpp = Preprocessor{};
+			output = cpp.Preprocess(input);
+		});
+
+		printf("macro: %zu tokens in, %zu tokens out, %.3f ms per run, %.2f M tokens/s\n",
+			input.size(), output.Size(), seconds * 1000, output.Size() / seconds / 1e6);
+
+		// the output is kept as a TokenBuffer, instead of a TokenVec
+		printf("macro: output takes %.2f MB, %.2f MB as a TokenVec\n",
+			output.MemoryUsage() / (1024.0 * 1024.0), output.Size() * sizeof(Token) / (1024.0 * 1024.0));
+
+		FinalizeTranslation();
+	}
+
+	// size of the generated source for BenchmarkExpressionParser
+	static constexpr auto kExprStatementCount = 8192;
+
+	// identifiers referred to by the generated expressions, which are declared first
+	static const char* const kExprIdentifiers[] = {
+		"a", "b", "c", "d", "e", "f", "g", "h", "i", "k", "m", "n", "o", "p", "q",
+		"r", "s", "t", "u", "v", "w", "x", "y", "z", "flag",
+	};
+
+	// generate a block of expression statements, which mix operators of every precedence
+	// NOTE most operands are primary expressions, the worst case of descending a function per level
+	static string GenerateExpressionSource()
+	{
+		auto text = string{ "{\n" };
+		for (auto name : kExprIdentifiers)
+		{
+			text += "int " + string{ name } + ";\n";
+		}
+
+		for (auto i = 0; i < kExprStatementCount; ++i)
+		{
+			auto n = to_string(i);
+			switch (i % 4)
+			{
+			case 0:
+				text += "v = a * b + (c - d) / 3 << 1 > e && f | g ^ h & k == m || !n ? p[" + n + "] : q - r % 5;\n";
+				break;
+			case 1:
+				text += "w += x * y - z / (u + " + n + ") % 2 | (s & t) ^ ~o;\n";
+				break;
+			case 2:
+				text += "a = b = c ? d : e ? f : g, h = i->j + k.l * m(n, o + " + n + ");\n";
+				break;
+			case 3:
+				text += "flag = x < y && y <= z || z != " + n + " && w >= 1 && v == 2;\n";
+				break;
+			}
+		}
+
+		return text + "}\n";
+	}
+
+	void BenchmarkExpressionParser()
+	{
+		auto src = SourceManager{};
+		auto diag = DiagonisticClient{};
+		InitTranslation(src, diag);
+
+		// keywords are refined by the preprocessor
+		auto file = SourceFile::FromMemory("<expression-benchmark>", GenerateExpressionSource());
+		auto tokens = Preprocessor{}.Preprocess(LexSourceFile(file.get()));
+
+		auto seconds = MeasureRepeatedly([&]() {
+			auto reader = TokenBufferSource{ tokens };
+			reader.Try(TokenTag::LBrace);
+
+			auto parser = ParserImpl{ reader };
+			parser.ParseCompoundStmt();
+		});
+
+		printf("expression: %d statements, %zu tokens, %.3f ms per run, %.2f M tokens/s\n",
+			kExprStatementCount, tokens.Size(), seconds * 1000, tokens.Size() / seconds / 1e6);
+
+		FinalizeTranslation();
+	}
+
+	// depth of the generated nested blocks, and how many times they're repeated
+	static constexpr auto kScopeDepth = 256;
+	static constexpr auto kScopeRepeatCount = 32;
+
+	// generate a block of nested blocks, where each declares a fresh name and shadows $v,
+	// and refers to names declared in the enclosing, the middle and the outermost block
+	static string GenerateNestedScopeSource()
+	{
+		auto text = string{ "{\nint a0 = 1;\nint v = 0;\n" };
+		for (auto i = 0; i < kScopeRepeatCount; ++i)
+		{
+			for (auto depth = 1; depth <= kScopeDepth; ++depth)
+			{
+				auto n = to_string(depth);
+				text += "{\nint a" + n + " = a" + to_string(depth - 1) + " + a0;\n";
+				text += "int v = a" + n + " * 2;\n";
+				text += "v = v + a" + to_string(depth / 2) + ";\n";
+			}
+
+			// names shadowed become visible again when a block exits
+			for (auto depth = kScopeDepth; depth >= 1; --depth)
+			{
+				text += "}\nv = v - a" + to_string(depth - 1) + ";\n";
+			}
+		}
+
+		return text + "}\n";
+	}
+
+	void BenchmarkNestedScopes()
+	{
+		auto src = SourceManager{};
+		auto diag = DiagonisticClient{};
+		InitTranslation(src, diag);
+
+		// keywords are refined by the preprocessor
+		auto file = SourceFile::FromMemory("<scope-benchmark>", GenerateNestedScopeSource());
+		auto tokens = Preprocessor{}.Preprocess(LexSourceFile(file.get()));
+
+		auto seconds = MeasureRepeatedly([&]() {
+			auto reader = TokenBufferSource{ tokens };
+			reader.Try(TokenTag::LBrace);
+
+			auto parser = ParserImpl{ reader };
+			parser.ParseCompoundStmt();
+		});
+
+		printf("nested scopes: depth %d, %d blocks, %zu tokens, %.3f ms per run, %.2f M tokens/s\n",
+			kScopeDepth, kScopeDepth * kScopeRepeatCount, tokens.Size(), seconds * 1000, tokens.Size() / seconds / 1e6);
+
+		FinalizeTranslation();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace lolita
+{
+	// Benchmarks
+	//
+	// NOTE each benchmark repeats its work for a while, and prints the throughput
+
+	// lex source files, and report throughput in MB/s
+	void BenchmarkLexer(const std::vector<std::string>& files);
+
+	// preprocess a generated macro-heavy source, and report throughput in tokens/s
+	void BenchmarkMacroExpansion();
+
+	// parse generated expression-heavy statements, and report throughput in tokens/s
+	void BenchmarkExpressionParser();
+
+	// parse generated deeply nested blocks, where names are shadowed and looked up across scopes
+	void BenchmarkNestedScopes();
+}
\ No newline at end of file
@@ -21,7 +21,7 @@ namespace lolita
 	// decl and def of variable as well as decl of function may be grouped
 	struct GroupDecl : public DeclBase
 	{
-		std::vector<DeclBase*> Group;
+		ArenaArray<DeclBase*> Group;
 
 		void Accept(DeclVisitor&) override;
 	};
@@ -1,17 +1,56 @@
 #pragma once
 #include "SourceLocation.h"
+#include "TextUtils.h"
 #include <string>
+#include <vector>
 #include <cstdlib>
+#include <cstdio>
 
 namespace lolita
 {
 	class DiagonisticClient
 	{
 	public:
+		// NOTE a buffered client keeps messages until Flush is called,
+		// so that diagnostics of concurrent translations would not interleave
+		DiagonisticClient(bool buffered = false)
+			: buffered_(buffered) { }
+
 		void ReportError(SourceLocation loc, const char* msg)
 		{
 			auto filename = std::string{ loc.File->Name() };
-			printf("error@[line %u; column %u; file %s]: %s\n", loc.Line, loc.Column, filename.c_str(), msg);
+			auto text = FormatString("error@[line %u; column %u; file %s]: %s\n", loc.Line, loc.Column, filename.c_str(), msg);
+
+			if (buffered_)
+				messages_.push_back(std::move(text));
+			else
+				fputs(text.c_str(), stdout);
+		}
+
+		const std::vector<std::string>& Messages() const
+		{
+			return messages_;
+		}
+
+		// discard messages kept
+		void Clear()
+		{
+			messages_.clear();
 		}
+
+		void Flush()
+		{
+			for (const auto& text : messages_)
+			{
+				fputs(text.c_str(), stdout);
+			}
+
+			messages_.clear();
+		}
+
+	private:
+		bool buffered_;
+
+		std::vector<std::string> messages_;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "Driver.h"
+#include "SourceLexer.h"
+#include "Preprocessor.h"
+#include "TranslationContext.h"
+#include "TextUtils.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+namespace lolita
+{
+	// translate a single file on the calling thread
+	static void TranslateFile(const string& filename, SourceManager& src, const DriverOptions& options, TranslationResult& result)
+	{
+		result.File = SourceFile::Open(filename, filename);
+		if (!result.File)
+		{
+			result.Diagnostics.push_back(FormatString("error@[file %s]: cannot open the file\n", filename.c_str()));
+			result.Aborted = true;
+			return;
+		}
+
+		// each translation unit has its own context, so diagnostics are not shared
+		auto diag = DiagonisticClient{ true };
+		InitTranslation(src, diag);
+
+		auto stats = options.Instrument ? &result.Stats : nullptr;
+		if (stats)
+		{
+			stats->File = filename;
+			InstrumentTranslation(stats);
+		}
+
+		try
+		{
+			auto lex_result = TokenVec{};
+			{
+				auto timer = PhaseTimer{ stats, Phase::Lexing };
+				lex_result = LexSourceFile(result.File.get());
+			}
+
+			auto cpp = Preprocessor{};
+			{
+				auto timer = PhaseTimer{ stats, Phase::Preprocessing };
+				if (options.Precompiled)
+				{
+					cpp.Restore(*options.Precompiled);
+				}
+
+				result.Tokens = cpp.Preprocess(lex_result);
+			}
+
+			if (stats)
+			{
+				// headers lexed by this unit are counted by the HeaderCache
+				(*stats)[Phase::Lexing].Tokens += lex_result.size();
+				(*stats)[Phase::Preprocessing].Tokens += result.Tokens.Size();
+				stats->MacroExpansions += cpp.MacroExpansionCount();
+				stats->IncludeHits += cpp.IncludeHitCount();
+				stats->IncludeMisses += cpp.IncludeMissCount();
+			}
+
+			if (options.Parse)
+			{
+				auto timer = PhaseTimer{ stats, Phase::Parsing };
+				result.Tree = ParseTranslationUnit(result.Tokens);
+
+				if (stats)
+				{
+					(*stats)[Phase::Parsing].Tokens += result.Tokens.Size();
+					stats->AstNodes += result.Tree->Arena().ObjectCount();
+					stats->ArenaBytes += result.Tree->Arena().ByteCount();
+				}
+			}
+		}
+		catch (...)
+		{
+			// AbortTranslation and the parser throw to stop a translation
+			result.Aborted = true;
+		}
+
+		FinalizeTranslation();
+		result.Diagnostics = diag.Messages();
+	}
+
+	vector<TranslationResult> TranslateFiles(const vector<string>& files, SourceManager& src, const DriverOptions& options)
+	{
+		auto results = vector<TranslationResult>(files.size());
+
+		auto worker_count = options.WorkerCount != 0
+			? options.WorkerCount
+			: max<size_t>(thread::hardware_concurrency(), 1);
+		worker_count = min(worker_count, files.size());
+
+		// files are claimed one by one, as their costs hardly balance
+		// NOTE headers are lexed once and shared through the HeaderCache
+		auto next_file = atomic<size_t>{ 0 };
+		auto work = [&]() {
+			for (auto i = next_file++; i < files.size(); i = next_file++)
+			{
+				TranslateFile(files[i], src, options, results[i]);
+			}
+		};
+
+		auto workers = vector<thread>{};
+		for (size_t i = 1; i < worker_count; ++i)
+		{
+			workers.emplace_back(work);
+		}
+
+		// the calling thread works as well
+		work();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		// merge diagnostics in the order of files
+		for (const auto& result : results)
+		{
+			for (const auto& text : result.Diagnostics)
+			{
+				fputs(text.c_str(), stdout);
+			}
+		}
+
+		return results;
+	}
+
+	PrecompiledHeader::Ptr PrecompileFile(const string& filename, SourceManager& src)
+	{
+		auto file = SourceFile::Open(filename, filename);
+		if (!file)
+		{
+			printf("error@[file %s]: cannot open the file\n", filename.c_str());
+			return nullptr;
+		}
+
+		auto diag = DiagonisticClient{};
+		InitTranslation(src, diag);
+
+		auto result = PrecompiledHeader::Ptr{};
+		try
+		{
+			auto cpp = Preprocessor{};
+			result = cpp.Precompile(LexSourceFile(file.get()));
+
+			// tokens of the prefix header refer to the file
+			result->Retain(move(file));
+		}
+		catch (...)
+		{
+			result = nullptr;
+		}
+
+		FinalizeTranslation();
+		return result;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include "Token.h"
+#include "TokenBuffer.h"
+#include "SourceFile.h"
+#include "SourceManager.h"
+#include "Parser.h"
+#include "PrecompiledHeader.h"
+#include "TranslationStats.h"
+#include <string>
+#include <vector>
+
+namespace lolita
+{
+	struct DriverOptions
+	{
+		// number of worker threads, 0 to use hardware concurrency
+		size_t WorkerCount = 0;
+
+		// if translation units are parsed after preprocessing
+		bool Parse = false;
+
+		// restored before each translation unit, nullptr if none
+		const PrecompiledHeader* Precompiled = nullptr;
+
+		// if phases are timed and counted into TranslationResult::Stats
+		bool Instrument = false;
+	};
+
+	// Result of a translation unit, which owns everything its tokens and tree refer to
+	struct TranslationResult
+	{
+		SourceFile::Ptr File;
+
+		// preprocessed tokens, ends with EndOfFile
+		TokenBuffer Tokens;
+
+		// nullptr if not parsed
+		ParseTree::Ptr Tree;
+
+		// formatted diagnostics in the order reported
+		std::vector<std::string> Diagnostics;
+
+		// if the translation is aborted or the file cannot be opened
+		bool Aborted = false;
+
+		// collected only if DriverOptions::Instrument is set
+		TranslationStats Stats;
+	};
+
+	// Translate source files concurrently on a pool of workers
+	// NOTE results are in the order of files, and diagnostics are printed
+	//      in the same order after all translation units finish
+	std::vector<TranslationResult> TranslateFiles(
+		const std::vector<std::string>& files, SourceManager& src, const DriverOptions& options = {});
+
+	// Preprocess a prefix header, and snapshot the state
+	// returns nullptr if the translation is aborted or the file cannot be opened
+	PrecompiledHeader::Ptr PrecompileFile(const std::string& filename, SourceManager& src);
+}
\ No newline at end of file
@@ -1,32 +1,112 @@
-#include "SourceLexer.h"
-#include "Preprocessor.h"
-#include "Parser.h"
+#include "Driver.h"
+#include "Benchmark.h"
+#include <optional>
 #include <vector>
 
-int main()
+int main(int argc, char** argv)
 {
 	using namespace std;
 	using namespace lolita;
 
-	auto file = SourceFile::Open("test.c", "C:\\Users\\Edward Cheng\\Desktop\\test.c");
-	auto lex_result = LexSourceFile(file.get());
+	auto files = vector<string>(argv + 1, argv + argc);
+	if (!files.empty() && files.front() == "--benchmark-lexer")
+	{
+		BenchmarkLexer(vector<string>(files.begin() + 1, files.end()));
+		return 0;
+	}
+
+	if (files.size() == 1 && files.front() == "--benchmark-macro")
+	{
+		BenchmarkMacroExpansion();
+		return 0;
+	}
+
+	if (files.size() == 1 && files.front() == "--benchmark-expr")
+	{
+		BenchmarkExpressionParser();
+		return 0;
+	}
+
+	if (files.size() == 1 && files.front() == "--benchmark-scope")
+	{
+		BenchmarkNestedScopes();
+		return 0;
+	}
 
 	auto src = SourceManager{};
-	auto diag = DiagonisticClient{};
-	InitTranslation(src, diag);
+	if (files.size() == 3 && files.front() == "--create-pch")
+	{
+		// --create-pch <output> <header>
+		auto pch = PrecompileFile(files[2], src);
+		return pch && pch->Save(files[1]) ? 0 : 1;
+	}
 
-	auto cpp = Preprocessor{ };
-	auto cpp_result = cpp.Preprocess(lex_result);
+	auto options = DriverOptions{};
+	auto pch = PrecompiledHeader::Ptr{};
+	if (files.size() >= 2 && files.front() == "--pch")
+	{
+		// --pch <file> <sources...>
+		pch = PrecompiledHeader::Load(files[1]);
+		if (!pch)
+		{
+			printf("cannot load precompiled header %s\n", files[1].c_str());
+			return 1;
+		}
 
-	// auto parse_tree = ParseTranslationUnit(cpp_result);
+		options.Precompiled = pch.get();
+		files.erase(files.begin(), files.begin() + 2);
+	}
 
-	for (const auto& tok : cpp_result)
+	// -ftime-report[=json] prints statistics of each translation unit to stderr
+	auto report = optional<StatsFormat>{};
+	for (auto it = files.begin(); it != files.end();)
 	{
-		auto filename = std::string{ tok.Location.File->Name() };
-		printf("tok@[line %u; column %u; file %s]: %s\n", tok.Location.Line, tok.Location.Column, filename.c_str(), tok.Content.c_str());
+		if (*it == "-ftime-report" || *it == "-ftime-report=table")
+		{
+			report = StatsFormat::Table;
+		}
+		else if (*it == "-ftime-report=json")
+		{
+			report = StatsFormat::Json;
+		}
+		else
+		{
+			++it;
+			continue;
+		}
+
+		it = files.erase(it);
 	}
 
-	FinalizeTranslation();
+	options.Instrument = report.has_value();
+
+	if (files.empty())
+	{
+		files.push_back("C:\\Users\\Edward Cheng\\Desktop\\test.c");
+	}
+
+	auto results = TranslateFiles(files, src, options);
+
+	if (report)
+	{
+		auto stats = vector<TranslationStats>{};
+		for (const auto& result : results)
+		{
+			stats.push_back(result.Stats);
+		}
+
+		PrintTranslationStats(stats, *report, stderr);
+	}
+
+	for (const auto& result : results)
+	{
+		for (size_t i = 0; i < result.Tokens.Size(); ++i)
+		{
+			auto tok = result.Tokens[i];
+			auto filename = std::string{ tok.Location.File->Name() };
+			printf("tok@[line %u; column %u; file %s]: %.*s\n", tok.Location.Line, tok.Location.Column, filename.c_str(), static_cast<int>(tok.Content.size()), tok.Content.data());
+		}
+	}
 
 	system("pause");
 	return 0;
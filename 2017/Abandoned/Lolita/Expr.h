@@ -1,5 +1,6 @@
 #pragma once
 #include "AstObject.h"
+#include "Type.h"
 #include "Literal.h"
 
 namespace lolita
@@ -82,6 +83,7 @@ namespace lolita
 
 	class UnaryExpr : public ExprBase
 	{
+	public:
 		UnaryExpr(UnaryOp op, ExprBase* expr)
 			: op_(op), expr_(expr) 
 		{
@@ -158,7 +160,7 @@ namespace lolita
 	class CommaExpr : public ExprBase
 	{
 	public:
-		CommaExpr(const std::vector<ExprBase*>& list)
+		CommaExpr(ArenaArray<ExprBase*> list)
 			: seq_(list)
 		{
 			assert(!list.empty());
@@ -169,7 +171,7 @@ namespace lolita
 		void Accept(ExprVisitor&) override;
 
 	private:
-		std::vector<ExprBase*> seq_;
+		ArenaArray<ExprBase*> seq_;
 	};
 
 	class AccessExpr : public ExprBase
@@ -195,16 +197,19 @@ namespace lolita
 	class InvokeExpr : public ExprBase
 	{
 	public:
-		InvokeExpr(ExprBase* func, const std::vector<ExprBase*>& args)
+		InvokeExpr(ExprBase* func, ArenaArray<ExprBase*> args)
 			: callee_(func), args_(args)
 		{
 			assert(func != nullptr);
 		}
 
+		auto Callee() const { return callee_; }
+		const auto& Args() const { return args_; }
+
 		void Accept(ExprVisitor&) override;
 	private:
 		ExprBase *callee_;
-		std::vector<ExprBase*> args_;
+		ArenaArray<ExprBase*> args_;
 	};
 
 	class SubscriptExpr : public ExprBase
@@ -216,6 +221,9 @@ namespace lolita
 			assert(data != nullptr && index != nullptr);
 		}
 
+		auto Object() const { return object_; }
+		auto Index() const { return index_; }
+
 		void Accept(ExprVisitor&) override;
 	private:
 		ExprBase* object_;
@@ -0,0 +1,169 @@
+#include "HeaderCache.h"
+#include "SourceLexer.h"
+#include "TranslationContext.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace lolita
+{
+	// returns symbol of the directive name if a preprocessing directive starts at $i
+	static SymbolId PeekDirective(const TokenVec& toks, size_t i)
+	{
+		// NOTE toks[i + 1] is always valid for a non-EndOfFile toks[i]
+		if (toks[i].Tag == TokenTag::Sharp && toks[i].StartOfLine
+			&& toks[i + 1].Tag == TokenTag::Identifier && !toks[i + 1].StartOfLine)
+		{
+			return toks[i + 1].Symbol;
+		}
+
+		return kInvalidSymbol;
+	}
+
+	// returns index of the first token in the next line
+	static size_t SkipLine(const TokenVec& toks, size_t i)
+	{
+		do
+		{
+			i += 1;
+		} while (!toks[i].StartOfLine);
+
+		return i;
+	}
+
+	// Implementation of HeaderFile
+	//
+
+	HeaderFile::HeaderFile(SourceFile::Ptr file)
+		: file_(move(file))
+	{
+		tokens_ = LexSourceFile(file_.get());
+
+		for (const auto& tok : tokens_)
+		{
+			if (tok.Tag == TokenTag::Identifier)
+				symbols_.push_back(tok.Symbol);
+		}
+
+		sort(symbols_.begin(), symbols_.end());
+		symbols_.erase(unique(symbols_.begin(), symbols_.end()), symbols_.end());
+
+		DetectGuard();
+	}
+
+	// detect #pragma once, and the include guard that wraps the whole file, i.e.
+	//   #ifndef GUARD
+	//   ...
+	//   #endif
+	void HeaderFile::DetectGuard()
+	{
+		const auto& toks = tokens_;
+
+		// #ifndef GUARD must be the first line
+		auto guarded = PeekDirective(toks, 0) == kSymbolIfndef
+			&& toks[2].Tag == TokenTag::Identifier
+			&& !toks[2].StartOfLine
+			&& toks[3].StartOfLine;
+
+		auto depth = 0;
+		auto guard_end = size_t{ 0 };
+		for (auto i = size_t{ 0 }; toks[i].Tag != TokenTag::EndOfFile; i = SkipLine(toks, i))
+		{
+			// something follows the #endif closing the first line
+			if (guard_end != 0)
+				guarded = false;
+
+			switch (PeekDirective(toks, i))
+			{
+			case KeywordSymbol(TokenTag::If):
+			case kSymbolIfdef:
+			case kSymbolIfndef:
+				depth += 1;
+				break;
+			case kSymbolEndif:
+				if (depth > 0 && --depth == 0 && guard_end == 0)
+					guard_end = i;
+				break;
+			case kSymbolPragma:
+				if (depth <= (guarded ? 1 : 0)
+					&& toks[i + 2].Symbol == kSymbolOnce && !toks[i + 2].StartOfLine)
+				{
+					pragma_once_ = true;
+				}
+				break;
+			}
+		}
+
+		if (guarded && guard_end != 0)
+		{
+			guard_ = toks[2].Symbol;
+
+			// copy the guarded group, and keep it ended with EndOfFile
+			body_.assign(toks.begin() + 3, toks.begin() + guard_end);
+			body_.push_back(toks.back());
+		}
+	}
+
+	shared_ptr<const PreprocessedHeader> HeaderFile::LoadPreprocessed() const
+	{
+		lock_guard<mutex> lock{ mutex_ };
+		return preprocessed_;
+	}
+
+	void HeaderFile::StorePreprocessed(shared_ptr<const PreprocessedHeader> result) const
+	{
+		lock_guard<mutex> lock{ mutex_ };
+		preprocessed_ = move(result);
+	}
+
+	// Implementation of HeaderCache
+	//
+
+	const HeaderFile* HeaderCache::Lookup(const string& name, string_view includer, SourceManager& src)
+	{
+		// NOTE the same spelling may refer to different files for different SourceManagers,
+		//      and the same file may be modified between translations
+		auto url = src.ResolvePath(name, includer);
+		if (url.empty())
+			return nullptr;
+
+		auto key = Key{ url, GetLastWriteTime(url) };
+		if (key.second == -1)
+			return nullptr;
+
+		Entry* entry;
+		{
+			lock_guard<mutex> lock{ mutex_ };
+
+			auto& slot = entries_[key];
+			if (!slot)
+				slot = make_unique<Entry>();
+
+			entry = slot.get();
+		}
+
+		// open and lex the file without holding the lock
+		call_once(entry->Flag, [&]() {
+			// NOTE a header is lexed once, which is counted by the translation lexing it
+			auto stats = GetTranslationStats();
+			auto timer = PhaseTimer{ stats, Phase::Lexing };
+
+			// NOTE the header outlives the translation, so it's read rather than mapped
+			auto file = SourceFile::Load(name, url);
+			if (file)
+				entry->Header = make_unique<HeaderFile>(move(file));
+
+			if (stats && entry->Header)
+				(*stats)[Phase::Lexing].Tokens += entry->Header->Tokens().size();
+		});
+
+		return entry->Header.get();
+	}
+
+	HeaderCache& GetHeaderCache()
+	{
+		static HeaderCache cache;
+		return cache;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+#include "Token.h"
+#include "TokenBuffer.h"
+#include "Symbol.h"
+#include "SourceFile.h"
+#include "SourceManager.h"
+#include "MacroEngine.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lolita
+{
+	class HeaderFile;
+
+	// Preprocessing result of a header, which does not depend on the macro state
+	// of the includer as long as none of Symbols is defined at the inclusion
+	struct PreprocessedHeader
+	{
+		// finalized tokens yielded, without EndOfFile
+		TokenBuffer Tokens;
+
+		// identifiers appearing in the header and in those included, sorted
+		std::vector<SymbolId> Symbols;
+
+		// macros remaining defined after the inclusion
+		std::vector<std::shared_ptr<const MacroDescription>> Macros;
+
+		// headers with #pragma once entered during the inclusion
+		std::vector<const HeaderFile*> OnceHeaders;
+	};
+
+	// A lexed header, which is shared among translation units
+	class HeaderFile
+	{
+	public:
+		HeaderFile(SourceFile::Ptr file);
+
+		HeaderFile(const HeaderFile&) = delete;
+		HeaderFile& operator=(const HeaderFile&) = delete;
+
+		const SourceFile* File() const { return file_.get(); }
+
+		// tokens of the file
+		const TokenVec& Tokens() const { return tokens_; }
+
+		// tokens wrapped by the include guard, or of the whole file if not guarded
+		const TokenVec& Body() const { return guard_ != kInvalidSymbol ? body_ : tokens_; }
+
+		// controlling macro of the include guard, kInvalidSymbol if not guarded
+		SymbolId Guard() const { return guard_; }
+
+		// if the file contains #pragma once
+		bool PragmaOnce() const { return pragma_once_; }
+
+		// identifiers appearing in the file, sorted
+		const std::vector<SymbolId>& Symbols() const { return symbols_; }
+
+		std::shared_ptr<const PreprocessedHeader> LoadPreprocessed() const;
+		void StorePreprocessed(std::shared_ptr<const PreprocessedHeader> result) const;
+
+	private:
+		void DetectGuard();
+
+		SourceFile::Ptr file_;
+		TokenVec tokens_;
+
+		SymbolId guard_ = kInvalidSymbol;
+		TokenVec body_;
+
+		bool pragma_once_ = false;
+		std::vector<SymbolId> symbols_;
+
+		mutable std::mutex mutex_;
+		mutable std::shared_ptr<const PreprocessedHeader> preprocessed_;
+	};
+
+	// The process-wide storage of lexed headers, keyed by the path HeaderName resolves to
+	// and the last write time of the file, so that a file modified is lexed again
+	// NOTE headers are kept until the process exits, as tokens of macros may refer to them,
+	//      including those of a file modified since, so their content is read into memory owned
+	//      rather than mapped, which a file truncated or rewritten in place would change
+	class HeaderCache
+	{
+	public:
+		// $includer is the url of the file including the header, see SourceManager::ResolvePath
+		// returns nullptr if the file cannot be opened
+		const HeaderFile* Lookup(const std::string& name, std::string_view includer, SourceManager& src);
+
+	private:
+		struct Entry
+		{
+			std::once_flag Flag;
+			std::unique_ptr<HeaderFile> Header;
+		};
+
+		// path and last write time of a file
+		using Key = std::pair<std::string, int64_t>;
+
+		std::mutex mutex_;
+		std::map<Key, std::unique_ptr<Entry>> entries_;
+	};
+
+	HeaderCache& GetHeaderCache();
+}
\ No newline at end of file
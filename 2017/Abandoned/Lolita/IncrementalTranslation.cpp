@@ -0,0 +1,347 @@
+#include "IncrementalTranslation.h"
+#include "ParserImpl.h"
+#include "Error.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace lolita
+{
+	// nodes of declarations replaced are reclaimed by parsing again, once this many arenas pile up
+	static constexpr size_t kMaxArenaCount = 16;
+
+	// if any token in [begin, end) of $tokens is of $tag
+	static bool ContainsTag(const TokenBuffer& tokens, size_t begin, size_t end, TokenTag tag)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			if (tokens.Tag(i) == tag)
+				return true;
+		}
+
+		return false;
+	}
+
+	IncrementalTranslation::IncrementalTranslation(SourceFile::Ptr file, SourceManager& src, const DriverOptions& options)
+		: file_(move(file)), options_(options)
+	{
+		InitTranslation(src, diag_);
+
+		try
+		{
+			lexed_ = LexSourceFile(file_.get());
+			Preprocess();
+
+			if (options_.Parse)
+				Parse();
+		}
+		catch (...)
+		{
+			// AbortTranslation and the parser throw to stop a translation
+			aborted_ = true;
+		}
+
+		ctx_ = SuspendTranslation();
+	}
+
+	IncrementalTranslation::~IncrementalTranslation()
+	{
+		ResumeTranslation(ctx_);
+		FinalizeTranslation();
+	}
+
+	IncrementalTranslation::Ptr IncrementalTranslation::Open(const string& filename, SourceManager& src, const DriverOptions& options)
+	{
+		auto file = SourceFile::Open(filename, filename);
+		if (!file)
+			return nullptr;
+
+		return Ptr{ new IncrementalTranslation{ move(file), src, options } };
+	}
+
+	bool IncrementalTranslation::Edit(const SourceEdit& edit)
+	{
+		auto clamped = file_->ClampEdit(edit);
+		auto previous = move(file_);
+		file_ = SourceFile::Edited(*previous, clamped);
+
+		last_edit_ = EditSummary{ { 0, lexed_.size(), 0 }, true, options_.Parse, 0 };
+
+		ResumeTranslation(ctx_);
+		try
+		{
+			if (aborted_)
+			{
+				// nothing is reliable after an aborted translation, so start over
+				aborted_ = false;
+
+				lexed_ = LexSourceFile(file_.get());
+				last_edit_.Lexed.End = lexed_.size();
+
+				Preprocess();
+				if (options_.Parse)
+					Parse();
+			}
+			else
+			{
+				auto eof_line = lexed_.back().Location.Line;
+				last_edit_.Lexed = RelexSourceFile(file_.get(), previous.get(), lexed_, clamped);
+
+				// NOTE lines after the edit are moved by the same delta
+				auto line_delta = static_cast<int32_t>(lexed_.back().Location.Line - eof_line);
+
+				auto output = TokenEdit{};
+				auto typedef_removed = false;
+				if (TryPatchTokens(previous.get(), clamped, last_edit_.Lexed, line_delta, output, typedef_removed))
+				{
+					last_edit_.Repreprocessed = false;
+					if (options_.Parse && !typedef_removed && TryReparse(output))
+						last_edit_.Reparsed = false;
+					else if (options_.Parse)
+						Parse();
+				}
+				else
+				{
+					Preprocess();
+					if (options_.Parse)
+						Parse();
+				}
+			}
+		}
+		catch (...)
+		{
+			aborted_ = true;
+		}
+
+		ctx_ = SuspendTranslation();
+		return !aborted_;
+	}
+
+	void IncrementalTranslation::Preprocess()
+	{
+		// diagnostics are reported again
+		diag_.Clear();
+
+		auto cpp = Preprocessor{};
+		if (options_.Precompiled)
+		{
+			cpp.Restore(*options_.Precompiled);
+		}
+
+		tokens_ = cpp.Preprocess(lexed_, &trace_);
+	}
+
+	void IncrementalTranslation::Parse()
+	{
+		// NOTE declarations are not kept if the parser throws, as its arena is gone
+		decls_.clear();
+		arenas_.clear();
+
+		auto src = TokenBufferSource{ tokens_ };
+		auto parser = ParserImpl{ src };
+		auto parsed = vector<TopLevelDecl>{};
+		try
+		{
+			for (auto decl = parser.ParseTopLevelDecl(); decl.Decl; decl = parser.ParseTopLevelDecl())
+			{
+				parsed.push_back(decl);
+			}
+		}
+		catch (const ParsingError&)
+		{
+			AbortTranslation();
+		}
+
+		arenas_.push_back(parser.ReleaseArena());
+		decls_ = move(parsed);
+		last_edit_.ParsedDecls = decls_.size();
+	}
+
+	// patch preprocessed tokens for an edit that does not change the preprocessing state
+	// i.e. tokens replaced and inserted are copied as is, and they involve no macro
+	bool IncrementalTranslation::TryPatchTokens(const SourceFile* previous, const SourceEdit& edit,
+		const TokenEdit& lexed, int32_t line_delta, TokenEdit& output, bool& typedef_removed)
+	{
+		auto& copies = trace_.Copies;
+
+		// NOTE EndOfFile is only replaced if the file is lexed to the end differently
+		if (lexed.PreviousEnd >= copies.size())
+			return false;
+
+		auto is_macro = [&](const Token& tok) {
+			return tok.Tag == TokenTag::Identifier
+				&& binary_search(trace_.Macros.begin(), trace_.Macros.end(), tok.Symbol);
+		};
+
+		// tokens replaced, and those around, must be copied as is and contiguously
+		// NOTE a function-like macro before could be invoked by a '(' inserted
+		auto first = lexed.Begin > 0 ? lexed.Begin - 1 : lexed.Begin;
+		if (first < lexed.Begin && is_macro(lexed_[first]))
+			return false;
+
+		for (auto i = first; i <= lexed.PreviousEnd; ++i)
+		{
+			if (copies[i] == kNotCopied || (i > first && copies[i] != copies[i - 1] + 1))
+				return false;
+		}
+
+		// tokens inserted would be copied as is
+		for (auto i = lexed.Begin; i < lexed.End; ++i)
+		{
+			switch (lexed_[i].Tag)
+			{
+			case TokenTag::Sharp:
+			case TokenTag::SharpSharp:
+			case TokenTag::InvalidChar:
+			case TokenTag::HeaderName:
+			case TokenTag::BadHeaderName:
+				return false;
+			default:
+				if (is_macro(lexed_[i]))
+					return false;
+			}
+		}
+
+		// __LINE__ expanded after the edit would be moved
+		if (line_delta != 0)
+		{
+			for (auto i = lexed.End; i < lexed_.size(); ++i)
+			{
+				if (lexed_[i].Symbol == kSymbolBuiltinLine)
+					return false;
+			}
+		}
+
+		auto begin = copies[first] + (first < lexed.Begin ? 1 : 0);
+		auto previous_end = copies[lexed.PreviousEnd];
+
+		typedef_removed = ContainsTag(tokens_, begin, previous_end, TokenTag::Typedef);
+
+		// refine tokens inserted as the preprocessor does for a copy
+		// NOTE the line offset by #line is the same as of the token before
+		auto line_offset = int64_t{ 0 };
+		if (first < lexed.Begin)
+			line_offset = int64_t{ tokens_.Location(begin - 1).Line } - lexed_[first].Location.Line;
+
+		auto inserted = TokenVec(lexed_.begin() + lexed.Begin, lexed_.begin() + lexed.End);
+		for (auto& tok : inserted)
+		{
+			tok.Location.Line = static_cast<uint32_t>(tok.Location.Line + line_offset);
+			if (tok.Tag == TokenTag::Identifier)
+				tok.Tag = TranslateKeyword(tok.Symbol);
+		}
+
+		// move tokens kept onto the edited file, and splice those inserted
+		tokens_.Erase(begin, previous_end);
+		tokens_.Rebase(file_.get(), previous, edit, line_delta);
+		tokens_.Insert(begin, inserted);
+
+		output = TokenEdit{ begin, previous_end, begin + inserted.size() };
+
+		// update the trace for tokens moved
+		// NOTE the shift wraps around if tokens are removed, which is fine for unsigned arithmetic
+		auto shift = output.End - output.PreviousEnd;
+		copies.erase(copies.begin() + lexed.Begin, copies.begin() + lexed.PreviousEnd);
+		copies.insert(copies.begin() + lexed.Begin, inserted.size(), kNotCopied);
+		for (auto i = size_t{ 0 }; i < inserted.size(); ++i)
+		{
+			copies[lexed.Begin + i] = begin + i;
+		}
+		for (auto i = lexed.End; i < copies.size(); ++i)
+		{
+			if (copies[i] != kNotCopied)
+				copies[i] += shift;
+		}
+
+		return true;
+	}
+
+	// parse only declarations affected by an edit of preprocessed tokens
+	// returns false if the edit may change how the others are parsed, e.g. by a typedef
+	bool IncrementalTranslation::TryReparse(const TokenEdit& output)
+	{
+		if (arenas_.size() >= kMaxArenaCount)
+			return false;
+
+		// nothing to parse if no token is replaced, as nodes do not refer to tokens
+		if (output.Begin == output.End && output.Begin == output.PreviousEnd)
+			return true;
+
+		// the first declaration affected, including one that ends right before the edit
+		auto first = static_cast<size_t>(lower_bound(decls_.begin(), decls_.end(), output.Begin,
+			[](const TopLevelDecl& decl, size_t offset) { return decl.End < offset; }) - decls_.begin());
+
+		auto start = size_t{ 0 };
+		if (first < decls_.size() && decls_[first].Begin <= output.Begin)
+			start = decls_[first].Begin;
+		else if (first > 0)
+			start = decls_[first - 1].End;
+
+		// parse until a declaration after the edit ends where an old one did
+		// as tokens after it are the same, the rest of old declarations are still valid
+		// NOTE the shift wraps around if tokens are removed, which is fine for unsigned arithmetic
+		auto shift = output.End - output.PreviousEnd;
+		auto src = TokenBufferSource{ tokens_ };
+		src.Seek(start);
+
+		auto parser = ParserImpl{ src };
+		auto parsed = vector<TopLevelDecl>{};
+		auto synced = first;
+
+		// names declared before are visible to declarations reparsed
+		for (auto i = size_t{ 0 }; i < first; ++i)
+		{
+			parser.RedeclareTopLevel(decls_[i].Decl);
+		}
+
+		try
+		{
+			for (;;)
+			{
+				auto decl = parser.ParseTopLevelDecl();
+				if (!decl.Decl)
+				{
+					synced = decls_.size();
+					break;
+				}
+
+				parsed.push_back(decl);
+				if (decl.End >= output.End)
+				{
+					while (synced < decls_.size() && decls_[synced].End + shift < decl.End)
+						synced += 1;
+
+					if (synced < decls_.size() && decls_[synced].End + shift == decl.End)
+					{
+						synced += 1;
+						break;
+					}
+				}
+			}
+		}
+		catch (const ParsingError&)
+		{
+			AbortTranslation();
+		}
+
+		// a typedef changes how the following declarations are parsed
+		auto parsed_end = parsed.empty() ? start : parsed.back().End;
+		if (ContainsTag(tokens_, start, parsed_end, TokenTag::Typedef))
+			return false;
+
+		// splice the declarations parsed, and move the rest
+		for (auto i = synced; i < decls_.size(); ++i)
+		{
+			decls_[i].Begin += shift;
+			decls_[i].End += shift;
+		}
+
+		decls_.erase(decls_.begin() + first, decls_.begin() + synced);
+		decls_.insert(decls_.begin() + first, parsed.begin(), parsed.end());
+
+		arenas_.push_back(parser.ReleaseArena());
+		last_edit_.ParsedDecls = parsed.size();
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+#include "Token.h"
+#include "TokenBuffer.h"
+#include "SourceFile.h"
+#include "SourceManager.h"
+#include "SourceLexer.h"
+#include "Preprocessor.h"
+#include "Parser.h"
+#include "Driver.h"
+#include "DiagonisticClient.h"
+#include "TranslationContext.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lolita
+{
+	// How the last edit is translated
+	struct EditSummary
+	{
+		// tokens of the file relexed, excluding those lexed the same as before
+		TokenEdit Lexed;
+
+		// if the file is preprocessed again, instead of only the tokens edited
+		bool Repreprocessed;
+
+		// if the translation unit is parsed again, instead of only the declarations affected
+		bool Reparsed;
+
+		// declarations parsed for the edit
+		size_t ParsedDecls;
+	};
+
+	// A translation unit kept alive across edits of its file
+	// an edit only relexes the lines around it, and if the preprocessing state is not changed,
+	// i.e. no directive or macro is involved, only top-level declarations affected are parsed
+	// NOTE the translation context is suspended between edits, so an instance could be used
+	//      on any thread with no other translation in progress, but by one thread at a time
+	class IncrementalTranslation
+	{
+	public:
+		using Ptr = std::unique_ptr<IncrementalTranslation>;
+
+		IncrementalTranslation(const IncrementalTranslation&) = delete;
+		IncrementalTranslation& operator=(const IncrementalTranslation&) = delete;
+
+		~IncrementalTranslation();
+
+		// returns nullptr if the file cannot be opened
+		static Ptr Open(const std::string& filename, SourceManager& src, const DriverOptions& options = {});
+
+		// apply an edit on the current content of the file
+		// returns false if the translation is aborted, which is started over by the next edit
+		bool Edit(const SourceEdit& edit);
+
+		const SourceFile* File() const { return file_.get(); }
+
+		// preprocessed tokens, ends with EndOfFile
+		const TokenBuffer& Tokens() const { return tokens_; }
+
+		// empty if not parsed
+		const std::vector<TopLevelDecl>& Decls() const { return decls_; }
+
+		// diagnostics since the file is preprocessed the last time
+		// NOTE locations are not updated for edits translated incrementally
+		const std::vector<std::string>& Diagnostics() const { return diag_.Messages(); }
+
+		bool Aborted() const { return aborted_; }
+
+		const EditSummary& LastEdit() const { return last_edit_; }
+
+	private:
+		IncrementalTranslation(SourceFile::Ptr file, SourceManager& src, const DriverOptions& options);
+
+		void Preprocess();
+		void Parse();
+
+		bool TryPatchTokens(const SourceFile* previous, const SourceEdit& edit,
+			const TokenEdit& lexed, int32_t line_delta, TokenEdit& output, bool& typedef_removed);
+		bool TryReparse(const TokenEdit& output);
+
+		SourceFile::Ptr file_;
+		DriverOptions options_;
+
+		DiagonisticClient diag_{ true };
+		TranslationContext* ctx_;
+
+		// tokens of the file, and how they are preprocessed
+		TokenVec lexed_;
+		PreprocessTrace trace_;
+
+		TokenBuffer tokens_;
+
+		// arenas where nodes of decls_ are allocated, the latest last
+		// NOTE nodes of declarations replaced are kept until the translation unit is parsed again
+		std::vector<AstArena> arenas_;
+		std::vector<TopLevelDecl> decls_;
+
+		bool aborted_ = false;
+		EditSummary last_edit_ = {};
+	};
+}
\ No newline at end of file
@@ -2,12 +2,171 @@
 #include "Error.h"
 #include "TextUtils.h"
 #include "TranslationContext.h"
+#include "StringPool.h"
+#include "Symbol.h"
 #include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOLITA_LEXER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace std;
 
 namespace lolita
 {
+	// Character Classification
+	//
+
+	enum CharClass : uint8_t
+	{
+		// [A-Za-z0-9_], and any non-ASCII character
+		kCharIdentifier = 1,
+
+		// whitespace except newline
+		kCharSpace = 2,
+	};
+
+	static constexpr array<uint8_t, 256> MakeCharClassTable()
+	{
+		auto result = array<uint8_t, 256>{};
+		for (int ch = 0; ch < 256; ++ch)
+		{
+			if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')
+				|| (ch >= '0' && ch <= '9') || ch == '_' || ch >= 0x80)
+			{
+				result[ch] |= kCharIdentifier;
+			}
+			if (ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f' || ch == '\r')
+			{
+				result[ch] |= kCharSpace;
+			}
+		}
+
+		return result;
+	}
+
+	static constexpr auto kCharClassTable = MakeCharClassTable();
+
+	static bool TestCharClass(char ch, CharClass cls)
+	{
+		return (kCharClassTable[static_cast<uint8_t>(ch)] & cls) != 0;
+	}
+
+	// Bulk Scanning
+	//
+	// NOTE none of the scanners passes a backslash, so a line connection
+	//      is only handled where a backslash actually presents
+
+#ifdef LOLITA_LEXER_SSE2
+	static unsigned CountTrailingZero(unsigned x)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, x);
+		return index;
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+
+	static __m128i TestRange(__m128i v, char lo, char hi)
+	{
+		// NOTE non-ASCII characters are negative, so they never fall in an ASCII range
+		return _mm_and_si128(
+			_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+			_mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+	}
+#endif
+
+	// returns length of the leading identifier characters in $s
+	static size_t ScanIdentifier(string_view s)
+	{
+		size_t i = 0;
+
+#ifdef LOLITA_LEXER_SSE2
+		for (; i + 16 <= s.size(); i += 16)
+		{
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+			auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+			auto accept = _mm_or_si128(
+				_mm_or_si128(TestRange(lower, 'a', 'z'), TestRange(v, '0', '9')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+			// sign bits of v are non-ASCII characters
+			auto mask = static_cast<unsigned>(_mm_movemask_epi8(accept) | _mm_movemask_epi8(v));
+			if (mask != 0xffff)
+				return i + CountTrailingZero(~mask);
+		}
+#endif
+
+		while (i < s.size() && TestCharClass(s[i], kCharIdentifier))
+			i += 1;
+
+		return i;
+	}
+
+	// returns length of the leading whitespace except newline in $s
+	static size_t ScanSpace(string_view s)
+	{
+		size_t i = 0;
+
+#ifdef LOLITA_LEXER_SSE2
+		for (; i + 16 <= s.size(); i += 16)
+		{
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+			auto accept = _mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+				TestRange(v, '\t', '\r'));
+
+			// NOTE newline is in the range of [\t, \r]
+			accept = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), accept);
+
+			auto mask = static_cast<unsigned>(_mm_movemask_epi8(accept));
+			if (mask != 0xffff)
+				return i + CountTrailingZero(~mask);
+		}
+#endif
+
+		while (i < s.size() && TestCharClass(s[i], kCharSpace))
+			i += 1;
+
+		return i;
+	}
+
+	// returns length of the leading characters in $s that are neither $a nor $b
+	static size_t ScanUntil(string_view s, char a, char b)
+	{
+		size_t i = 0;
+
+#ifdef LOLITA_LEXER_SSE2
+		auto va = _mm_set1_epi8(a);
+		auto vb = _mm_set1_epi8(b);
+		for (; i + 16 <= s.size(); i += 16)
+		{
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+			auto hit = _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb));
+
+			auto mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+			if (mask != 0)
+				return i + CountTrailingZero(mask);
+		}
+#endif
+
+		while (i < s.size() && s[i] != a && s[i] != b)
+			i += 1;
+
+		return i;
+	}
+
 	// Implementation of Lexer
 	//
 
@@ -22,12 +181,14 @@ namespace lolita
 		while (!window_.empty())
 		{
 			auto ch = Peek();
-			if (isspace(ch))
+			if (ch == '\n')
 			{
 				Consume();
-
-				if (ch == '\n')
-					start_of_line_ = true;
+				start_of_line_ = true;
+			}
+			else if (TestCharClass(ch, kCharSpace))
+			{
+				ConsumeBulk(ScanSpace(window_));
 			}
 			else if (ch == '/')
 			{
@@ -55,15 +216,27 @@ namespace lolita
 	void Lexer::SkipSingleLineComment()
 	{
 		// assume "//" consumed
-		while (TryPred([](char ch) { return ch != '\n'; })) {}
+		while (!window_.empty())
+		{
+			ConsumeBulk(ScanUntil(window_, '\n', '\\'));
+			if (window_.empty() || Peek() == '\n')
+				return;
+
+			// a backslash that does not connect lines
+			Consume();
+		}
 	}
 
 	void Lexer::SkipBlockComment()
 	{
 		// assume "/*" consumed
 
-		while (!Exhausted())
+		while (!window_.empty())
 		{
+			ConsumeBulk(ScanUntil(window_, '*', '\\'));
+			if (window_.empty())
+				break;
+
 			if (Peek() == '*' && TrySeq("*/"))
 				return;
 
@@ -193,10 +366,13 @@ namespace lolita
 				return ExportToken(TokenTag::Greater);
 
 		case '!':
-			return ExportToken(TokenTag::Exclamation);
+			if (Try('='))
+				return ExportToken(TokenTag::Unequal);
+			else
+				return ExportToken(TokenTag::Exclamation);
 
 		case '.':
-			if (TryPred(isdigit))
+			if (TryPred(::isdigit))
 				return LexPPNumber(false);
 			else if (TrySeq(".."))
 				return ExportToken(TokenTag::Ellipsis);
@@ -306,7 +482,7 @@ namespace lolita
 				int_hint = false;
 				continue;
 			}
-			else if (TryPred(isalnum))
+			else if (TryPred(::isalnum))
 			{
 				continue;
 			}
@@ -368,12 +544,10 @@ namespace lolita
 	{
 		// assume first character consumed
 
-		while (char ch = Peek())
+		// NOTE an identifier may continue after a line connection
+		while (auto n = ScanIdentifier(window_))
 		{
-			if (ch == '_' || isalnum(ch) || ch & 0x80)
-				Consume();
-			else
-				break;
+			ConsumeBulk(n);
 		}
 
 		return ExportToken(TokenTag::Identifier);
@@ -409,10 +583,10 @@ namespace lolita
 		auto consumed_len = checkpoint_view_.length() - window_.length();
 		auto consumed_view = checkpoint_view_.substr(0, consumed_len);
 
+		auto buf = string{};
 		if (dirty_)
 		{
 			// cleanup dirty content
-			auto buf = string{};
 			bool escaped = false;
 			for (auto ch : consumed_view)
 			{
@@ -424,14 +598,49 @@ namespace lolita
 				escaped = (ch == '\\');
 			}
 
-			return Token{ tag, buf, checkpoint_loc_, start_of_line_, succeeding_space_ };
+			consumed_view = buf;
+		}
+
+		if (tag == TokenTag::Identifier)
+		{
+			// identifiers are interned, and share the text in the symbol table
+			auto symbol = InternIdentifier(consumed_view);
+			return Token{ tag, SymbolText(symbol), checkpoint_loc_, start_of_line_, succeeding_space_, symbol };
+		}
+		else if (dirty_)
+		{
+			// spliced text is not in the source, so keep it in the pool
+			return Token{ tag, InternString(consumed_view), checkpoint_loc_, start_of_line_, succeeding_space_ };
 		}
 		else
 		{
-			return Token{ tag, string{ consumed_view }, checkpoint_loc_, start_of_line_, succeeding_space_ };
+			// zero-copy, refer to the source text directly
+			return Token{ tag, consumed_view, checkpoint_loc_, start_of_line_, succeeding_space_ };
 		}
 	}
 
+	SymbolId Lexer::InternIdentifier(string_view text)
+	{
+		if (!symbol_cache_)
+			return InternSymbol(text);
+
+		// FNV-1a, which is cheap for short identifiers
+		auto hash = uint32_t{ 2166136261 };
+		for (auto ch : text)
+		{
+			hash = (hash ^ static_cast<uint8_t>(ch)) * 16777619;
+		}
+
+		auto& entry = symbol_cache_[hash % kSymbolCacheSize];
+		if (entry.Symbol == kInvalidSymbol || entry.Text != text)
+		{
+			entry.Symbol = InternSymbol(text);
+			entry.Text = SymbolText(entry.Symbol);
+		}
+
+		return entry.Symbol;
+	}
+
 	char Lexer::Consume()
 	{
 		// consume the next character
@@ -457,4 +666,29 @@ namespace lolita
 		// yield what is consumed
 		return result;
 	}
+
+	void Lexer::ConsumeBulk(size_t n)
+	{
+		auto text = window_.substr(0, n);
+		assert(text.find('\\') == string_view::npos);
+
+		window_.remove_prefix(n);
+
+		// update location
+		loc_.Index += static_cast<uint32_t>(n);
+
+		auto last_newline = text.rfind('\n');
+		if (last_newline != string_view::npos)
+		{
+			loc_.Column = 1;
+			loc_.Line += static_cast<uint32_t>(count(text.begin(), text.end(), '\n'));
+			text.remove_prefix(last_newline + 1);
+		}
+
+		auto tab_count = count(text.begin(), text.end(), '\t');
+		loc_.Column += static_cast<uint32_t>(text.size() + tab_count * (kLexerTabSize - 1));
+
+		// prepare for next consumption
+		SkipLineConnect();
+	}
 }
\ No newline at end of file
@@ -2,7 +2,9 @@
 #include "CompilerConfig.h"
 #include "Token.h"
 #include "SourceLocation.h"
+#include "Symbol.h"
 #include "TextUtils.h"
+#include <memory>
 #include <string>
 #include <string_view>
 #include <algorithm>
@@ -25,6 +27,10 @@ namespace lolita
 			loc_.Column = loc_.Line = 1;
 			loc_.File = file;
 
+			// the cache only pays off for a text much longer than itself, e.g. not for a paste
+			if (dat.size() > kSymbolCacheSize)
+				symbol_cache_ = std::make_unique<SymbolCacheEntry[]>(kSymbolCacheSize);
+
 			// prepare consumption
 			SkipLineConnect();
 
@@ -32,6 +38,29 @@ namespace lolita
 			PrepareCheckpoint(true);
 		}
 
+		// resume lexing $dat at $resume, a token previously lexed from the same text
+		// NOTE $resume should start a line, so that no HeaderName hint is missed
+		Lexer(std::string_view dat, const SourceFile* file, const Token& resume)
+			: checkpoint_view_(dat.substr(resume.Location.Index))
+			, window_(dat.substr(resume.Location.Index))
+		{
+			assert(resume.StartOfLine);
+
+			// the text may be of another file, e.g. an edited one
+			loc_ = resume.Location;
+			loc_.File = file;
+
+			if (dat.size() > kSymbolCacheSize)
+				symbol_cache_ = std::make_unique<SymbolCacheEntry[]>(kSymbolCacheSize);
+
+			// prepare consumption, as the text at $resume may be edited
+			SkipLineConnect();
+
+			// NOTE whitespace preceding $resume is already skipped
+			PrepareCheckpoint(true);
+			succeeding_space_ = succeeding_space_ || resume.SucceedingSpace;
+		}
+
 		bool Exhausted() const
 		{
 			return checkpoint_view_.empty();
@@ -83,6 +112,9 @@ namespace lolita
 		// export consumed content from last checkpoint with particular token tag
 		Token ExportToken(TokenTag tag);
 
+		// intern an identifier, with recently seen ones cached in the lexer
+		SymbolId InternIdentifier(std::string_view text);
+
 		// Text Utils
 		//
 
@@ -90,6 +122,9 @@ namespace lolita
 		char Peek() const;
 		char Consume();
 
+		// consume $n characters in bulk, which contain no backslash
+		void ConsumeBulk(size_t n);
+
 		template <typename Predicate>
 		bool TryPred(Predicate pred);
 
@@ -116,12 +151,30 @@ namespace lolita
 		SourceLocation loc_;
 		// view to remaining source text
 		std::string_view window_;
+
+		// a direct-mapped cache of identifiers, which saves a lookup in the shared SymbolTable
+		// NOTE text of an entry is a view into the SymbolTable
+		struct SymbolCacheEntry
+		{
+			std::string_view Text;
+			SymbolId Symbol = kInvalidSymbol;
+		};
+
+		static constexpr size_t kSymbolCacheSize = 4096;
+
+		// NOTE nullptr if not used
+		std::unique_ptr<SymbolCacheEntry[]> symbol_cache_;
 	};
 
 	inline void Lexer::SkipLineConnect()
 	{
-		while (TrySeqPrefix(window_, "\\\n"))
+		// NOTE test the first character to keep the common path cheap
+		while (!window_.empty() && window_.front() == '\\' && TrySeqPrefix(window_, "\\\n"))
+		{
+			// NOTE a line splice does not start a new line, but it still counts in Index
+			loc_.Index += 2;
 			dirty_ = true;
+		}
 	}
 
 	inline char Lexer::Peek() const
@@ -154,13 +207,10 @@ namespace lolita
 
 	inline bool Lexer::TryAny(std::string_view any)
 	{
-		for (auto ch : any)
+		if (!window_.empty() && any.find(Peek()) != std::string_view::npos)
 		{
-			if (any.find(Peek()) != any.length())
-			{
-				Consume();
-				return true;
-			}
+			Consume();
+			return true;
 		}
 
 		return false;
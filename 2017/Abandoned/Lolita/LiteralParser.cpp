@@ -91,26 +91,25 @@ namespace lolita
 		return typemap[type_select][unsign_ ? 1 : 0];
 	}
 
-	CInteger ParseIntegerConst(const Token& tok)
+	CInteger ParseIntegerConst(string_view text)
 	{
 		// NOTE that integer constant is always positive
 		// (sign would be parsed saperately)
-		assert(tok.Tag == TokenTag::IntegerConst);
 
 		// parse value
 		// FIXME: handle possible exceptions
 		size_t pos;
-		auto value = stoull(tok.Content, &pos, 0);
+		auto value = stoull(string{ text }, &pos, 0);
 
 		// parse type suffix
 		auto prec = IntPrecision::Int32;
-		if (pos != tok.Content.size())
+		if (pos != text.size())
 		{
 			auto unsigned_ = false;
 			auto long_ = false;
 			auto longlong_ = false;
 
-			auto view = string_view{ tok.Content.c_str() + pos };
+			auto view = text.substr(pos);
 
 			// first round
 			unsigned_ = TryAnyPrefix(view, "uU");
@@ -148,20 +147,18 @@ namespace lolita
 		return CInteger{ value, prec };
 	}
 
-	CFloat ParseFloatConst(const Token& tok)
+	CFloat ParseFloatConst(string_view text)
 	{
-		assert(tok.Tag == TokenTag::FloatConst);
-
 		// parse value
 		// FIXME: handle possible exceptions
 		size_t pos = 0;
-		auto value = stod(tok.Content, &pos);
+		auto value = stod(string{ text }, &pos);
 
 		// parse type suffix
 		auto prec = FloatPrecision::Double;
-		if (pos != tok.Content.size())
+		if (pos != text.size())
 		{
-			auto view = string_view{ tok.Content.c_str() + pos };
+			auto view = text.substr(pos);
 
 			if (TryAnyPrefix(view, "fF"))
 			{
@@ -294,9 +291,9 @@ namespace lolita
 		}
 	}
 
-	CInteger ParseCharConst(const Token& tok)
+	CInteger ParseCharConst(string_view text)
 	{
-		auto view = string_view{ tok.Content };
+		auto view = text;
 
 		// FIXME: Magic Number used: assumption on character types
 		// parse prefix
@@ -364,9 +361,9 @@ namespace lolita
 	//
 	// Parsing string literal in C
 	//
-	CString ParseStringLiteral(const Token& tok)
+	CString ParseStringLiteral(string_view text)
 	{
-		auto view = string_view{ tok.Content };
+		auto view = text;
 
 #pragma warning "Magic Number used: assumption on character types"
 		// parse prefix
@@ -404,7 +401,13 @@ namespace lolita
 		}
 
 		// parse contents(use UCS4 as intermediate encoding)
-		basic_string<uint32_t> buffer32; // should be u32string, workaround for MSVC
+#ifdef _MSC_VER
+		// workaround: MSVC cannot handle the correct form of cvt definition
+		using CodePoint = uint32_t;
+#else
+		using CodePoint = char32_t;
+#endif
+		basic_string<CodePoint> buffer32;
 		while (!view.empty())
 		{
 			if (view.front() == '\"')
@@ -414,7 +417,7 @@ namespace lolita
 			}
 
 			uint32_t ch = ReadMaybeEscaped(view, char_max);
-			buffer32.push_back(ch);
+			buffer32.push_back(static_cast<CodePoint>(ch));
 		}
 
 		// parse closing double quote
@@ -423,12 +426,7 @@ namespace lolita
 			throw LiteralError{ };
 		}
 
-#ifdef _MSC_VER
-		// workaround: MSVC cannot handle the correct form of cvt definition
-		wstring_convert<codecvt_utf8<uint32_t>, uint32_t> cvt;
-#else
-		wstring_convert<codecvt_utf8<char32_t>, char32_t> cvt;
-#endif
+		wstring_convert<codecvt_utf8<CodePoint>, CodePoint> cvt;
 
 		return CString(cvt.to_bytes(buffer32), type);
 	}
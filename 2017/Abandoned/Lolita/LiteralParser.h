@@ -1,12 +1,13 @@
 #pragma once
 #include "Literal.h"
-#include "Token.h"
 #include <string>
+#include <string_view>
 
 namespace lolita
 {
-	CInteger	ParseIntegerConst(const Token& tok);
-	CFloat		ParseFloatConst(const Token& tok);
-	CInteger	ParseCharConst(const Token& tok);
-	CString		ParseStringLiteral(const Token& tok);
+	// NOTE $text is the content of a token of the literal
+	CInteger	ParseIntegerConst(std::string_view text);
+	CFloat		ParseFloatConst(std::string_view text);
+	CInteger	ParseCharConst(std::string_view text);
+	CString		ParseStringLiteral(std::string_view text);
 }
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include "MacroEngine.h"
 #include "Lexer.h"
+#include "StringPool.h"
 #include <cassert>
 #include <algorithm>
 #include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
 
 using namespace std;
 
@@ -17,54 +21,143 @@ namespace lolita
 		}
 	}
 
-	MacroIR	CreateIR(const Token& tok)
+	// Implementation of HideSetTable
+	//
+
+	size_t HideSetTable::NamesHash::operator()(const vector<SymbolId>& names) const
 	{
-		return MacroIR{ tok, {} };
+		// FNV-1a over the ids
+		auto hash = uint64_t{ 14695981039346656037ull };
+		for (auto name : names)
+		{
+			hash ^= name;
+			hash *= 1099511628211ull;
+		}
+
+		return static_cast<size_t>(hash);
 	}
 
-	MacroIR CreatePlacemarker()
+	HideSetId HideSetTable::Intern(vector<SymbolId> names)
 	{
-		return {};
+		auto next_id = static_cast<HideSetId>(sets_.size());
+		auto result = lookup_.emplace(move(names), next_id);
+		if (result.second)
+		{
+			// NOTE keys of an unordered_map never move
+			sets_.push_back(&result.first->first);
+		}
+
+		return result.first->second;
 	}
 
-	// test if a token is a parameter
-	const MacroIRList* LookupArgs(const MacroArgsMap& args, const MacroIR& tok)
+	bool HideSetTable::Contains(HideSetId set, SymbolId name) const
 	{
-		// a quick path
-		// non-identifier cannot be a parameter name
-		if (tok.Tok.Tag != TokenTag::Identifier)
-			return nullptr;
+		const auto& names = *sets_[set];
+		return binary_search(names.begin(), names.end(), name);
+	}
 
-		// lookup parameter name in args map
-		for (const auto& arg_pair : args)
+	HideSetId HideSetTable::Insert(HideSetId set, SymbolId name)
+	{
+		auto key = (uint64_t{ set } << 32) | name;
+		auto iter = insert_memo_.find(key);
+		if (iter != insert_memo_.end())
+			return iter->second;
+
+		auto names = *sets_[set];
+		auto pos = lower_bound(names.begin(), names.end(), name);
+		if (pos == names.end() || *pos != name)
 		{
-			if (arg_pair.first == tok.Tok.Content)
-				return &arg_pair.second;
+			names.insert(pos, name);
 		}
 
-		return nullptr;
+		auto result = Intern(move(names));
+		insert_memo_.emplace(key, result);
+
+		return result;
 	}
 
+	HideSetId HideSetTable::Union(HideSetId lhs, HideSetId rhs)
+	{
+		// quick paths
+		if (lhs == rhs || rhs == kEmptyHideSet)
+			return lhs;
+		if (lhs == kEmptyHideSet)
+			return rhs;
+
+		// union is commutative, so keep only one order in the memo
+		if (lhs > rhs)
+			swap(lhs, rhs);
 
-	// Stringize a sequence of tokens
-	MacroIR Stringize(const MacroIRList &ts)
+		auto key = (uint64_t{ lhs } << 32) | rhs;
+		auto iter = union_memo_.find(key);
+		if (iter != union_memo_.end())
+			return iter->second;
+
+		const auto& lhs_names = *sets_[lhs];
+		const auto& rhs_names = *sets_[rhs];
+
+		auto names = vector<SymbolId>{};
+		names.reserve(lhs_names.size() + rhs_names.size());
+		set_union(lhs_names.begin(), lhs_names.end(), rhs_names.begin(), rhs_names.end(), back_inserter(names));
+
+		auto result = Intern(move(names));
+		union_memo_.emplace(key, result);
+
+		return result;
+	}
+
+	HideSetId HideSetTable::Intersect(HideSetId lhs, HideSetId rhs)
+	{
+		// quick paths
+		if (lhs == rhs)
+			return lhs;
+		if (lhs == kEmptyHideSet || rhs == kEmptyHideSet)
+			return kEmptyHideSet;
+
+		// intersection is commutative, so keep only one order in the memo
+		if (lhs > rhs)
+			swap(lhs, rhs);
+
+		auto key = (uint64_t{ lhs } << 32) | rhs;
+		auto iter = intersect_memo_.find(key);
+		if (iter != intersect_memo_.end())
+			return iter->second;
+
+		const auto& lhs_names = *sets_[lhs];
+		const auto& rhs_names = *sets_[rhs];
+
+		auto names = vector<SymbolId>{};
+		set_intersection(lhs_names.begin(), lhs_names.end(), rhs_names.begin(), rhs_names.end(), back_inserter(names));
+
+		auto result = Intern(move(names));
+		intersect_memo_.emplace(key, result);
+
+		return result;
+	}
+
+	// Token Operations
+	//
+
+	// Stringize tokens in [first, last)
+	Token Stringize(const MacroIR* first, const MacroIR* last)
 	{
 		string buffer;
 
 		buffer.push_back('"');
-		for (const auto &tok : ts)
+		for (auto iter = first; iter != last; ++iter)
 		{
-			if (tok.Tok.SucceedingSpace)
+			const auto& tok = *iter->Tok;
+			if (tok.SucceedingSpace)
 				buffer.push_back(' ');
 
-			switch (tok.Tok.Tag)
+			switch (tok.Tag)
 			{
 				// for potential tokens may contain backslash or backquote
 				// iterate to escape those special characters
 			case TokenTag::InvalidChar:
 			case TokenTag::CharConst:
 			case TokenTag::StringLiteral:
-				for (char ch : tok.Tok.Content)
+				for (char ch : tok.Content)
 				{
 					if (ch == '\\' || ch == '"')
 						buffer.push_back('\\');
@@ -79,55 +172,42 @@ namespace lolita
 				break;
 
 			default:
-				buffer.append(tok.Tok.Content);
+				buffer.append(tok.Content);
 				break;
 			}
 		}
 		buffer.push_back('"');
 
-		return MacroIR
-		{
-			Token{ TokenTag::StringLiteral, move(buffer), ts.front().Tok.Location, false, false },
-			{ }
-		};
+		return Token{ TokenTag::StringLiteral, InternString(buffer), first->Tok->Location, false, false };
 	}
 
-	MacroHideSet IntersectHideSet(const MacroHideSet& lhs, const MacroHideSet& rhs)
+	// Glue two tokens together, and re-lex the result
+	// NOTE the concatenation is only lexed once, as pasting repeats in expansions
+	Token Glue(const Token& lhs, const Token& rhs, unordered_map<string, Token>& pastes)
 	{
-		auto result = lhs;
-		for (const auto& name : rhs)
+		if (lhs.Tag == TokenTag::Placemarker
+			&& rhs.Tag == TokenTag::Placemarker)
 		{
-			// name in rhs but not in lhs
-			if (find(lhs.begin(), lhs.end(), name) == lhs.end())
-			{
-				// append it to result
-				result.emplace_back(name);
-			}
+			return lhs;
 		}
 
-		return result;
-	}
-
-	// Glue two tokens together, and mark its tag unknown
-	MacroIR Glue(const MacroIR &lhs, const MacroIR &rhs)
-	{
-		auto hide_set = IntersectHideSet(lhs.HideSet, rhs.HideSet);
+		auto buffer = string{ lhs.Content };
+		buffer.append(rhs.Content);
 
-		// glue two tokens
-		if (lhs.Tok.Tag == TokenTag::Placemarker 
-			&& rhs.Tok.Tag == TokenTag::Placemarker)
+		auto iter = pastes.find(buffer);
+		if (iter == pastes.end())
 		{
-			return MacroIR{ lhs.Tok, {} };
-		}
-		else
-		{
-			string buffer = lhs.Tok.Content + rhs.Tok.Content;
 			auto lexer = Lexer{ buffer, nullptr };
-			auto result = lexer.Next();
+			auto tok = lexer.Next();
+
+			// the buffer is temporary, so keep the text in the pool
+			// NOTE identifiers already refer to the symbol table
+			if (tok.Tag != TokenTag::Identifier)
+				tok.Content = InternString(tok.Content);
 
 			// verify concatenation forms a single unique valid Token
 			MacroExpansionAssert(lexer.Exhausted());
-			switch (result.Tag)
+			switch (tok.Tag)
 			{
 			case TokenTag::EndOfFile:
 			case TokenTag::BadHeaderName:
@@ -135,386 +215,507 @@ namespace lolita
 				break;
 			}
 
-			// rewrite location
-			result.Location = lhs.Tok.Location;
-
-			return MacroIR{ move(result), hide_set };
+			iter = pastes.emplace(move(buffer), tok).first;
 		}
-	}
 
-	// Paste tok into the end of list
-	void PasteToList(MacroIRList &list, const MacroIR& tok)
-	{
-		assert(!list.empty());
+		// rewrite location
+		auto result = iter->second;
+		result.Location = lhs.Location;
+		result.StartOfLine = lhs.StartOfLine;
+		result.SucceedingSpace = lhs.SucceedingSpace;
 
-		// paste
-		auto glued = Glue(list.back(), tok);
-		// replace the last token in list
-		list.back() = move(glued);
+		return result;
 	}
 
-	bool TestMayExpand(const MacroIR& tok)
+	bool ContainsPaste(const MacroDescription& macro)
 	{
-		if (tok.Tok.Tag != TokenTag::Identifier)
-			return false;
-
-		const auto& hideset = tok.HideSet;
-		return find(hideset.begin(), hideset.end(), tok.Tok.Content) == hideset.end();
+		return any_of(macro.Expansion.begin(), macro.Expansion.end(), [](const Token& tok) {
+			return tok.Tag == TokenTag::SharpSharp;
+		});
 	}
 
-	const MacroDescription* LookupMacro(const MacroArchive& macros, const std::string& name)
+	// A range of tokens pending for rescanning
+	struct PendingRange
 	{
-		auto iter = macros.find(name);
-		return iter != macros.end() ? &iter->second : nullptr;
-	}
-
-	MacroIRList CreateReplacementList(const MacroDescription& m)
+		// tokens of a definition, which share a hide set
+		const Token* TokNext = nullptr;
+		const Token* TokEnd = nullptr;
+		HideSetId HideSet = kEmptyHideSet;
+
+		// or tokens with their own hide sets
+		const MacroIR* IrNext = nullptr;
+		const MacroIR* IrEnd = nullptr;
+
+		// storage of the tokens above, if owned by the range
+		MacroIRList Storage;
+	};
+
+	// Arguments of an invocation, indexed as parameters with __VA_ARGS__ last
+	// NOTE all arguments are kept in a list, so that loading them costs few allocations
+	struct MacroArgs
 	{
-		auto result = MacroIRList{};
-		transform(m.Expansion.begin(), m.Expansion.end(), back_inserter(result),
-			[](const Token& tok)
+		MacroIRList Tokens;
+
+		// end of each argument in Tokens
+		vector<size_t> Ends;
+
+		const MacroIR* Begin(size_t index) const
 		{
-			return CreateIR(tok);
-		});
+			return Tokens.data() + (index == 0 ? 0 : Ends[index - 1]);
+		}
 
-		return result;
-	}
+		const MacroIR* End(size_t index) const
+		{
+			return Tokens.data() + Ends[index];
+		}
+	};
 
-	// generate substituted form of a macro
-	MacroIRList Substitute(
-		const MacroArchive& macros, 
-		const MacroDescription& m, 
-		const MacroHideSet& hideset, 
-		const MacroArgsMap& args);
-	// parse arguments from sequence of tokens
-	// NOTE this function assume is starts with a '('
-	MacroArgsMap LoadMacroArgs(MacroIRList& is, const MacroDescription& macro);
-	bool TryExpandFirstAsBuiltin(const MacroArchive& macros, MacroIRList& is);
-	bool TryExpandFirstAsCustom(const MacroArchive& macros, MacroIRList& is);
-	bool TryExpandFirst(const MacroArchive& macros, MacroIRList& is);
-	MacroIRList Expand(const MacroArchive& macros, MacroIRList is);
-
-	// generate a token sequence from a macro expansion
-	MacroIRList Substitute(
-		const MacroArchive& macros, 
-		const MacroDescription& m, 
-		const MacroHideSet& hideset, 
-		const MacroArgsMap& args)
+	// State shared by an expansion and expansions of arguments in it
+	struct ExpansionState
 	{
-		// internal automaton for iteration
-		enum class SubstitutionState
-		{
-			None,
-			Sharp,
-			SharpSharp,
-		};
+		const MacroArchive& Macros;
+		HideSetTable& HideSets;
+		deque<Token>& Tokens;
+		unordered_map<string, Token>& Pastes;
 
-		auto state = SubstitutionState::None;
+		// ranges pending, where an expansion of an argument works above its invocation
+		vector<PendingRange> Stack;
 
-		// iterate to substitute
-		auto is = CreateReplacementList(m);
-		auto os = MacroIRList{};
-		while (!is.empty())
-		{
-			auto tok = move(is.front());
-			is.pop_front();
+		// macro invocations expanded, including those in rescanning
+		size_t Expansions = 0;
+	};
 
-			if (state == SubstitutionState::Sharp)
+	// Expansion with rescanning, where tokens pending are kept as a stack of ranges,
+	// each of which is either a part of a definition or the result of a substitution
+	class MacroExpander
+	{
+	public:
+		// NOTE tokens from $src, if any, are read only to complete an invocation
+		//      of a function-like macro whose name is the last token pending
+		MacroExpander(ExpansionState& state, TokenSource* src)
+			: state_(state), hidesets_(state.HideSets), src_(src), base_(state.Stack.size()) { }
+
+		// expand $first and then all tokens pending, yielding each token left to $emit
+		template <typename Emitter>
+		void Run(MacroIR first, Emitter emit)
+		{
+			auto ir = first;
+			while (true)
 			{
-				// state that is ready for stringification
-				// expect a parameter
-				if (auto actual_arg = LookupArgs(args, tok))
-				{
-					os.emplace_back(Stringize(*actual_arg));
+				if (!TryExpand(ir))
+					emit(ir);
 
-					state = SubstitutionState::None;
-				}
-				else
-				{
-					// the next token after '#' must be a parameter
-					MacroExpansionAssert(false);
-				}
-			}
-			else if (state == SubstitutionState::SharpSharp)
-			{
-				if (auto actual_arg = LookupArgs(args, tok))
-				{
-					// paste first token from the actual arguments
-					PasteToList(os, actual_arg->front());
-					// and copy the rest
-					auto succeeding_begin = next(actual_arg->begin());
-					copy(succeeding_begin, actual_arg->end(), back_inserter(os));
-				}
-				else
-				{
-					PasteToList(os, tok);
-				}
+				if (!Pending())
+					break;
 
-				state = SubstitutionState::None;
+				ir = Take();
 			}
-			else // SubstitutionState::None
-			{
-				// try to transfer state
-				if (tok.Tok.Tag == TokenTag::Sharp)
-				{
-					state = SubstitutionState::Sharp;
-				}
-				else if (tok.Tok.Tag == TokenTag::SharpSharp)
-				{
-					// leading or tailing "##" is not allowed
-					// FIXME: reason of failure not specified
-					MacroExpansionAssert(!os.empty() && !is.empty());
+		}
 
-					state = SubstitutionState::SharpSharp;
-				}
-				else
-				{
-					state = SubstitutionState::None;
+		// push tokens in [first, last), which must outlive the expansion
+		void PushRange(const MacroIR* first, const MacroIR* last)
+		{
+			if (first == last)
+				return;
 
-					if (auto actual_arg = LookupArgs(args, tok))
-					{
-						// for arguments, expand recursively
-						auto expanded_args = Expand(macros, *actual_arg);
-						move(expanded_args.begin(), expanded_args.end(), back_inserter(os));
-					}
-					else
-					{
-						// for trivial tokens, simply echo
-						os.emplace_back(move(tok));
-					}
-				}
-			}
+			state_.Stack.emplace_back();
+			state_.Stack.back().IrNext = first;
+			state_.Stack.back().IrEnd = last;
 		}
 
-		// this may fail if last valid token is # without pasting
-		MacroExpansionAssert(state == SubstitutionState::None);
+	private:
+		void PushDefinition(const MacroDescription& macro, HideSetId hideset)
+		{
+			if (macro.Expansion.empty())
+				return;
 
-		// update hide set for each token generated
-		for (auto &tok : os)
+			state_.Stack.emplace_back();
+			state_.Stack.back().TokNext = macro.Expansion.data();
+			state_.Stack.back().TokEnd = macro.Expansion.data() + macro.Expansion.size();
+			state_.Stack.back().HideSet = hideset;
+		}
+
+		void PushList(MacroIRList list)
 		{
-			tok.HideSet = hideset;
+			if (list.empty())
+				return;
+
+			// NOTE moving a vector keeps its buffer, so IrNext is stable
+			state_.Stack.emplace_back();
+			auto& range = state_.Stack.back();
+			range.Storage = move(list);
+			range.IrNext = range.Storage.data();
+			range.IrEnd = range.IrNext + range.Storage.size();
 		}
 
-		return os;
-	}
+		// drop exhausted ranges, and test if any token is pending
+		bool Pending()
+		{
+			auto& stack = state_.Stack;
+			while (stack.size() > base_)
+			{
+				const auto& top = stack.back();
+				if (top.TokNext != top.TokEnd || top.IrNext != top.IrEnd)
+					return true;
 
-	MacroArgsMap LoadMacroArgs(MacroIRList& is, const MacroDescription& macro)
-	{
-		assert(!is.empty());
-		assert(is.front().Tok.Tag == TokenTag::LParenthesis);
-		assert(!is.front().Tok.SucceedingSpace);
+				stack.pop_back();
+			}
 
-		size_t nest_depth = 1;
+			return false;
+		}
+
+		// take a pending token
+		MacroIR Take()
+		{
+			assert(state_.Stack.size() > base_);
 
-		MacroArgsMap result;
-		MacroIRList args_buffer;
+			auto& top = state_.Stack.back();
+			if (top.TokNext != top.TokEnd)
+				return MacroIR{ top.TokNext++, top.HideSet };
+			else
+				return *top.IrNext++;
+		}
 
-		is.pop_front();
-		while (true)
+		// peek the next token, either pending or from the source, nullptr if none
+		const Token* PeekNext()
 		{
-			// no coresponding ')' can be found
-			// FIXME: reason of failure not specified
-			MacroExpansionAssert(!is.empty());
-
-			const auto &first = is.front();
-			if (nest_depth == 1 &&
-				first.Tok.Tag == TokenTag::Comma &&
-				result.size() < macro.Params.size())
-			{
-				// assuming Params is alway correct (without duplicates)
-				is.pop_front();
-				result.emplace_back(make_pair(macro.Params[result.size()], move(args_buffer)));
-				continue;
-
-				// NOTE that all extra arguments are put in __VA_ARGS__
-				// even if the macro doesn't report it
-				// in that case, an error would be reported later
-			}
-			else if (first.Tok.Tag == TokenTag::LParenthesis)
+			if (Pending())
 			{
-				nest_depth += 1;
+				const auto& top = state_.Stack.back();
+				return top.TokNext != top.TokEnd ? top.TokNext : top.IrNext->Tok;
 			}
-			else if (first.Tok.Tag == TokenTag::RParenthesis)
-			{
-				nest_depth -= 1;
-
-				if (nest_depth == 0)
-				{
-					// remove closing ')'
-					is.pop_front();
 
-					// finalize parsing
-					string param_name = result.size() < macro.Params.size()
-						? macro.Params[result.size()]
-						: "__VA_ARGS__";
+			if (src_ != nullptr && !src_->Exhausted())
+				return &src_->Peek();
 
-					result.emplace_back(make_pair(macro.Params[result.size()], move(args_buffer)));
+			return nullptr;
+		}
 
-					// exit parsing
-					break;
-				}
-			}
+		MacroIR TakeNext()
+		{
+			if (Pending())
+				return Take();
 
-			args_buffer.emplace_back(move(is.front()));
-			is.pop_front();
+			assert(src_ != nullptr && !src_->Exhausted());
+			return MacroIR{ &src_->Consume(), kEmptyHideSet };
 		}
 
-		// verify there's enough args loaded
-		if (result.size() < macro.Params.size())
+		const Token* NewToken(Token tok)
 		{
-			// FIXME: throw 0?
-			throw 0;
+			state_.Tokens.push_back(tok);
+			return &state_.Tokens.back();
 		}
 
-		// trim arguments and replace empty one with placemarker
-		for (auto &item : result)
+		// returns index of the argument if $tok is a parameter of $macro
+		optional<size_t> LookupArg(const MacroDescription& macro, const Token& tok)
 		{
-			MacroIRList &args = item.second;
+			// a quick path
+			// non-identifier cannot be a parameter name
+			if (tok.Tag != TokenTag::Identifier)
+				return nullopt;
 
-			if (args.empty())
+			for (size_t i = 0; i < macro.Params.size(); ++i)
 			{
-				// append a placemarker if empty
-				args.emplace_back(CreatePlacemarker());
+				if (macro.Params[i] == tok.Symbol)
+					return i;
 			}
-			else
+
+			if (macro.VariadicArgs && tok.Symbol == kSymbolVaArgs)
+				return macro.Params.size();
+
+			return nullopt;
+		}
+
+		// append tokens of an argument, with the hide set of the invocation added
+		void AppendArg(MacroIRList& list, const MacroIR* first, const MacroIR* last, HideSetId hideset)
+		{
+			// NOTE adjacent tokens are likely to share a hide set
+			auto last_hideset = kEmptyHideSet;
+			auto last_union = hideset;
+			for (auto iter = first; iter != last; ++iter)
 			{
-				// discard leading and tailing whitespace
-				args.front().Tok.SucceedingSpace = false;
+				if (iter->HideSet != last_hideset)
+				{
+					last_hideset = iter->HideSet;
+					last_union = hidesets_.Union(last_hideset, hideset);
+				}
+
+				list.push_back(MacroIR{ iter->Tok, last_union });
 			}
 		}
 
-		return result;
-	}
-
-	bool TryExpandFirstAsBuiltin(const MacroArchive& macros, MacroIRList& is)
-	{
-		auto& first_tok = is.front().Tok;
-		if (first_tok.Content == "__FILE__")
+		// paste $rhs into the last token in $list
+		void Paste(MacroIRList& list, const MacroIR& rhs)
 		{
-			first_tok.Tag = TokenTag::StringLiteral;
-			first_tok.Content = first_tok.Location.File->Url();
+			assert(!list.empty());
+
+			auto& lhs = list.back();
+			auto glued = Glue(*lhs.Tok, *rhs.Tok, state_.Pastes);
+			lhs = MacroIR{ NewToken(glued), hidesets_.Union(lhs.HideSet, rhs.HideSet) };
 		}
-		else if (first_tok.Content == "__LINE__")
+
+		bool TryExpandBuiltin(MacroIR& ir)
 		{
-			first_tok.Tag = TokenTag::IntegerConst;
-			first_tok.Content = std::to_string(first_tok.Location.Line);
+			auto tok = *ir.Tok;
+			if (tok.Symbol == kSymbolBuiltinFile)
+			{
+				tok.Tag = TokenTag::StringLiteral;
+				tok.Content = InternString(tok.Location.File->Url());
+			}
+			else if (tok.Symbol == kSymbolBuiltinLine)
+			{
+				tok.Tag = TokenTag::IntegerConst;
+				tok.Content = InternString(std::to_string(tok.Location.Line));
+			}
+			else
+			{
+				return false;
+			}
+
+			tok.Symbol = kInvalidSymbol;
+			ir.Tok = NewToken(tok);
+			return true;
 		}
-		else
+
+		// try to expand $ir as a macro, and push its replacement
+		// NOTE a builtin macro is replaced in place, and false is returned
+		bool TryExpand(MacroIR& ir)
 		{
-			return false;
-		}
+			// a quick path
+			const auto& tok = *ir.Tok;
+			if (tok.Tag != TokenTag::Identifier || hidesets_.Contains(ir.HideSet, tok.Symbol))
+				return false;
 
-		return true;
-	}
+			if (TryExpandBuiltin(ir))
+				return false;
+
+			auto pmacro = state_.Macros.Lookup(tok.Symbol);
+			if (!pmacro)
+				return false;
 
-	bool TryExpandFirstAsCustom(const MacroArchive& macros, MacroIRList& is)
-	{
-		if (auto pmacro = LookupMacro(macros, is.front().Tok.Content))
-		{
 			// still have a chance not to be expanded
 			// NOTE function-like macro without strictedly followed '('
-			if (!pmacro->ObjectLike) // i.e. function-liken
+			if (!pmacro->ObjectLike)
 			{
-				if (is.size() == 1)
-					return false;
-
-				const auto& second = is[1];
-				if (second.Tok.Tag != TokenTag::LParenthesis
-					|| second.Tok.SucceedingSpace)
+				auto next = PeekNext();
+				if (next == nullptr
+					|| next->Tag != TokenTag::LParenthesis
+					|| next->SucceedingSpace)
 				{
 					return false;
 				}
 			}
-			
-			// load hide set
-			auto hideset = is.front().HideSet;
-			is.pop_front();
-			// load args
-			auto args_map = pmacro->ObjectLike
-				? MacroArgsMap{}
-				: LoadMacroArgs(is, *pmacro);
-
-			auto subst = Substitute(macros, *pmacro, hideset, args_map);
-			move(subst.rbegin(), subst.rend(), front_inserter(is));
-		}
-	}
 
-	// try to expand first token in $is as a macro
-	bool TryExpandFirst(const MacroArchive& macros, MacroIRList& is)
-	{
-		assert(!is.empty());
-		
-		// a quick path
-		if (!TestMayExpand(is.front()))
-			return false;
+			// the macro itself is hidden from its expansion
+			if (pmacro->ObjectLike)
+			{
+				auto hideset = hidesets_.Insert(ir.HideSet, pmacro->Name);
+				if (ContainsPaste(*pmacro))
+					PushList(Substitute(*pmacro, hideset, MacroArgs{}));
+				else
+					PushDefinition(*pmacro, hideset);  // rescan the definition as is
+			}
+			else
+			{
+				// NOTE for a function-like macro, only names hidden from both the name
+				//      and the closing ')' remain hidden, as in Prosser's algorithm
+				auto rp_hideset = kEmptyHideSet;
+				auto args = LoadArgs(*pmacro, rp_hideset);
+				auto hideset = hidesets_.Insert(hidesets_.Intersect(ir.HideSet, rp_hideset), pmacro->Name);
 
-		return TryExpandFirstAsBuiltin(macros, is)
-			|| TryExpandFirstAsCustom(macros, is);
-	}
+				PushList(Substitute(*pmacro, hideset, args));
+			}
 
-	// expand macros in $is and yields result
-	MacroIRList Expand(const MacroArchive& macros, MacroIRList is)
-	{
-		MacroIRList os;
-		while (!is.empty())
+			state_.Expansions += 1;
+			return true;
+		}
+
+		// finish an argument ending at $delim
+		void CloseArg(MacroArgs& args, const Token& delim)
 		{
-			if (!TryExpandFirst(macros, is))
+			auto& tokens = args.Tokens;
+			auto begin = args.Ends.empty() ? 0 : args.Ends.back();
+			if (begin == tokens.size())
 			{
-				// if first token cannot expand as a macro, echo
-				os.emplace_back(move(is.front()));
-				is.pop_front();
+				// append a placemarker if empty
+				auto placemarker = Token{ TokenTag::Placemarker, {}, delim.Location, false, false };
+				tokens.push_back(MacroIR{ NewToken(placemarker), kEmptyHideSet });
+			}
+			else if (tokens[begin].Tok->SucceedingSpace)
+			{
+				// discard leading whitespace
+				auto tok = *tokens[begin].Tok;
+				tok.SucceedingSpace = false;
+				tokens[begin].Tok = NewToken(tok);
 			}
-		}
-
-		return os;
-	}
 
-	// Impl
-	//
+			args.Ends.push_back(tokens.size());
+		}
 
-	std::vector<Token> ExpandMacro(TokenSource& src, const MacroArchive& macros, bool obj_like)
-	{
-		assert(src.Test(TokenTag::Identifier));
-		assert(macros.find(src.Peek().Content) != macros.end());
-		auto is = MacroIRList{ CreateIR(src.Consume()) };
-		if (!obj_like)
+		// parse arguments of an invocation, and load the hide set of the closing ')' into $rp_hideset
+		// NOTE this function assume the next token is a '('
+		MacroArgs LoadArgs(const MacroDescription& macro, HideSetId& rp_hideset)
 		{
-			assert(src.Test(TokenTag::LParenthesis));
-			assert(!src.Peek().SucceedingSpace);
-			auto depth = 0;
+			auto lp = TakeNext();
+			assert(lp.Tok->Tag == TokenTag::LParenthesis);
 
-			// load arguments
+			auto param_count = macro.Params.size();
+			auto args = MacroArgs{};
+			args.Ends.reserve(param_count + 1);
+
+			auto nest_depth = 1;
 			while (true)
 			{
-				// FIXME: throw 0?
-				if (src.Exhausted())
-					throw 0;
+				// no coresponding ')' can be found
+				// FIXME: reason of failure not specified
+				MacroExpansionAssert(PeekNext() != nullptr);
 
-				if (src.Test(TokenTag::LParenthesis))
-					depth += 1;
-				else if (src.Test(TokenTag::RParenthesis))
-					depth -= 1;
+				auto ir = TakeNext();
+				auto tag = ir.Tok->Tag;
+				if (tag == TokenTag::Comma && nest_depth == 1 && args.Ends.size() < param_count)
+				{
+					// NOTE all extra arguments are put in __VA_ARGS__
+					CloseArg(args, *ir.Tok);
+					continue;
+				}
+				else if (tag == TokenTag::LParenthesis)
+				{
+					nest_depth += 1;
+				}
+				else if (tag == TokenTag::RParenthesis && --nest_depth == 0)
+				{
+					CloseArg(args, *ir.Tok);
 
-				is.emplace_back(CreateIR(src.Consume()));
+					// __VA_ARGS__ may be omitted
+					if (macro.VariadicArgs && args.Ends.size() == param_count)
+						CloseArg(args, *ir.Tok);
 
-				if (depth == 0)
-				{
+					rp_hideset = ir.HideSet;
 					break;
 				}
+
+				args.Tokens.push_back(ir);
 			}
+
+			// verify the count of arguments
+			MacroExpansionAssert(args.Ends.size() == param_count + (macro.VariadicArgs ? 1 : 0));
+
+			return args;
+		}
+
+		// expand tokens in [first, last) in isolation, appending the result to $output
+		void ExpandArg(const MacroIR* first, const MacroIR* last, MacroIRList& output)
+		{
+			auto expander = MacroExpander{ state_, nullptr };
+			expander.PushRange(first + 1, last);
+			expander.Run(*first, [&](const MacroIR& ir) {
+				output.push_back(ir);
+			});
 		}
 
-		auto os = Expand(macros, is);
-		auto result = vector<Token>{};
-		for (auto& ir : os)
+		// generate a token sequence from a macro expansion
+		MacroIRList Substitute(const MacroDescription& macro, HideSetId hideset, const MacroArgs& args)
 		{
-			if (ir.Tok.Tag != TokenTag::Placemarker)
+			// arguments expanded, each at most once, as ranges in expanded_tokens
+			constexpr auto kNotExpanded = numeric_limits<size_t>::max();
+			auto expanded_tokens = MacroIRList{};
+			auto expanded_ranges = vector<pair<size_t, size_t>>{};
+
+			const auto& rp = macro.Expansion;
+			auto result = MacroIRList{};
+			result.reserve(rp.size() + args.Tokens.size());
+			for (size_t i = 0; i < rp.size(); ++i)
 			{
-				result.emplace_back(move(ir.Tok));
+				const auto& tok = rp[i];
+				if (tok.Tag == TokenTag::Sharp && !macro.ObjectLike)
+				{
+					// the next token after '#' must be a parameter
+					auto index = i + 1 < rp.size() ? LookupArg(macro, rp[++i]) : nullopt;
+					MacroExpansionAssert(index.has_value());
+
+					auto str = Stringize(args.Begin(*index), args.End(*index));
+					result.push_back(MacroIR{ NewToken(str), hideset });
+				}
+				else if (tok.Tag == TokenTag::SharpSharp)
+				{
+					// leading or tailing "##" is not allowed
+					// FIXME: reason of failure not specified
+					MacroExpansionAssert(!result.empty() && i + 1 < rp.size());
+
+					const auto& rhs = rp[++i];
+					if (auto index = LookupArg(macro, rhs))
+					{
+						// paste first token from the actual arguments, and copy the rest
+						auto first = args.Begin(*index);
+						Paste(result, MacroIR{ first->Tok, hidesets_.Union(first->HideSet, hideset) });
+						AppendArg(result, first + 1, args.End(*index), hideset);
+					}
+					else
+					{
+						Paste(result, MacroIR{ &rhs, hideset });
+					}
+				}
+				else if (auto index = LookupArg(macro, tok))
+				{
+					if (i + 1 < rp.size() && rp[i + 1].Tag == TokenTag::SharpSharp)
+					{
+						// an operand of ## is not expanded
+						AppendArg(result, args.Begin(*index), args.End(*index), hideset);
+						continue;
+					}
+
+					// for arguments, expand recursively
+					if (expanded_ranges.empty())
+						expanded_ranges.assign(args.Ends.size(), { kNotExpanded, 0 });
+
+					auto& range = expanded_ranges[*index];
+					if (range.first == kNotExpanded)
+					{
+						range.first = expanded_tokens.size();
+						ExpandArg(args.Begin(*index), args.End(*index), expanded_tokens);
+						range.second = expanded_tokens.size();
+					}
+
+					auto expanded = expanded_tokens.data();
+					AppendArg(result, expanded + range.first, expanded + range.second, hideset);
+				}
+				else
+				{
+					// for trivial tokens, simply echo
+					result.push_back(MacroIR{ &tok, hideset });
+				}
 			}
+
+			return result;
 		}
 
-		return result;
-	}
+		ExpansionState& state_;
+		HideSetTable& hidesets_;
+		TokenSource* src_;
+
+		// depth of the stack where this expansion starts
+		size_t base_;
+	};
+
+	// Implementation of MacroEngine
+	//
 
+	void MacroEngine::Expand(TokenSource& src, const MacroArchive& macros, TokenVec& output)
+	{
+		assert(src.Test(TokenTag::Identifier));
+		assert(macros.Lookup(src.Peek().Symbol));
+
+		// tokens created by the last expansion are no longer referred
+		tokens_.clear();
+
+		auto state = ExpansionState{ macros, hidesets_, tokens_, pastes_, {} };
+		auto expander = MacroExpander{ state, &src };
+		expander.Run(MacroIR{ &src.Consume(), kEmptyHideSet }, [&](const MacroIR& ir) {
+			// placemarkers only live during the expansion
+			if (ir.Tok->Tag != TokenTag::Placemarker)
+				output.push_back(*ir.Tok);
+		});
+
+		expansion_count_ += state.Expansions;
+	}
 }
\ No newline at end of file
@@ -1,34 +1,73 @@
 #pragma once
 #include "Basic.h"
 #include "Token.h"
-#include <vector>
+#include "Symbol.h"
+#include <cstdint>
 #include <deque>
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace lolita
 {
-	struct MacroIR;
 	struct MacroDescription;
 
-	using MacroArchive = std::unordered_map<std::string, MacroDescription>;
-	using MacroHideSet = std::vector<std::string>;
-	using MacroIRList = std::deque<MacroIR>;
-	using MacroArgument = std::pair<std::string, MacroIRList>;
-	using MacroArgsMap = std::vector<MacroArgument>;
+	// id of a hide set in a HideSetTable
+	using HideSetId = uint32_t;
+
+	constexpr HideSetId kEmptyHideSet = 0;
 
+	// A token during macro expansion
+	// NOTE the token is owned by the input, a macro definition or the MacroEngine
 	struct MacroIR
 	{
-		Token Tok;
+		const Token* Tok;
 
-		MacroHideSet HideSet;
+		HideSetId HideSet;
+	};
+
+	using MacroIRList = std::vector<MacroIR>;
+
+	// Hash-consed hide sets, where equal sets always share the same id
+	// NOTE a set is immutable once created, and results of operations are memoized
+	class HideSetTable
+	{
+	public:
+		HideSetTable()
+		{
+			Intern({});
+		}
+
+		bool Contains(HideSetId set, SymbolId name) const;
+
+		HideSetId Insert(HideSetId set, SymbolId name);
+		HideSetId Union(HideSetId lhs, HideSetId rhs);
+		HideSetId Intersect(HideSetId lhs, HideSetId rhs);
+
+	private:
+		struct NamesHash
+		{
+			size_t operator()(const std::vector<SymbolId>& names) const;
+		};
+
+		HideSetId Intern(std::vector<SymbolId> names);
+
+		// sorted names of each set, pointing to keys of lookup_
+		std::vector<const std::vector<SymbolId>*> sets_;
+		std::unordered_map<std::vector<SymbolId>, HideSetId, NamesHash> lookup_;
+
+		std::unordered_map<uint64_t, HideSetId> insert_memo_;
+		std::unordered_map<uint64_t, HideSetId> union_memo_;
+		std::unordered_map<uint64_t, HideSetId> intersect_memo_;
 	};
 
 	// A description to a custom macro
 	struct MacroDescription
 	{
-		std::string Name;
+		SymbolId Name;
 
-		StringVec Params;
+		std::vector<SymbolId> Params;
 
 		bool ObjectLike;
 
@@ -37,5 +76,97 @@ namespace lolita
 		std::vector<Token> Expansion;
 	};
 
-	std::vector<Token> ExpandMacro(TokenSource& src, const MacroArchive& macros, bool obj_like);
+	// Macro definitions indexed by the symbol of their names
+	class MacroArchive
+	{
+	public:
+		const MacroDescription* Lookup(SymbolId name) const
+		{
+			return name < macros_.size() ? macros_[name].get() : nullptr;
+		}
+
+		// NOTE a definition is immutable, so it can be shared by archives
+		std::shared_ptr<const MacroDescription> LookupShared(SymbolId name) const
+		{
+			return name < macros_.size() ? macros_[name] : nullptr;
+		}
+
+		void Define(MacroDescription macro)
+		{
+			Define(std::make_shared<const MacroDescription>(std::move(macro)));
+		}
+
+		void Define(std::shared_ptr<const MacroDescription> macro)
+		{
+			auto name = macro->Name;
+			if (name >= macros_.size())
+			{
+				macros_.resize(name + 1);
+				defined_.resize(name + 1);
+			}
+
+			macros_[name] = std::move(macro);
+			defined_[name] = true;
+		}
+
+		void Undefine(SymbolId name)
+		{
+			if (name < macros_.size())
+				macros_[name] = nullptr;
+		}
+
+		// all definitions, in the order of their names
+		std::vector<std::shared_ptr<const MacroDescription>> Definitions() const
+		{
+			auto result = std::vector<std::shared_ptr<const MacroDescription>>{};
+			for (const auto& macro : macros_)
+			{
+				if (macro)
+					result.push_back(macro);
+			}
+
+			return result;
+		}
+
+		// names of macros that have ever been defined, even if undefined later, sorted
+		std::vector<SymbolId> EverDefined() const
+		{
+			auto result = std::vector<SymbolId>{};
+			for (auto name = SymbolId{ 0 }; name < defined_.size(); ++name)
+			{
+				if (defined_[name])
+					result.push_back(name);
+			}
+
+			return result;
+		}
+
+	private:
+		std::vector<std::shared_ptr<const MacroDescription>> macros_;
+
+		// if a macro of the name has ever been defined
+		std::vector<bool> defined_;
+	};
+
+	// Expands macro invocations in a translation unit
+	// NOTE hide sets and results of ## are kept across expansions, and tokens created are kept
+	//      until the next expansion, so that rescanning refers to tokens instead of copying
+	class MacroEngine
+	{
+	public:
+		// expand the macro invocation at the front of $src, appending the result to $output
+		void Expand(TokenSource& src, const MacroArchive& macros, TokenVec& output);
+
+		// number of macro invocations expanded, including those nested
+		size_t ExpansionCount() const { return expansion_count_; }
+
+	private:
+		size_t expansion_count_ = 0;
+
+		HideSetTable hidesets_;
+		std::deque<Token> tokens_;
+
+		// tokens formed by ##, keyed by the text concatenated
+		std::unordered_map<std::string, Token> pastes_;
+	};
 }
\ No newline at end of file
@@ -1,28 +1,17 @@
 #include "Parser.h"
 #include "ParserImpl.h"
-#include "AstManip.h"
-#include <stack>
-#include <unordered_map>
-#include <optional>
+#include <memory>
 
 using namespace std;
 
 namespace lolita
 {
-	ParseTree ParseTranslationUnit(const TokenVec& src)
+	ParseTree::Ptr ParseTranslationUnit(const TokenBuffer& src)
 	{
-		TokenSource reader{ src };
-		reader.Try(TokenTag::LBrace);
-		ParserImpl parser{reader};
+		auto reader = TokenBufferSource{ src };
+		auto parser = ParserImpl{ reader };
 
-		auto result = parser.ParseTranslationUnit();
-		for (auto decl : result)
-		{
-			Print(decl);
-		}
-
-		auto& types = GetTypeTable();
-		system("pause");
-		throw 0;
+		auto root = parser.GroupTopLevelDecls(parser.ParseTranslationUnit());
+		return make_unique<ParseTree>(parser.ReleaseArena(), root);
 	}
 }
\ No newline at end of file
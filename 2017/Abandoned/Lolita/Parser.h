@@ -1,6 +1,7 @@
 #pragma once
 #include "TranslationContext.h"
 #include "Token.h"
+#include "TokenBuffer.h"
 #include "AstObject.h"
 #include "AstArena.h"
 #include <memory>
@@ -8,6 +9,16 @@
 
 namespace lolita
 {
+	// A top-level declaration, and the range of tokens it's parsed from
+	struct TopLevelDecl
+	{
+		// nullptr if tokens are exhausted
+		DeclBase* Decl;
+
+		size_t Begin;
+		size_t End;
+	};
+
 	class ParseTree
 	{
 	public:
@@ -25,10 +36,16 @@ namespace lolita
 			return root_;
 		}
 
+		const AstArena& Arena() const
+		{
+			return arena_;
+		}
+
 	private:
 		AstArena arena_;
 		AstObject *root_;
 	};
 
-	ParseTree::Ptr ParseTranslationUnit(const TokenVec& src);
+	// parse preprocessed tokens, whose root is a GroupDecl of top-level declarations
+	ParseTree::Ptr ParseTranslationUnit(const TokenBuffer& src);
 }
\ No newline at end of file
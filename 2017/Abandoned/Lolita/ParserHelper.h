@@ -1,6 +1,7 @@
 #pragma once
 #include "Token.h"
 #include "AstModel.h"
+#include <array>
 #include <optional>
 
 namespace lolita
@@ -112,4 +113,100 @@ namespace lolita
 		// NOTE this heavily depends on how BinaryOp is defined
 		return op >= BinaryOp::Assign;
 	}
+
+	// binding power of an operator in an expression, where a higher one binds tighter
+	// NOTE assignment and conditional operators are right associative, and the others are left
+	enum class Precedence
+	{
+		None,
+		Assignment,
+		Conditional,
+		LogicalOr,
+		LogicalAnd,
+		BitwiseOr,
+		BitwiseXor,
+		BitwiseAnd,
+		Equality,
+		Relational,
+		Shift,
+		Additive,
+		Multiplicative,
+	};
+
+	constexpr inline
+	Precedence GetPrecedence(TokenTag tag)
+	{
+		switch (tag)
+		{
+		case TokenTag::Asterisk:
+		case TokenTag::Slash:
+		case TokenTag::Modulus:
+			return Precedence::Multiplicative;
+		case TokenTag::Plus:
+		case TokenTag::Minus:
+			return Precedence::Additive;
+		case TokenTag::LShift:
+		case TokenTag::RShift:
+			return Precedence::Shift;
+		case TokenTag::Less:
+		case TokenTag::Greater:
+		case TokenTag::LessEqual:
+		case TokenTag::GreaterEqual:
+			return Precedence::Relational;
+		case TokenTag::Equal:
+		case TokenTag::Unequal:
+			return Precedence::Equality;
+		case TokenTag::Ampersand:
+			return Precedence::BitwiseAnd;
+		case TokenTag::Caret:
+			return Precedence::BitwiseXor;
+		case TokenTag::Pipe:
+			return Precedence::BitwiseOr;
+		case TokenTag::DoubleAmp:
+			return Precedence::LogicalAnd;
+		case TokenTag::DoublePipe:
+			return Precedence::LogicalOr;
+		case TokenTag::Question:
+			return Precedence::Conditional;
+		default:
+			// NOTE of binary operators, only assignments are left here, member access is postfix
+			auto op = TranslateBinaryOp(tag);
+			return op && IsAssignmentOp(*op) ? Precedence::Assignment : Precedence::None;
+		}
+	}
+
+	// An infix operator that a token stands for
+	struct InfixOperator
+	{
+		Precedence Prec;
+
+		// NOTE meaningless for Precedence::None and Precedence::Conditional
+		BinaryOp Op;
+	};
+
+	constexpr size_t kTokenTagCount = static_cast<size_t>(TokenTag::StringLiteral) + 1;
+
+	constexpr inline
+	std::array<InfixOperator, kTokenTagCount> MakeInfixOperatorTable()
+	{
+		auto table = std::array<InfixOperator, kTokenTagCount>{};
+		for (size_t i = 0; i < kTokenTagCount; ++i)
+		{
+			auto tag = static_cast<TokenTag>(i);
+			auto op = TranslateBinaryOp(tag);
+
+			table[i] = InfixOperator{ GetPrecedence(tag), op ? *op : BinaryOp{} };
+		}
+
+		return table;
+	}
+
+	// infix operators indexed by TokenTag, so that an expression is parsed with a lookup per token
+	inline constexpr auto kInfixOperatorTable = MakeInfixOperatorTable();
+
+	constexpr inline
+	const InfixOperator& LookupInfixOperator(TokenTag tag)
+	{
+		return kInfixOperatorTable[static_cast<size_t>(tag)];
+	}
 }
\ No newline at end of file
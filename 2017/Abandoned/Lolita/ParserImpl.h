@@ -4,6 +4,8 @@
 #include "Token.h"
 #include "AstBuilder.h"
 #include "Decl.h"
+#include "Parser.h"
+#include "ParserHelper.h"
 #include "Error.h"
 #include <memory>
 #include <string>
@@ -270,7 +272,7 @@ namespace lolita
 	class ParserImpl
 	{
 	public:
-		ParserImpl(TokenSource& src)
+		ParserImpl(TokenBufferSource& src)
 			: src_(src) { }
 
 		// Parsing Translation Unit
@@ -279,8 +281,27 @@ namespace lolita
 		DeclBase* ParseStaticAssert();
 
 		DeclBase* ParseDeclaration(FunctionSpecifier* func, StorageSpecifier* storage);
+		TopLevelDecl ParseTopLevelDecl();
 		std::vector<DeclBase*> ParseTranslationUnit();
 
+		// make the root of a translation unit
+		DeclBase* GroupTopLevelDecls(const std::vector<DeclBase*>& decls)
+		{
+			return builder_.NewGroupDecl(decls);
+		}
+
+		// take the arena where nodes parsed are allocated
+		AstArena ReleaseArena()
+		{
+			return std::move(builder_.Arena());
+		}
+
+		// make names declared by a top-level declaration parsed before visible
+		void RedeclareTopLevel(const DeclBase* decl)
+		{
+			builder_.RedeclareTopLevel(decl);
+		}
+
 		// Parsing Type
 		//
 
@@ -313,49 +334,12 @@ namespace lolita
 		ExprBase* ParsePostfixExpr();
 		ExprBase* ParseUnaryExpr();
 		ExprBase* ParseCastExpr();
-		ExprBase* ParseMultiplicativeExpr();
-		ExprBase* ParseAdditiveExpr();
-		ExprBase* ParseShiftExpr();
-		ExprBase* ParseRelationalExpr();
-		ExprBase* ParseEqualityExpr();
-		ExprBase* ParseBitwiseAndExpr();
-		ExprBase* ParseBitwiseXorExpr();
-		ExprBase* ParseBitwiseOrExpr();
-		ExprBase* ParseLogicalAndExpr();
-		ExprBase* ParseLogicalOrExpr();
+		ExprBase* ParseInfixExpr(Precedence min_prec);
 		ExprBase* ParseConditionalExpr();
 		ExprBase* ParseAssignmentExpr();
 		ExprBase* ParseCommaExpr();
 		ExprBase* ParseExpr();
 
-		// assuming left associativity
-		template <ExprBase* (ParserImpl::*NextParseFunc)(), TokenTag ... Ps>
-		ExprBase* ParseNaiveBinaryExpr()
-		{
-			ExprBase* lhs = (this->*NextParseFunc)();
-			while (!src_.Exhausted())
-			{
-				auto tok = src_.Peek();
-				auto ps = initializer_list<TokenTag>{ Ps... };
-				auto iter = find(ps.begin(), ps.end(), tok.Tag);
-				if (iter != ps.end())
-				{
-					// consume the token
-					src_.Consume();
-					// prepare other parts of the expression
-					BinaryOp op = *TranslateBinaryOp(*iter);
-					ExprBase* rhs = (this->*NextParseFunc)();
-					// construct expression
-					lhs = arena_.NewBinaryExpr(op, lhs, rhs);
-					continue;
-				}
-
-				break;
-			}
-
-			return lhs;
-		}
-
 		// Parsing Stmt
 		//
 		StmtBase* ParseDeclStmt();
@@ -372,13 +356,15 @@ namespace lolita
 	private:
 		// Utils
 		//
-		bool DetectExpression()
+		// if a token of $tag starts an expression rather than a type name
+		bool DetectExpression(TokenTag tag)
 		{
-			switch (src_.Peek().Tag)
+			switch (tag)
 			{
 			case TokenTag::Identifier:
 				// FIXME: check declarations
 				return true;
+			case TokenTag::LParenthesis:
 			case TokenTag::IntegerConst:
 			case TokenTag::FloatConst:
 			case TokenTag::CharConst:
@@ -391,6 +377,9 @@ namespace lolita
 			case TokenTag::Tlide:
 			case TokenTag::Increment:
 			case TokenTag::Decrement:
+			case TokenTag::Sizeof:
+			case TokenTag::Alignof:
+			case TokenTag::Generic:
 				return true;
 			default:
 				return false;
@@ -407,13 +396,8 @@ namespace lolita
 
 		// ======================================
 
-		TokenSource src_;
+		TokenBufferSource src_;
 
 		AstBuilder builder_;
-		
-		// remove fields below
-		AstArena arena_;
-		Scope* file_scope_;
-		Scope* local_scope_;
 	};
 }
\ No newline at end of file
@@ -30,9 +30,12 @@ namespace lolita
 				}
 
 				// function definition
-				src_.Consume(); // consume {
+				src_.Skip(); // consume {
+				builder_.EnterFunction(static_cast<FunctionType*>(decl_type.first.Type), param_annot);
 				auto body = ParseCompoundStmt();
-				return arena_.NewFunctionDecl(decl_type.first.Type, *decl_type.second, body);
+				builder_.ExitFunction();
+
+				return builder_.NewFunctionDecl(decl_type.first.Type, *decl_type.second, body);
 			}
 
 			auto init = static_cast<ExprBase*>(nullptr);
@@ -41,7 +44,8 @@ namespace lolita
 				init = ParseAssignmentExpr();
 			}
 
-			decls.push_back(arena_.NewVariableDecl(decl_type.first, *decl_type.second, init));
+			auto decl_storage = storage ? *storage : StorageSpecifier::None;
+			decls.push_back(builder_.NewVariableDecl(decl_type.first, *decl_type.second, decl_storage, init));
 			first_run = false;
 		} while (src_.Try(TokenTag::Comma));
 
@@ -54,29 +58,44 @@ namespace lolita
 		}
 		else
 		{
-			return arena_.NewGroupDecl(decls);
+			return builder_.NewGroupDecl(decls);
 		}
 	}
 
+	TopLevelDecl ParserImpl::ParseTopLevelDecl()
+	{
+		// skip empty declarations
+		while (src_.Try(TokenTag::Semicolon)) { }
+
+		auto begin = src_.Position();
+		if (src_.Exhausted())
+			return TopLevelDecl{ nullptr, begin, begin };
+
+		DeclBase* decl;
+		if (src_.Try(TokenTag::StaticAssert))
+		{
+			decl = ParseStaticAssert();
+		}
+		else
+		{
+			// NOTE storage class is kept, e.g. so that a typedef name is not taken as a variable
+			auto func = FunctionSpecifier{};
+			auto storage = StorageSpecifier::None;
+			decl = ParseDeclaration(&func, &storage);
+		}
+
+		return TopLevelDecl{ decl, begin, src_.Position() };
+	}
+
 	std::vector<DeclBase*> ParserImpl::ParseTranslationUnit()
 	{
 		std::vector<DeclBase*> result;
 
 		try
 		{
-			while (!src_.Exhausted())
+			for (auto decl = ParseTopLevelDecl(); decl.Decl; decl = ParseTopLevelDecl())
 			{
-				if (src_.Try(TokenTag::Semicolon))
-					continue;
-
-				if (src_.Try(TokenTag::StaticAssert))
-				{
-					result.push_back(ParseStaticAssert());
-				}
-				else
-				{
-					result.push_back(ParseDeclaration());
-				}
+				result.push_back(decl.Decl);
 			}
 		}
 		catch (const ParsingError& error)
@@ -18,27 +18,26 @@ namespace lolita
 
 	ExprBase* ParserImpl::ParsePrimaryExpr()
 	{
-		auto& tok = src_.Peek();
-
 		if (src_.Try(TokenTag::Identifier))
 		{
-			return builder_.NewVariableExpr(tok.Content);
+			builder_.AnnotateLocation(src_.LastConsumed().Location);
+			return builder_.NewVariableExpr(src_.LastConsumedSymbol());
 		}
 		else if (src_.Try(TokenTag::IntegerConst))
 		{
-			return builder_.NewLiteralExpr(ParseIntegerConst(tok));
+			return builder_.NewLiteralExpr(ParseIntegerConst(src_.LastConsumedContent()));
 		}
 		else if (src_.Try(TokenTag::FloatConst))
 		{
-			return builder_.NewLiteralExpr(ParseFloatConst(tok));
+			return builder_.NewLiteralExpr(ParseFloatConst(src_.LastConsumedContent()));
 		}
 		else if (src_.Try(TokenTag::CharConst))
 		{
-			return builder_.NewLiteralExpr(ParseCharConst(tok));
+			return builder_.NewLiteralExpr(ParseCharConst(src_.LastConsumedContent()));
 		}
 		else if (src_.Try(TokenTag::StringLiteral))
 		{
-			return builder_.NewLiteralExpr(ParseStringLiteral(tok));
+			return builder_.NewLiteralExpr(ParseStringLiteral(src_.LastConsumedContent()));
 		}
 		else if (src_.Try(TokenTag::Generic))
 		{
@@ -97,13 +96,13 @@ namespace lolita
 			{
 				// member access
 				ExpectToken(TokenTag::Identifier);
-				expr = builder_.NewAccessExpr(expr, src_.LastConsumed().Content, false);
+				expr = builder_.NewAccessExpr(expr, string{ src_.LastConsumedContent() }, false);
 			}
 			else if (src_.Try(TokenTag::Arrow))
 			{
 				// ptr member access
 				ExpectToken(TokenTag::Identifier);
-				expr = builder_.NewAccessExpr(expr, src_.LastConsumed().Content, true);
+				expr = builder_.NewAccessExpr(expr, string{ src_.LastConsumedContent() }, true);
 			}
 			else if (src_.Try(TokenTag::Increment))
 			{
@@ -131,14 +130,16 @@ namespace lolita
 		}
 		else if (src_.Try(TokenTag::Sizeof))
 		{
+			builder_.AnnotateLocation(src_.LastConsumed().Location);
+
 			if (src_.Try(TokenTag::LParenthesis))
 			{
-				if (DetectExpression())
+				if (DetectExpression(src_.PeekTag()))
 				{
 					auto expr = ParseExpr();
 					ExpectToken(TokenTag::RParenthesis);
 
-					return builder_.NewSizeOfExpr(expr.Type);
+					return builder_.NewSizeOfExpr(expr->GetType());
 				}
 				else
 				{
@@ -151,11 +152,13 @@ namespace lolita
 			else
 			{
 				auto expr = ParseUnaryExpr();
-				return builder_.NewSizeOfExpr(expr.type);
+				return builder_.NewSizeOfExpr(expr->GetType());
 			}
 		}
 		else if (src_.Try(TokenTag::Alignof))
 		{
+			builder_.AnnotateLocation(src_.LastConsumed().Location);
+
 			ExpectToken(TokenTag::LParenthesis);
 			auto type = ParseTypeName();
 			ExpectToken(TokenTag::RParenthesis);
@@ -164,7 +167,7 @@ namespace lolita
 		}
 		else
 		{
-			switch (src_.Peek().Tag)
+			switch (src_.PeekTag())
 			{
 			case TokenTag::Ampersand:
 			case TokenTag::Asterisk:
@@ -173,7 +176,9 @@ namespace lolita
 			case TokenTag::Tlide:
 			case TokenTag::Exclamation:
 			{
-				auto tag = src_.Consume().Tag;
+				auto tag = src_.PeekTag();
+				src_.Skip();
+
 				return builder_.NewUnaryExpr(*TranslateUnaryOp(tag), ParseCastExpr());
 			}
 			default:
@@ -183,119 +188,69 @@ namespace lolita
 	}
 	ExprBase* ParserImpl::ParseCastExpr()
 	{
-		if (src_.Try(TokenTag::LParenthesis))
+		// NOTE a parenthesized expression is left to ParsePrimaryExpr
+		if (src_.Test(TokenTag::LParenthesis) && !DetectExpression(src_.LookAheadTag(1)))
 		{
+			src_.Skip();
 			auto type = ParseTypeName();
 			ExpectToken(TokenTag::RParenthesis);
 			auto expr = ParseCastExpr();
 
-			return builder_.NewCastExpr(type, expr);
+			return builder_.NewCastExpr(type.Type, expr);
 		}
 		else
 		{
 			return ParseUnaryExpr();
 		}
 	}
-	ExprBase* ParserImpl::ParseMultiplicativeExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseCastExpr,
-			TokenTag::Asterisk,
-			TokenTag::Slash>();
-	}
-	ExprBase* ParserImpl::ParseAdditiveExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseMultiplicativeExpr,
-			TokenTag::Plus,
-			TokenTag::Minus>();
-	}
-	ExprBase* ParserImpl::ParseShiftExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseAdditiveExpr,
-			TokenTag::LShift,
-			TokenTag::RShift>();
-	}
-	ExprBase* ParserImpl::ParseRelationalExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseShiftExpr,
-			TokenTag::Less,
-			TokenTag::LessEqual,
-			TokenTag::Greater,
-			TokenTag::GreaterEqual>();
-	}
-	ExprBase* ParserImpl::ParseEqualityExpr()
+	// parse an expression of operators that bind at least as tight as $min_prec
+	// NOTE operands are parsed by precedence climbing with a table lookup per operator,
+	//      instead of descending a function per precedence level
+	ExprBase* ParserImpl::ParseInfixExpr(Precedence min_prec)
 	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseRelationalExpr,
-			TokenTag::Equal,
-			TokenTag::Unequal>();
-	}
-	ExprBase* ParserImpl::ParseBitwiseAndExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseEqualityExpr,
-			TokenTag::Ampersand>();
-	}
-	ExprBase* ParserImpl::ParseBitwiseXorExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseBitwiseAndExpr,
-			TokenTag::Caret>();
-	}
-	ExprBase* ParserImpl::ParseBitwiseOrExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseBitwiseXorExpr,
-			TokenTag::Pipe>();
-	}
-	ExprBase* ParserImpl::ParseLogicalAndExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseBitwiseOrExpr,
-			TokenTag::DoubleAmp>();
-	}
-	ExprBase* ParserImpl::ParseLogicalOrExpr()
-	{
-		return ParseNaiveBinaryExpr<
-			&ParserImpl::ParseLogicalAndExpr,
-			TokenTag::DoublePipe>();
-	}
-	ExprBase* ParserImpl::ParseConditionalExpr()
-	{
-		ExprBase *maybe_condition = ParseLogicalOrExpr();
-		if (src_.Try(TokenTag::Question))
+		ExprBase *lhs = ParseCastExpr();
+		for (;;)
 		{
-			ExprBase *positive_branch = ParseCommaExpr();
-			ExpectToken(TokenTag::Colon);
-			ExprBase *negative_branch = ParseConditionalExpr();
+			const auto& infix = LookupInfixOperator(src_.PeekTag());
+			if (infix.Prec == Precedence::None || infix.Prec < min_prec)
+				return lhs;
 
-			return builder_.NewConditionalExpr(maybe_condition, positive_branch, negative_branch);
-		}
+			// consume the operator
+			src_.Skip();
 
-		// not a conditional-expression
-		return maybe_condition;
-	}
-	ExprBase* ParserImpl::ParseAssignmentExpr()
-	{
-		ExprBase *lhs = ParseConditionalExpr();
+			if (infix.Prec == Precedence::Conditional)
+			{
+				ExprBase *positive_branch = ParseCommaExpr();
+				ExpectToken(TokenTag::Colon);
+				// right associative
+				ExprBase *negative_branch = ParseInfixExpr(Precedence::Conditional);
 
-		auto assign_op = TranslateBinaryOp(src_.Peek().Tag);
-		if (assign_op && IsAssignmentOp(*assign_op))
-		{
-			// consume the assign op
-			src_.Consume();
-			// parse rhs
-			// NOTE must call ParseAssignmentExpr here for right associativity
-			ExprBase *rhs = ParseAssignmentExpr();
+				lhs = builder_.NewConditionalExpr(lhs, positive_branch, negative_branch);
+			}
+			else if (infix.Prec == Precedence::Assignment)
+			{
+				// right associative
+				ExprBase *rhs = ParseInfixExpr(Precedence::Assignment);
 
-			return builder_.NewBinaryExpr(*assign_op, lhs, rhs);
-		}
+				lhs = builder_.NewBinaryExpr(infix.Op, lhs, rhs);
+			}
+			else
+			{
+				// left associative, so rhs only takes operators that bind tighter
+				auto next_prec = static_cast<Precedence>(static_cast<int>(infix.Prec) + 1);
+				ExprBase *rhs = ParseInfixExpr(next_prec);
 
-		// not an assignment-expression
-		return lhs;
+				lhs = builder_.NewBinaryExpr(infix.Op, lhs, rhs);
+			}
+		}
+	}
+	ExprBase* ParserImpl::ParseConditionalExpr()
+	{
+		return ParseInfixExpr(Precedence::Conditional);
+	}
+	ExprBase* ParserImpl::ParseAssignmentExpr()
+	{
+		return ParseInfixExpr(Precedence::Assignment);
 	}
 	ExprBase* ParserImpl::ParseCommaExpr()
 	{
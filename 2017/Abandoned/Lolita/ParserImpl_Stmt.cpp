@@ -35,8 +35,7 @@ namespace lolita
 
 		ExpectToken(TokenTag::Semicolon);
 
-		// local_scope_->DeclareEntity(name, type, storage);
-		return arena_.NewDeclStmt(type.first, *type.second, nullptr);
+		return builder_.NewDeclStmt(type.first, *type.second, storage, value);
 	}
 
 	StmtBase* ParserImpl::ParseExprStmt()
@@ -44,7 +43,7 @@ namespace lolita
 		auto expr = ParseExpr();
 		ExpectToken(TokenTag::Semicolon);
 
-		return arena_.NewExprStmt(expr);
+		return builder_.NewExprStmt(expr);
 	}
 	StmtBase* ParserImpl::ParseIfStmt()
 	{
@@ -63,7 +62,7 @@ namespace lolita
 			no_stmt = ParseStmt();
 		}
 
-		return arena_.NewIfStmt(expr, yes_stmt, no_stmt);
+		return builder_.NewIfStmt(expr, yes_stmt, no_stmt);
 	}
 	StmtBase* ParserImpl::ParseSwitchStmt()
 	{
@@ -83,7 +82,7 @@ namespace lolita
 		ExpectToken(TokenTag::RParenthesis);
 		auto body = ParseStmt();
 
-		return arena_.NewWhileStmt(cond, body);
+		return builder_.NewWhileStmt(cond, body);
 	}
 	StmtBase* ParserImpl::ParseDoWhileStmt()
 	{
@@ -94,13 +93,16 @@ namespace lolita
 	{
 		assert(src_.LastConsumed().Tag == TokenTag::LBrace);
 
+		builder_.EnterScope(ScopeCategory::Block);
+
 		vector<StmtBase*> children;
 		while (!src_.Try(TokenTag::RBrace))
 		{
 			children.push_back(ParseStmt());
 		}
 
-		return arena_.NewCompoundStmt(move(children));
+		builder_.ExitScope();
+		return builder_.NewCompoundStmt(move(children));
 	}
 	StmtBase* ParserImpl::ParseUnlabelledStmt()
 	{
@@ -128,20 +130,20 @@ namespace lolita
 		else if (src_.Try(TokenTag::Goto))
 		{
 			ExpectToken(TokenTag::Identifier);
-			auto label_name = src_.LastConsumed().Content;
+			auto label_name = string{ src_.LastConsumedContent() };
 			ExpectToken(TokenTag::Semicolon);
 
-			return arena_.NewGotoStmt(label_name);
+			return builder_.NewGotoStmt(label_name);
 		}
 		else if (src_.Try(TokenTag::Break))
 		{
 			ExpectToken(TokenTag::Semicolon);
-			return arena_.NewBreakStmt();
+			return builder_.NewBreakStmt();
 		}
 		else if (src_.Try(TokenTag::Continue))
 		{
 			ExpectToken(TokenTag::Semicolon);
-			return arena_.NewContinueStmt();
+			return builder_.NewContinueStmt();
 		}
 		else if (src_.Try(TokenTag::Return))
 		{
@@ -152,7 +154,7 @@ namespace lolita
 			}
 
 			ExpectToken(TokenTag::Semicolon);
-			return arena_.NewReturnStmt(expr);
+			return builder_.NewReturnStmt(expr);
 		}
 		else if (src_.Try(TokenTag::LBrace))
 		{
@@ -161,11 +163,11 @@ namespace lolita
 		else if (src_.Try(TokenTag::Semicolon))
 		{
 			// empty statement
-			return arena_.NewExprStmt(nullptr);
+			return builder_.NewExprStmt(nullptr);
 		}
 		else
 		{
-			if (DetectExpression())
+			if (DetectExpression(src_.PeekTag()))
 				return ParseExprStmt();
 			else
 				return ParseDeclStmt();
@@ -173,11 +175,11 @@ namespace lolita
 	}
 	StmtBase* ParserImpl::ParseStmt()
 	{
-		StringVec labels;
-		while (src_.LookAhead(1).Tag == TokenTag::Colon)
+		vector<SymbolId> labels;
+		while (src_.LookAheadTag(1) == TokenTag::Colon)
 		{
 			ExpectToken(TokenTag::Identifier);
-			labels.push_back(src_.LastConsumed().Content);
+			labels.push_back(src_.LastConsumedSymbol());
 
 			ExpectToken(TokenTag::Colon);
 		}
@@ -185,7 +187,7 @@ namespace lolita
 		// parse statement without labels
 		auto stmt = ParseUnlabelledStmt();
 		// assign labels
-		copy(labels.begin(), labels.end(), back_inserter(stmt->Labels));
+		builder_.AnnotateLabels(stmt, labels);
 
 		return stmt;
 	}
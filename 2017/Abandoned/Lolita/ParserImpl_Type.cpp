@@ -13,8 +13,7 @@ namespace lolita
 
 	bool ParserImpl::TryAppendQual(TypeQualifier& quals)
 	{
-		const auto& tok = src_.Peek();
-		switch (tok.Tag)
+		switch (src_.PeekTag())
 		{
 		case TokenTag::Const:
 			quals.Const = true;
@@ -33,23 +32,22 @@ namespace lolita
 			return false;
 		}
 
-		src_.Consume();
+		src_.Skip();
 		return true;
 	}
 
 	bool ParserImpl::TryAppendFuncSpec(FunctionSpecifier& spec)
 	{
-		const auto& tok = src_.Peek();
-		switch (tok.Tag)
+		switch (src_.PeekTag())
 		{
 		case TokenTag::Inline:
 			if (spec.Inline)
-				ReportError(tok.Location, "redundant inline");
+				ReportError(src_.Peek().Location, "redundant inline");
 			spec.Inline = true;
 			break;
 		case TokenTag::Noreturn:
 			if (spec.Noreturn)
-				ReportError(tok.Location, "redundant noreturn");
+				ReportError(src_.Peek().Location, "redundant noreturn");
 			spec.Noreturn = true;
 			break;
 
@@ -57,7 +55,7 @@ namespace lolita
 			return false;
 		}
 
-		src_.Consume();
+		src_.Skip();
 		return true;
 	}
 
@@ -65,7 +63,7 @@ namespace lolita
 	{
 		// parse token
 		auto tok_spec = StorageSpecifier::None;
-		switch (src_.Peek().Tag)
+		switch (src_.PeekTag())
 		{
 		case TokenTag::Typedef:
 			tok_spec = StorageSpecifier::Typedef;
@@ -87,9 +85,9 @@ namespace lolita
 		}
 
 		// consume the token anyway
-		const auto& tok = src_.Consume();
+		src_.Skip();
 		if (spec != StorageSpecifier::None)
-			ReportError(tok.Location, "redundant storage spec");
+			ReportError(src_.LastConsumed().Location, "redundant storage spec");
 		else
 			spec = tok_spec;
 
@@ -123,7 +121,7 @@ namespace lolita
 
 		while (true)
 		{
-			const auto& tok = src_.Peek();
+			// NOTE a specifier is consumed when it's reported, whose location is only looked up then
 			if (TryAppendQual(quals))
 			{
 				// do nothing
@@ -131,30 +129,30 @@ namespace lolita
 			else if (TryAppendFuncSpec(func))
 			{
 				if (!func_spec)
-					ReportError(tok.Location, "function specifier not expected");
+					ReportError(src_.LastConsumed().Location, "function specifier not expected");
 			}
 			else if (TryAppendStorageSpec(storage))
 			{
 				if (!storage_spec)
-					ReportError(tok.Location, "storage specifier not expected");
+					ReportError(src_.LastConsumed().Location, "storage specifier not expected");
 			}
 			else if (TryAppendAlignas(align))
 			{
 				if (!align_spec)
-					ReportError(tok.Location, "alignment specifier not expected");
+					ReportError(src_.LastConsumed().Location, "alignment specifier not expected");
 			}
 			else if (src_.Try(TokenTag::ThreadLocal))
 			{
 				if (thd_local_spec)
 				{
 					if (thd_local)
-						ReportError(tok.Location, "redundant _Thread_local");
+						ReportError(src_.LastConsumed().Location, "redundant _Thread_local");
 
 					thd_local = true;
 				}
 				else
 				{
-					ReportError(tok.Location, "storage specifier not expected");
+					ReportError(src_.LastConsumed().Location, "storage specifier not expected");
 				}
 			}
 			else if (src_.Try(TokenTag::Struct))
@@ -180,10 +178,10 @@ namespace lolita
 					TokenTag::Signed, TokenTag::Unsigned,
 					TokenTag::Float, TokenTag::Double,
 				};
-				auto iter = find(ps.begin(), ps.end(), tok.Tag);
+				auto iter = find(ps.begin(), ps.end(), src_.PeekTag());
 				if (iter != ps.end())
 				{
-					src_.Consume();
+					src_.Skip();
 					type.Feed(*iter);
 				}
 				else
@@ -244,7 +242,7 @@ namespace lolita
 		if (src_.Try(TokenTag::Identifier))
 		{
 			// declarator name found
-			name = src_.LastConsumed().Content;
+			name = src_.LastConsumedContent();
 		}
 		else if (src_.Try(TokenTag::LParenthesis))
 		{
@@ -0,0 +1,413 @@
+#include "PrecompiledHeader.h"
+#include "Symbol.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace lolita
+{
+	// Binary Layout
+	//
+	// PchHeader
+	// uint32_t[StringCount + 1]		offsets of strings in the blob
+	// char[StringBytes]				blob of strings, padded to 4 bytes
+	// PchFile[FileCount]
+	// PchToken[TokenCount]				tokens yielded
+	// PchToken[ExpansionCount]			replacement lists of macros
+	// PchMacro[MacroCount]
+	// uint32_t[ParamCount]				parameters of macros, as string indices
+	// uint32_t[OnceCount]				paths of headers with #pragma once, as string indices
+	//
+	// NOTE fields are in the native byte order, so a file only works for the same build
+
+	static constexpr char kPchMagic[8] = { 'L', 'O', 'L', 'I', 'T', 'A', 'P', 'H' };
+	static constexpr uint32_t kPchVersion = 2;
+	static constexpr uint32_t kPchNoFile = UINT32_MAX;
+
+	struct PchHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t StringCount;
+		uint64_t StringBytes;
+		uint32_t FileCount;
+		uint32_t TokenCount;
+		uint32_t ExpansionCount;
+		uint32_t MacroCount;
+		uint32_t ParamCount;
+		uint32_t OnceCount;
+	};
+
+	struct PchFile
+	{
+		uint32_t Name;
+		uint32_t Url;
+	};
+
+	enum PchTokenFlag : uint8_t
+	{
+		kPchStartOfLine = 1,
+		kPchSucceedingSpace = 2,
+		kPchHasSymbol = 4,
+	};
+
+	struct PchToken
+	{
+		uint16_t Tag;
+		uint8_t Flags;
+		uint8_t Reserved;
+		uint32_t Content;
+		uint32_t File;
+		uint32_t Index;
+		uint32_t Line;
+		uint32_t Column;
+	};
+
+	struct PchMacro
+	{
+		uint32_t Name;
+		uint32_t ParamBegin;
+		uint32_t ParamCount;
+		uint32_t ExpansionBegin;
+		uint32_t ExpansionCount;
+		uint8_t ObjectLike;
+		uint8_t VaArgs;
+		uint16_t Reserved;
+	};
+
+	// Serialization
+	//
+
+	// flattens a snapshot into tables of the binary layout
+	class PchWriter
+	{
+	public:
+		uint32_t AddString(string_view s)
+		{
+			// NOTE views are stable while the snapshot is alive
+			auto iter = string_lookup_.find(s);
+			if (iter != string_lookup_.end())
+				return iter->second;
+
+			auto index = static_cast<uint32_t>(strings_.size());
+			string_lookup_.emplace(s, index);
+			strings_.push_back(s);
+
+			return index;
+		}
+
+		uint32_t AddFile(const SourceFile* file)
+		{
+			if (file == nullptr)
+				return kPchNoFile;
+
+			auto iter = file_lookup_.find(file);
+			if (iter != file_lookup_.end())
+				return iter->second;
+
+			auto index = static_cast<uint32_t>(files_.size());
+			file_lookup_.emplace(file, index);
+			files_.push_back(PchFile{ AddString(file->Name()), AddString(file->Url()) });
+
+			return index;
+		}
+
+		PchToken MakeToken(const Token& tok)
+		{
+			auto flags = uint8_t{ 0 };
+			flags |= tok.StartOfLine ? kPchStartOfLine : 0;
+			flags |= tok.SucceedingSpace ? kPchSucceedingSpace : 0;
+			flags |= tok.Symbol != kInvalidSymbol ? kPchHasSymbol : 0;
+
+			const auto& loc = tok.Location;
+			return PchToken{
+				static_cast<uint16_t>(tok.Tag), flags, 0, AddString(tok.Content),
+				AddFile(loc.File), loc.Index, loc.Line, loc.Column };
+		}
+
+		void AddToken(const Token& tok)
+		{
+			tokens_.push_back(MakeToken(tok));
+		}
+
+		void AddMacro(const MacroDescription& macro)
+		{
+			auto record = PchMacro{};
+			record.Name = AddString(SymbolText(macro.Name));
+			record.ParamBegin = static_cast<uint32_t>(params_.size());
+			record.ParamCount = static_cast<uint32_t>(macro.Params.size());
+			record.ExpansionBegin = static_cast<uint32_t>(expansions_.size());
+			record.ExpansionCount = static_cast<uint32_t>(macro.Expansion.size());
+			record.ObjectLike = macro.ObjectLike;
+			record.VaArgs = macro.VariadicArgs;
+
+			for (auto param : macro.Params)
+				params_.push_back(AddString(SymbolText(param)));
+			for (const auto& tok : macro.Expansion)
+				expansions_.push_back(MakeToken(tok));
+
+			macros_.push_back(record);
+		}
+
+		void AddOnceHeader(string_view name)
+		{
+			once_headers_.push_back(AddString(name));
+		}
+
+		bool Write(const string& url) const
+		{
+			auto header = PchHeader{};
+			memcpy(header.Magic, kPchMagic, sizeof(kPchMagic));
+			header.Version = kPchVersion;
+			header.StringCount = static_cast<uint32_t>(strings_.size());
+			header.FileCount = static_cast<uint32_t>(files_.size());
+			header.TokenCount = static_cast<uint32_t>(tokens_.size());
+			header.ExpansionCount = static_cast<uint32_t>(expansions_.size());
+			header.MacroCount = static_cast<uint32_t>(macros_.size());
+			header.ParamCount = static_cast<uint32_t>(params_.size());
+			header.OnceCount = static_cast<uint32_t>(once_headers_.size());
+
+			auto offsets = vector<uint32_t>{ 0 };
+			auto blob = string{};
+			for (auto s : strings_)
+			{
+				blob.append(s.data(), s.size());
+				offsets.push_back(static_cast<uint32_t>(blob.size()));
+			}
+
+			header.StringBytes = blob.size();
+			blob.resize((blob.size() + 3) & ~size_t{ 3 });
+
+			ofstream fs(url, ios::out | ios::binary | ios::trunc);
+			WriteArray(fs, &header, 1);
+			WriteArray(fs, offsets.data(), offsets.size());
+			WriteArray(fs, blob.data(), blob.size());
+			WriteArray(fs, files_.data(), files_.size());
+			WriteArray(fs, tokens_.data(), tokens_.size());
+			WriteArray(fs, expansions_.data(), expansions_.size());
+			WriteArray(fs, macros_.data(), macros_.size());
+			WriteArray(fs, params_.data(), params_.size());
+			WriteArray(fs, once_headers_.data(), once_headers_.size());
+
+			return static_cast<bool>(fs.flush());
+		}
+
+	private:
+		template <typename T>
+		static void WriteArray(ofstream& fs, const T* data, size_t count)
+		{
+			fs.write(reinterpret_cast<const char*>(data), sizeof(T) * count);
+		}
+
+		unordered_map<string_view, uint32_t> string_lookup_;
+		vector<string_view> strings_;
+
+		unordered_map<const SourceFile*, uint32_t> file_lookup_;
+		vector<PchFile> files_;
+
+		vector<PchToken> tokens_;
+		vector<PchToken> expansions_;
+		vector<PchMacro> macros_;
+		vector<uint32_t> params_;
+		vector<uint32_t> once_headers_;
+	};
+
+	// a bounds-checked cursor over a mapped file
+	class PchReader
+	{
+	public:
+		PchReader(string_view data)
+			: data_(data) { }
+
+		// returns nullptr if the file is too short
+		template <typename T>
+		const T* ReadArray(size_t count)
+		{
+			if (count > (data_.size() - pos_) / sizeof(T))
+				return nullptr;
+
+			// NOTE every section is aligned to 4 bytes, and the mapping to a page
+			auto result = reinterpret_cast<const T*>(data_.data() + pos_);
+			pos_ += sizeof(T) * count;
+
+			return count != 0 ? result : reinterpret_cast<const T*>(data_.data());
+		}
+
+	private:
+		string_view data_;
+		size_t pos_ = 0;
+	};
+
+	// Implementation of PrecompiledHeader
+	//
+
+	bool PrecompiledHeader::Save(const string& url) const
+	{
+		auto writer = PchWriter{};
+		for (const auto& tok : tokens_)
+			writer.AddToken(tok);
+		for (const auto& macro : macros_)
+			writer.AddMacro(*macro);
+		for (const auto& name : once_headers_)
+			writer.AddOnceHeader(name);
+
+		return writer.Write(url);
+	}
+
+	PrecompiledHeader::Ptr PrecompiledHeader::Load(const string& url)
+	{
+		// NOTE the mapping is kept by the result, as texts of tokens refer to the string table in place
+		auto mapping = FileMapping::Map(url, true);
+		if (mapping.Empty())
+			return nullptr;
+
+		auto reader = PchReader{ mapping.Data() };
+
+		auto header = reader.ReadArray<PchHeader>(1);
+		if (!header
+			|| memcmp(header->Magic, kPchMagic, sizeof(kPchMagic)) != 0
+			|| header->Version != kPchVersion)
+		{
+			return nullptr;
+		}
+
+		auto offsets = reader.ReadArray<uint32_t>(size_t{ header->StringCount } + 1);
+		auto blob = reader.ReadArray<char>((header->StringBytes + 3) & ~uint64_t{ 3 });
+		auto files = reader.ReadArray<PchFile>(header->FileCount);
+		auto tokens = reader.ReadArray<PchToken>(size_t{ header->TokenCount } + header->ExpansionCount);
+		auto macros = reader.ReadArray<PchMacro>(header->MacroCount);
+		auto params = reader.ReadArray<uint32_t>(header->ParamCount);
+		auto once_headers = reader.ReadArray<uint32_t>(header->OnceCount);
+		if (!offsets || !blob || !files || !tokens || !macros || !params || !once_headers)
+			return nullptr;
+
+		// validate tables before restoring anything
+		auto string_count = header->StringCount;
+		for (uint32_t i = 0; i < string_count; ++i)
+		{
+			if (offsets[i] > offsets[i + 1] || offsets[i + 1] > header->StringBytes)
+				return nullptr;
+		}
+		for (uint32_t i = 0; i < header->FileCount; ++i)
+		{
+			if (files[i].Name >= string_count || files[i].Url >= string_count)
+				return nullptr;
+		}
+		for (size_t i = 0; i < size_t{ header->TokenCount } + header->ExpansionCount; ++i)
+		{
+			const auto& tok = tokens[i];
+			if (tok.Tag > static_cast<uint16_t>(TokenTag::StringLiteral)
+				|| tok.Content >= string_count
+				|| (tok.File != kPchNoFile && tok.File >= header->FileCount))
+			{
+				return nullptr;
+			}
+		}
+		for (uint32_t i = 0; i < header->MacroCount; ++i)
+		{
+			const auto& macro = macros[i];
+			if (macro.Name >= string_count
+				|| macro.ParamCount > header->ParamCount - macro.ParamBegin
+				|| macro.ParamBegin > header->ParamCount
+				|| macro.ExpansionBegin > header->ExpansionCount
+				|| macro.ExpansionCount > header->ExpansionCount - macro.ExpansionBegin)
+			{
+				return nullptr;
+			}
+		}
+		for (uint32_t i = 0; i < header->ParamCount; ++i)
+		{
+			if (params[i] >= string_count)
+				return nullptr;
+		}
+		for (uint32_t i = 0; i < header->OnceCount; ++i)
+		{
+			if (once_headers[i] >= string_count)
+				return nullptr;
+		}
+
+		// restore
+		auto result = Ptr{ new PrecompiledHeader };
+
+		auto string_at = [&](uint32_t index) {
+			return string_view{ blob + offsets[index], offsets[index + 1] - offsets[index] };
+		};
+
+		// only identifiers are interned, lazily, as symbols are dense ids of the process
+		auto symbols = vector<SymbolId>(string_count, kInvalidSymbol);
+
+		auto symbol_at = [&](uint32_t index) {
+			if (symbols[index] == kInvalidSymbol)
+				symbols[index] = InternSymbol(string_at(index));
+
+			return symbols[index];
+		};
+
+		for (uint32_t i = 0; i < header->FileCount; ++i)
+		{
+			result->files_.push_back(SourceFile::Detached(
+				string{ string_at(files[i].Name) }, string{ string_at(files[i].Url) }));
+		}
+
+		auto restore_token = [&](const PchToken& record) {
+			auto tok = Token{};
+			tok.Tag = static_cast<TokenTag>(record.Tag);
+			tok.StartOfLine = (record.Flags & kPchStartOfLine) != 0;
+			tok.SucceedingSpace = (record.Flags & kPchSucceedingSpace) != 0;
+			tok.Location.Index = record.Index;
+			tok.Location.Line = record.Line;
+			tok.Location.Column = record.Column;
+			tok.Location.File = record.File != kPchNoFile ? result->files_[record.File].get() : nullptr;
+
+			if (record.Flags & kPchHasSymbol)
+			{
+				// identifiers share the text in the symbol table
+				tok.Symbol = symbol_at(record.Content);
+				tok.Content = SymbolText(tok.Symbol);
+			}
+			else
+			{
+				// other text is a view into the mapping
+				tok.Content = string_at(record.Content);
+			}
+
+			return tok;
+		};
+
+		result->tokens_.reserve(header->TokenCount);
+		for (uint32_t i = 0; i < header->TokenCount; ++i)
+		{
+			result->tokens_.push_back(restore_token(tokens[i]));
+		}
+
+		auto expansions = tokens + header->TokenCount;
+		for (uint32_t i = 0; i < header->MacroCount; ++i)
+		{
+			const auto& record = macros[i];
+
+			auto macro = MacroDescription{};
+			macro.Name = symbol_at(record.Name);
+			macro.ObjectLike = record.ObjectLike != 0;
+			macro.VariadicArgs = record.VaArgs != 0;
+
+			for (uint32_t j = 0; j < record.ParamCount; ++j)
+				macro.Params.push_back(symbol_at(params[record.ParamBegin + j]));
+			for (uint32_t j = 0; j < record.ExpansionCount; ++j)
+				macro.Expansion.push_back(restore_token(expansions[record.ExpansionBegin + j]));
+
+			result->macros_.push_back(make_shared<const MacroDescription>(move(macro)));
+		}
+
+		for (uint32_t i = 0; i < header->OnceCount; ++i)
+		{
+			result->once_headers_.emplace_back(string_at(once_headers[i]));
+		}
+
+		// NOTE moving the mapping keeps its address, so views into it are still valid
+		result->mapping_ = move(mapping);
+		return result;
+	}
+}
\ No newline at end of file
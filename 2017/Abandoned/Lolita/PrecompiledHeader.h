@@ -0,0 +1,63 @@
+#pragma once
+#include "Token.h"
+#include "SourceFile.h"
+#include "MacroEngine.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lolita
+{
+	using MacroList = std::vector<std::shared_ptr<const MacroDescription>>;
+
+	// A snapshot of the preprocessing state after a prefix header,
+	// which could be saved into a binary file and restored by a later run
+	// NOTE a restored instance must outlive translations that it's restored into,
+	//      as the locations of its tokens refer to the file table it owns,
+	//      and texts of tokens other than identifiers refer to the file mapped
+	class PrecompiledHeader
+	{
+	public:
+		using Ptr = std::unique_ptr<PrecompiledHeader>;
+
+		PrecompiledHeader(TokenVec tokens, MacroList macros, std::vector<std::string> once_headers)
+			: tokens_(std::move(tokens)), macros_(std::move(macros)), once_headers_(std::move(once_headers)) { }
+
+		PrecompiledHeader(const PrecompiledHeader&) = delete;
+		PrecompiledHeader& operator=(const PrecompiledHeader&) = delete;
+
+		// finalized tokens yielded by the prefix header, without EndOfFile
+		const TokenVec& Tokens() const { return tokens_; }
+
+		// macros defined after the prefix header
+		const MacroList& Macros() const { return macros_; }
+
+		// resolved paths of headers with #pragma once entered, see SourceFile::Url
+		const std::vector<std::string>& OnceHeaders() const { return once_headers_; }
+
+		// keep a file alive as long as the snapshot, as its tokens may refer to the file
+		void Retain(SourceFile::Ptr file)
+		{
+			files_.push_back(std::move(file));
+		}
+
+		// returns false if the file cannot be written
+		bool Save(const std::string& url) const;
+
+		// returns nullptr if the file cannot be mapped or it's malformed
+		static Ptr Load(const std::string& url);
+
+	private:
+		PrecompiledHeader() = default;
+
+		TokenVec tokens_;
+		MacroList macros_;
+		std::vector<std::string> once_headers_;
+
+		// files retained, or restored without content
+		std::vector<SourceFile::Ptr> files_;
+
+		// the file a restored instance is loaded from, empty if not restored
+		FileMapping mapping_;
+	};
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <optional>
 
 using namespace std;
@@ -13,87 +14,22 @@ namespace lolita
 	// returns PPDirective::Unknown if not a preprocessing directive
 	PPDirective TranslateDirective(const Token& tok)
 	{
-		static unordered_map<string, PPDirective> directive_map
+		switch (tok.Symbol)
 		{
-			{ "if"		, PPDirective::If },
-			{ "ifdef"	, PPDirective::IfDef },
-			{ "ifndef"	, PPDirective::IfNDef },
-			{ "else"	, PPDirective::Else },
-			{ "elif"	, PPDirective::ElseIf },
-			{ "endif"	, PPDirective::EndIf },
-			{ "define"	, PPDirective::Define },
-			{ "undef"	, PPDirective::Undef },
-			{ "include"	, PPDirective::Include },
-			{ "pragma"	, PPDirective::Pragma },
-			{ "line"	, PPDirective::Line },
-			{ "error"	, PPDirective::Error },
-		};
-
-		auto directive_iter = directive_map.find(tok.Content);
-
-		if (directive_iter != directive_map.end())
-			return directive_iter->second;
-		else
-			return PPDirective::Unknown;
-	}
-
-	// returns TokenTag::Identifier if not a keyword
-	TokenTag TranslateKeyword(const Token& tok)
-	{
-		static unordered_map<string, TokenTag> keyword_map
-		{
-			{ "_Alignas"		, TokenTag::Alignas		},
-			{ "_Alignof"		, TokenTag::Alignof		},
-			{ "_Atomic"			, TokenTag::Atomic		},
-			{ "auto"			, TokenTag::Auto		},
-			{ "break"			, TokenTag::Break		},
-			{ "_Bool"			, TokenTag::Bool		},
-			{ "case"			, TokenTag::Case		},
-			{ "char"			, TokenTag::Char		},
-			{ "_Complex"		, TokenTag::Complex		},
-			{ "const"			, TokenTag::Const		},
-			{ "continue"		, TokenTag::Continue	},
-			{ "default"			, TokenTag::Default		},
-			{ "do"				, TokenTag::Do			},
-			{ "double"			, TokenTag::Double		},
-			{ "else"			, TokenTag::Else		},
-			{ "enum"			, TokenTag::Enum		},
-			{ "extern"			, TokenTag::Extern		},
-			{ "float"			, TokenTag::Float		},
-			{ "for"				, TokenTag::For			},
-			{ "_Generic"		, TokenTag::Generic		},
-			{ "goto"			, TokenTag::Goto		},
-			{ "if"				, TokenTag::If			},
-			{ "_Imaginary"		, TokenTag::Imaginary	},
-			{ "inline"			, TokenTag::Inline		},
-			{ "int"				, TokenTag::Int			},
-			{ "long"			, TokenTag::Long		},
-			{ "_Noreturn"		, TokenTag::Noreturn	},
-			{ "register"		, TokenTag::Register	},
-			{ "restrict"		, TokenTag::Restrict	},
-			{ "return"			, TokenTag::Return		},
-			{ "short"			, TokenTag::Short		},
-			{ "signed"			, TokenTag::Signed		},
-			{ "sizeof"			, TokenTag::Sizeof		},
-			{ "static"			, TokenTag::Static		},
-			{ "_Static_assert"	, TokenTag::StaticAssert },
-			{ "struct"			, TokenTag::Struct		},
-			{ "switch"			, TokenTag::Switch		},
-			{ "_Thread_local"	, TokenTag::ThreadLocal },
-			{ "typedef"			, TokenTag::Typedef		},
-			{ "union"			, TokenTag::Union		},
-			{ "unsigned"		, TokenTag::Unsigned	},
-			{ "void"			, TokenTag::Void		},
-			{ "volatile"		, TokenTag::Volatile	},
-			{ "while"			, TokenTag::While		},
-		};
-
-		auto kwd_iter = keyword_map.find(tok.Content);
-
-		if (kwd_iter != keyword_map.end())
-			return kwd_iter->second;
-		else
-			return TokenTag::Identifier;
+		case KeywordSymbol(TokenTag::If):	return PPDirective::If;
+		case kSymbolIfdef:					return PPDirective::IfDef;
+		case kSymbolIfndef:					return PPDirective::IfNDef;
+		case KeywordSymbol(TokenTag::Else):	return PPDirective::Else;
+		case kSymbolElif:					return PPDirective::ElseIf;
+		case kSymbolEndif:					return PPDirective::EndIf;
+		case kSymbolDefine:					return PPDirective::Define;
+		case kSymbolUndef:					return PPDirective::Undef;
+		case kSymbolInclude:				return PPDirective::Include;
+		case kSymbolPragma:					return PPDirective::Pragma;
+		case kSymbolLine:					return PPDirective::Line;
+		case kSymbolError:					return PPDirective::Error;
+		default:							return PPDirective::Unknown;
+		}
 	}
 
 	void Preprocessor::PreprocessInternal(const TokenVec& input)
@@ -134,6 +70,10 @@ namespace lolita
 
 				// [[fallthrough]]
 			default:
+				// only tokens of the main file are traced
+				if (trace_ && records_.empty())
+					trace_->Copies[&tok - input.data()] = buffer_.Size();
+
 				FinalizeToken(tok);
 				src.Consume();
 				break;
@@ -143,15 +83,18 @@ namespace lolita
 
 	void Preprocessor::FinalizeToken(const Token& tok)
 	{
-		Token result = tok;
+		auto refined = tok;
+		RefineToken(refined);
+		buffer_.PushBack(refined);
+	}
 
+	void Preprocessor::RefineToken(Token& tok)
+	{
 		// refine location track
-		result.Location.Line += line_offset_;
+		tok.Location.Line += line_offset_;
 		// refine tag if it is a keyword
 		if (tok.Tag == TokenTag::Identifier)
-			result.Tag = TranslateKeyword(tok);
-
-		buffer_.emplace_back(move(result));
+			tok.Tag = TranslateKeyword(tok.Symbol);
 	}
 
 	void Preprocessor::ExecutePP(TokenSource& src)
@@ -256,11 +199,11 @@ namespace lolita
 		if (!PPExpectTag(src_cp, TokenTag::Identifier))
 			return;
 
-		auto macro_name = src_cp.LastConsumed().Content;
+		auto macro_name = src_cp.LastConsumed().Symbol;
 		auto func_like = false;
 		auto va_args = false;
-		auto params = StringVec{};
-		auto rp_list = TokenSeq{};
+		auto params = std::vector<SymbolId>{};
+		auto rp_list = TokenVec{};
 
 		if (!src_cp.StartOfLine())
 		{
@@ -286,7 +229,7 @@ namespace lolita
 					{
 						if (src_cp.Try(TokenTag::Identifier))
 						{
-							params.emplace_back(src_cp.LastConsumed().Content);
+							params.emplace_back(src_cp.LastConsumed().Symbol);
 						}
 						else if (src_cp.Try(TokenTag::Ellipsis))
 						{
@@ -336,15 +279,14 @@ namespace lolita
 
 		// register macro
 		// FIXME: validate macros with the same name
-		macros_[macro_name]
-			= MacroDescription{ macro_name, move(params), !func_like, va_args, move(rp_list) };
+		macros_.Define(MacroDescription{ macro_name, move(params), !func_like, va_args, move(rp_list) });
 	}
 	void Preprocessor::ExecutePPUndef(TokenSource& src, SourceLocation loc)
 	{
 		if (PPExpectTag(src, TokenTag::Identifier))
 		{
 			const auto& last_tok = src.LastConsumed();
-			macros_.erase(last_tok.Content);
+			macros_.Undefine(last_tok.Symbol);
 		}
 		else
 		{
@@ -363,15 +305,23 @@ namespace lolita
 		{
 			const auto& last_tok = src.LastConsumed();
 		
-			auto toks_to_include = SearchFile(last_tok.Content);
-			if (toks_to_include)
+			auto header = SearchFile(string{ last_tok.Content }, last_tok.Location.File);
+			if (header)
 			{
 				// save context
 				auto line_offset = line_offset_;
 				depth_ += 1;
 
-				// preprocess included file
-				PreprocessInternal(*toks_to_include);
+				// preprocess included file, unless it could be skipped or reused
+				if (PPTrySkipHeader(*header) || PPTryReuseHeader(*header))
+				{
+					include_hits_ += 1;
+				}
+				else
+				{
+					include_misses_ += 1;
+					PPIncludeHeader(*header);
+				}
 
 				// restore context
 				line_offset_ = line_offset;
@@ -393,6 +343,13 @@ namespace lolita
 	}
 	void Preprocessor::ExecutePPPragma(TokenSource& src, SourceLocation loc)
 	{
+		// #pragma once is detected when a header is lexed
+		if (!src.StartOfLine() && src.Peek().Symbol == kSymbolOnce)
+		{
+			src.Consume();
+			return;
+		}
+
 		ReportError(loc, "#pragma not supported yet");
 		PPFinalizeSource(src);
 	}
@@ -412,11 +369,194 @@ namespace lolita
 		if (PPExpectTag(src, TokenTag::StringLiteral))
 		{
 			const auto& last_tok = src.LastConsumed();
-			ReportError(last_tok.Location, last_tok.Content.c_str());
+			ReportError(last_tok.Location, string{ last_tok.Content });
 		}
 		else
 		{
 			PPFinalizeSource(src);
 		}
 	}
+
+	// Precompiled Header
+	//
+
+	PrecompiledHeader::Ptr Preprocessor::Precompile(const TokenVec& input)
+	{
+		PreprocessInternal(input);
+
+		auto once_headers = vector<string>{ restored_once_headers_.begin(), restored_once_headers_.end() };
+		for (auto header : once_headers_)
+		{
+			once_headers.emplace_back(header->File()->Url());
+		}
+
+		return make_unique<PrecompiledHeader>(buffer_.ToVec(), macros_.Definitions(), move(once_headers));
+	}
+
+	void Preprocessor::Restore(const PrecompiledHeader& pch)
+	{
+		buffer_.Reserve(pch.Tokens().size());
+		for (const auto& tok : pch.Tokens())
+		{
+			buffer_.PushBack(tok);
+		}
+
+		for (const auto& macro : pch.Macros())
+		{
+			macros_.Define(macro);
+		}
+
+		restored_once_headers_.insert(pch.OnceHeaders().begin(), pch.OnceHeaders().end());
+	}
+
+	// Header Inclusion
+	//
+
+	// returns true if the header has been included and it's not needed any more
+	bool Preprocessor::PPTrySkipHeader(const HeaderFile& header)
+	{
+		if (header.PragmaOnce() && (once_headers_.count(&header)
+			|| restored_once_headers_.count(string{ header.File()->Url() })))
+		{
+			// it's not entered by a header being included, so the header depends on the includer
+			for (auto& record : records_)
+			{
+				const auto& once = record.OnceHeaders;
+				if (find(once.begin(), once.end(), &header) == once.end())
+					record.Cacheable = false;
+			}
+
+			return true;
+		}
+
+		auto guard = header.Guard();
+		if (guard != kInvalidSymbol && macros_.Lookup(guard))
+		{
+			// it's not defined by a header being included, so the header depends on the includer
+			for (auto& record : records_)
+			{
+				if (!binary_search(record.Symbols.begin(), record.Symbols.end(), guard))
+					record.Cacheable = false;
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// returns true if a cached result of the header is applicable
+	bool Preprocessor::PPTryReuseHeader(const HeaderFile& header)
+	{
+		auto result = header.LoadPreprocessed();
+		if (!result || line_offset_ != 0)
+			return false;
+
+		// the result is only valid if no identifier in it is defined
+		for (auto symbol : result->Symbols)
+		{
+			if (macros_.Lookup(symbol))
+				return false;
+		}
+		for (auto once_header : result->OnceHeaders)
+		{
+			if (once_headers_.count(once_header))
+				return false;
+		}
+
+		// replay the inclusion
+		PPMergeSymbols(result->Symbols);
+		for (auto once_header : result->OnceHeaders)
+		{
+			once_headers_.insert(once_header);
+			for (auto& record : records_)
+				record.OnceHeaders.push_back(once_header);
+		}
+
+		buffer_.Append(result->Tokens, 0, result->Tokens.Size());
+		for (const auto& macro : result->Macros)
+		{
+			macros_.Define(macro);
+		}
+
+		return true;
+	}
+
+	void Preprocessor::PPIncludeHeader(const HeaderFile& header)
+	{
+		PPMergeSymbols(header.Symbols());
+		if (header.PragmaOnce())
+		{
+			once_headers_.insert(&header);
+			for (auto& record : records_)
+				record.OnceHeaders.push_back(&header);
+		}
+
+		// start recording the header
+		auto record = HeaderRecord{ &header, buffer_.Size(), GetErrorCount(), header.Symbols(), {}, line_offset_ == 0 };
+		if (header.PragmaOnce())
+		{
+			record.OnceHeaders.push_back(&header);
+		}
+		for (auto symbol : record.Symbols)
+		{
+			if (macros_.Lookup(symbol))
+			{
+				record.Cacheable = false;
+				break;
+			}
+		}
+
+		records_.push_back(move(record));
+
+		// NOTE the include guard, if any, is not preprocessed
+		PreprocessInternal(header.Body());
+
+		record = move(records_.back());
+		records_.pop_back();
+
+		// cache the result, unless it's not reproducible
+		if (record.Cacheable && record.ErrorCount == GetErrorCount())
+		{
+			auto result = make_shared<PreprocessedHeader>();
+			result->Tokens.Append(buffer_, record.BufferOffset, buffer_.Size());
+			for (auto symbol : record.Symbols)
+			{
+				if (auto macro = macros_.LookupShared(symbol))
+					result->Macros.push_back(move(macro));
+			}
+			result->Symbols = move(record.Symbols);
+			result->OnceHeaders = move(record.OnceHeaders);
+
+			header.StorePreprocessed(move(result));
+		}
+	}
+
+	// add identifiers to headers being included
+	void Preprocessor::PPMergeSymbols(const vector<SymbolId>& symbols)
+	{
+		for (auto& record : records_)
+		{
+			auto added = vector<SymbolId>{};
+			set_difference(symbols.begin(), symbols.end(),
+				record.Symbols.begin(), record.Symbols.end(), back_inserter(added));
+
+			// an identifier new to the header could only be defined by the includer
+			for (auto symbol : added)
+			{
+				if (macros_.Lookup(symbol))
+				{
+					record.Cacheable = false;
+					break;
+				}
+			}
+
+			auto merged = vector<SymbolId>{};
+			merged.reserve(record.Symbols.size() + added.size());
+			merge(record.Symbols.begin(), record.Symbols.end(),
+				added.begin(), added.end(), back_inserter(merged));
+
+			record.Symbols = move(merged);
+		}
+	}
 }
\ No newline at end of file
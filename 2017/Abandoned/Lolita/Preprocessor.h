@@ -1,9 +1,13 @@
 #pragma once
 #include "Token.h"
+#include "TokenBuffer.h"
 #include "TranslationContext.h"
 #include "MacroEngine.h"
+#include "PrecompiledHeader.h"
+#include <cstdint>
 #include <deque>
 #include <memory>
+#include <unordered_set>
 
 namespace lolita
 {
@@ -26,24 +30,64 @@ namespace lolita
 		Error
 	};
 
+	constexpr size_t kNotCopied = SIZE_MAX;
+
+	// How tokens of the main file are yielded, so that an edit could be preprocessed incrementally
+	struct PreprocessTrace
+	{
+		// for each token of the main file, index of its copy in the result, or kNotCopied
+		// if it's consumed otherwise, e.g. by a directive, a macro invocation or a skipped group
+		std::vector<size_t> Copies;
+
+		// names of macros that have ever been defined, sorted
+		std::vector<SymbolId> Macros;
+	};
+
 	class Preprocessor
 	{
 	public:
 		Preprocessor() { }
 
-		TokenVec Preprocess(const TokenVec& input)
+		// NOTE $trace is filled if not nullptr
+		TokenBuffer Preprocess(const TokenVec& input, PreprocessTrace* trace = nullptr)
 		{
+			trace_ = trace;
+			if (trace_)
+				trace_->Copies.assign(input.size(), kNotCopied);
+
+			// NOTE the result is about as long as the input, plus headers included
+			buffer_.Reserve(buffer_.Size() + input.size());
+
 			// preprocess the file
 			PreprocessInternal(input);
 			// keep the EOF token
-			buffer_.emplace_back(input.back());
+			if (trace_)
+			{
+				trace_->Copies.back() = buffer_.Size();
+				trace_->Macros = macros_.EverDefined();
+			}
+			buffer_.PushBack(input.back());
 
 			return std::move(buffer_);
 		}
 
+		// snapshot the state after preprocessing a prefix header
+		PrecompiledHeader::Ptr Precompile(const TokenVec& input);
+
+		// restore the state of a precompiled header, whose tokens come first
+		void Restore(const PrecompiledHeader& pch);
+
+		// number of macro invocations expanded
+		size_t MacroExpansionCount() const { return engine_.ExpansionCount(); }
+
+		// number of inclusions skipped or reusing a preprocessed header, and the others
+		size_t IncludeHitCount() const { return include_hits_; }
+		size_t IncludeMissCount() const { return include_misses_; }
+
 	private:
 		void PreprocessInternal(const TokenVec& input);
 		void FinalizeToken(const Token& tok);
+		void RefineToken(Token& tok);
 
 
 		void ExecutePP(TokenSource& src);
@@ -59,15 +103,20 @@ namespace lolita
 		void ExecutePPLine(TokenSource& src, SourceLocation loc);
 		void ExecutePPError(TokenSource& src, SourceLocation loc);
 
+		bool PPTrySkipHeader(const HeaderFile& header);
+		bool PPTryReuseHeader(const HeaderFile& header);
+		void PPIncludeHeader(const HeaderFile& header);
+		void PPMergeSymbols(const std::vector<SymbolId>& symbols);
+
 		bool PPTryExpandMacro(TokenSource& src)
 		{
 			assert(src.Test(TokenTag::Identifier));
-			auto iter = macros_.find(src.Peek().Content);
-			if (iter != macros_.end())
+			auto pmacro = macros_.Lookup(src.Peek().Symbol);
+			if (pmacro)
 			{
 				// there is a macro of this name
 				// maybe a macro expansion
-				auto obj_like = iter->second.ObjectLike;
+				auto obj_like = pmacro->ObjectLike;
 				if (!obj_like)
 				{
 					// i.e. function-like
@@ -80,11 +129,16 @@ namespace lolita
 					}
 				}
 
-				for (const auto& tok : ExpandMacro(src, macros_, obj_like))
+				// expand into a scratch, and finalize the tokens into the buffer
+				engine_.Expand(src, macros_, expansion_);
+				for (auto& tok : expansion_)
 				{
-					FinalizeToken(tok);
+					RefineToken(tok);
+					buffer_.PushBack(tok);
 				}
 
+				expansion_.clear();
+
 				return true;
 			}
 			else
@@ -95,7 +149,7 @@ namespace lolita
 
 		TokenVec PPExtractLine(TokenSource& src)
 		{
-			auto result = TokenSeq{};
+			auto result = TokenVec{};
 			while (!src.StartOfLine())
 			{
 				result.emplace_back(src.Consume());
@@ -132,11 +186,51 @@ namespace lolita
 		}
 
 	private:
+		// a header being preprocessed, whose result may be cached
+		struct HeaderRecord
+		{
+			const HeaderFile* Header;
+
+			// where tokens yielded by the header start in buffer_
+			size_t BufferOffset;
+
+			size_t ErrorCount;
+
+			// identifiers appearing in the header and those included so far, sorted
+			std::vector<SymbolId> Symbols;
+
+			// headers with #pragma once entered so far
+			std::vector<const HeaderFile*> OnceHeaders;
+
+			// false if the result depends on the macro state of the includer
+			bool Cacheable;
+		};
+
 		MacroArchive macros_;
+		MacroEngine engine_;
+
+		// headers with #pragma once entered in this translation unit
+		std::unordered_set<const HeaderFile*> once_headers_;
+
+		// resolved paths of headers with #pragma once entered in a precompiled header
+		// NOTE HeaderName of the same file may be spelled differently by includers
+		std::unordered_set<std::string> restored_once_headers_;
+
+		// headers being included, innermost last
+		std::vector<HeaderRecord> records_;
+
+		int line_offset_ = 0;
+		size_t depth_ = 0;
+
+		size_t include_hits_ = 0;
+		size_t include_misses_ = 0;
+
+		// nullptr if not traced
+		PreprocessTrace* trace_ = nullptr;
 
-		int line_offset_;
-		size_t depth_;
+		TokenBuffer buffer_;
 
-		TokenVec buffer_;
+		// tokens yielded by the last macro expansion
+		TokenVec expansion_;
 	};
 }
\ No newline at end of file
@@ -1,33 +1,62 @@
 #include "Scope.h"
+#include <algorithm>
 
 namespace lolita
 {
-	// Implementation of Scope
+	// Implementation of ScopeStack
 	//
 
-	void Scope::DeclareEntity(NamedEntity item)
+	void ScopeStack::EnterScope(ScopeCategory cat)
 	{
-		assert(!LookupEntity(item.Name));
-		decls_[item.Name] = item;
-	}
-	void Scope::DeclareEntity(const std::string& name, QualType type, StorageSpecifier storage)
-	{
-		assert(!LookupEntity(name));
-		decls_[name] = NamedEntity { name, type, storage };
+		scopes_.push_back(ScopeFrame{ cat, static_cast<uint32_t>(bindings_.size()) });
 	}
 
-	const NamedEntity* Scope::LookupEntity(const std::string& name)
+	void ScopeStack::ExitScope()
 	{
-		auto iter = decls_.find(name);
-		if (iter != decls_.end())
+		assert(!scopes_.empty());
+
+		// unwind bindings of the scope, so that those shadowed become visible again
+		auto begin = scopes_.back().BindingBegin;
+		while (bindings_.size() > begin)
 		{
-			return &iter->second;
+			const auto& binding = bindings_.back();
+			heads_[binding.Entity->Name] = binding.Shadowed;
+
+			bindings_.pop_back();
 		}
-		else
+
+		scopes_.pop_back();
+	}
+
+	bool ScopeStack::DeclareEntity(NamedEntity* entity)
+	{
+		assert(!scopes_.empty());
+
+		auto name = entity->Name;
+		if (LookupLocalEntity(name))
+			return false;
+
+		if (name >= heads_.size())
 		{
-			return parent_
-				? parent_->LookupEntity(name)
-				: nullptr;
+			// NOTE symbols are dense, so grow geometrically to cover those interned later
+			heads_.resize(std::max<size_t>(name + 1, heads_.size() * 2), kNoBinding);
 		}
+
+		bindings_.push_back(Binding{ entity, heads_[name] });
+		heads_[name] = static_cast<uint32_t>(bindings_.size() - 1);
+
+		return true;
+	}
+
+	NamedEntity* ScopeStack::LookupLocalEntity(SymbolId name) const
+	{
+		if (scopes_.empty() || name >= heads_.size() || heads_[name] == kNoBinding)
+			return nullptr;
+
+		// bindings of the innermost scope are on top of the stack
+		auto index = heads_[name];
+		return index >= scopes_.back().BindingBegin
+			? bindings_[index].Entity
+			: nullptr;
 	}
 }
\ No newline at end of file
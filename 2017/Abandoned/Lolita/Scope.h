@@ -1,8 +1,10 @@
 #pragma once
 #include "AstObject.h"
 #include "Type.h"
-#include <memory>
-#include <map>
+#include "Symbol.h"
+#include <cassert>
+#include <cstdint>
+#include <vector>
 
 namespace lolita
 {
@@ -17,7 +19,7 @@ namespace lolita
 	// what an ordianary identifier refers to (variables, functions or typedef names)
 	struct NamedEntity : public AstObject
 	{
-		std::string Name;
+		SymbolId Name;
 
 		QualType Type;
 
@@ -25,6 +27,7 @@ namespace lolita
 	};
 
 	// an abstract of a scope in C language
+	// NOTE declarations are kept by ScopeStack while the scope is open
 	class Scope : public AstObject
 	{
 	public:
@@ -34,22 +37,79 @@ namespace lolita
 		ScopeCategory Category() const { return category_; }
 		Scope* Parent() const { return parent_; }
 
-		// CType* LookupType(const std::string& name);
-		// AggregateType* DeclareStruct(const std::string& name, AggregationLayout layout);
-
-		void DeclareEntity(NamedEntity item);
-		void DeclareEntity(const std::string& name, QualType type, StorageSpecifier storage);
-		const NamedEntity* LookupEntity(const std::string& name);
-
 	private:
 		const ScopeCategory category_;
 		Scope *const parent_;
+	};
+
+	// The scopes open at a point of translation, innermost last
+	// each identifier has a chain of declarations shadowing each other, indexed by its SymbolId,
+	// so that a lookup costs O(1) however deeply scopes are nested
+	// NOTE entities are not owned, they're allocated in the AstArena along with nodes referring to them
+	class ScopeStack
+	{
+	public:
+		ScopeStack() = default;
+
+		ScopeStack(const ScopeStack&) = delete;
+		ScopeStack& operator=(const ScopeStack&) = delete;
+
+		void EnterScope(ScopeCategory cat);
+
+		// declarations in the innermost scope go out of sight
+		void ExitScope();
+
+		// number of scopes open
+		size_t Depth() const { return scopes_.size(); }
+
+		// NOTE at least one scope must be open
+		ScopeCategory CurrentCategory() const
+		{
+			assert(!scopes_.empty());
+			return scopes_.back().Category;
+		}
+
+		// declare an entity in the innermost scope
+		// returns false if its name is already declared in the scope
+		bool DeclareEntity(NamedEntity* entity);
+
+		// returns the innermost visible declaration of $name, or nullptr if none
+		NamedEntity* LookupEntity(SymbolId name) const
+		{
+			return name < heads_.size() && heads_[name] != kNoBinding
+				? bindings_[heads_[name]].Entity
+				: nullptr;
+		}
+
+		// returns nullptr unless $name is declared in the innermost scope
+		NamedEntity* LookupLocalEntity(SymbolId name) const;
+
+	private:
+		static constexpr uint32_t kNoBinding = UINT32_MAX;
+
+		// a declaration visible now
+		struct Binding
+		{
+			NamedEntity* Entity;
+
+			// the declaration of the same identifier that is shadowed, or kNoBinding
+			uint32_t Shadowed;
+		};
+
+		struct ScopeFrame
+		{
+			ScopeCategory Category;
+
+			// index of the first binding made in the scope
+			uint32_t BindingBegin;
+		};
+
+		std::vector<ScopeFrame> scopes_;
 
-		// declaration of types in the current scope
-		// in Tag name space
-		std::map<std::string, CType*> types_;
+		// bindings of all scopes open, in the order of declaration
+		std::vector<Binding> bindings_;
 
-		// in Ordianary name space
-		std::map<std::string, NamedEntity> decls_;
+		// the innermost binding of each identifier, indexed by SymbolId
+		std::vector<uint32_t> heads_;
 	};
 }
\ No newline at end of file
@@ -1,50 +1,259 @@
 #include "SourceFile.h"
+#include "CompilerConfig.h"
+#include <algorithm>
+#include <cassert>
 #include <fstream>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 namespace lolita
 {
-	SourceFile::Ptr SourceFile::Open(const std::string& name, const std::string& url)
-	{
-		fstream fs(url);
-		string result;
+	// Implementation of FileMapping
+	//
 
-		// read from file
-		constexpr size_t kLoadingBufferSize = 1024;
-		char buffer[kLoadingBufferSize];
-		while (true)
+	FileMapping::~FileMapping()
+	{
+		if (base_)
 		{
-			fs.read(buffer, sizeof(buffer));
+#ifdef _WIN32
+			UnmapViewOfFile(base_);
+#else
+			munmap(const_cast<char*>(base_), size_);
+#endif
+		}
+	}
+
+	FileMapping FileMapping::Map(const std::string& url, bool sequential)
+	{
+		auto result = FileMapping{};
 
-			if (fs.gcount() != 0)
+#ifdef _WIN32
+		auto flags = FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0);
+		auto file = CreateFileA(url.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, flags, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return result;
+
+		LARGE_INTEGER file_size;
+		if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+		{
+			// NOTE the view keeps the mapping alive after both handles are closed
+			auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping)
 			{
-				result.append(buffer, fs.gcount());
+				result.base_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				result.size_ = result.base_ ? static_cast<size_t>(file_size.QuadPart) : 0;
+				CloseHandle(mapping);
 			}
-			else
+		}
+
+		CloseHandle(file);
+#else
+		auto fd = open(url.c_str(), O_RDONLY);
+		if (fd == -1)
+			return result;
+
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			auto size = static_cast<size_t>(st.st_size);
+
+			auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED)
 			{
-				break;
+				result.base_ = static_cast<const char*>(p);
+				result.size_ = size;
+
+				if (sequential)
+					madvise(p, size, MADV_SEQUENTIAL);
 			}
 		}
 
+		close(fd);
+#endif
+
+		return result;
+	}
+
+	int64_t GetLastWriteTime(const std::string& url)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(url.c_str(), GetFileExInfoStandard, &data))
+			return -1;
+
+		return static_cast<int64_t>((uint64_t{ data.ftLastWriteTime.dwHighDateTime } << 32) | data.ftLastWriteTime.dwLowDateTime);
+#else
+		struct stat st;
+		if (stat(url.c_str(), &st) != 0)
+			return -1;
+
+		return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	}
+
+	// Implementation of SourceFile
+	//
+
+	// map the file into memory if it can be lexed in place,
+	// i.e. it's non-empty and ends with <newline>
+	bool SourceFile::TryMap(const std::string& url)
+	{
+		auto mapping = FileMapping::Map(url, true);
+		if (mapping.Empty() || mapping.Data().back() != '\n')
+			return false;
+
+		mapping_ = move(mapping);
+		view_ = mapping_.Data();
+		return true;
+	}
+
+	// read the whole file into data_
+	bool SourceFile::TryLoad(const std::string& url)
+	{
+		ifstream fs(url, ios::in | ios::binary | ios::ate);
+		if (!fs)
+			return false;
+
+		auto size = static_cast<size_t>(fs.tellg());
+		fs.seekg(0);
+
+		// reserve one more for the appended <newline>
+		string result;
+		result.reserve(size + 1);
+		result.resize(size);
+		if (size != 0 && !fs.read(&result[0], size))
+			return false;
+
 		// to ensure file ends with <newline>
 		if (result.empty() || result.back() != '\n')
 		{
 			result.push_back('\n');
 		}
 
-		// check the whole file's been read into memory
-		if (!fs.eof())
+		data_ = move(result);
+		view_ = data_;
+		return true;
+	}
+
+	SourceFile::Ptr SourceFile::Open(const std::string& name, const std::string& url)
+	{
+		auto file = unique_ptr<SourceFile>{ new SourceFile };
+		file->name_ = name;
+		file->url_ = url;
+
+		// prefer a zero-copy mapping, and fallback to reading the file
+		if (!file->TryMap(url) && !file->TryLoad(url))
+		{
+			return nullptr;
+		}
+
+		return file;
+	}
+
+	SourceFile::Ptr SourceFile::Load(const std::string& name, const std::string& url)
+	{
+		auto file = unique_ptr<SourceFile>{ new SourceFile };
+		file->name_ = name;
+		file->url_ = url;
+
+		if (!file->TryLoad(url))
 		{
 			return nullptr;
 		}
 
-		// construct file object
+		return file;
+	}
+
+	SourceFile::Ptr SourceFile::Detached(const std::string& name, const std::string& url)
+	{
 		auto file = unique_ptr<SourceFile>{ new SourceFile };
 		file->name_ = name;
 		file->url_ = url;
-		file->data_ = move(result);
 
 		return file;
 	}
+
+	SourceFile::Ptr SourceFile::FromMemory(const std::string& name, std::string content)
+	{
+		auto file = unique_ptr<SourceFile>{ new SourceFile };
+		file->name_ = name;
+		file->url_ = name;
+
+		// to ensure file ends with <newline>
+		if (content.empty() || content.back() != '\n')
+		{
+			content.push_back('\n');
+		}
+
+		file->data_ = move(content);
+		file->view_ = file->data_;
+		return file;
+	}
+	pair<uint32_t, uint32_t> SourceFile::Position(size_t index) const
+	{
+		assert(index <= view_.size());
+
+		call_once(lines_flag_, [this]() {
+			line_starts_.push_back(0);
+			for (size_t i = 0; i < view_.size(); ++i)
+			{
+				// NOTE a line splice does not start a new line
+				if (view_[i] == '\n' && (i == 0 || view_[i - 1] != '\\'))
+					line_starts_.push_back(static_cast<uint32_t>(i + 1));
+			}
+		});
+
+		auto iter = upper_bound(line_starts_.begin(), line_starts_.end(), index) - 1;
+		auto line = static_cast<uint32_t>(iter - line_starts_.begin() + 1);
+
+		// a tab takes kLexerTabSize columns, and a line splice takes none
+		auto column = uint32_t{ 1 };
+		for (auto i = size_t{ *iter }; i < index; ++i)
+		{
+			if (view_[i] == '\\' && i + 1 < view_.size() && view_[i + 1] == '\n')
+				i += 1;
+			else
+				column += static_cast<uint32_t>(view_[i] == '\t' ? kLexerTabSize : 1);
+		}
+
+		return { line, column };
+	}
+
+	SourceEdit SourceFile::ClampEdit(SourceEdit edit) const
+	{
+		assert(!view_.empty());
+
+		edit.Offset = min(edit.Offset, view_.size() - 1);
+		edit.RemovedLength = min(edit.RemovedLength, view_.size() - 1 - edit.Offset);
+		return edit;
+	}
+
+	SourceFile::Ptr SourceFile::Edited(const SourceFile& file, const SourceEdit& edit)
+	{
+		auto clamped = file.ClampEdit(edit);
+		auto content = file.Data();
+
+		auto result = unique_ptr<SourceFile>{ new SourceFile };
+		result->name_ = file.name_;
+		result->url_ = file.url_;
+
+		result->data_.reserve(content.size() - clamped.RemovedLength + clamped.Text.size());
+		result->data_.append(content.substr(0, clamped.Offset));
+		result->data_.append(clamped.Text);
+		result->data_.append(content.substr(clamped.Offset + clamped.RemovedLength));
+
+		result->view_ = result->data_;
+		return result;
+	}
 }
\ No newline at end of file
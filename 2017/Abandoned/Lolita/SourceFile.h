@@ -1,11 +1,63 @@
 #pragma once
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 namespace lolita
 {
+	// A read-only mapping of a whole file
+	class FileMapping
+	{
+	public:
+		FileMapping() = default;
+		FileMapping(FileMapping&& other)
+			: base_(other.base_), size_(other.size_)
+		{
+			other.base_ = nullptr;
+			other.size_ = 0;
+		}
+		FileMapping& operator=(FileMapping&& other)
+		{
+			std::swap(base_, other.base_);
+			std::swap(size_, other.size_);
+			return *this;
+		}
+		~FileMapping();
+
+		bool Empty() const
+		{
+			return base_ == nullptr;
+		}
+
+		std::string_view Data() const
+		{
+			return std::string_view{ base_, size_ };
+		}
+
+		// returns an empty mapping if the file cannot be mapped, or it's empty
+		static FileMapping Map(const std::string& url, bool sequential);
+
+	private:
+		const char* base_ = nullptr;
+		size_t size_ = 0;
+	};
+
+	// returns the last write time of a file, which is only compared for equality,
+	// or -1 if the file cannot be found
+	int64_t GetLastWriteTime(const std::string& url);
+
+	// An edit on the content of a file, which replaces $RemovedLength bytes at $Offset with $Text
+	struct SourceEdit
+	{
+		size_t Offset;
+		size_t RemovedLength;
+		std::string Text;
+	};
+
 	class SourceFile
 	{
 	private:
@@ -15,14 +67,32 @@ namespace lolita
 		// url to locate the file
 		std::string url_;
 
-		// data with standardized newline
+		// view to the content, which always ends with a newline
+		// it's either into a read-only mapping of the file, or into data_
+		std::string_view view_;
+
+		// copied content, only if the file cannot be mapped as is
 		std::string data_;
 
+		// mapping of the file, empty if not mapped
+		FileMapping mapping_;
+
+		// offsets where lines start, built on the first lookup
+		mutable std::once_flag lines_flag_;
+		mutable std::vector<uint32_t> line_starts_;
+
 		// SourceFile instance should be constructed by static function Open
 		SourceFile() = default;
+
+		bool TryMap(const std::string& url);
+		bool TryLoad(const std::string& url);
+
 	public:
 		using Ptr = std::unique_ptr<SourceFile>;
 
+		SourceFile(const SourceFile&) = delete;
+		SourceFile& operator=(const SourceFile&) = delete;
+
 		std::string_view Name() const
 		{
 			return name_;
@@ -35,17 +105,43 @@ namespace lolita
 
 		size_t Size() const
 		{
-			return data_.size();
+			return view_.size();
 		}
 
 		std::string_view Data() const
 		{
-			return data_;
+			return view_;
 		}
 
+		bool IsMapped() const
+		{
+			return !mapping_.Empty();
+		}
+
+		// line and column of the character at $index, counted as the lexer does
+		// NOTE the content must be loaded, and the first call builds the line table
+		std::pair<uint32_t, uint32_t> Position(size_t index) const;
+
+		// returns $edit clamped to the content, where the <newline> at the end is never removed
+		SourceEdit ClampEdit(SourceEdit edit) const;
+
 		// Factory Function
 		//
 
+		// NOTE a mapping is not a snapshot, so a file mapped must not be truncated or rewritten in place while opened,
+		//      which would fault or change the content, see Load
 		static SourceFile::Ptr Open(const std::string& name, const std::string& url);
+
+		// a file whose content is always read into memory, e.g. a header kept after the file is modified
+		static SourceFile::Ptr Load(const std::string& name, const std::string& url);
+
+		// a file whose content is not loaded, e.g. one restored from a precompiled header
+		static SourceFile::Ptr Detached(const std::string& name, const std::string& url);
+
+		// a file whose content is given, e.g. a generated one
+		static SourceFile::Ptr FromMemory(const std::string& name, std::string content);
+
+		// a file whose content is of $file with $edit applied, where $edit is clamped first
+		static SourceFile::Ptr Edited(const SourceFile& file, const SourceEdit& edit);
 	};
 }
\ No newline at end of file
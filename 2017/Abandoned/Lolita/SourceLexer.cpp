@@ -1,11 +1,28 @@
 #include "SourceLexer.h"
 #include "Lexer.h"
 #include <cassert>
+#include <functional>
 
 using namespace std;
 
 namespace lolita
 {
+	// hint $lexer if a HeaderName is expected after $tok
+	// NOTE $pp_state tracks if $tok follows a '#' that starts a line
+	static void TrackDirective(Lexer& lexer, const Token& tok, bool& pp_state)
+	{
+		if (pp_state && !tok.StartOfLine)
+		{
+			if (tok.Tag == TokenTag::Identifier
+				&& tok.Symbol == kSymbolInclude)
+			{
+				lexer.HintHeaderName();
+			}
+		}
+
+		pp_state = tok.StartOfLine && tok.Tag == TokenTag::Sharp;
+	}
+
 	TokenVec LexSourceFile(const SourceFile* file)
 	{
 		assert(file != nullptr);
@@ -17,25 +34,173 @@ namespace lolita
 		auto pp_state = false;
 
 		// iterate to lex the source file
+		// NOTE C sources have roughly a token per 8 characters
 		auto result = vector<Token>{};
+		result.reserve(file->Size() / 8 + 1);
 		do
 		{
 			result.emplace_back(lexer.Next());
+			TrackDirective(lexer, result.back(), pp_state);
 
-			const auto& last_tok = result.back();
+		} while (result.back().Tag != TokenTag::EndOfFile);
+
+		return result;
+	}
 
-			if (pp_state && !last_tok.StartOfLine)
+	// returns if $tok is lexed the same as $old, which is moved by an edit
+	static bool SameToken(const Token& tok, const Token& old, int64_t index_delta, int32_t line_delta)
+	{
+		return tok.Tag == old.Tag
+			&& tok.Symbol == old.Symbol
+			&& tok.StartOfLine == old.StartOfLine
+			&& tok.SucceedingSpace == old.SucceedingSpace
+			&& tok.Location.Index == old.Location.Index + index_delta
+			&& tok.Location.Line == old.Location.Line + line_delta
+			&& tok.Location.Column == old.Location.Column
+			&& tok.Content == old.Content;
+	}
+
+	void RebaseToken(Token& tok, const SourceFile* file, const SourceFile* previous,
+		const SourceEdit& edit, int32_t line_delta)
+	{
+		auto delta = static_cast<int64_t>(edit.Text.size()) - static_cast<int64_t>(edit.RemovedLength);
+		auto edit_end = edit.Offset + edit.RemovedLength;
+
+		auto& loc = tok.Location;
+		if (loc.File == previous)
+		{
+			assert(loc.Index < edit.Offset || loc.Index >= edit_end);
+
+			loc.File = file;
+			if (loc.Index >= edit_end)
 			{
-				if (last_tok.Tag == TokenTag::Identifier
-					&& last_tok.Content == "include")
+				loc.Index = static_cast<uint32_t>(loc.Index + delta);
+				loc.Line += line_delta;
+			}
+		}
+
+		// a zero-copy text refers to the previous content
+		// NOTE it's not necessarily the text at the location, e.g. for a macro
+		auto text = tok.Content.data();
+		auto base = previous->Data().data();
+		if (!less<const char*>{}(text, base) && less<const char*>{}(text, base + previous->Size()))
+		{
+			auto offset = static_cast<size_t>(text - base);
+			if (offset >= edit_end)
+				offset = static_cast<size_t>(offset + delta);
+
+			tok.Content = string_view{ file->Data().data() + offset, tok.Content.size() };
+		}
+	}
+
+	TokenEdit RelexSourceFile(const SourceFile* file, const SourceFile* previous,
+		TokenVec& tokens, const SourceEdit& edit)
+	{
+		assert(file != nullptr && previous != nullptr);
+		assert(!tokens.empty() && tokens.back().Tag == TokenTag::EndOfFile);
+		assert(edit.Offset + edit.RemovedLength < previous->Size());
+
+		auto delta = static_cast<int64_t>(edit.Text.size()) - static_cast<int64_t>(edit.RemovedLength);
+		auto inserted_end = edit.Offset + edit.Text.size();
+
+		// resume at the last token that starts a line, and is not after the edit
+		// NOTE the text before the edit is intact, so is the state of lexer there
+		auto resume = static_cast<size_t>(upper_bound(tokens.begin(), tokens.end(), edit.Offset,
+			[](size_t offset, const Token& tok) { return offset < tok.Location.Index; }) - tokens.begin());
+		while (resume > 0 && !tokens[resume - 1].StartOfLine)
+		{
+			resume -= 1;
+		}
+
+		auto from_start = resume == 0;
+		if (!from_start)
+		{
+			resume -= 1;
+		}
+
+		// relex until a token that starts a line after the edit is found at where an old one was
+		// as the text after it is intact, the rest of old tokens are still valid
+		auto lexer = from_start
+			? Lexer{ file->Data(), file }
+			: Lexer{ file->Data(), file, tokens[resume] };
+		auto pp_state = false;
+
+		auto relexed = TokenVec{};
+		auto synced = resume;
+		auto line_delta = int32_t{ 0 };
+		for (;;)
+		{
+			auto tok = lexer.Next();
+			if (tok.Tag == TokenTag::EndOfFile)
+			{
+				relexed.push_back(tok);
+				synced = tokens.size();
+				line_delta = static_cast<int32_t>(tok.Location.Line - tokens.back().Location.Line);
+				break;
+			}
+
+			if (tok.StartOfLine && tok.Location.Index >= inserted_end)
+			{
+				auto old_index = static_cast<uint32_t>(tok.Location.Index - delta);
+				while (tokens[synced].Location.Index < old_index && tokens[synced].Tag != TokenTag::EndOfFile)
+					synced += 1;
+
+				const auto& old = tokens[synced];
+				if (old.Location.Index == old_index
+					&& old.StartOfLine
+					&& old.SucceedingSpace == tok.SucceedingSpace
+					&& old.Location.Column == tok.Location.Column
+					&& old.Tag != TokenTag::EndOfFile)
 				{
-					lexer.HintHeaderName();
+					line_delta = static_cast<int32_t>(tok.Location.Line - old.Location.Line);
+					break;
 				}
 			}
 
-			pp_state = last_tok.StartOfLine && last_tok.Tag == TokenTag::Sharp;
+			relexed.push_back(tok);
+			TrackDirective(lexer, relexed.back(), pp_state);
+		}
 
-		} while (result.back().Tag != TokenTag::EndOfFile);
+		// narrow the range by tokens lexed the same as before, where they are not edited
+		// NOTE so that a copy of an old token out of the range could be rebased
+		auto intact = [&](const Token& tok) {
+			auto base = previous->Data().data();
+			return !less<const char*>{}(tok.Content.data(), base)
+				&& less<const char*>{}(tok.Content.data(), base + previous->Size())
+				? tok.Location.Index + tok.Content.size() <= edit.Offset
+				: tok.Location.Index < edit.Offset;
+		};
+
+		auto prefix = size_t{ 0 };
+		while (prefix < relexed.size() && resume + prefix < synced
+			&& intact(tokens[resume + prefix])
+			&& SameToken(relexed[prefix], tokens[resume + prefix], 0, 0))
+		{
+			prefix += 1;
+		}
+
+		auto suffix = size_t{ 0 };
+		while (prefix + suffix < relexed.size() && resume + prefix + suffix < synced
+			&& tokens[synced - suffix - 1].Location.Index >= edit.Offset + edit.RemovedLength
+			&& SameToken(relexed[relexed.size() - suffix - 1], tokens[synced - suffix - 1], delta, line_delta))
+		{
+			suffix += 1;
+		}
+
+		auto result = TokenEdit{ resume + prefix, synced - suffix, resume + relexed.size() - suffix };
+
+		// splice the relexed tokens, and move the others onto the new file
+		tokens.erase(tokens.begin() + resume, tokens.begin() + synced);
+		tokens.insert(tokens.begin() + resume, relexed.begin(), relexed.end());
+
+		for (auto i = size_t{ 0 }; i < resume; ++i)
+		{
+			RebaseToken(tokens[i], file, previous, edit, line_delta);
+		}
+		for (auto i = resume + relexed.size(); i < tokens.size(); ++i)
+		{
+			RebaseToken(tokens[i], file, previous, edit, line_delta);
+		}
 
 		return result;
 	}
@@ -5,4 +5,23 @@
 namespace lolita
 {
 	TokenVec LexSourceFile(const SourceFile* file);
+
+	// Tokens [Begin, End) that replace [Begin, PreviousEnd) after an edit
+	struct TokenEdit
+	{
+		size_t Begin;
+		size_t PreviousEnd;
+		size_t End;
+	};
+
+	// move $tok of $previous onto $file, which is $previous with $edit applied
+	// NOTE $tok should not be lexed from the text removed by $edit
+	void RebaseToken(Token& tok, const SourceFile* file, const SourceFile* previous,
+		const SourceEdit& edit, int32_t line_delta);
+
+	// update $tokens of $previous to those of $file, which is $previous with $edit applied
+	// only the lines around the edit are relexed, until the tokens are in sync again
+	// NOTE $edit should be clamped to the content of $previous
+	TokenEdit RelexSourceFile(const SourceFile* file, const SourceFile* previous,
+		TokenVec& tokens, const SourceEdit& edit);
 }
\ No newline at end of file
@@ -6,6 +6,7 @@ namespace lolita
 {
 	struct SourceLocation
 	{
+		// offset in bytes into the file
 		uint32_t Index;
 		uint32_t Line;
 		uint32_t Column;
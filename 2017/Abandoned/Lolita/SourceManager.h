@@ -1,57 +1,50 @@
 #pragma once
 #include "SourceFile.h"
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 
 namespace lolita
 {
+	// NOTE SourceManager keeps no state, so it could be shared by concurrent translations
+	//      files opened are cached by HeaderCache, see GetHeaderCache
 	class SourceManager
 	{
 	public:
-		// NOTE name is raw content of HeaderName
-		const SourceFile* Lookup(const std::string& name)
+		// NOTE name is raw content of HeaderName, and includer is the url of the file including it
+		SourceFile::Ptr OpenFile(const std::string& name, std::string_view includer = {})
 		{
-			// fast path, search in cache
-			auto cache_iter = cache_.find(name);
-			if (cache_iter != cache_.end())
-				return cache_iter->second.get();
-
-			// slow path, open the file and lex it
-			auto file = OpenFile(name);
-			if (file)
-			{
-				auto result = file.get();
-				cache_[name] = std::move(file);
-
-				return result;
-			}
-			else
-			{
-				// FIXME: throw?
+			auto url = ResolvePath(name, includer);
+			if (url.empty())
 				return nullptr;
-			}
+
+			return SourceFile::Open(name, url);
 		}
 
-		SourceFile::Ptr OpenFile(const std::string& name)
+		// returns the path of the file a HeaderName refers to, or an empty string if none
+		// a quoted name is searched in the directory of the includer, then in the working directory
+		// FIXME: there's no include path yet, so a bracketed name is never found
+		std::string ResolvePath(const std::string& name, std::string_view includer = {}) const
 		{
-			assert(name.size() > 2);
-			if (name.front() == '"' && name.back() == '"')
-			{
-				// FIXME:
-				auto url = "C:\\Users\\Edward Cheng\\Desktop\\" + name.substr(1, name.size() - 2);
-				return SourceFile::Open(name, url);
-			}
-			else if (name.front() == '<' && name.back() == '>')
-			{
-				throw;
-			}
-			else
+			if (name.size() < 3 || name.front() != '"' || name.back() != '"')
+				return {};
+
+			auto path = name.substr(1, name.size() - 2);
+			auto absolute = path.front() == '/' || path.front() == '\\' || (path.size() > 1 && path[1] == ':');
+
+			auto dir_end = includer.find_last_of("/\\");
+			if (!absolute && dir_end != std::string_view::npos)
 			{
-				return nullptr;
+				auto url = std::string{ includer.substr(0, dir_end + 1) } + path;
+				if (GetLastWriteTime(url) != -1)
+					return url;
 			}
-		}
 
-		std::unordered_map<std::string, SourceFile::Ptr> cache_;
+			if (GetLastWriteTime(path) != -1)
+				return path;
+
+			return {};
+		}
 	};
 }
\ No newline at end of file
@@ -20,7 +20,7 @@ namespace lolita
 		// maybe nullptr, where no scope should be added
 		Scope* LocalScope;
 
-		StringVec Labels;
+		ArenaArray<SymbolId> Labels;
 	};
 
 	// Stmt
@@ -37,7 +37,7 @@ namespace lolita
 
 	struct CompoundStmt : public StmtBase
 	{
-		std::vector<StmtBase*> Children;
+		ArenaArray<StmtBase*> Children;
 
 		void Accept(StmtVisitor&) override;
 	};
@@ -0,0 +1,61 @@
+#include "StringPool.h"
+#include <cstring>
+
+using namespace std;
+
+namespace lolita
+{
+	// Implementation of StringArena
+	//
+
+	string_view StringArena::Allocate(string_view s)
+	{
+		// large strings get a chunk of their own
+		if (s.size() > kChunkSize / 4)
+		{
+			chunks_.emplace_back(new char[s.size()]);
+			memcpy(chunks_.back().get(), s.data(), s.size());
+
+			// NOTE the rest of the current chunk is wasted, as it's no longer the last one
+			chunk_used_ = kChunkSize;
+			return string_view{ chunks_.back().get(), s.size() };
+		}
+
+		if (chunk_used_ + s.size() > kChunkSize)
+		{
+			chunks_.emplace_back(new char[kChunkSize]);
+			chunk_used_ = 0;
+		}
+
+		auto p = chunks_.back().get() + chunk_used_;
+		memcpy(p, s.data(), s.size());
+		chunk_used_ += s.size();
+
+		return string_view{ p, s.size() };
+	}
+
+	// Implementation of StringPool
+	//
+
+	string_view StringPool::Intern(string_view s)
+	{
+		lock_guard<mutex> lock{ mutex_ };
+
+		// fast path, already interned
+		auto iter = lookup_.find(s);
+		if (iter != lookup_.end())
+			return *iter;
+
+		// slow path, copy it into the pool
+		auto result = arena_.Allocate(s);
+		lookup_.insert(result);
+
+		return result;
+	}
+
+	StringPool& GetStringPool()
+	{
+		static StringPool pool;
+		return pool;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <unordered_set>
+
+namespace lolita
+{
+	// A chunked storage of strings, views yielded are stable until the arena is destroyed
+	// NOTE StringArena is not thread-safe
+	class StringArena
+	{
+	public:
+		StringArena() = default;
+		StringArena(const StringArena&) = delete;
+		StringArena& operator=(const StringArena&) = delete;
+
+		std::string_view Allocate(std::string_view s);
+
+	private:
+		static constexpr size_t kChunkSize = 64 * 1024;
+
+		std::vector<std::unique_ptr<char[]>> chunks_;
+		size_t chunk_used_ = kChunkSize;
+	};
+
+	// An append-only storage of unique strings
+	// views yielded are stable until the pool is destroyed,
+	// and equal strings are interned into the same view
+	class StringPool
+	{
+	public:
+		StringPool() = default;
+		StringPool(const StringPool&) = delete;
+		StringPool& operator=(const StringPool&) = delete;
+
+		std::string_view Intern(std::string_view s);
+
+	private:
+		std::mutex mutex_;
+
+		// interned strings, keyed by views into arena_
+		std::unordered_set<std::string_view> lookup_;
+
+		StringArena arena_;
+	};
+
+	// the process-wide pool for text of tokens that are not in a source file
+	// e.g. spliced tokens and tokens synthesized in macro expansion
+	StringPool& GetStringPool();
+
+	inline std::string_view InternString(std::string_view s)
+	{
+		return GetStringPool().Intern(s);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "Symbol.h"
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace lolita
+{
+	static constexpr string_view kPredefinedSymbolText[] =
+	{
+		// keywords
+		"_Alignas", "_Alignof", "_Atomic", "auto", "break", "_Bool", "case", "char",
+		"_Complex", "const", "continue", "default", "do", "double", "else", "enum",
+		"extern", "float", "for", "_Generic", "goto", "if", "_Imaginary", "inline",
+		"int", "long", "_Noreturn", "register", "restrict", "return", "short", "signed",
+		"sizeof", "static", "_Static_assert", "struct", "switch", "_Thread_local", "typedef", "union",
+		"unsigned", "void", "volatile", "while",
+
+		// preprocessing directives
+		"ifdef", "ifndef", "elif", "endif", "define", "undef", "include", "pragma", "line", "error",
+
+		// others
+		"__VA_ARGS__", "__FILE__", "__LINE__", "defined", "once",
+	};
+
+	static_assert(size(kPredefinedSymbolText) == kPredefinedSymbolCount,
+		"predefined symbols mismatch");
+
+	// Implementation of SymbolTable
+	//
+
+	SymbolTable::SymbolTable()
+		: blocks_(new atomic<string_view*>[kMaxBlockCount])
+	{
+		for (size_t i = 0; i < kMaxBlockCount; ++i)
+		{
+			blocks_[i].store(nullptr, memory_order_relaxed);
+		}
+
+		for (auto text : kPredefinedSymbolText)
+		{
+			Intern(text);
+		}
+	}
+
+	SymbolId SymbolTable::Intern(string_view text)
+	{
+		auto& shard = shards_[hash<string_view>{}(text) % kShardCount];
+		lock_guard<mutex> lock{ shard.Mutex };
+
+		// fast path, already interned
+		auto iter = shard.Lookup.find(text);
+		if (iter != shard.Lookup.end())
+			return iter->second;
+
+		// slow path, assign a new id
+		auto id = next_id_.fetch_add(1, memory_order_relaxed);
+		if (id >= kBlockSize * kMaxBlockCount)
+			throw std::runtime_error("too many symbols");
+
+		auto stored = shard.Arena.Allocate(text);
+		shard.Lookup.emplace(stored, id);
+		Publish(id, stored);
+
+		return id;
+	}
+
+	void SymbolTable::Publish(SymbolId id, string_view text)
+	{
+		auto& slot = blocks_[id >> kBlockBits];
+
+		auto block = slot.load(memory_order_acquire);
+		if (block == nullptr)
+		{
+			lock_guard<mutex> lock{ block_mutex_ };
+
+			// double check, as another shard may have allocated it
+			block = slot.load(memory_order_relaxed);
+			if (block == nullptr)
+			{
+				block_storage_.emplace_back(new string_view[kBlockSize]);
+				block = block_storage_.back().get();
+				slot.store(block, memory_order_release);
+			}
+		}
+
+		// NOTE the id is not visible to other threads before the shard lock is released
+		block[id & (kBlockSize - 1)] = text;
+	}
+
+	SymbolTable& GetSymbolTable()
+	{
+		static SymbolTable table;
+		return table;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+#include "StringPool.h"
+#include <cstdint>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+namespace lolita
+{
+	// a dense id of an interned identifier
+	using SymbolId = uint32_t;
+
+	static constexpr SymbolId kInvalidSymbol = UINT32_MAX;
+
+	// Predefined Symbols
+	// they are interned before any other identifier, in the order below
+	// NOTE the list must match kPredefinedSymbolText in Symbol.cpp
+	//
+
+	// keywords take the first ids, in the same order as in TokenTag
+	static constexpr SymbolId kKeywordSymbolCount = 44;
+
+	enum : SymbolId
+	{
+		// preprocessing directives
+		// NOTE "if" and "else" are keywords
+		kSymbolIfdef = kKeywordSymbolCount,
+		kSymbolIfndef,
+		kSymbolElif,
+		kSymbolEndif,
+		kSymbolDefine,
+		kSymbolUndef,
+		kSymbolInclude,
+		kSymbolPragma,
+		kSymbolLine,
+		kSymbolError,
+
+		// others
+		kSymbolVaArgs,			// __VA_ARGS__
+		kSymbolBuiltinFile,		// __FILE__
+		kSymbolBuiltinLine,		// __LINE__
+		kSymbolDefined,			// defined
+		kSymbolOnce,			// once
+
+		kPredefinedSymbolCount,
+	};
+
+	// A thread-safe table that maps identifiers to dense ids
+	// NOTE symbols are never removed, and their text is stable
+	class SymbolTable
+	{
+	public:
+		SymbolTable();
+		SymbolTable(const SymbolTable&) = delete;
+		SymbolTable& operator=(const SymbolTable&) = delete;
+
+		SymbolId Intern(std::string_view text);
+
+		// NOTE id must be yielded by Intern
+		std::string_view Text(SymbolId id) const
+		{
+			auto block = blocks_[id >> kBlockBits].load(std::memory_order_acquire);
+			return block[id & (kBlockSize - 1)];
+		}
+
+		size_t Size() const
+		{
+			return next_id_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// identifiers are distributed into shards to reduce lock contention
+		static constexpr size_t kShardCount = 16;
+
+		// text of symbols are indexed in blocks, so that a lookup never takes a lock
+		static constexpr size_t kBlockBits = 12;
+		static constexpr size_t kBlockSize = size_t(1) << kBlockBits;
+		static constexpr size_t kMaxBlockCount = 4096;
+
+		struct Shard
+		{
+			std::mutex Mutex;
+			std::unordered_map<std::string_view, SymbolId> Lookup;
+			StringArena Arena;
+		};
+
+		void Publish(SymbolId id, std::string_view text);
+
+	private:
+		Shard shards_[kShardCount];
+
+		std::atomic<SymbolId> next_id_{ 0 };
+
+		std::mutex block_mutex_;
+		std::unique_ptr<std::atomic<std::string_view*>[]> blocks_;
+		std::vector<std::unique_ptr<std::string_view[]>> block_storage_;
+	};
+
+	// the process-wide symbol table
+	SymbolTable& GetSymbolTable();
+
+	inline SymbolId InternSymbol(std::string_view text)
+	{
+		return GetSymbolTable().Intern(text);
+	}
+
+	inline std::string_view SymbolText(SymbolId id)
+	{
+		return GetSymbolTable().Text(id);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "catch.hpp"
+#include "../IncrementalTranslation.h"
+#include "../Decl.h"
+#include "../Expr.h"
+#include "../HeaderCache.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace lolita;
+
+namespace
+{
+	// a translation of $content, which is written to a file first
+	IncrementalTranslation::Ptr OpenContent(SourceManager& src, const std::string& filename, const std::string& content)
+	{
+		std::ofstream{ filename, std::ios::binary } << content;
+
+		auto options = DriverOptions{};
+		options.Parse = true;
+		return IncrementalTranslation::Open(filename, src, options);
+	}
+
+	const std::string& DeclName(const DeclBase* decl)
+	{
+		static const std::string kNoName;
+		if (auto var = dynamic_cast<const VariableDecl*>(decl))
+			return var->Name;
+		if (auto func = dynamic_cast<const FunctionDecl*>(decl))
+			return func->Name;
+
+		return kNoName;
+	}
+
+	// declarations of $x are of the same names and ranges as those of $y
+	void RequireSameDecls(const IncrementalTranslation& x, const IncrementalTranslation& y)
+	{
+		REQUIRE(x.Decls().size() == y.Decls().size());
+		for (size_t i = 0; i < x.Decls().size(); ++i)
+		{
+			const auto& lhs = x.Decls()[i];
+			const auto& rhs = y.Decls()[i];
+
+			REQUIRE(lhs.Begin == rhs.Begin);
+			REQUIRE(lhs.End == rhs.End);
+			REQUIRE(DeclName(lhs.Decl) == DeclName(rhs.Decl));
+			REQUIRE((dynamic_cast<const FunctionDecl*>(lhs.Decl) == nullptr) == (dynamic_cast<const FunctionDecl*>(rhs.Decl) == nullptr));
+		}
+	}
+}
+
+TEST_CASE("IncrementalTranslation reparses declarations edited")
+{
+	const std::string content = "int a = 1;\nint b = 2;\nint f() { return a + b; }\nint c = 3;\n";
+
+	SourceManager src;
+	auto edited = OpenContent(src, "incremental_test_edited.c", content);
+	REQUIRE(edited != nullptr);
+	REQUIRE(!edited->Aborted());
+	REQUIRE(edited->Decls().size() == 4);
+
+	// each edit is translated incrementally, and yields what a full translation of the result does
+	auto check_edit = [&](const SourceEdit& edit) {
+		REQUIRE(edited->Edit(edit));
+		REQUIRE(!edited->LastEdit().Repreprocessed);
+		REQUIRE(!edited->LastEdit().Reparsed);
+		REQUIRE(edited->LastEdit().ParsedDecls < edited->Decls().size());
+
+		auto full = OpenContent(src, "incremental_test_full.c", std::string{ edited->File()->Data() });
+		REQUIRE(full != nullptr);
+		REQUIRE(!full->Aborted());
+
+		RequireSameDecls(*edited, *full);
+	};
+
+	// insert " + a" after "2"
+	check_edit(SourceEdit{ content.find("2;") + 1, 0, " + a" });
+	REQUIRE(std::string{ edited->File()->Data() } == "int a = 1;\nint b = 2 + a;\nint f() { return a + b; }\nint c = 3;\n");
+
+	// insert a declaration, which moves those after
+	check_edit(SourceEdit{ 0, 0, "int z = 0;\n" });
+	REQUIRE(edited->Decls().size() == 5);
+
+	// edit the body of f
+	auto body = std::string{ edited->File()->Data() }.find("a + b");
+	check_edit(SourceEdit{ body, 5, "z" });
+
+	// remove a declaration
+	auto removed = std::string{ edited->File()->Data() }.find("int c = 3;");
+	check_edit(SourceEdit{ removed, 10, "" });
+	REQUIRE(edited->Decls().size() == 4);
+
+	std::remove("incremental_test_edited.c");
+	std::remove("incremental_test_full.c");
+}
+
+TEST_CASE("IncrementalTranslation declares parameters in function bodies")
+{
+	SourceManager src;
+	auto tu = OpenContent(src, "incremental_test_params.c", "int f(int x, int y) { return x + y; }\nint g(int) { return 0; }\n");
+	REQUIRE(tu != nullptr);
+	REQUIRE(!tu->Aborted());
+	REQUIRE(tu->Decls().size() == 2);
+	REQUIRE(tu->Diagnostics().empty());
+
+	// a parameter goes out of sight after the body
+	auto offset = std::string{ tu->File()->Data() }.find("return 0");
+	REQUIRE(!tu->Edit(SourceEdit{ offset + 7, 1, "x" }));
+	REQUIRE(tu->Diagnostics().size() == 1);
+	REQUIRE(tu->Diagnostics()[0].find("identifier x does not refer to a variable") != std::string::npos);
+
+	std::remove("incremental_test_params.c");
+}
+
+TEST_CASE("IncrementalTranslation folds sizeof and _Alignof of types")
+{
+	SourceManager src;
+	auto tu = OpenContent(src, "incremental_test_sizeof.c", "int s = sizeof(long long);\nint t = _Alignof(short);\nint u = 0;\n");
+	REQUIRE(tu != nullptr);
+	REQUIRE(!tu->Aborted());
+	REQUIRE(tu->Diagnostics().empty());
+	REQUIRE(tu->Decls().size() == 3);
+
+	auto folded = [&](size_t i) {
+		auto var = dynamic_cast<const VariableDecl*>(tu->Decls()[i].Decl);
+		REQUIRE(var != nullptr);
+		auto literal = dynamic_cast<const LiteralExpr*>(var->Init);
+		REQUIRE(literal != nullptr);
+		auto value = std::get_if<CInteger>(&literal->Value());
+		REQUIRE(value != nullptr);
+		REQUIRE(value->Precision() == IntPrecision::UInt32);
+		return value->Value();
+	};
+	REQUIRE(folded(0) == 8);
+	REQUIRE(folded(1) == 2);
+
+	// types of expressions are not deduced yet, so sizeof an expression is reported
+	auto offset = std::string{ tu->File()->Data() }.find("0;");
+	REQUIRE(!tu->Edit(SourceEdit{ offset, 1, "sizeof s" }));
+	REQUIRE(tu->Diagnostics().size() == 1);
+	REQUIRE(tu->Diagnostics()[0].find("sizeof an expression is not supported yet") != std::string::npos);
+
+	std::remove("incremental_test_sizeof.c");
+}
+
+TEST_CASE("IncrementalTranslation keeps typedef names apart from variables")
+{
+	const std::string content = "typedef int T;\nint a = 1;\nint g() { return a; }\n";
+
+	SourceManager src;
+	auto edited = OpenContent(src, "incremental_test_edited.c", content);
+	REQUIRE(edited != nullptr);
+	REQUIRE(!edited->Aborted());
+	REQUIRE(edited->Diagnostics().empty());
+	REQUIRE(edited->Decls().size() == 3);
+
+	auto typedef_decl = dynamic_cast<const VariableDecl*>(edited->Decls()[0].Decl);
+	REQUIRE(typedef_decl != nullptr);
+	REQUIRE(typedef_decl->Spec == StorageSpecifier::Typedef);
+
+	// refer to a variable in g, which is reparsed with the names declared before redeclared
+	auto offset = content.find("return a") + 7;
+	REQUIRE(edited->Edit(SourceEdit{ offset, 1, "a + 1" }));
+	REQUIRE(!edited->LastEdit().Reparsed);
+	REQUIRE(edited->LastEdit().ParsedDecls == 1);
+	REQUIRE(edited->Diagnostics().empty());
+
+	// and to the typedef name, which is not a variable either way
+	offset = std::string{ edited->File()->Data() }.find("return a") + 7;
+	REQUIRE(!edited->Edit(SourceEdit{ offset, 1, "T" }));
+	REQUIRE(edited->Diagnostics().size() == 1);
+	REQUIRE(edited->Diagnostics()[0].find("identifier T does not refer to a variable") != std::string::npos);
+
+	auto full = OpenContent(src, "incremental_test_full.c", std::string{ edited->File()->Data() });
+	REQUIRE(full != nullptr);
+	REQUIRE(full->Aborted());
+	REQUIRE(full->Diagnostics().size() == 1);
+	REQUIRE(full->Diagnostics()[0].find("line 3; column 18;") != std::string::npos);
+	REQUIRE(edited->Diagnostics()[0].find("line 3; column 18;") != std::string::npos);
+
+	std::remove("incremental_test_edited.c");
+	std::remove("incremental_test_full.c");
+}
+
+TEST_CASE("IncrementalTranslation resolves quoted headers next to the includer")
+{
+	std::filesystem::create_directory("incremental_test_dir");
+	std::ofstream{ "incremental_test_dir/header.h", std::ios::binary } << "int h = 1;\n";
+
+	// the header is not in the working directory, but next to the file including it
+	SourceManager src;
+	auto tu = OpenContent(src, "incremental_test_dir/main.c", "#include \"header.h\"\nint m = h;\n");
+	REQUIRE(tu != nullptr);
+	REQUIRE(!tu->Aborted());
+	REQUIRE(tu->Diagnostics().empty());
+	REQUIRE(tu->Decls().size() == 2);
+
+	// there's no include path, so a bracketed name is reported instead
+	auto bracketed = OpenContent(src, "incremental_test_dir/bracketed.c", "#include <header.h>\nint m = 0;\n");
+	REQUIRE(bracketed != nullptr);
+	REQUIRE(bracketed->Diagnostics().size() == 1);
+	REQUIRE(bracketed->Diagnostics()[0].find("cannot lex file") != std::string::npos);
+
+	std::filesystem::remove_all("incremental_test_dir");
+}
+
+TEST_CASE("IncrementalTranslation lexes a header again after it is rewritten in place")
+{
+	std::filesystem::create_directory("incremental_test_dir");
+	std::ofstream{ "incremental_test_dir/header.h", std::ios::binary } << "int h = 1;\nint k = 2;\n";
+
+	SourceManager src;
+	auto before = OpenContent(src, "incremental_test_dir/main.c", "#include \"header.h\"\nint m = h;\n");
+	REQUIRE(before != nullptr);
+	REQUIRE(before->Diagnostics().empty());
+	REQUIRE(before->Decls().size() == 3);
+
+	auto old_header = GetHeaderCache().Lookup("\"header.h\"", "incremental_test_dir/main.c", src);
+	REQUIRE(old_header != nullptr);
+	REQUIRE(!old_header->File()->IsMapped());
+
+	// truncate and rewrite the same file, whose write time is moved on in case the clock is coarse
+	auto write_time = std::filesystem::last_write_time("incremental_test_dir/header.h");
+	std::ofstream{ "incremental_test_dir/header.h", std::ios::binary | std::ios::trunc } << "int h;\n";
+	std::filesystem::last_write_time("incremental_test_dir/header.h", write_time + std::chrono::seconds{ 1 });
+
+	// the header kept is left as it was lexed
+	REQUIRE(old_header->File()->Data() == "int h = 1;\nint k = 2;\n");
+
+	auto after = OpenContent(src, "incremental_test_dir/main.c", "#include \"header.h\"\nint m = h;\n");
+	REQUIRE(after != nullptr);
+	REQUIRE(after->Diagnostics().empty());
+	REQUIRE(after->Decls().size() == 2);
+	REQUIRE(GetHeaderCache().Lookup("\"header.h\"", "incremental_test_dir/main.c", src) != old_header);
+
+	std::filesystem::remove_all("incremental_test_dir");
+}
\ No newline at end of file
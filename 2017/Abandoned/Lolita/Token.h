@@ -1,13 +1,17 @@
 #pragma once
 #include "SourceLocation.h"
+#include "Symbol.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cassert>
 #include <algorithm>
 
 namespace lolita
 {
-	enum class TokenTag
+	// NOTE tags are stored in a byte, see TokenBuffer
+	enum class TokenTag : uint8_t
 	{
 		// Preprocessing Temporaries
 		//
@@ -151,13 +155,30 @@ namespace lolita
 		StringLiteral,
 	};
 
+	static_assert(static_cast<int>(TokenTag::While) - static_cast<int>(TokenTag::Alignas) + 1 == kKeywordSymbolCount,
+		"keyword symbols mismatch");
+
+	constexpr SymbolId KeywordSymbol(TokenTag tag)
+	{
+		return static_cast<SymbolId>(static_cast<int>(tag) - static_cast<int>(TokenTag::Alignas));
+	}
+
+	// returns TokenTag::Identifier if the symbol is not a keyword
+	constexpr TokenTag TranslateKeyword(SymbolId id)
+	{
+		return id < kKeywordSymbolCount
+			? static_cast<TokenTag>(static_cast<int>(TokenTag::Alignas) + id)
+			: TokenTag::Identifier;
+	}
+
 	struct Token
 	{
 		// category of the token
 		TokenTag Tag;
 
 		// text form of the token
-		std::string Content;
+		// NOTE it's a view into either the source file or the StringPool
+		std::string_view Content;
 
 		// reference location of the token
 		SourceLocation Location;
@@ -167,83 +188,145 @@ namespace lolita
 
 		// indicates if there's any whitespace preceeding this token
 		bool SucceedingSpace;
+
+		// id of the identifier, or kInvalidSymbol for other tokens
+		SymbolId Symbol = kInvalidSymbol;
 	};
 
 	// a TokenVec instance should always ends with an EndOfFile Token
 	using TokenVec = std::vector<Token>;
 
-	// a wrapper class for TokenSeq that provides iteration utilities
-	class TokenSource
+	// How BasicTokenSource accesses a sequence of tokens
+	template <typename TSeq>
+	struct TokenSeqTraits;
+
+	template <>
+	struct TokenSeqTraits<TokenVec>
+	{
+		static size_t Size(const TokenVec& seq) { return seq.size(); }
+		static TokenTag Tag(const TokenVec& seq, size_t i) { return seq[i].Tag; }
+		static bool StartOfLine(const TokenVec& seq, size_t i) { return seq[i].StartOfLine; }
+		static SymbolId Symbol(const TokenVec& seq, size_t i) { return seq[i].Symbol; }
+		static std::string_view Content(const TokenVec& seq, size_t i) { return seq[i].Content; }
+		static const Token& Get(const TokenVec& seq, size_t i) { return seq[i]; }
+	};
+
+	// a wrapper class for a sequence of tokens that provides iteration utilities
+	// NOTE a token is returned by value if the sequence does not store it as is, e.g. TokenBuffer
+	template <typename TSeq>
+	class BasicTokenSource
 	{
 	public:
-		TokenSource(const TokenVec& seq)
+		using Traits = TokenSeqTraits<TSeq>;
+
+		BasicTokenSource(const TSeq& seq)
 			: src_(seq), index_(0)
 		{ 
-			assert(!seq.empty());
-			assert(seq.back().Tag == TokenTag::EndOfFile);
-			assert(seq.back().StartOfLine);
+			assert(Traits::Size(seq) != 0);
+			assert(Traits::Tag(seq, Traits::Size(seq) - 1) == TokenTag::EndOfFile);
+			assert(Traits::StartOfLine(seq, Traits::Size(seq) - 1));
 		}
 
 		bool Exhausted() const
 		{
-			if (Peek().Tag == TokenTag::EndOfFile)
+			if (PeekTag() == TokenTag::EndOfFile)
 			{
-				assert(index_ == src_.size() - 1);
+				assert(index_ == Traits::Size(src_) - 1);
 			}
 
-			return Peek().Tag == TokenTag::EndOfFile;
+			return PeekTag() == TokenTag::EndOfFile;
 		}
 
-		const Token& Peek() const
+		decltype(auto) Peek() const
 		{
-			return src_[index_];
+			return Traits::Get(src_, index_);
 		}
 
-		const Token& LookAhead(size_t step) const
+		TokenTag PeekTag() const
+		{
+			return Traits::Tag(src_, index_);
+		}
+
+		SymbolId PeekSymbol() const
+		{
+			return Traits::Symbol(src_, index_);
+		}
+
+		// index of the next token to consume
+		size_t Position() const
+		{
+			return index_;
+		}
+
+		void Seek(size_t index)
+		{
+			assert(index < Traits::Size(src_));
+			index_ = index;
+		}
+
+		decltype(auto) LookAhead(size_t step) const
 		{
 			auto forward_index = 
-				std::min(index_ + step, src_.size() - 1);
+				std::min(index_ + step, Traits::Size(src_) - 1);
 
-			return src_[forward_index];
+			return Traits::Get(src_, forward_index);
 		}
 
-		const Token& Consume()
+		TokenTag LookAheadTag(size_t step) const
 		{
-			const auto& result = Peek();
-			index_ += Exhausted() ? 0 : 1;
+			return Traits::Tag(src_, std::min(index_ + step, Traits::Size(src_) - 1));
+		}
+
+		decltype(auto) Consume()
+		{
+			decltype(auto) result = Peek();
+			Skip();
 
 			return result;
 		}
 
-		const Token& LastConsumed()
+		// consume the next token without looking at it
+		void Skip()
+		{
+			index_ += Exhausted() ? 0 : 1;
+		}
+
+		decltype(auto) LastConsumed() const
 		{
-			if (index_ == 0)
-				return src_[0];
-			else
-				return src_[index_ - 1];
+			return Traits::Get(src_, LastConsumedIndex());
+		}
+
+		SymbolId LastConsumedSymbol() const
+		{
+			return Traits::Symbol(src_, LastConsumedIndex());
+		}
+
+		std::string_view LastConsumedContent() const
+		{
+			return Traits::Content(src_, LastConsumedIndex());
 		}
 
 		void OmitCurrentLine()
 		{
 			while (!StartOfLine())
-				Consume();
+				Skip();
 		}
 
 		bool StartOfLine() const
 		{
-			return Peek().StartOfLine;
+			return Traits::StartOfLine(src_, index_);
 		}
 
 		bool Test(TokenTag tag) const
 		{
-			return Peek().Tag == tag;
+			return PeekTag() == tag;
 		}
 
 		bool Try(TokenTag tag)
 		{
 			if (Test(tag))
 			{
-				Consume();
+				Skip();
 				return true;
 			}
 
@@ -251,7 +334,14 @@ namespace lolita
 		}
 
 	private:
-		const TokenVec& src_;
+		size_t LastConsumedIndex() const
+		{
+			return index_ == 0 ? 0 : index_ - 1;
+		}
+
+		const TSeq& src_;
 		size_t index_;
 	};
+
+	using TokenSource = BasicTokenSource<TokenVec>;
 }
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "TokenBuffer.h"
+#include "SourceLexer.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace lolita
+{
+	string_view TokenBuffer::Content(size_t i) const
+	{
+		if (flags_[i] & kSideTable)
+			return side_table_[values_[i]].Content;
+		if (flags_[i] & kSymbolic)
+			return SymbolText(values_[i]);
+
+		return file_table_[files_[i]]->Data().substr(offsets_[i], values_[i]);
+	}
+
+	SourceLocation TokenBuffer::Location(size_t i) const
+	{
+		if (flags_[i] & kSideTable)
+			return side_table_[values_[i]].Location;
+
+		auto file = file_table_[files_[i]];
+		auto position = file->Position(offsets_[i]);
+		return SourceLocation{ offsets_[i], position.first, position.second, file };
+	}
+
+	Token TokenBuffer::operator[](size_t i) const
+	{
+		if (flags_[i] & kSideTable)
+			return side_table_[values_[i]];
+
+		return Token{ tags_[i], Content(i), Location(i), StartOfLine(i), SucceedingSpace(i), Symbol(i) };
+	}
+
+	void TokenBuffer::Reserve(size_t n)
+	{
+		tags_.reserve(n);
+		flags_.reserve(n);
+		files_.reserve(n);
+		offsets_.reserve(n);
+		values_.reserve(n);
+	}
+
+	uint16_t TokenBuffer::AddFile(const SourceFile* file)
+	{
+		if (last_file_ != kMaxFileCount && file_table_[last_file_] == file)
+			return last_file_;
+
+		auto iter = find(file_table_.begin(), file_table_.end(), file);
+		if (iter == file_table_.end())
+		{
+			if (file_table_.size() == kMaxFileCount)
+				return kMaxFileCount;
+
+			iter = file_table_.insert(iter, file);
+		}
+
+		last_file_ = static_cast<uint16_t>(iter - file_table_.begin());
+		return last_file_;
+	}
+
+	void TokenBuffer::Describe(const Token& tok, uint8_t& flags, uint16_t& file, uint32_t& offset, uint32_t& value)
+	{
+		flags = static_cast<uint8_t>((tok.StartOfLine ? kStartOfLine : 0) | (tok.SucceedingSpace ? kSucceedingSpace : 0));
+		file = 0;
+		offset = tok.Location.Index;
+
+		// the location is of a file loaded, whose line table would yield the same line and column
+		// NOTE the lexer, and those who move tokens, keep the location in sync with the content
+		const auto& loc = tok.Location;
+		auto located = loc.File != nullptr
+			&& !loc.File->Data().empty()
+			&& loc.Index <= loc.File->Size()
+			&& (file = AddFile(loc.File)) != kMaxFileCount;
+
+		auto data = located ? loc.File->Data().data() + loc.Index : nullptr;
+		if (located && tok.Symbol != kInvalidSymbol && tok.Content.data() == SymbolText(tok.Symbol).data())
+		{
+			// an identifier shares the text in the symbol table
+			flags |= kSymbolic;
+			value = tok.Symbol;
+		}
+		else if (located && tok.Symbol == kInvalidSymbol
+			&& (tok.Content.empty() || tok.Content.data() == data)
+			&& tok.Content.size() <= loc.File->Size() - loc.Index)
+		{
+			// the text is at the location
+			value = static_cast<uint32_t>(tok.Content.size());
+		}
+		else
+		{
+			flags |= kSideTable;
+			value = static_cast<uint32_t>(side_table_.size());
+			side_table_.push_back(tok);
+		}
+
+		assert((flags & kSideTable) || loc.File->Position(loc.Index) == make_pair(loc.Line, loc.Column));
+	}
+
+	void TokenBuffer::PushBack(const Token& tok)
+	{
+		uint8_t flags;
+		uint16_t file;
+		uint32_t offset, value;
+		Describe(tok, flags, file, offset, value);
+
+		tags_.push_back(tok.Tag);
+		flags_.push_back(flags);
+		files_.push_back(file);
+		offsets_.push_back(offset);
+		values_.push_back(value);
+	}
+
+	void TokenBuffer::Append(const TokenBuffer& other, size_t begin, size_t end)
+	{
+		assert(&other != this && begin <= end && end <= other.Size());
+
+		// NOTE file indices differ between buffers, they're mapped lazily
+		auto file_map = vector<uint16_t>(other.file_table_.size(), kMaxFileCount);
+
+		Reserve(Size() + end - begin);
+		for (auto i = begin; i < end; ++i)
+		{
+			if (other.flags_[i] & kSideTable)
+			{
+				PushBack(other.side_table_[other.values_[i]]);
+				continue;
+			}
+
+			auto& file = file_map[other.files_[i]];
+			if (file == kMaxFileCount)
+			{
+				file = AddFile(other.file_table_[other.files_[i]]);
+				if (file == kMaxFileCount)
+				{
+					PushBack(other[i]);
+					continue;
+				}
+			}
+
+			tags_.push_back(other.tags_[i]);
+			flags_.push_back(other.flags_[i]);
+			files_.push_back(file);
+			offsets_.push_back(other.offsets_[i]);
+			values_.push_back(other.values_[i]);
+		}
+	}
+
+	void TokenBuffer::Erase(size_t begin, size_t end)
+	{
+		assert(begin <= end && end <= Size());
+
+		auto side_erased = any_of(flags_.begin() + begin, flags_.begin() + end,
+			[](uint8_t flags) { return (flags & kSideTable) != 0; });
+
+		tags_.erase(tags_.begin() + begin, tags_.begin() + end);
+		flags_.erase(flags_.begin() + begin, flags_.begin() + end);
+		files_.erase(files_.begin() + begin, files_.begin() + end);
+		offsets_.erase(offsets_.begin() + begin, offsets_.begin() + end);
+		values_.erase(values_.begin() + begin, values_.begin() + end);
+
+		// compact the side table, so that no entry is left for a token erased
+		if (side_erased)
+		{
+			auto side_table = vector<Token>{};
+			for (auto i = size_t{ 0 }; i < Size(); ++i)
+			{
+				if (flags_[i] & kSideTable)
+				{
+					side_table.push_back(move(side_table_[values_[i]]));
+					values_[i] = static_cast<uint32_t>(side_table.size() - 1);
+				}
+			}
+
+			side_table_ = move(side_table);
+		}
+	}
+
+	void TokenBuffer::Insert(size_t pos, const TokenVec& tokens)
+	{
+		assert(pos <= Size());
+
+		auto count = tokens.size();
+		tags_.insert(tags_.begin() + pos, count, TokenTag::EndOfFile);
+		flags_.insert(flags_.begin() + pos, count, 0);
+		files_.insert(files_.begin() + pos, count, 0);
+		offsets_.insert(offsets_.begin() + pos, count, 0);
+		values_.insert(values_.begin() + pos, count, 0);
+
+		for (auto i = size_t{ 0 }; i < count; ++i)
+		{
+			tags_[pos + i] = tokens[i].Tag;
+			Describe(tokens[i], flags_[pos + i], files_[pos + i], offsets_[pos + i], values_[pos + i]);
+		}
+	}
+
+	void TokenBuffer::Rebase(const SourceFile* file, const SourceFile* previous, const SourceEdit& edit, int32_t line_delta)
+	{
+		auto delta = static_cast<int64_t>(edit.Text.size()) - static_cast<int64_t>(edit.RemovedLength);
+		auto edit_end = edit.Offset + edit.RemovedLength;
+
+		for (auto& tok : side_table_)
+		{
+			RebaseToken(tok, file, previous, edit, line_delta);
+		}
+
+		auto from = find(file_table_.begin(), file_table_.end(), previous);
+		if (from == file_table_.end())
+			return;
+
+		// $file takes the place of $previous, unless it's already referred to
+		auto from_index = static_cast<uint16_t>(from - file_table_.begin());
+		auto to_index = from_index;
+		auto to = find(file_table_.begin(), file_table_.end(), file);
+		if (to != file_table_.end())
+			to_index = static_cast<uint16_t>(to - file_table_.begin());
+		else
+			file_table_[from_index] = file;
+
+		// the content moves with the offset, and the line table of $file yields lines moved
+		for (auto i = size_t{ 0 }; i < Size(); ++i)
+		{
+			if ((flags_[i] & kSideTable) || files_[i] != from_index)
+				continue;
+
+			assert(offsets_[i] < edit.Offset || offsets_[i] >= edit_end);
+
+			files_[i] = to_index;
+			if (offsets_[i] >= edit_end)
+				offsets_[i] = static_cast<uint32_t>(offsets_[i] + delta);
+		}
+	}
+
+	size_t TokenBuffer::MemoryUsage() const
+	{
+		return tags_.capacity() * sizeof(TokenTag)
+			+ flags_.capacity() * sizeof(uint8_t)
+			+ files_.capacity() * sizeof(uint16_t)
+			+ offsets_.capacity() * sizeof(uint32_t)
+			+ values_.capacity() * sizeof(uint32_t)
+			+ side_table_.capacity() * sizeof(Token)
+			+ file_table_.capacity() * sizeof(const SourceFile*);
+	}
+
+	TokenVec TokenBuffer::ToVec() const
+	{
+		auto result = TokenVec{};
+		result.reserve(Size());
+		for (auto i = size_t{ 0 }; i < Size(); ++i)
+		{
+			result.push_back((*this)[i]);
+		}
+
+		return result;
+	}
+}
\ No newline at end of file
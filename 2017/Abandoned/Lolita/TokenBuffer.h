@@ -0,0 +1,130 @@
+#pragma once
+#include "Token.h"
+#include "SourceFile.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lolita
+{
+	// A compact sequence of tokens, stored as a struct of arrays
+	// a token takes 12 bytes, i.e. a tag, flags, a file, an offset and a value, where the value
+	// is the symbol of an identifier, or the length of the text at the offset of the file
+	// line and column are computed from the line table of the file when a location is asked for
+	// NOTE a token that cannot be described so is stored as is in a side table, e.g. a text pasted,
+	//      or a location in a file whose content is not loaded
+	class TokenBuffer
+	{
+	public:
+		TokenBuffer() = default;
+
+		size_t Size() const
+		{
+			return tags_.size();
+		}
+
+		bool Empty() const
+		{
+			return tags_.empty();
+		}
+
+		TokenTag Tag(size_t i) const
+		{
+			return tags_[i];
+		}
+
+		bool StartOfLine(size_t i) const
+		{
+			return (flags_[i] & kStartOfLine) != 0;
+		}
+
+		bool SucceedingSpace(size_t i) const
+		{
+			return (flags_[i] & kSucceedingSpace) != 0;
+		}
+
+		SymbolId Symbol(size_t i) const
+		{
+			if (flags_[i] & kSideTable)
+				return side_table_[values_[i]].Symbol;
+
+			return (flags_[i] & kSymbolic) ? values_[i] : kInvalidSymbol;
+		}
+
+		std::string_view Content(size_t i) const;
+		SourceLocation Location(size_t i) const;
+
+		// a copy of the token at $i
+		Token operator[](size_t i) const;
+
+		Token Back() const
+		{
+			return (*this)[Size() - 1];
+		}
+
+		void Reserve(size_t n);
+
+		void PushBack(const Token& tok);
+
+		// append tokens [$begin, $end) of $other
+		void Append(const TokenBuffer& other, size_t begin, size_t end);
+
+		void Erase(size_t begin, size_t end);
+		void Insert(size_t pos, const TokenVec& tokens);
+
+		// move tokens of $previous onto $file, which is $previous with $edit applied
+		// NOTE see RebaseToken
+		void Rebase(const SourceFile* file, const SourceFile* previous, const SourceEdit& edit, int32_t line_delta);
+
+		// bytes taken by the tokens
+		size_t MemoryUsage() const;
+
+		TokenVec ToVec() const;
+
+	private:
+		enum : uint8_t
+		{
+			kStartOfLine = 1 << 0,
+			kSucceedingSpace = 1 << 1,
+
+			// the value is a symbol, whose text is the content
+			kSymbolic = 1 << 2,
+
+			// the value is an index into side_table_
+			kSideTable = 1 << 3,
+		};
+
+		static constexpr uint16_t kMaxFileCount = UINT16_MAX;
+
+		// returns kMaxFileCount if the file table is full
+		uint16_t AddFile(const SourceFile* file);
+
+		// fill columns other than tags_ and flags_ for $tok
+		void Describe(const Token& tok, uint8_t& flags, uint16_t& file, uint32_t& offset, uint32_t& value);
+
+		std::vector<TokenTag> tags_;
+		std::vector<uint8_t> flags_;
+		std::vector<uint16_t> files_;
+		std::vector<uint32_t> offsets_;
+		std::vector<uint32_t> values_;
+
+		std::vector<Token> side_table_;
+
+		// files referred to, the last added is cached as tokens come from a file in a row
+		std::vector<const SourceFile*> file_table_;
+		uint16_t last_file_ = kMaxFileCount;
+	};
+
+	template <>
+	struct TokenSeqTraits<TokenBuffer>
+	{
+		static size_t Size(const TokenBuffer& seq) { return seq.Size(); }
+		static TokenTag Tag(const TokenBuffer& seq, size_t i) { return seq.Tag(i); }
+		static bool StartOfLine(const TokenBuffer& seq, size_t i) { return seq.StartOfLine(i); }
+		static SymbolId Symbol(const TokenBuffer& seq, size_t i) { return seq.Symbol(i); }
+		static std::string_view Content(const TokenBuffer& seq, size_t i) { return seq.Content(i); }
+		static Token Get(const TokenBuffer& seq, size_t i) { return seq[i]; }
+	};
+
+	using TokenBufferSource = BasicTokenSource<TokenBuffer>;
+}
\ No newline at end of file
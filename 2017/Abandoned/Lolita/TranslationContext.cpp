@@ -10,13 +10,9 @@ namespace lolita
 		SourceManager& Source;
 		DiagonisticClient& Diagonistic;
 
-		std::vector<SourceFile::Ptr> Files;
-		std::unordered_map<std::string, std::unique_ptr<TokenVec>>
-			LexCache;
-
 		size_t ErrorCount = 0;
 
-		TypeTable Types;
+		TranslationStats* Stats = nullptr;
 	};
 
 	static TranslationContext*& GetContext()
@@ -50,6 +46,22 @@ namespace lolita
 		assert(TestTranslationContext());
 
 		delete GetContext();
+		GetContext() = nullptr;
+	}
+
+	TranslationContext* SuspendTranslation()
+	{
+		assert(TestTranslationContext());
+
+		auto ctx = GetContext();
+		GetContext() = nullptr;
+		return ctx;
+	}
+	void ResumeTranslation(TranslationContext* ctx)
+	{
+		assert(!TestTranslationContext() && ctx != nullptr);
+
+		GetContext() = ctx;
 	}
 
 	void AbortTranslation()
@@ -57,6 +69,16 @@ namespace lolita
 		throw 0;
 	}
 
+	void InstrumentTranslation(TranslationStats* stats)
+	{
+		EnsureAndGetContext().Stats = stats;
+	}
+	TranslationStats* GetTranslationStats()
+	{
+		auto ctx = GetContext();
+		return ctx ? ctx->Stats : nullptr;
+	}
+
 	// Error Impl
 	//
 
@@ -67,6 +89,10 @@ namespace lolita
 		ctx.ErrorCount += 1;
 		ctx.Diagonistic.ReportError(loc, msg.c_str());
 	}
+	size_t GetErrorCount()
+	{
+		return EnsureAndGetContext().ErrorCount;
+	}
 
 	void ReportInvalidChar(const Token& tok)
 	{
@@ -88,38 +114,10 @@ namespace lolita
 	// Source Helper
 	//
 
-	const TokenVec* SearchFile(const std::string& name)
-	{
-		auto& ctx = EnsureAndGetContext();
-
-		// fast path, lookup in the cache
-		auto iter = ctx.LexCache.find(name);
-		if (iter != ctx.LexCache.end())
-		{
-			return iter->second.get();
-		}
-
-		// slow path, open the file and lex
-		auto file = ctx.Source.OpenFile(name);
-		if (file)
-		{
-			auto toks = std::make_unique<TokenVec>(LexSourceFile(file.get()));
-			auto result = toks.get();
-
-			ctx.Files.push_back(std::move(file));
-			ctx.LexCache[name] = std::move(toks);
-			return result;
-		}
-		else
-		{
-			return nullptr;
-		}
-	}
-
-	// TypeTable Impl
-	//
-	TypeTable& GetTypeTable()
+	const HeaderFile* SearchFile(const std::string& name, const SourceFile* includer)
 	{
-		return EnsureAndGetContext().Types;
+		// headers are lexed once and shared by all translation units
+		auto includer_url = includer != nullptr ? includer->Url() : std::string_view{};
+		return GetHeaderCache().Lookup(name, includer_url, EnsureAndGetContext().Source);
 	}
 }
\ No newline at end of file
@@ -1,22 +1,37 @@
 #pragma once
 #include "Token.h"
 #include "SourceManager.h"
+#include "HeaderCache.h"
 #include "DiagonisticClient.h"
+#include "TranslationStats.h"
 #include "Type.h"
 
 namespace lolita
 {
+	struct TranslationContext;
+
 	// Control
 	//
 	bool TestTranslationContext();
 	void InitTranslation(SourceManager& src, DiagonisticClient& diag);
 	void FinalizeTranslation();
+
+	// detach the context from the current thread, so that it could be resumed later
+	TranslationContext* SuspendTranslation();
+	void ResumeTranslation(TranslationContext* ctx);
 	
 	void AbortTranslation();
+
+	// collect statistics of the translation into $stats, nullptr to stop
+	void InstrumentTranslation(TranslationStats* stats);
+
+	// returns nullptr if the translation is not instrumented
+	TranslationStats* GetTranslationStats();
 	
 	// Error Helper
 	//
 	void ReportError(const SourceLocation& loc, const std::string& msg);
+	size_t GetErrorCount();
 
 	void ReportInvalidChar(const Token& tok);
 	void ReportUnexpectedNewline(const Token& tok);
@@ -26,9 +41,7 @@ namespace lolita
 	// Source Helper
 	//
 
-	const TokenVec* SearchFile(const std::string& name);
-
-	// Type Helper
-	//
-	TypeTable& GetTypeTable();
+	// $includer is the file including the header, or nullptr if unspecified
+	// returns nullptr if the file cannot be opened
+	const HeaderFile* SearchFile(const std::string& name, const SourceFile* includer);
 }
\ No newline at end of file
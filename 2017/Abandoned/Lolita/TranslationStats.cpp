@@ -0,0 +1,141 @@
+#include "TranslationStats.h"
+
+using namespace std;
+
+namespace lolita
+{
+	static const char* const kPhaseNames[kPhaseCount] = {
+		"lexing",
+		"preprocessing",
+		"parsing",
+	};
+
+	void TranslationStats::Merge(const TranslationStats& other)
+	{
+		for (size_t i = 0; i < kPhaseCount; ++i)
+		{
+			Phases[i].Seconds += other.Phases[i].Seconds;
+			Phases[i].Tokens += other.Phases[i].Tokens;
+		}
+
+		MacroExpansions += other.MacroExpansions;
+		IncludeHits += other.IncludeHits;
+		IncludeMisses += other.IncludeMisses;
+		AstNodes += other.AstNodes;
+		ArenaBytes += other.ArenaBytes;
+	}
+
+	// Human-readable Table
+	//
+
+	static void PrintTable(const TranslationStats& stats, FILE* out)
+	{
+		auto total = 0.0;
+		for (const auto& phase : stats.Phases)
+		{
+			total += phase.Seconds;
+		}
+
+		fprintf(out, "===== %s =====\n", stats.File.c_str());
+		fprintf(out, "  %-16s %12s %8s %12s\n", "phase", "wall (ms)", "share", "tokens");
+		for (size_t i = 0; i < kPhaseCount; ++i)
+		{
+			const auto& phase = stats.Phases[i];
+			fprintf(out, "  %-16s %12.3f %7.1f%% %12zu\n",
+				kPhaseNames[i], phase.Seconds * 1000, total > 0 ? phase.Seconds / total * 100 : 0.0, phase.Tokens);
+		}
+
+		fprintf(out, "  %-16s %12.3f\n", "total", total * 1000);
+		fprintf(out, "  macro expansions: %zu\n", stats.MacroExpansions);
+		fprintf(out, "  includes: %zu hits, %zu misses\n", stats.IncludeHits, stats.IncludeMisses);
+		fprintf(out, "  ast: %zu nodes, %zu bytes in arena\n", stats.AstNodes, stats.ArenaBytes);
+	}
+
+	// JSON
+	//
+
+	static string EscapeJson(const string& s)
+	{
+		auto result = string{};
+		for (auto ch : s)
+		{
+			switch (ch)
+			{
+			case '"':
+				result += "\\\"";
+				break;
+			case '\\':
+				result += "\\\\";
+				break;
+			case '\n':
+				result += "\\n";
+				break;
+			case '\t':
+				result += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(ch) < 0x20)
+				{
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(ch));
+					result += buffer;
+				}
+				else
+				{
+					result += ch;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	static void PrintJson(const TranslationStats& stats, FILE* out)
+	{
+		fprintf(out, "{\"file\":\"%s\",\"phases\":{", EscapeJson(stats.File).c_str());
+		for (size_t i = 0; i < kPhaseCount; ++i)
+		{
+			const auto& phase = stats.Phases[i];
+			fprintf(out, "%s\"%s\":{\"ms\":%.3f,\"tokens\":%zu}",
+				i == 0 ? "" : ",", kPhaseNames[i], phase.Seconds * 1000, phase.Tokens);
+		}
+
+		fprintf(out, "},\"macro_expansions\":%zu,\"include_hits\":%zu,\"include_misses\":%zu,\"ast_nodes\":%zu,\"arena_bytes\":%zu}",
+			stats.MacroExpansions, stats.IncludeHits, stats.IncludeMisses, stats.AstNodes, stats.ArenaBytes);
+	}
+
+	void PrintTranslationStats(const vector<TranslationStats>& stats, StatsFormat format, FILE* out)
+	{
+		auto total = TranslationStats{};
+		total.File = "<total>";
+		for (const auto& item : stats)
+		{
+			total.Merge(item);
+		}
+
+		if (format == StatsFormat::Table)
+		{
+			for (const auto& item : stats)
+			{
+				PrintTable(item, out);
+			}
+
+			PrintTable(total, out);
+		}
+		else
+		{
+			fputs("{\"files\":[", out);
+			for (size_t i = 0; i < stats.size(); ++i)
+			{
+				if (i != 0)
+					fputc(',', out);
+
+				PrintJson(stats[i], out);
+			}
+
+			fputs("],\"total\":", out);
+			PrintJson(total, out);
+			fputs("}\n", out);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace lolita
+{
+	enum class Phase
+	{
+		Lexing,
+		Preprocessing,
+		Parsing,
+
+		// NOTE not a phase, but the count of phases
+		Count,
+	};
+
+	constexpr size_t kPhaseCount = static_cast<size_t>(Phase::Count);
+
+	struct PhaseStats
+	{
+		// wall time spent, excluding phases nested in it
+		double Seconds = 0;
+
+		// tokens lexed, yielded by the preprocessor, or consumed by the parser
+		size_t Tokens = 0;
+	};
+
+	// Measurements of a translation unit, collected only if it's instrumented
+	struct TranslationStats
+	{
+		using Clock = std::chrono::steady_clock;
+
+		std::string File;
+
+		PhaseStats Phases[kPhaseCount];
+
+		size_t MacroExpansions = 0;
+
+		// inclusions skipped by a guard or reusing a preprocessed header, and the others
+		size_t IncludeHits = 0;
+		size_t IncludeMisses = 0;
+
+		size_t AstNodes = 0;
+		size_t ArenaBytes = 0;
+
+		// the phase being timed, and when it's entered or resumed
+		Phase Current = Phase::Count;
+		Clock::time_point Since;
+
+		PhaseStats& operator[](Phase phase)
+		{
+			return Phases[static_cast<size_t>(phase)];
+		}
+
+		// accumulate another one, e.g. into the total
+		void Merge(const TranslationStats& other);
+	};
+
+	// Times a phase into $stats for its lifetime, and pauses the phase it's nested in
+	// NOTE only a null check is paid if $stats is nullptr, i.e. not instrumented
+	class PhaseTimer
+	{
+	public:
+		PhaseTimer(TranslationStats* stats, Phase phase)
+			: stats_(stats), phase_(phase)
+		{
+			if (stats_)
+			{
+				previous_ = stats_->Current;
+				Switch(phase_);
+			}
+		}
+
+		~PhaseTimer()
+		{
+			if (stats_)
+			{
+				Switch(previous_);
+			}
+		}
+
+		PhaseTimer(const PhaseTimer&) = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	private:
+		void Switch(Phase next)
+		{
+			auto now = TranslationStats::Clock::now();
+			if (stats_->Current != Phase::Count)
+			{
+				(*stats_)[stats_->Current].Seconds += std::chrono::duration<double>(now - stats_->Since).count();
+			}
+
+			stats_->Current = next;
+			stats_->Since = now;
+		}
+
+		TranslationStats* stats_;
+		Phase phase_;
+		Phase previous_ = Phase::Count;
+	};
+
+	enum class StatsFormat
+	{
+		Table,
+		Json,
+	};
+
+	// print statistics of each translation unit and the total, like -ftime-report
+	void PrintTranslationStats(const std::vector<TranslationStats>& stats, StatsFormat format, FILE* out = stdout);
+}
\ No newline at end of file
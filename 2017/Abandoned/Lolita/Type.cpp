@@ -1,13 +1,13 @@
 #include "Type.h"
-#include <random>
+#include <algorithm>
+#include <memory>
+#include <new>
 
 namespace lolita
 {
 	// Helpers
 	//
 
-	extern TypeTable& GetTypeTable();
-
 	bool operator==(TypeQualifier lhs, TypeQualifier rhs)
 	{
 		return lhs.Const == rhs.Const
@@ -25,47 +25,83 @@ namespace lolita
 
 	// Hash Functions
 	//
-	TypeHash HushQualType(QualType type)
-	{
-		auto result = type.Type->Hash();
 
-		if (type.Quals.Const)
-			result *= 17;
-		if (type.Quals.Restrict)
-			result *= 23;
-		if (type.Quals.Volatile)
-			result *= 31;
-
-		return result;
+	static TypeHash CombineHash(TypeHash seed, TypeHash value)
+	{
+		return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
 	}
 
-	TypeHash RandomTypeHash()
+	// spread bits of the hash, as the top bits select a shard and the bottom bits a slot
+	static TypeHash FinalizeHash(TypeHash hash)
 	{
-		// FIXME: thread_local?
-		static auto rnd_engine = std::minstd_rand{};
-		return rnd_engine();
+		hash ^= hash >> 16;
+		hash *= 0x85ebca6b;
+		hash ^= hash >> 13;
+		hash *= 0xc2b2ae35;
+		hash ^= hash >> 16;
+
+		return hash;
 	}
-	TypeHash HashPointerType(QualType base)
+
+	static TypeHash HashQualType(QualType type)
 	{
-		return 0x8f9d7e63 ^ HushQualType(base) + 0x1234;
+		auto quals = (type.Quals.Const ? 1 : 0)
+			| (type.Quals.Restrict ? 2 : 0)
+			| (type.Quals.Volatile ? 4 : 0);
+
+		return CombineHash(type.Type->Hash(), quals);
 	}
-	TypeHash HashArrayType(QualType base, size_t cnt)
+
+	TypeHash TypeKey::Hash() const
 	{
-		return (0x6c7d2333 + 37 * cnt) ^ HushQualType(base) + 0xfe41;
+		auto result = CombineHash(static_cast<TypeHash>(Category), HashQualType(Base));
+		switch (Category)
+		{
+		case TypeCategory::Array:
+			result = CombineHash(result, static_cast<TypeHash>(Count));
+			break;
+		case TypeCategory::Function:
+			for (size_t i = 0; i < ParamCount; ++i)
+			{
+				result = CombineHash(result, HashQualType(Params[i]));
+			}
+
+			result = CombineHash(result, VaArgs ? 1 : 0);
+			break;
+		}
+
+		return FinalizeHash(result);
 	}
-	TypeHash HashFunctionType(QualType ret, const QualTypeVec& params, bool va_args) 
+
+	bool TypeKey::Matches(const CType* type) const
 	{
-		auto result = HushQualType(ret);
-		for (auto type : params)
+		switch (Category)
+		{
+		case TypeCategory::Pointer:
+			return type->IsPointer()
+				&& static_cast<const PointerType*>(type)->BaseType() == Base;
+		case TypeCategory::Array:
+		{
+			if (!type->IsArray())
+				return false;
+
+			auto arr = static_cast<const ArrayType*>(type);
+			return arr->BaseType() == Base && arr->Count() == Count;
+		}
+		case TypeCategory::Function:
 		{
-			result *= 11;
-			result ^= HushQualType(type);
+			if (!type->IsFunction())
+				return false;
+
+			auto func = static_cast<const FunctionType*>(type);
+			return func->ReturnType() == Base
+				&& func->VaArgs() == VaArgs
+				&& func->ParamTypes().size() == ParamCount
+				&& std::equal(Params, Params + ParamCount, func->ParamTypes().begin());
+		}
 		}
-		
-		if (va_args)
-			result *= 19;
 
-		return result;
+		return false;
 	}
 
 	// Other Functions
@@ -75,6 +111,8 @@ namespace lolita
 	{
 		switch (type)
 		{
+		case BuiltinType::Void:
+			return 0;
 		case BuiltinType::Boolean:
 		case BuiltinType::Char:
 		case BuiltinType::Int8:
@@ -100,23 +138,31 @@ namespace lolita
 
 		// init builtins
 		// NOTE order of initialization is important
-		result.emplace_back(BuiltinType::Void);
+		const BuiltinType types[] = {
+			BuiltinType::Void,
+
+			BuiltinType::Boolean,
+			BuiltinType::Char,
 
-		result.emplace_back(BuiltinType::Boolean);
-		result.emplace_back(BuiltinType::Char);
+			BuiltinType::Int8,
+			BuiltinType::Int16,
+			BuiltinType::Int32,
+			BuiltinType::Int64,
 
-		result.emplace_back(BuiltinType::Int8);
-		result.emplace_back(BuiltinType::Int16);
-		result.emplace_back(BuiltinType::Int32);
-		result.emplace_back(BuiltinType::Int64);
+			BuiltinType::UInt8,
+			BuiltinType::UInt16,
+			BuiltinType::UInt32,
+			BuiltinType::UInt64,
 
-		result.emplace_back(BuiltinType::UInt8);
-		result.emplace_back(BuiltinType::UInt16);
-		result.emplace_back(BuiltinType::UInt32);
-		result.emplace_back(BuiltinType::UInt64);
+			BuiltinType::Float32,
+			BuiltinType::Float64,
+		};
 
-		result.emplace_back(BuiltinType::Float32);
-		result.emplace_back(BuiltinType::Float64);
+		for (auto type : types)
+		{
+			// NOTE hash of a builtin must be identical in every run and every thread
+			result.emplace_back(FinalizeHash(static_cast<TypeHash>(type) + 1), type);
+		}
 
 		return result;
 	}
@@ -125,7 +171,27 @@ namespace lolita
 	//
 
 	TypeTable::TypeTable()
-		: builtins_(CreateBuiltinTypeVec()) { }
+		: builtins_(CreateBuiltinTypeVec())
+	{
+		for (auto& shard : shards_)
+		{
+			Grow(shard, kInitialCapacity);
+		}
+	}
+
+	TypeTable::~TypeTable()
+	{
+		// type nodes are placed in chunks, so destroy them explicitly
+		for (auto& shard : shards_)
+		{
+			auto& table = *shard.Table.load(std::memory_order_relaxed);
+			for (size_t i = 0; i <= table.Mask; ++i)
+			{
+				if (auto type = table.Slots[i].load(std::memory_order_relaxed))
+					type->~CType();
+			}
+		}
+	}
 
 	CType* TypeTable::MakeBuiltin(BuiltinType type)
 	{
@@ -135,83 +201,162 @@ namespace lolita
 		return &builtins_[index];
 	}
 
-	// FIXME: TypeTable::Make* functions are very similar
 	CType* TypeTable::MakePointer(QualType base)
 	{
-		// calculate hash
-		auto hash = HashPointerType(base);
-		
-		// find ptr type in cache
-		auto iter_pair = ptr_arena_.equal_range(hash);
-		for (auto iter = iter_pair.first; iter != iter_pair.second; ++iter)
+		auto key = TypeKey{ TypeCategory::Pointer, base };
+		return Intern(key);
+	}
+	
+	CType* TypeTable::MakeArray(QualType base, size_t cnt)
+	{
+		auto key = TypeKey{ TypeCategory::Array, base, cnt };
+		return Intern(key);
+	}
+	
+	CType* TypeTable::MakeFunction(QualType ret, const QualTypeVec& params, bool va_args)
+	{
+		auto key = TypeKey{ TypeCategory::Function, ret, 0, params.data(), params.size(), va_args };
+		return Intern(key);
+	}
+
+	size_t TypeTable::Size() const
+	{
+		auto result = size_t{ 0 };
+		for (auto& shard : shards_)
 		{
-			auto type = iter->second.get();
-			if (type->BaseType() == base)
-			{
-				return type;
-			}
+			std::lock_guard<std::mutex> lock{ shard.Mutex };
+			result += shard.Count;
 		}
 
-		// then type is not yet created
-		// so construct one
-		auto result_iter = ptr_arena_.insert(
-			std::make_pair(hash, std::make_unique<PointerType>(base))
-		);
+		return result;
+	}
+
+	CType* TypeTable::Intern(const TypeKey& key)
+	{
+		auto hash = key.Hash();
+		auto& shard = shards_[hash >> (32 - kShardBits)];
+
+		// a quick path without locking, as most of types are made more than once
+		if (auto type = Probe(*shard.Table.load(std::memory_order_acquire), key, hash))
+			return type;
+
+		std::lock_guard<std::mutex> lock{ shard.Mutex };
+
+		// NOTE the type may be made by another thread, or the table may be grown since the probe
+		auto table = shard.Table.load(std::memory_order_relaxed);
+		if (auto type = Probe(*table, key, hash))
+			return type;
 
-		return result_iter->second.get();
+		// keep the load factor no more than 1/2
+		if ((shard.Count + 1) * 2 > table->Mask + 1)
+			table = Grow(shard, (table->Mask + 1) * 2);
+
+		auto type = Construct(shard, key, hash);
+		Insert(*table, type);
+		shard.Count += 1;
+
+		return type;
 	}
-	
-	CType* TypeTable::MakeArray(QualType base, size_t cnt)
+
+	CType* TypeTable::Construct(Shard& shard, const TypeKey& key, TypeHash hash)
 	{
-		// calculate hash
-		auto hash = HashArrayType(base, cnt);
+		switch (key.Category)
+		{
+		case TypeCategory::Pointer:
+			return new (Allocate(shard, sizeof(PointerType), alignof(PointerType))) PointerType(hash, key.Base);
+		case TypeCategory::Array:
+			return new (Allocate(shard, sizeof(ArrayType), alignof(ArrayType))) ArrayType(hash, key.Base, key.Count);
+		case TypeCategory::Function:
+		{
+			auto params = static_cast<QualType*>(Allocate(shard, sizeof(QualType) * key.ParamCount, alignof(QualType)));
+			std::uninitialized_copy(key.Params, key.Params + key.ParamCount, params);
+
+			return new (Allocate(shard, sizeof(FunctionType), alignof(FunctionType)))
+				FunctionType(hash, key.Base, ArenaArray<QualType>{ params, key.ParamCount }, key.VaArgs);
+		}
+		}
 
-		// find array type in cache
-		auto iter_pair = arr_arena_.equal_range(hash);
-		for (auto iter = iter_pair.first; iter != iter_pair.second; ++iter)
+		assert(false);
+		return nullptr;
+	}
+
+	void* TypeTable::Allocate(Shard& shard, size_t size, size_t align)
+	{
+		auto offset = (align - reinterpret_cast<uintptr_t>(shard.Cursor) % align) % align;
+		if (size + offset > static_cast<size_t>(shard.Limit - shard.Cursor))
 		{
-			auto type = iter->second.get();
-			if (type->BaseType() == base
-				&& type->Count() == cnt)
-			{
-				return type;
-			}
+			// NOTE types are small, so that a chunk always fits one
+			assert(size + align <= kChunkSize);
+
+			shard.Chunks.push_back(std::make_unique<char[]>(kChunkSize));
+			shard.Cursor = shard.Chunks.back().get();
+			shard.Limit = shard.Cursor + kChunkSize;
+
+			offset = (align - reinterpret_cast<uintptr_t>(shard.Cursor) % align) % align;
 		}
 
-		// then type is not yet created
-		// so construct one
-		auto result_iter = arr_arena_.insert(
-			std::make_pair(hash, std::make_unique<ArrayType>(base, cnt))
-		);
+		auto result = shard.Cursor + offset;
+		shard.Cursor = result + size;
 
-		return result_iter->second.get();
+		return result;
 	}
-	
-	CType* TypeTable::MakeFunction(QualType ret, const QualTypeVec& params, bool va_args)
+
+	TypeTable::SlotArray* TypeTable::Grow(Shard& shard, size_t capacity)
 	{
-		// calculate hash
-		auto hash = HashFunctionType(ret, params, va_args);
+		auto table = std::make_unique<SlotArray>();
+		table->Mask = capacity - 1;
+		table->Slots = std::make_unique<std::atomic<CType*>[]>(capacity);
+		for (size_t i = 0; i < capacity; ++i)
+		{
+			table->Slots[i].store(nullptr, std::memory_order_relaxed);
+		}
 
-		// find function type in cache
-		auto iter_pair = func_arena_.equal_range(hash);
-		for (auto iter = iter_pair.first; iter != iter_pair.second; ++iter)
+		// rehash types into the new table before it's published
+		if (auto old_table = shard.Table.load(std::memory_order_relaxed))
 		{
-			auto type = iter->second.get();
-			if (type->ReturnType() == ret
-				&& type->ParamTypes() == params
-				&& type->VaArgs() == va_args)
+			for (size_t i = 0; i <= old_table->Mask; ++i)
 			{
-				return type;
+				if (auto type = old_table->Slots[i].load(std::memory_order_relaxed))
+					Insert(*table, type);
 			}
 		}
 
-		// then type is not yet created
-		// so construct one
-		auto result_iter = func_arena_.insert(
-			std::make_pair(hash, std::make_unique<FunctionType>(ret, params, va_args))
-		);
+		auto result = table.get();
+		shard.Tables.push_back(std::move(table));
+		shard.Table.store(result, std::memory_order_release);
+
+		return result;
+	}
 
-		return result_iter->second.get();
+	CType* TypeTable::Probe(const SlotArray& table, const TypeKey& key, TypeHash hash)
+	{
+		for (auto i = hash & table.Mask; ; i = (i + 1) & table.Mask)
+		{
+			auto type = table.Slots[i].load(std::memory_order_acquire);
+			if (type == nullptr)
+				return nullptr;
+
+			if (type->Hash() == hash && key.Matches(type))
+				return type;
+		}
+	}
+
+	void TypeTable::Insert(SlotArray& table, CType* type)
+	{
+		auto i = type->Hash() & table.Mask;
+		while (table.Slots[i].load(std::memory_order_relaxed) != nullptr)
+		{
+			i = (i + 1) & table.Mask;
+		}
+
+		// NOTE publish the slot after the type is constructed, for readers without lock
+		table.Slots[i].store(type, std::memory_order_release);
+	}
+
+	TypeTable& GetTypeTable()
+	{
+		static TypeTable table;
+		return table;
 	}
 
 	// ShiftBase Impl
@@ -220,7 +365,7 @@ namespace lolita
 	CType* CType::ShiftBase(CType* old_base, CType* new_base) const
 	{
 		// NOTE instance of CType is unique globally
-		// managed by a TypeTable instance managed by TranslationContext
+		// managed by the process-wide TypeTable
 		if (this == old_base)
 			return new_base;
 		else
@@ -263,7 +408,7 @@ namespace lolita
 			->ShiftBase(old_base, new_base)
 			->MakeQualified(ret_type_.Quals),
 
-			param_types_,
+			QualTypeVec{ param_types_.begin(), param_types_.end() },
 			va_args_
 		);
 	}
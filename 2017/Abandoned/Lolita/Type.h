@@ -8,8 +8,9 @@
 #include <map>
 #include <vector>
 #include <cassert>
+#include <atomic>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
 
 namespace lolita
 {
@@ -35,20 +36,48 @@ namespace lolita
 
 	using TypeHash = uint32_t;
 
-	TypeHash RandomTypeHash();
-	TypeHash HashPointerType(QualType base);
-	TypeHash HashArrayType(QualType base, size_t cnt);
-	TypeHash HashFunctionType(QualType ret, const QualTypeVec& params, bool va_args);
-
 	size_t CalcBuiltinTypeSize(BuiltinType type);
 
+	enum class TypeCategory
+	{
+		Pointer,
+		Array,
+		Function,
+	};
+
+	// the structure of a derived type, by which types are hash-consed
+	// NOTE component types are canonical, so they're compared by pointer
+	struct TypeKey
+	{
+		TypeCategory Category;
+
+		// pointee type, element type or return type
+		QualType Base;
+
+		// for array only
+		size_t Count = 0;
+
+		// for function only
+		const QualType* Params = nullptr;
+		size_t ParamCount = 0;
+		bool VaArgs = false;
+
+		TypeHash Hash() const;
+		bool Matches(const CType* type) const;
+	};
+
 	// TypeTable
 	//
 
+	// The process-wide store of canonical types, so that types made by translation units
+	// running concurrently are still identical if and only if they're the same pointer
+	// NOTE types are hash-consed into shards of flat open-addressing tables,
+	//      and looking up a type already made never takes a lock
 	class TypeTable : NonMovable
 	{
 	public:
 		TypeTable();
+		~TypeTable();
 
 		CType* MakeBuiltin(BuiltinType type);
 
@@ -56,18 +85,56 @@ namespace lolita
 		CType* MakeArray(QualType type, size_t cnt);
 		CType* MakeFunction(QualType ret_type, const QualTypeVec& params, bool va_args = false);
 
+		// number of derived types made
+		size_t Size() const;
+
 	private:
-		void PushBuiltin(BuiltinType type);
+		// a power-of-two array of slots probed linearly, where nullptr marks an empty slot
+		struct SlotArray
+		{
+			size_t Mask;
+			std::unique_ptr<std::atomic<CType*>[]> Slots;
+		};
+
+		struct Shard
+		{
+			// table of the shard, which is only replaced with the mutex held
+			std::atomic<SlotArray*> Table{ nullptr };
 
-		template <typename T>
-		using TypeMultimap = std::unordered_multimap<TypeHash, std::unique_ptr<T>>;
+			mutable std::mutex Mutex;
+			size_t Count = 0;
+
+			// every table ever used, as readers may be probing an old one
+			std::vector<std::unique_ptr<SlotArray>> Tables;
+
+			// type nodes are bump-allocated from chunks
+			std::vector<std::unique_ptr<char[]>> Chunks;
+			char* Cursor = nullptr;
+			char* Limit = nullptr;
+		};
+
+		// types are distributed into shards by the top bits of their hash
+		static constexpr size_t kShardBits = 4;
+		static constexpr size_t kShardCount = size_t(1) << kShardBits;
+
+		static constexpr size_t kInitialCapacity = 64;
+		static constexpr size_t kChunkSize = 16 * 1024;
+
+		CType* Intern(const TypeKey& key);
+		CType* Construct(Shard& shard, const TypeKey& key, TypeHash hash);
+		void* Allocate(Shard& shard, size_t size, size_t align);
+		SlotArray* Grow(Shard& shard, size_t capacity);
+
+		static CType* Probe(const SlotArray& table, const TypeKey& key, TypeHash hash);
+		static void Insert(SlotArray& table, CType* type);
 
 		std::vector<PrimaryType> builtins_;
-		TypeMultimap<PointerType> ptr_arena_;
-		TypeMultimap<ArrayType> arr_arena_;
-		TypeMultimap<FunctionType> func_arena_;
+		Shard shards_[kShardCount];
 	};
 
+	// the process-wide type table
+	TypeTable& GetTypeTable();
+
 	// CType Base Class
 	//
 
@@ -144,13 +211,20 @@ namespace lolita
 		size_t align_ = 0;
 	};
 
+	// NOTE types are only made by TypeTable, with the hash of their structure
+	//
+
 	class PrimaryType : public CType
 	{
 	public:
-		PrimaryType(BuiltinType type)
-			: CType(RandomTypeHash()), type_(type)
+		PrimaryType(TypeHash hash, BuiltinType type)
+			: CType(hash), type_(type)
 		{
-
+			// NOTE void is left incomplete
+			if (type != BuiltinType::Void)
+			{
+				SetSize(CalcBuiltinTypeSize(type));
+			}
 		}
 
 		bool IsBuiltin() const override { return true; }
@@ -179,8 +253,8 @@ namespace lolita
 	class PointerType : public CType
 	{
 	public:
-		PointerType(QualType base)
-			: CType(HashPointerType(base))
+		PointerType(TypeHash hash, QualType base)
+			: CType(hash)
 			, base_type_(base) 
 		{
 			assert(base.Type != nullptr);
@@ -200,8 +274,8 @@ namespace lolita
 	class ArrayType : public CType
 	{
 	public:
-		ArrayType(QualType base, size_t count)
-			: CType(HashArrayType(base, count))
+		ArrayType(TypeHash hash, QualType base, size_t count)
+			: CType(hash)
 			, base_type_(base)
 			, count_(count)
 		{
@@ -216,6 +290,8 @@ namespace lolita
 		auto BaseType() const { return base_type_; }
 		auto Count() const { return count_; }
 
+		bool IsArray() const override { return true; }
+
 		virtual CType* ShiftBase(CType* old_base, CType* new_base) const override;
 
 	private:
@@ -226,10 +302,11 @@ namespace lolita
 	class FunctionType : public CType
 	{
 	public:
-		FunctionType(QualType ret, 
-			std::vector<QualType> params,
+		FunctionType(TypeHash hash,
+			QualType ret, 
+			ArenaArray<QualType> params,
 			bool va_args)
-			: CType(HashFunctionType(ret, params, va_args))
+			: CType(hash)
 			, ret_type_(ret)
 			, param_types_(params)
 			, va_args_(va_args)
@@ -241,10 +318,12 @@ namespace lolita
 		const auto& ParamTypes() const { return param_types_; }
 		auto VaArgs() const { return va_args_; }
 
+		bool IsFunction() const override { return true; }
+
 		virtual CType* ShiftBase(CType* old_base, CType* new_base) const override;
 	private:
 		QualType ret_type_;
-		std::vector<QualType> param_types_;
+		ArenaArray<QualType> param_types_;
 		bool va_args_;
 	};
 